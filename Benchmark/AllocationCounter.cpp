@@ -0,0 +1,45 @@
+//
+//  AllocationCounter.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/7/25.
+//
+
+#include "AllocationCounter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Relaxed atomics keep the counts right if a benchmark ever uses threads, and cost about
+// the same as a plain increment on the machines we use.
+static std::atomic<long> allocationCount{0};
+static std::atomic<long> allocationBytes{0};
+
+// The totals since the program started
+AllocationCount currentAllocations() {
+    return AllocationCount{allocationCount.load(std::memory_order_relaxed), allocationBytes.load(std::memory_order_relaxed)};
+}
+
+// The allocations made since an earlier call to currentAllocations()
+AllocationCount allocationsSince(const AllocationCount &start) {
+    AllocationCount now = currentAllocations();
+    return AllocationCount{now.allocations - start.allocations, now.bytes - start.bytes};
+}
+
+// Replacements for the global operator new and delete. The array and nothrow forms in the
+// standard library call these, so they are counted too.
+void *operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(static_cast<long>(size), std::memory_order_relaxed);
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,33 @@
+//
+//  AllocationCounter.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/7/25.
+//
+
+#ifndef AllocationCounter_hpp
+#define AllocationCounter_hpp
+
+#include <stdio.h>
+#include <cstddef>
+
+/*
+ *******************************************************************************************
+ * Allocation counting
+ * The benchmark executable replaces the global operator new and delete so it can report
+ * how many heap allocations each benchmark makes. This is only linked into the benchmark,
+ * never into the simulator itself.
+ *******************************************************************************************
+ */
+struct AllocationCount {
+    long allocations; // Calls to operator new
+    long bytes; // Bytes requested from operator new
+};
+
+// The totals since the program started
+AllocationCount currentAllocations();
+
+// The allocations made since an earlier call to currentAllocations()
+AllocationCount allocationsSince(const AllocationCount &start);
+
+#endif /* AllocationCounter_hpp */
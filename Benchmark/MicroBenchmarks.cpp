@@ -0,0 +1,312 @@
+//
+//  MicroBenchmarks.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/7/25.
+//
+
+#include "MicroBenchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Simulation.hpp"
+#include "SimClock.hpp"
+#include "ChargerQueue.hpp"
+#include "PlaneQueue.hpp"
+#include "Plane.hpp"
+#include "SimRandom.hpp"
+#include "SimTrace.hpp"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <climits>
+#include <cstdio>
+
+/*
+ *******************************************************************************************
+ * Micro benchmarks
+ * Each benchmark sets up what it needs, then times only the operations it reports. The
+ * allocation counts cover the same timed section. The queues are used on their own
+ * (without a Simulation) the same way their tests use them.
+ *******************************************************************************************
+ */
+
+// Write this result as one line of JSON
+void BenchmarkResult::write(std::ostream &out) const {
+    std::ostringstream line;
+    line << std::setprecision(6) << std::fixed
+    << "{\"benchmark\": \"" << name << "\""
+    << ", \"size\": " << size
+    << ", \"operations\": " << operations
+    << ", \"seconds\": " << seconds
+    << ", \"ns_per_op\": " << std::setprecision(1) << nsPerOperation()
+    << ", \"events_per_sec\": " << std::setprecision(0) << eventsPerSecond
+    << ", \"allocations\": " << allocations
+    << ", \"bytes\": " << bytes;
+    if(!counters.empty()) {
+        line << ", \"counters\": " << counters;
+    }
+    line << "}";
+    out << line.str() << std::endl;
+}
+
+// The default settings changed to match this preset
+SimSettings StressPreset::settings() const {
+    SimSettings someSettings{};
+    someSettings.simulationDuration = hours * secondsPerHour;
+    someSettings.planeCount = planeCount;
+    someSettings.chargerCount = chargerCount;
+    someSettings.minPlanePerKind = minPlanePerKind;
+    someSettings.maxPassengerDelay = maxPassengerDelay;
+    someSettings.randomSeed = benchmarkSeed;
+    someSettings.progressInterval = 0;
+    return someSettings;
+}
+
+// These match the stress test menu in MainMenu.cpp
+const std::vector<StressPreset> stressPresets {
+    {"30 hours", 30, 20, 3, 1, 0},
+    {"300 hours", 300, 20, 3, 1, 0},
+    {"3,000 hours", 3000, 20, 3, 1, 0},
+    {"35,040 hours", 35040, 20, 3, 1, 0},
+    {"4 years, 1000 planes, 150 chargers", 35040, 1000, 150, 100, secondsPerHour},
+};
+
+// Times a section of a benchmark and records its allocations. Call stop() at the end of
+// the section so building the result is not counted.
+class BenchmarkTimer {
+    std::chrono::high_resolution_clock::time_point startTime;
+    AllocationCount startAllocations;
+    double seconds;
+    AllocationCount used;
+public:
+    BenchmarkTimer(): startTime{std::chrono::high_resolution_clock::now()}, startAllocations{currentAllocations()},
+    seconds{0}, used{0, 0} {
+    }
+    void stop() {
+        seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+        used = allocationsSince(startAllocations);
+    }
+    // Make the result for the section that was timed
+    BenchmarkResult result(const std::string &name, long size, long operations, long events = 0) {
+        return BenchmarkResult{name, size, operations, seconds,
+            (events > 0 && seconds > 0) ? events / seconds : 0.0, used.allocations, used.bytes};
+    }
+};
+
+// A handler that does nothing when called, so timing the clock times only the clock
+class BenchmarkHandler: public EventHandler {
+public:
+    BenchmarkHandler(long nextEventTime): EventHandler(nextEventTime) {
+    }
+    virtual bool handleEvent(long currentTime, bool closeOut) override {
+        return false;
+    }
+    virtual const std::string describe() override {
+        return "Benchmark EventHandler";
+    }
+};
+
+// Time SimClock addHandler, reSortHandler and handling events with handlerCount handlers
+void benchmarkSimClock(long handlerCount, std::vector<BenchmarkResult> &results) {
+    const long timeRange = handlerCount * 100;
+    SimRandom random(benchmarkSeed);
+    std::vector<std::shared_ptr<EventHandler>> handlers;
+    handlers.reserve(handlerCount);
+    for(long i = 0; i < handlerCount; i++) {
+        handlers.push_back(std::make_shared<BenchmarkHandler>(random.uniformLong(1, timeRange)));
+    }
+    SimClock aClock(nullptr, timeRange + 1);
+
+    BenchmarkTimer addTimer;
+    for(const std::shared_ptr<EventHandler> &aHandler: handlers) {
+        aClock.addHandler(aHandler);
+    }
+    addTimer.stop();
+    results.push_back(addTimer.result("SimClock.addHandler", handlerCount, handlerCount));
+
+    // Move handlers to new times, as the queues do when their next event changes
+    std::vector<long> newTimes(handlerCount);
+    for(long &aTime: newTimes) { aTime = random.uniformLong(1, timeRange); }
+    BenchmarkTimer reSortTimer;
+    for(long i = 0; i < handlerCount; i++) {
+        handlers[i]->setNextEventTime(newTimes[i]);
+        aClock.reSortHandler(handlers[i]);
+    }
+    reSortTimer.stop();
+    results.push_back(reSortTimer.result("SimClock.reSortHandler", handlerCount, handlerCount));
+
+    // Each handler is popped and called once, then leaves the clock
+    BenchmarkTimer popTimer;
+    aClock.run(false);
+    popTimer.stop();
+    results.push_back(popTimer.result("SimClock.pop", handlerCount, handlerCount));
+}
+
+// Time ChargerQueue addPlane and handling charges with planeCount planes and chargerCount chargers
+void benchmarkChargerQueue(long planeCount, long chargerCount, std::vector<BenchmarkResult> &results) {
+    std::vector<std::shared_ptr<Plane>> planes;
+    planes.reserve(planeCount);
+    for(long i = 0; i < planeCount; i++) {
+        planes.push_back(Plane::getRandomPlane());
+    }
+    std::shared_ptr<ChargerQueue> aQueue = std::make_shared<ChargerQueue>(nullptr, chargerCount);
+
+    // The first chargerCount planes get chargers, the rest wait
+    BenchmarkTimer addTimer;
+    for(const std::shared_ptr<Plane> &aPlane: planes) {
+        aQueue->addPlane(0, aPlane);
+    }
+    addTimer.stop();
+    results.push_back(addTimer.result("ChargerQueue.addPlane", planeCount, planeCount));
+
+    // Handle charges until every plane has been charged
+    BenchmarkTimer chargeTimer;
+    long events = 0;
+    while(aQueue->getNextEventTime() != LONG_MAX) {
+        aQueue->handleEvent(aQueue->getNextEventTime(), false);
+        events++;
+    }
+    chargeTimer.stop();
+    results.push_back(chargeTimer.result("ChargerQueue.handleEvent", planeCount, planeCount, events));
+}
+
+// Time PlaneQueue addPlane and taking off with planeCount planes
+void benchmarkPlaneQueue(long planeCount, std::vector<BenchmarkResult> &results) {
+    SimRandom random(benchmarkSeed);
+    std::vector<std::shared_ptr<Plane>> planes;
+    std::vector<long> readyTimes;
+    planes.reserve(planeCount);
+    readyTimes.reserve(planeCount);
+    for(long i = 0; i < planeCount; i++) {
+        planes.push_back(Plane::getRandomPlane());
+        readyTimes.push_back(random.uniformLong(0, planeCount * 10));
+    }
+    std::shared_ptr<PlaneQueue> aQueue = std::make_shared<PlaneQueue>(nullptr);
+
+    BenchmarkTimer addTimer;
+    for(long i = 0; i < planeCount; i++) {
+        aQueue->addPlane(readyTimes[i], planes[i]);
+    }
+    addTimer.stop();
+    results.push_back(addTimer.result("PlaneQueue.addPlane", planeCount, planeCount));
+
+    // Take off every plane in order
+    BenchmarkTimer takeOffTimer;
+    long events = 0;
+    while(aQueue->getNextEventTime() != LONG_MAX) {
+        aQueue->handleEvent(aQueue->getNextEventTime(), false);
+        events++;
+    }
+    takeOffTimer.stop();
+    results.push_back(takeOffTimer.result("PlaneQueue.handleEvent", planeCount, planeCount, events));
+}
+
+// Time Plane::createFaultInterval
+void benchmarkFaultIntervals(long count, std::vector<BenchmarkResult> &results) {
+    std::shared_ptr<Plane> aPlane = Plane::getRandomPlane();
+    long total = 0;
+    BenchmarkTimer faultTimer;
+    for(long i = 0; i < count; i++) {
+        total += aPlane->createFaultInterval();
+    }
+    faultTimer.stop();
+    results.push_back(faultTimer.result("Plane.createFaultInterval", 1, count));
+    // Use the total so the loop is not optimized away
+    if(total == LONG_MIN) { std::cerr << total << std::endl; }
+}
+
+// Time Simulation::run on a preset with one engine
+void benchmarkPreset(const StressPreset &aPreset, int engineOption, std::vector<BenchmarkResult> &results) {
+    SimSettings someSettings = aPreset.settings();
+    someSettings.engineOption = engineOption;
+    Simulation aSimulation(someSettings);
+    aSimulation.setQuiet(true);
+    BenchmarkTimer runTimer;
+    aSimulation.run(false);
+    std::string name = std::string{"Simulation.run "} + (engineOption == 1 ? "FastEngine " : "SimClock ") + aPreset.name;
+    runTimer.stop();
+    results.push_back(runTimer.result(name, aPreset.planeCount, aSimulation.getEventCount(), aSimulation.getEventCount()));
+}
+
+// Time Simulation::run on a preset with one engine while writing a trace of it. Compare with
+// benchmarkPreset to see what the trace costs. The trace file is removed afterwards.
+void benchmarkTracedPreset(const StressPreset &aPreset, int engineOption, std::vector<BenchmarkResult> &results) {
+    SimSettings someSettings = aPreset.settings();
+    someSettings.engineOption = engineOption;
+    const char *path = "JobyBenchmarkTrace.json";
+    Simulation aSimulation(someSettings);
+    aSimulation.setQuiet(true);
+    BenchmarkTimer runTimer;
+    {
+        SimTrace aTrace(path);
+        aSimulation.setTrace(&aTrace);
+        aSimulation.run(false);
+    }
+    std::string name = std::string{"Simulation.run + SimTrace "} + (engineOption == 1 ? "FastEngine " : "SimClock ") + aPreset.name;
+    runTimer.stop();
+    std::remove(path);
+    results.push_back(runTimer.result(name, aPreset.planeCount, aSimulation.getEventCount(), aSimulation.getEventCount()));
+}
+
+// Run Simulation::run on a preset with one engine, profiled with the hardware counters, and
+// report the counts per event for the event loop and each kind of event. The profiler's
+// sampling and the counter reads make this run slower than benchmarkPreset, so its time is
+// not comparable. Where the counters are not available it reports why and the timing only.
+void benchmarkCountedPreset(const StressPreset &aPreset, int engineOption, std::vector<BenchmarkResult> &results) {
+    SimSettings someSettings = aPreset.settings();
+    someSettings.engineOption = engineOption;
+    someSettings.profileOption = 2;
+    Simulation aSimulation(someSettings);
+    aSimulation.setQuiet(true);
+    BenchmarkTimer runTimer;
+    aSimulation.run(false);
+    std::string name = std::string{"Simulation.run + counters "} + (engineOption == 1 ? "FastEngine " : "SimClock ") + aPreset.name;
+    runTimer.stop();
+    BenchmarkResult aResult = runTimer.result(name, aPreset.planeCount, aSimulation.getEventCount(), aSimulation.getEventCount());
+    const SimProfile &aProfile = aSimulation.getProfile();
+    std::ostringstream counters;
+    if(aProfile.countersAvailable) {
+        // One object per row: the whole event loop, then the timed events of each kind
+        counters << std::setprecision(1) << std::fixed << "{";
+        for(int kind = -1; kind < profileKindCount; kind++) {
+            if(kind >= 0 && aProfile.kinds[kind].sampledEvents == 0) { continue; }
+            counters << (kind >= 0 ? ", " : "") << "\"" << (kind < 0 ? "EventLoop" : profileKindName(kind)) << "\": {";
+            const char *separator = "";
+            for(int counter = 0; counter < hardwareCounterCount; counter++) {
+                if(!aProfile.countersOpened[counter]) { continue; }
+                counters << separator << "\"" << hardwareCounterName(counter) << "\": "
+                << (kind < 0 ? aProfile.loopCountPerEvent(counter) : aProfile.kinds[kind].countPerEvent(counter));
+                separator = ", ";
+            }
+            counters << "}";
+        }
+        counters << "}";
+    } else {
+        counters << "\"unavailable: " << aProfile.countersNote << "\"";
+    }
+    aResult.counters = counters.str();
+    results.push_back(aResult);
+}
+
+// Time the main menu's "Average results from 100 Simulations" with one engine.
+// Like runMultiple(), each run uses the next seed and the results are added up.
+void benchmarkRunMultiple(long runCount, int engineOption, std::vector<BenchmarkResult> &results) {
+    SimSettings someSettings{};
+    someSettings.engineOption = engineOption;
+    someSettings.progressInterval = 0;
+    long events = 0;
+    long totalFlights = 0;
+    BenchmarkTimer runTimer;
+    for(long run = 0; run < runCount; run++) {
+        someSettings.randomSeed = benchmarkSeed + run;
+        Simulation aSimulation(someSettings);
+        aSimulation.setQuiet(true);
+        for(const FinalStats &aResult: aSimulation.run(false)) {
+            totalFlights += aResult.totalFlights;
+        }
+        events += aSimulation.getEventCount();
+    }
+    std::string name = std::string{"runMultiple "} + (engineOption == 1 ? "FastEngine" : "SimClock");
+    runTimer.stop();
+    results.push_back(runTimer.result(name, runCount, runCount, events));
+    if(totalFlights < 0) { std::cerr << totalFlights << std::endl; }
+}
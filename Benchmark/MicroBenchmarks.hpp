@@ -0,0 +1,93 @@
+//
+//  MicroBenchmarks.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/7/25.
+//
+
+#ifndef MicroBenchmarks_hpp
+#define MicroBenchmarks_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <iostream>
+#include "SimSettings.hpp"
+
+/*
+ *******************************************************************************************
+ * Struct BenchmarkResult
+ * One line of benchmark output. Each result is written as a single JSON object on its own
+ * line so the output can be read by a script or pasted into a spreadsheet tool.
+ * eventsPerSecond is only set for benchmarks that run whole simulations, and counters only
+ * for the ones that read the hardware counters.
+ *******************************************************************************************
+ */
+struct BenchmarkResult {
+    std::string name; // What was timed, such as "SimClock.addHandler"
+    long size; // Handlers, planes or runs involved
+    long operations; // How many operations (or simulation events) were timed
+    double seconds; // Wall time for all of them
+    double eventsPerSecond; // Simulation events per second, or 0
+    long allocations; // Heap allocations made while timing
+    long bytes; // Bytes requested by those allocations
+    std::string counters; // Hardware counts per event as JSON members, a note why there are none, or empty
+
+    // Time per operation in nanoseconds
+    double nsPerOperation() const {
+        return operations > 0 ? seconds * 1e9 / operations : 0.0;
+    }
+
+    // Write this result as one line of JSON
+    void write(std::ostream &out) const;
+};
+
+/*
+ *******************************************************************************************
+ * Struct StressPreset
+ * The stress simulations offered in the main menu. The benchmark and regression harness
+ * run these with a fixed seed.
+ *******************************************************************************************
+ */
+struct StressPreset {
+    const char *name;
+    long hours;
+    long planeCount;
+    long chargerCount;
+    long minPlanePerKind;
+    long maxPassengerDelay;
+
+    // The default settings changed to match this preset
+    SimSettings settings() const;
+};
+extern const std::vector<StressPreset> stressPresets;
+
+// The seed used by every benchmark so runs can be compared
+const long benchmarkSeed{20250207};
+
+// Time SimClock addHandler, reSortHandler and handling events with handlerCount handlers
+void benchmarkSimClock(long handlerCount, std::vector<BenchmarkResult> &results);
+
+// Time ChargerQueue addPlane and handling charges with planeCount planes and chargerCount chargers
+void benchmarkChargerQueue(long planeCount, long chargerCount, std::vector<BenchmarkResult> &results);
+
+// Time PlaneQueue addPlane and taking off with planeCount planes
+void benchmarkPlaneQueue(long planeCount, std::vector<BenchmarkResult> &results);
+
+// Time Plane::createFaultInterval
+void benchmarkFaultIntervals(long count, std::vector<BenchmarkResult> &results);
+
+// Time Simulation::run on a preset with one engine
+void benchmarkPreset(const StressPreset &aPreset, int engineOption, std::vector<BenchmarkResult> &results);
+
+// Time Simulation::run on a preset with one engine while writing a trace of it
+void benchmarkTracedPreset(const StressPreset &aPreset, int engineOption, std::vector<BenchmarkResult> &results);
+
+// Run Simulation::run on a preset with one engine, profiled with the hardware counters, and
+// report the counts per event. Where the counters are not available it reports the timing only.
+void benchmarkCountedPreset(const StressPreset &aPreset, int engineOption, std::vector<BenchmarkResult> &results);
+
+// Time the main menu's "Average results from 100 Simulations" with one engine
+void benchmarkRunMultiple(long runCount, int engineOption, std::vector<BenchmarkResult> &results);
+
+#endif /* MicroBenchmarks_hpp */
@@ -0,0 +1,291 @@
+//
+//  RegressionHarness.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/8/25.
+//
+
+#include "RegressionHarness.hpp"
+#include "MicroBenchmarks.hpp"
+#include "Simulation.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Short scenarios are repeated until they have run at least this long and the fastest run
+// is used, so the timing of a run lasting a fraction of a millisecond is not all noise.
+static const double minimumTimedSeconds{0.25};
+// Peak RSS has to grow by more than this as well as by the threshold to count as a regression
+static const long rssSlackKilobytes{1024};
+
+// The seeded scenarios: the stress presets with both engines and fleets of 10,000 and 100,000 planes
+std::vector<RegressionScenario> regressionScenarios() {
+    std::vector<RegressionScenario> scenarios;
+    const char *presetNames[]{"preset-30h", "preset-300h", "preset-3000h", "preset-35040h", "preset-4yr-1000planes"};
+    for(size_t i = 0; i < stressPresets.size(); i++) {
+        for(int engine = 0; engine < 2; engine++) {
+            SimSettings someSettings = stressPresets[i].settings();
+            someSettings.engineOption = engine;
+            scenarios.push_back(RegressionScenario{std::string{presetNames[i]} + (engine == 1 ? "-fast" : "-simclock"),
+                someSettings, stressPresets[i].planeCount <= 100});
+        }
+    }
+    // Larger fleets with the same ratio of chargers to planes as the 1000 plane preset
+    struct Fleet { const char *name; long planes; long hours; bool withSimClock; };
+    // 100,000 planes is only run with the FastEngine so the regression run stays short
+    const Fleet fleets[]{{"fleet-10k-30h", 10000, 30, true}, {"fleet-100k-3h", 100000, 3, false}};
+    for(const Fleet &aFleet: fleets) {
+        for(int engine = aFleet.withSimClock ? 0 : 1; engine < 2; engine++) {
+            SimSettings someSettings{};
+            someSettings.simulationDuration = aFleet.hours * secondsPerHour;
+            someSettings.planeCount = aFleet.planes;
+            someSettings.chargerCount = aFleet.planes * 15 / 100;
+            someSettings.minPlanePerKind = aFleet.planes / 10;
+            someSettings.maxPassengerDelay = secondsPerHour;
+            someSettings.randomSeed = benchmarkSeed;
+            someSettings.progressInterval = 0;
+            someSettings.engineOption = engine;
+            scenarios.push_back(RegressionScenario{std::string{aFleet.name} + (engine == 1 ? "-fast" : "-simclock"), someSettings, false});
+        }
+    }
+    return scenarios;
+}
+
+// A 64 bit FNV-1a hash of text, shown in hex
+static void hashText(uint64_t &hash, const std::string &text) {
+    for(unsigned char c: text) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+}
+static void hashResults(uint64_t &hash, const std::vector<FinalStats> &results) {
+    for(const FinalStats &r: results) {
+        std::ostringstream values;
+        values << std::setprecision(17) << r.theCompany << '|' << r.totalFlights << '|' << r.averageTimePerFlight << '|'
+        << r.averageDistancePerFlight << '|' << r.totalCharges << '|' << r.averageTimeCharging << '|'
+        << r.averageTimeChargingWithWait << '|' << r.totalFaults << '|' << r.totalPassengerMiles << ';';
+        hashText(hash, values.str());
+    }
+}
+
+// The peak RSS of this process in kilobytes
+static long peakRSSKilobytes() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<long>(usage.ru_maxrss / 1024); // macOS reports bytes
+#else
+    return static_cast<long>(usage.ru_maxrss); // Linux reports kilobytes
+#endif
+}
+
+// Run one scenario in this process
+RegressionMeasurement measureScenario(const RegressionScenario &aScenario) {
+    RegressionMeasurement measurement{aScenario.name, 0, 0.0, 0.0, 0, 0, 0, 0, ""};
+    double totalSeconds = 0.0;
+    for(int run = 0; run == 0 || (totalSeconds < minimumTimedSeconds && run < 1000); run++) {
+        Simulation aSimulation(aScenario.settings);
+        aSimulation.setQuiet(true);
+        auto startTimer = std::chrono::high_resolution_clock::now();
+        std::vector<FinalStats> results = aSimulation.run(false);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTimer).count();
+        totalSeconds += seconds;
+        if(run == 0) {
+            measurement.wallSeconds = seconds;
+            measurement.events = aSimulation.getEventCount();
+            for(const FinalStats &r: results) {
+                measurement.flights += r.totalFlights;
+                measurement.charges += r.totalCharges;
+                measurement.faults += r.totalFaults;
+            }
+            uint64_t hash = 0xcbf29ce484222325ULL;
+            hashResults(hash, results);
+            for(const std::vector<FinalStats> &siteResults: aSimulation.getSiteResults()) {
+                hashResults(hash, siteResults);
+            }
+            std::ostringstream digest;
+            digest << std::hex << std::setw(16) << std::setfill('0') << hash;
+            measurement.resultsDigest = digest.str();
+        } else {
+            measurement.wallSeconds = std::min(measurement.wallSeconds, seconds);
+        }
+    }
+    measurement.eventsPerSecond = measurement.wallSeconds > 0 ? measurement.events / measurement.wallSeconds : 0.0;
+    measurement.peakRSSKilobytes = peakRSSKilobytes();
+    return measurement;
+}
+
+// One line of the baseline file
+static std::string formatMeasurement(const RegressionMeasurement &m) {
+    std::ostringstream line;
+    line << m.name << ' ' << m.events << ' ' << std::fixed << std::setprecision(6) << m.wallSeconds << ' '
+    << std::setprecision(0) << m.eventsPerSecond << ' ' << m.peakRSSKilobytes << ' '
+    << m.flights << ' ' << m.charges << ' ' << m.faults << ' ' << m.resultsDigest;
+    return line.str();
+}
+static bool parseMeasurement(const std::string &line, RegressionMeasurement &m) {
+    std::istringstream fields(line);
+    return static_cast<bool>(fields >> m.name >> m.events >> m.wallSeconds >> m.eventsPerSecond >> m.peakRSSKilobytes
+                             >> m.flights >> m.charges >> m.faults >> m.resultsDigest);
+}
+
+// Run a scenario in a child process so the peak RSS is for that scenario alone.
+// The child sends its measurement back as a baseline line.
+static bool measureInChild(const RegressionScenario &aScenario, RegressionMeasurement &measurement) {
+    int fds[2];
+    if(pipe(fds) != 0) { return false; }
+    std::cout.flush();
+    pid_t child = fork();
+    if(child < 0) { return false; }
+    if(child == 0) {
+        close(fds[0]);
+        std::string line = formatMeasurement(measureScenario(aScenario)) + "\n";
+        ssize_t written = write(fds[1], line.data(), line.size());
+        close(fds[1]);
+        _exit(written == static_cast<ssize_t>(line.size()) ? 0 : 1);
+    }
+    close(fds[1]);
+    std::string line;
+    char buffer[256];
+    ssize_t count;
+    while((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        line.append(buffer, count);
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 && parseMeasurement(line, measurement);
+}
+
+// Describe the change from a baseline value as a percentage
+static std::string percentChange(double baseline, double now) {
+    std::ostringstream text;
+    text << std::showpos << std::fixed << std::setprecision(1) << (baseline != 0 ? (now - baseline) * 100.0 / baseline : 0.0) << "%";
+    return text.str();
+}
+
+// Run the scenarios, then compare with or write the baseline.
+// Returns 0 if nothing regressed, 1 if something did and 2 if the baseline could not be used.
+int runRegression(const RegressionOptions &options) {
+    std::map<std::string, RegressionMeasurement> baseline;
+    if(!options.writeBaseline) {
+        std::ifstream in(options.baselinePath);
+        if(!in) {
+            std::cerr << "Could not read the baseline " << options.baselinePath << std::endl;
+            return 2;
+        }
+        std::string line;
+        while(std::getline(in, line)) {
+            RegressionMeasurement m{};
+            if(line.empty() || line[0] == '#') { continue; }
+            if(!parseMeasurement(line, m)) {
+                std::cerr << "Could not read this line of the baseline: " << line << std::endl;
+                return 2;
+            }
+            baseline[m.name] = m;
+        }
+    }
+
+    std::vector<RegressionMeasurement> measurements;
+    int failures = 0;
+    std::cout << std::left << std::setw(32) << "Scenario" << std::setw(16) << "Events/sec" << std::setw(10) << "Change"
+    << std::setw(12) << "Peak RSS KB" << std::setw(10) << "Change" << "Status" << std::endl;
+    for(const RegressionScenario &aScenario: regressionScenarios()) {
+        if(options.quick && !aScenario.quick) { continue; }
+        RegressionMeasurement now{};
+        if(!measureInChild(aScenario, now)) {
+            std::cout << std::left << std::setw(32) << aScenario.name << "FAIL (the scenario did not finish)" << std::endl;
+            failures++;
+            continue;
+        }
+        measurements.push_back(now);
+        if(options.writeBaseline) {
+            std::cout << std::left << std::setw(32) << now.name << std::setw(16) << std::fixed << std::setprecision(0)
+            << now.eventsPerSecond << std::setw(10) << "" << std::setw(12) << now.peakRSSKilobytes << std::setw(10) << ""
+            << "recorded" << std::endl;
+            continue;
+        }
+        auto found = baseline.find(now.name);
+        if(found == baseline.end()) {
+            std::cout << std::left << std::setw(32) << now.name << "FAIL (not in the baseline)" << std::endl;
+            failures++;
+            continue;
+        }
+        const RegressionMeasurement &base = found->second;
+
+        // Collect everything that got worse, then show the row and the details
+        std::vector<std::string> problems;
+        if(now.events != base.events || now.flights != base.flights || now.charges != base.charges ||
+           now.faults != base.faults || now.resultsDigest != base.resultsDigest) {
+            std::ostringstream text;
+            text << "results changed: events " << base.events << " -> " << now.events
+            << ", flights " << base.flights << " -> " << now.flights
+            << ", charges " << base.charges << " -> " << now.charges
+            << ", faults " << base.faults << " -> " << now.faults
+            << ", digest " << base.resultsDigest << " -> " << now.resultsDigest;
+            problems.push_back(text.str());
+        }
+        if(!options.resultsOnly) {
+            std::ostringstream text;
+            text << std::fixed;
+            if(now.eventsPerSecond < base.eventsPerSecond * (1.0 - options.threshold)) {
+                text.str("");
+                text << std::setprecision(0) << "events/sec " << base.eventsPerSecond << " -> " << now.eventsPerSecond
+                << " (" << percentChange(base.eventsPerSecond, now.eventsPerSecond) << ")";
+                problems.push_back(text.str());
+            }
+            if(now.wallSeconds > base.wallSeconds * (1.0 + options.threshold)) {
+                text.str("");
+                text << std::setprecision(6) << "wall seconds " << base.wallSeconds << " -> " << now.wallSeconds
+                << " (" << percentChange(base.wallSeconds, now.wallSeconds) << ")";
+                problems.push_back(text.str());
+            }
+            if(now.peakRSSKilobytes > base.peakRSSKilobytes * (1.0 + options.threshold) &&
+               now.peakRSSKilobytes > base.peakRSSKilobytes + rssSlackKilobytes) {
+                text.str("");
+                text << "peak RSS KB " << base.peakRSSKilobytes << " -> " << now.peakRSSKilobytes
+                << " (" << percentChange(base.peakRSSKilobytes, now.peakRSSKilobytes) << ")";
+                problems.push_back(text.str());
+            }
+        }
+        std::cout << std::left << std::setw(32) << now.name << std::setw(16) << std::fixed << std::setprecision(0)
+        << now.eventsPerSecond << std::setw(10) << percentChange(base.eventsPerSecond, now.eventsPerSecond)
+        << std::setw(12) << now.peakRSSKilobytes << std::setw(10) << percentChange(base.peakRSSKilobytes, now.peakRSSKilobytes)
+        << (problems.empty() ? "ok" : "FAIL") << std::endl;
+        for(const std::string &aProblem: problems) {
+            std::cout << "    " << aProblem << std::endl;
+        }
+        if(!problems.empty()) { failures++; }
+    }
+
+    if(options.writeBaseline) {
+        std::ofstream out(options.baselinePath);
+        if(!out) {
+            std::cerr << "Could not write the baseline " << options.baselinePath << std::endl;
+            return 2;
+        }
+        out << "# Regression baseline for JobyBenchmark --regression (see Benchmark/RegressionHarness.hpp)" << std::endl;
+        out << "# Refresh it with JobyBenchmark --regression --write-baseline on the machine that checks against it." << std::endl;
+        out << "# name events wall_seconds events_per_sec peak_rss_kb flights charges faults results_digest" << std::endl;
+        for(const RegressionMeasurement &m: measurements) {
+            out << formatMeasurement(m) << std::endl;
+        }
+        std::cout << "Wrote " << measurements.size() << " scenarios to " << options.baselinePath << std::endl;
+    }
+    if(failures > 0) {
+        std::cout << failures << " scenario" << (failures == 1 ? "" : "s") << " regressed" << std::endl;
+        return 1;
+    }
+    if(!options.writeBaseline) {
+        std::cout << "No regressions" << (options.resultsOnly ? " in results" : "") << std::endl;
+    }
+    return 0;
+}
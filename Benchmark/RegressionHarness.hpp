@@ -0,0 +1,74 @@
+//
+//  RegressionHarness.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/8/25.
+//
+
+#ifndef RegressionHarness_hpp
+#define RegressionHarness_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include "SimSettings.hpp"
+
+/*
+ *******************************************************************************************
+ * Regression harness
+ * Runs a fixed, seeded set of simulations and compares them with a baseline file that is
+ * committed with the code (Benchmark/RegressionBaseline.txt). Each scenario runs in its
+ * own process so its peak memory (RSS) is its own.
+ *
+ * Two things are checked:
+ *   - Results: the event count, total flights, charges and faults, and a digest of every
+ *     FinalStats value (for all companies and sites) must match exactly. Since the runs are
+ *     seeded, any difference means a change altered what the simulation does.
+ *   - Speed: events per second, wall time and peak RSS must not be worse than the baseline
+ *     by more than a threshold (25% unless told otherwise).
+ *
+ * The results depend on the math library (fault intervals use std::log), and the speed
+ * depends on the machine, so record the baseline on the machine that checks against it.
+ *******************************************************************************************
+ */
+
+// One simulation in the regression matrix
+struct RegressionScenario {
+    std::string name; // No spaces, it is the key in the baseline file
+    SimSettings settings;
+    bool quick; // Included in the --quick subset
+};
+
+// What one scenario did and how long it took
+struct RegressionMeasurement {
+    std::string name;
+    long events;
+    double wallSeconds;
+    double eventsPerSecond;
+    long peakRSSKilobytes;
+    long flights;
+    long charges;
+    long faults;
+    std::string resultsDigest; // Hex digest of every FinalStats value
+};
+
+// Options for runRegression()
+struct RegressionOptions {
+    std::string baselinePath; // Where the baseline is read from (or written to)
+    bool writeBaseline; // Record a new baseline instead of comparing
+    bool resultsOnly; // Only compare results, not speed (for machines other than the baseline's)
+    bool quick; // Only run the quick scenarios
+    double threshold; // How much worse (as a fraction) a speed metric may be before it fails
+};
+
+// The seeded scenarios: the stress presets with both engines and fleets of 10,000 and 100,000 planes
+std::vector<RegressionScenario> regressionScenarios();
+
+// Run one scenario in this process
+RegressionMeasurement measureScenario(const RegressionScenario &aScenario);
+
+// Run the scenarios, then compare with or write the baseline.
+// Returns 0 if nothing regressed, 1 if something did and 2 if the baseline could not be used.
+int runRegression(const RegressionOptions &options);
+
+#endif /* RegressionHarness_hpp */
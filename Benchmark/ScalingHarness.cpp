@@ -0,0 +1,146 @@
+//
+//  ScalingHarness.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "ScalingHarness.hpp"
+#include "MicroBenchmarks.hpp"
+#include "Simulation.hpp"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+// The plane sweep uses this many chargers, and the charger sweep this many planes
+static const long sweepChargerCount{100};
+static const long sweepPlaneCount{10000};
+// Points are run for at most this many simulated hours, even if they handle fewer events
+static const long maxSweepHours{65536};
+// Runs shorter than this are repeated (up to three times) and the fastest is used
+static const double minimumTimedSeconds{0.25};
+
+// The slope of the least squares line through (log sizes, log costs)
+double fitExponent(const std::vector<double> &sizes, const std::vector<double> &costs) {
+    double n = static_cast<double>(sizes.size());
+    double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+    for(size_t i = 0; i < sizes.size(); i++) {
+        double x = std::log(sizes[i]);
+        double y = std::log(costs[i]);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    double denominator = n * sumXX - sumX * sumX;
+    return denominator > 0 ? (n * sumXY - sumX * sumY) / denominator : 0.0;
+}
+
+// The settings for one point. Everything but the sizes and duration is the same for every point.
+static SimSettings pointSettings(int engineOption, long planeCount, long chargerCount, long hours) {
+    SimSettings someSettings{};
+    someSettings.simulationDuration = hours * secondsPerHour;
+    someSettings.planeCount = planeCount;
+    someSettings.chargerCount = chargerCount;
+    someSettings.minPlanePerKind = 0;
+    someSettings.maxPassengerDelay = secondsPerHour;
+    someSettings.randomSeed = benchmarkSeed;
+    someSettings.progressInterval = 0;
+    someSettings.engineOption = engineOption;
+    // The profiler times the event loop apart from setting up the fleet and adding up the results
+    someSettings.profileOption = 1;
+    return someSettings;
+}
+
+// Run one point for long enough to handle about targetEvents events and time its event loop
+static ScalingPoint measurePoint(int engineOption, long planeCount, long chargerCount, long targetEvents) {
+    ScalingPoint aPoint{planeCount, chargerCount, 1, 0, 0.0};
+    double loopSeconds = 0.0;
+    while(true) {
+        Simulation aSimulation(pointSettings(engineOption, planeCount, chargerCount, aPoint.hours));
+        aSimulation.setQuiet(true);
+        aSimulation.run(false);
+        aPoint.events = aSimulation.getEventCount();
+        loopSeconds = aSimulation.getProfile().eventLoopSeconds;
+        if(aPoint.events >= targetEvents || aPoint.hours >= maxSweepHours) {
+            break;
+        }
+        // Grow the run in proportion to the events still needed, at least doubling it
+        long factor = std::max(2L, (targetEvents + std::max(1L, aPoint.events) - 1) / std::max(1L, aPoint.events));
+        aPoint.hours = std::min(maxSweepHours, aPoint.hours * factor);
+    }
+    for(int repeat = 1; repeat < 3 && loopSeconds < minimumTimedSeconds; repeat++) {
+        Simulation aSimulation(pointSettings(engineOption, planeCount, chargerCount, aPoint.hours));
+        aSimulation.setQuiet(true);
+        aSimulation.run(false);
+        loopSeconds = std::min(loopSeconds, aSimulation.getProfile().eventLoopSeconds);
+    }
+    aPoint.nsPerEvent = aPoint.events > 0 ? loopSeconds * 1e9 / aPoint.events : 0.0;
+    return aPoint;
+}
+
+// Sweep one size for one engine and fit its growth exponent
+static ScalingCurve sweep(const std::string &name, int engineOption, bool planes, const std::vector<long> &sizes,
+                          long targetEvents, double tolerance) {
+    ScalingCurve aCurve{name, {}, 0.0, 0.0, false};
+    std::vector<double> sizeValues, costs, logCosts;
+    for(long aSize: sizes) {
+        std::cerr << "  " << name << " " << aSize << "..." << std::endl;
+        ScalingPoint aPoint = planes ? measurePoint(engineOption, aSize, sweepChargerCount, targetEvents)
+                                     : measurePoint(engineOption, sweepPlaneCount, aSize, targetEvents);
+        aCurve.points.push_back(aPoint);
+        sizeValues.push_back(static_cast<double>(aSize));
+        costs.push_back(std::max(aPoint.nsPerEvent, 1e-3));
+        // log2 of twice the size so a size of 1 does not give a cost of 0
+        logCosts.push_back(std::log2(2.0 * aSize));
+    }
+    aCurve.exponent = fitExponent(sizeValues, costs);
+    aCurve.logExponent = fitExponent(sizeValues, logCosts);
+    aCurve.passed = aCurve.exponent <= aCurve.logExponent + tolerance;
+    return aCurve;
+}
+
+// Write one curve as a table
+static void writeCurve(const ScalingCurve &aCurve) {
+    std::cout << aCurve.name << std::endl;
+    std::cout << std::left << std::setw(12) << "Planes" << std::setw(12) << "Chargers" << std::setw(10) << "Hours"
+    << std::setw(12) << "Events" << "ns/Event" << std::endl;
+    for(const ScalingPoint &aPoint: aCurve.points) {
+        std::cout << std::left << std::setw(12) << aPoint.planeCount << std::setw(12) << aPoint.chargerCount
+        << std::setw(10) << aPoint.hours << std::setw(12) << aPoint.events
+        << std::fixed << std::setprecision(1) << aPoint.nsPerEvent << std::endl;
+    }
+    std::cout << std::setprecision(3) << "Growth exponent " << aCurve.exponent << " (log n would be "
+    << aCurve.logExponent << "): " << (aCurve.passed ? "ok" : "GROWS FASTER THAN LOG N") << std::endl;
+    std::cout << std::defaultfloat << std::right << std::endl;
+}
+
+// Run the sweeps and write a table of each to cout.
+// Returns 0 if every curve grows no faster than logarithmically, 1 if any grows faster.
+int runScaling(const ScalingOptions &options) {
+#if !SIMPROFILE
+    // The cost per event comes from the profiler's event loop timer, so without it every slope is 0
+    std::cout << "The scaling sweep needs the profiler (SIMPROFILE 1) to time the event loop" << std::endl;
+    return 1;
+#endif
+    std::vector<long> planeCounts{10, 100, 1000, 10000, 100000};
+    if(!options.quick) { planeCounts.push_back(1000000); }
+    std::vector<long> chargerCounts{1, 10, 100, 1000, 10000};
+    long targetEvents = options.quick ? 100000 : 500000;
+    std::vector<ScalingCurve> curves;
+    for(int engine = 0; engine < 2; engine++) {
+        const char *engineName = engine == 1 ? "FastEngine" : "SimClock";
+        curves.push_back(sweep(std::string{engineName} + " by plane count (" + std::to_string(sweepChargerCount) + " chargers)",
+                               engine, true, planeCounts, targetEvents, options.tolerance));
+        curves.push_back(sweep(std::string{engineName} + " by charger count (" + std::to_string(sweepPlaneCount) + " planes)",
+                               engine, false, chargerCounts, targetEvents, options.tolerance));
+    }
+    int returnValue = 0;
+    for(const ScalingCurve &aCurve: curves) {
+        writeCurve(aCurve);
+        if(!aCurve.passed) { returnValue = 1; }
+    }
+    std::cout << (returnValue == 0 ? "Every engine scales no faster than log n" : "Something scales faster than log n") << std::endl;
+    return returnValue;
+}
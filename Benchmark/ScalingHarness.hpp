@@ -0,0 +1,62 @@
+//
+//  ScalingHarness.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef ScalingHarness_hpp
+#define ScalingHarness_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+
+/*
+ *******************************************************************************************
+ * Scaling harness
+ * Sweeps the plane count (10 to 1,000,000) with the charger count fixed, and the charger
+ * count with the plane count fixed, for each engine. Each point runs long enough to handle
+ * a fixed number of events and measures the event loop's time per event.
+ *
+ * A straight line is fitted to log(ns per event) against log(size) and its slope is the
+ * growth exponent. If handling an event costs O(log n), the exponent is about that of
+ * log(n) over the same sizes (around 0.15), plus up to about 0.1 more as the fleet outgrows
+ * the caches. Anything that walks or shifts every plane, charger or flight on each event
+ * shows up as an exponent well above that (about 0.5 for the SimClock's old sorted
+ * vector), and the sweep fails.
+ *******************************************************************************************
+ */
+
+// One size in a sweep and what it cost
+struct ScalingPoint {
+    long planeCount;
+    long chargerCount;
+    long hours; // Simulated time, chosen so the point handles about the target number of events
+    long events;
+    double nsPerEvent; // Event loop time per event (the fastest if the run was repeated)
+};
+
+// One sweep of one engine
+struct ScalingCurve {
+    std::string name;
+    std::vector<ScalingPoint> points;
+    double exponent; // The fitted slope of log(ns per event) against log(size)
+    double logExponent; // The slope a cost of c * log(size) would give over the same sizes
+    bool passed;
+};
+
+// Options for runScaling()
+struct ScalingOptions {
+    bool quick; // Sweep to 100,000 planes instead of 1,000,000, with fewer events per point
+    double tolerance; // How far above logExponent the exponent may be before it fails
+};
+
+// The slope of the least squares line through (log sizes, log costs)
+double fitExponent(const std::vector<double> &sizes, const std::vector<double> &costs);
+
+// Run the sweeps and write a table of each to cout.
+// Returns 0 if every curve grows no faster than logarithmically, 1 if any grows faster.
+int runScaling(const ScalingOptions &options);
+
+#endif /* ScalingHarness_hpp */
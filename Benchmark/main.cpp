@@ -0,0 +1,177 @@
+//
+//  main.cpp
+//  JobyBenchmark
+//
+//  Created by Chad Mitchell on 2/7/25.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <algorithm>
+#include "MicroBenchmarks.hpp"
+#include "RegressionHarness.hpp"
+#include "DifferentialTest.hpp"
+#include "ScalingHarness.hpp"
+#include "FluidModel.hpp"
+
+// CMake passes the source directory so the committed baseline is found from any build directory
+#ifdef JOBY_SOURCE_DIR
+static const char *defaultBaselinePath{JOBY_SOURCE_DIR "/Benchmark/RegressionBaseline.txt"};
+#else
+static const char *defaultBaselinePath{"Benchmark/RegressionBaseline.txt"};
+#endif
+
+/*
+ *******************************************************************************************
+ * JobyBenchmark
+ * Runs the benchmarks for the simulation core without any menus and writes one JSON object
+ * per line to cout. Progress goes to cerr so cout can be redirected to a file.
+ *
+ * Options:
+ *   --quick   Smaller sizes and a 300 hour version of the 1000 plane preset (a few seconds)
+ *   --only X  Only run benchmarks whose name contains X
+ *
+ * Regression harness (see RegressionHarness.hpp), which writes a table instead of JSON:
+ *   --regression        Run the seeded scenarios and compare them with the baseline.
+ *                       Exits with 1 if anything regressed. --quick runs the small ones.
+ *   --baseline PATH     Use another baseline file
+ *   --write-baseline    Record a new baseline instead of comparing
+ *   --results-only      Only check that the results are unchanged, not the speed
+ *   --threshold X       How much worse a speed metric may be, as a fraction (default 0.25)
+ *
+ * Differential test (see DifferentialTest.hpp):
+ *   --differential N    Check N random scenarios of every engine against the SimClock.
+ *                       Exits with 1 if any did not match.
+ *   --seed S            Make the scenarios from seed S (default 1)
+ *
+ * Scaling harness (see ScalingHarness.hpp), which writes a table for each sweep:
+ *   --scaling           Sweep the plane and charger counts and fit how the cost per event
+ *                       grows. Exits with 1 if it grows faster than log n. --quick stops
+ *                       at 100,000 planes.
+ *   --tolerance X       How far the fitted exponent may be above log n's (default 0.15)
+ *
+ * Fluid model validation (see FluidModel.hpp), which writes a table:
+ *   --fluid N           Run N planes with a charger for every 5 planes for 200 hours on the
+ *                       FastEngine and the fluid model, with 4 seeds from --seed, and
+ *                       compare each company's results. Exits with 1 if any differs by
+ *                       more than 6%.
+ *******************************************************************************************
+ */
+int main(int argc, const char * argv[]) {
+    bool quick = false;
+    std::string only{};
+    bool regression = false;
+    long differentialCount = 0;
+    uint64_t differentialSeed = 1;
+    RegressionOptions regressionOptions{defaultBaselinePath, false, false, false, 0.25};
+    bool scaling = false;
+    ScalingOptions scalingOptions{false, 0.15};
+    long fluidPlanes = 0;
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if(std::strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if(std::strcmp(argv[i], "--regression") == 0) {
+            regression = true;
+        } else if(std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            regressionOptions.baselinePath = argv[++i];
+        } else if(std::strcmp(argv[i], "--write-baseline") == 0) {
+            regressionOptions.writeBaseline = true;
+        } else if(std::strcmp(argv[i], "--results-only") == 0) {
+            regressionOptions.resultsOnly = true;
+        } else if(std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            regressionOptions.threshold = std::atof(argv[++i]);
+        } else if(std::strcmp(argv[i], "--differential") == 0 && i + 1 < argc) {
+            differentialCount = std::atol(argv[++i]);
+        } else if(std::strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if(std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            scalingOptions.tolerance = std::atof(argv[++i]);
+        } else if(std::strcmp(argv[i], "--fluid") == 0 && i + 1 < argc) {
+            fluidPlanes = std::atol(argv[++i]);
+        } else if(std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            differentialSeed = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "Usage: JobyBenchmark [--quick] [--only name]" << std::endl;
+            std::cerr << "       JobyBenchmark --regression [--quick] [--baseline path] [--write-baseline]"
+            << " [--results-only] [--threshold fraction]" << std::endl;
+            std::cerr << "       JobyBenchmark --differential count [--seed seed]" << std::endl;
+            std::cerr << "       JobyBenchmark --scaling [--quick] [--tolerance exponent]" << std::endl;
+            std::cerr << "       JobyBenchmark --fluid planes [--seed seed]" << std::endl;
+            return 2;
+        }
+    }
+    if(differentialCount > 0) {
+        return runDifferentialTest(differentialCount, differentialSeed) == 0 ? 0 : 1;
+    }
+    if(fluidPlanes > 0) {
+        SimSettings settings{};
+        settings.simulationDuration = 200 * secondsPerHour;
+        settings.planeCount = fluidPlanes;
+        settings.chargerCount = std::max(1L, fluidPlanes / 5);
+        settings.maxPassengerDelay = 1800;
+        settings.randomSeed = static_cast<long>(differentialSeed);
+        return validateFluidModel(settings, 4, std::cout).worstError > 0.06 ? 1 : 0;
+    }
+    if(scaling) {
+        scalingOptions.quick = quick;
+        return runScaling(scalingOptions);
+    }
+    if(regression) {
+        regressionOptions.quick = quick;
+        return runRegression(regressionOptions);
+    }
+
+    std::vector<BenchmarkResult> results;
+    // Run a group of benchmarks if any of their names could match, then write what they found
+    auto runGroup = [&](const std::string &group, std::function<void()> benchmark) {
+        if(!only.empty() && group.find(only) == std::string::npos) { return; }
+        std::cerr << "Running " << group << "..." << std::endl;
+        results.clear();
+        benchmark();
+        for(const BenchmarkResult &aResult: results) {
+            aResult.write(std::cout);
+        }
+    };
+
+    std::vector<long> handlerCounts = quick ? std::vector<long>{10000} : std::vector<long>{10000, 30000, 100000};
+    for(long handlerCount: handlerCounts) {
+        runGroup("SimClock " + std::to_string(handlerCount), [&]() { benchmarkSimClock(handlerCount, results); });
+    }
+    long planeCount = quick ? 10000 : 100000;
+    runGroup("ChargerQueue", [&]() { benchmarkChargerQueue(planeCount, 150, results); });
+    runGroup("PlaneQueue", [&]() { benchmarkPlaneQueue(planeCount, results); });
+    runGroup("Plane.createFaultInterval", [&]() { benchmarkFaultIntervals(quick ? 1000000 : 10000000, results); });
+    for(StressPreset aPreset: stressPresets) {
+        if(quick && aPreset.planeCount > 100) {
+            aPreset.name = "300 hours, 1000 planes, 150 chargers";
+            aPreset.hours = 300;
+        }
+        for(int engine = 0; engine < 2; engine++) {
+            runGroup(std::string{"Simulation.run "} + aPreset.name, [&]() { benchmarkPreset(aPreset, engine, results); });
+        }
+    }
+    // What a trace costs on a 300 hour run of the 1000 plane preset (compare with the run without one)
+    StressPreset tracePreset = stressPresets.back();
+    tracePreset.name = "300 hours, 1000 planes, 150 chargers";
+    tracePreset.hours = 300;
+    for(int engine = 0; engine < 2; engine++) {
+        runGroup(std::string{"SimTrace "} + tracePreset.name, [&]() {
+            benchmarkPreset(tracePreset, engine, results);
+            benchmarkTracedPreset(tracePreset, engine, results);
+        });
+    }
+    // Cycles, instructions and cache and branch misses per event on the same run, where available
+    for(int engine = 0; engine < 2; engine++) {
+        runGroup(std::string{"Counters "} + tracePreset.name, [&]() { benchmarkCountedPreset(tracePreset, engine, results); });
+    }
+    for(int engine = 0; engine < 2; engine++) {
+        runGroup("runMultiple", [&]() { benchmarkRunMultiple(100, engine, results); });
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+//
+//  FlightRecorder.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef FlightRecorder_hpp
+#define FlightRecorder_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+#include "SimProfile.hpp"
+
+// What happened in one entry of the flight recorder
+enum RecorderAction : uint8_t {
+    recordHandle = 0, // The engine is about to handle an event for this handler
+    recordKeep = 1, // The handler stays in the clock. The time is its next event time.
+    recordRemove = 2, // The handler left the clock
+    recordCloseOut = 3, // The handler was closed out at the end of the run
+    recordFlightLogged = 4, // A flight was added to the stats. The id is the plane number.
+    recordChargeLogged = 5, // A charge was added to the stats. The id is the plane number.
+    recordOutOfOrder = 6, // Error: the next event was earlier than the current time
+    recordBadReinsert = 7 // Error: a handler asked to stay in the clock without a future time
+};
+const int recorderActionCount{recordBadReinsert + 1};
+const char *recorderActionName(int action);
+
+// One entry of the flight recorder. It is 16 bytes so the recorder stays small and
+// recording one is a couple of stores.
+struct RecorderEntry {
+    long time;
+    int32_t id; // The plane number for a Flight, the site for a queue (see RecorderAction)
+    uint8_t kind; // The ProfileKind of the handler
+    uint8_t action; // The RecorderAction
+    uint16_t unused;
+};
+
+// How many entries a Simulation keeps, and how many are written when an error is found
+const size_t defaultFlightRecorderSize{4096};
+const size_t flightRecorderDumpCount{64};
+
+/*
+ *******************************************************************************************
+ * Class FlightRecorder
+ * Keeps the last entries of what the engine did in a fixed ring buffer, so when something
+ * goes wrong there is a history of what led up to it without re-running in verbose mode.
+ * Each Simulation has one that is always on. The engine records each event it handles,
+ * whether the handler stayed in the clock, every flight and charge logged and the close-out.
+ * The engines write their error messages followed by a dump of the last entries.
+ *
+ * Recording overwrites the oldest entry and never allocates or takes a lock. There is only
+ * ever one writer, the engine running the Simulation, so a plain counter is all it needs.
+ * The capacity is a power of two so wrapping is a mask.
+ *******************************************************************************************
+ */
+class FlightRecorder {
+    std::vector<RecorderEntry> entries;
+    size_t mask; // entries.size() - 1
+    uint64_t count; // How many entries have ever been recorded
+public:
+    // Room for at least capacity entries (rounded up to a power of two)
+    FlightRecorder(size_t capacity = defaultFlightRecorderSize);
+
+    // Record one entry, overwriting the oldest if the recorder is full
+    void record(long time, int kind, long id, RecorderAction action) {
+        RecorderEntry &anEntry = entries[count++ & mask];
+        anEntry.time = time;
+        anEntry.id = static_cast<int32_t>(id);
+        anEntry.kind = static_cast<uint8_t>(kind);
+        anEntry.action = action;
+    }
+
+    // Forget everything, for the start of a run
+    void clear();
+
+    // How many entries are kept now, and how many were ever recorded
+    size_t size() const;
+    uint64_t getCount() const;
+
+    // Look at a kept entry. Index 0 is the oldest.
+    const RecorderEntry &operator[](size_t index) const;
+
+    // Write the last entries (all of them if last is 0) to out, oldest first, one per line
+    void dump(std::ostream &out, size_t last = 0) const;
+};
+
+// Check the ring buffer, and that both engines record the same history for the same run.
+// It reports errors to cout.
+bool testFlightRecorder();
+
+#endif /* FlightRecorder_hpp */
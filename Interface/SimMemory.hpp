@@ -0,0 +1,134 @@
+//
+//  SimMemory.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef SimMemory_hpp
+#define SimMemory_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// The kinds of memory a Simulation counts separately
+enum MemoryCategory {
+    memoryHandlers = 0, // The SimClock and its EventHandler objects, or the FastEngine's events
+    memoryPlanes = 1, // Plane objects, and the FastEngine's array of planes
+    memoryStats = 2, // The FlightStats and ChargerStats records kept for the results
+    memoryQueues = 3 // Chargers and planes waiting in the ChargerQueue and PlaneQueue at each site
+};
+const int memoryCategoryCount{memoryQueues + 1};
+inline const char *memoryCategoryName(int category) {
+    switch(category) {
+        case memoryHandlers: return "Handlers";
+        case memoryPlanes: return "Planes";
+        case memoryStats: return "Stats records";
+        default: return "Queues";
+    }
+}
+
+/*
+ *******************************************************************************************
+ * Struct SimMemory
+ * The memory a Simulation is using, in bytes, by category. Its containers use a
+ * CountingAllocator and its handlers and planes are made with std::allocate_shared, so
+ * everything that grows with the size of a run is counted as it is allocated and freed.
+ * Small fixed things (the settings, the policy, the results) are not counted.
+ *
+ * If budgetBytes is set, overBudget is true while more than that is in use. The Simulation
+ * checks it as it records flights and charges (see SimSettings::memoryBudgetOption).
+ *******************************************************************************************
+ */
+struct SimMemory {
+    long currentBytes[memoryCategoryCount]{};
+    long peakBytes[memoryCategoryCount]{};
+    long currentTotal{0};
+    long peakTotal{0}; // The most in use at once, which may be less than the sum of the peaks
+    long budgetBytes{0}; // 0 means no budget
+    bool overBudget{false};
+    long streamingSince{-1}; // When the run switched to adding up stats as they happen, or -1
+    long stoppedAt{-1}; // When the run was stopped for going over its budget, or -1
+
+    void allocated(int category, long bytes) {
+        currentBytes[category] += bytes;
+        currentTotal += bytes;
+        if(currentBytes[category] > peakBytes[category]) { peakBytes[category] = currentBytes[category]; }
+        if(currentTotal > peakTotal) { peakTotal = currentTotal; }
+        overBudget = budgetBytes > 0 && currentTotal > budgetBytes;
+    }
+    void released(int category, long bytes) {
+        currentBytes[category] -= bytes;
+        currentTotal -= bytes;
+        overBudget = budgetBytes > 0 && currentTotal > budgetBytes;
+    }
+    // Would allocating this many more bytes go over the budget?
+    bool wouldExceed(long bytes) const {
+        return budgetBytes > 0 && currentTotal + bytes > budgetBytes;
+    }
+    // Start a new run: the peaks start from what is in use now
+    void startRun(long newBudgetBytes) {
+        for(int category = 0; category < memoryCategoryCount; category++) {
+            peakBytes[category] = currentBytes[category];
+        }
+        peakTotal = currentTotal;
+        budgetBytes = newBudgetBytes;
+        overBudget = budgetBytes > 0 && currentTotal > budgetBytes;
+        streamingSince = -1;
+        stoppedAt = -1;
+    }
+};
+
+/*
+ *******************************************************************************************
+ * Template class CountingAllocator
+ * A standard allocator that adds what it allocates to one category of a SimMemory. One
+ * made with a nullptr SimMemory (the default) counts nothing, so containers in objects made
+ * outside a Simulation (for testing) work as before.
+ *
+ * Anything allocated through one of these must be freed before its SimMemory goes away.
+ * The Simulation keeps its SimMemory as its first member so it outlives everything else.
+ *******************************************************************************************
+ */
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    SimMemory *theMemory;
+    int category;
+
+    CountingAllocator(SimMemory *theMemory = nullptr, int category = memoryQueues) noexcept: theMemory{theMemory}, category{category} {
+    }
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U> &other) noexcept: theMemory{other.theMemory}, category{other.category} {
+    }
+    T *allocate(size_t count) {
+        if(theMemory) { theMemory->allocated(category, static_cast<long>(count * sizeof(T))); }
+        return static_cast<T *>(::operator new(count * sizeof(T)));
+    }
+    void deallocate(T *pointer, size_t count) noexcept {
+        if(theMemory) { theMemory->released(category, static_cast<long>(count * sizeof(T))); }
+        ::operator delete(pointer);
+    }
+};
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T> &a, const CountingAllocator<U> &b) {
+    return a.theMemory == b.theMemory && a.category == b.category;
+}
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T> &a, const CountingAllocator<U> &b) {
+    return !(a == b);
+}
+
+// A vector whose memory is counted
+template <typename T>
+using CountedVector = std::vector<T, CountingAllocator<T>>;
+
+// Check that both engines count memory in every category, that the planes waiting for a
+// charger policy are counted, and that a memory budget either streams the stats without
+// changing the results or stops the run early. It reports errors to cout.
+bool testSimMemory();
+
+#endif /* SimMemory_hpp */
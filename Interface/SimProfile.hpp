@@ -0,0 +1,141 @@
+//
+//  SimProfile.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/6/25.
+//
+
+#ifndef SimProfile_hpp
+#define SimProfile_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+
+// Set this to 0 to compile the profiler out of SimClock, FastEngine and Simulation entirely.
+// When it is 1 the profiler still only runs if SimSettings::profileOption is set, and costs
+// one pointer check per event when it is not.
+#ifndef SIMPROFILE
+#define SIMPROFILE 1
+#endif
+
+// The kinds of event handler the profiler counts separately. The FastEngine uses the same
+// kinds for its events.
+enum ProfileKind {
+    profileFlight = 0,
+    profileChargerQueue = 1,
+    profilePlaneQueue = 2,
+    profileOther = 3 // Handlers only used for testing
+};
+const int profileKindCount{profileOther + 1};
+inline const char *profileKindName(int kind) {
+    switch(kind) {
+        case profileFlight: return "Flight";
+        case profileChargerQueue: return "ChargerQueue";
+        case profilePlaneQueue: return "PlaneQueue";
+        default: return "Other";
+    }
+}
+
+// Reading the clock costs about as much as handling a small event, so only one event in
+// this many of each kind is timed. The total for the kind is estimated from that sample.
+const long profileSampleInterval{64};
+
+// The hardware counters read when SimSettings::profileOption is 2. They count this thread
+// in user mode only.
+enum HardwareCounter {
+    counterCycles = 0,
+    counterInstructions = 1,
+    counterL1Misses = 2, // Level 1 data cache read misses
+    counterLLCMisses = 3, // Last level cache read misses
+    counterBranchMisses = 4
+};
+const int hardwareCounterCount{counterBranchMisses + 1};
+inline const char *hardwareCounterName(int counter) {
+    switch(counter) {
+        case counterCycles: return "Cycles";
+        case counterInstructions: return "Instructions";
+        case counterL1Misses: return "L1D Misses";
+        case counterLLCMisses: return "LLC Misses";
+        default: return "Branch Misses";
+    }
+}
+
+/*
+ *******************************************************************************************
+ * Struct ProfileKindStats
+ * The counts and sampled times for one kind of event handler.
+ *******************************************************************************************
+ */
+struct ProfileKindStats {
+    long events; // How many events of this kind were handled (not counting the close-out)
+    long sampledEvents; // How many of them were timed
+    double sampledSeconds; // Total time spent handling the timed events
+    double sampledCounts[hardwareCounterCount]; // Hardware counts for the timed events, if they were read
+
+    // The time spent on all the events of this kind, estimated from the sample
+    double estimatedSeconds() const {
+        return sampledEvents > 0 ? sampledSeconds * events / sampledEvents : 0.0;
+    }
+
+    // A hardware count per timed event of this kind
+    double countPerEvent(int counter) const {
+        return sampledEvents > 0 ? sampledCounts[counter] / sampledEvents : 0.0;
+    }
+};
+
+/*
+ *******************************************************************************************
+ * Struct SimProfile
+ * What the profiler found about one run of a Simulation. Simulation::getProfile() returns
+ * it after run(). If profiling was off (or compiled out) enabled is false and the rest is 0.
+ *
+ * For the FastEngine, queueInserts counts events pushed on its heap and reSorts counts
+ * events moved to a new time. It leaves the old event in its heap to be skipped instead of
+ * moving it, so reSortDistance stays 0.
+ *
+ * With profileOption 2 the engine also reads the hardware counters (cycles, instructions,
+ * cache and branch misses) around its event loop and around each timed event. Where the
+ * kernel does not offer them, as in many containers and virtual machines, countersAvailable
+ * is false, countersNote says why and the profile has the timing only.
+ *******************************************************************************************
+ */
+struct SimProfile {
+    bool enabled;
+    ProfileKindStats kinds[profileKindCount]; // Indexed by ProfileKind
+    long queueInserts; // Handlers (or events) added to the clock
+    long reSorts; // Handlers moved because their next event time changed
+    long reSortDistance; // Total number of levels those handlers moved in the clock's heap
+    long peakHandlers; // Most handlers in the clock at once
+    double simulatedHours; // How much simulated time the run covered
+    double eventsPerSimulatedHour;
+    double setupSeconds; // Creating the planes and queues
+    double eventLoopSeconds; // Handling events, including the close-out
+    double aggregationSeconds; // Summarizing the statistics into FinalStats
+    bool countersRequested; // SimSettings::profileOption was 2
+    bool countersAvailable; // The hardware counters were read
+    bool countersOpened[hardwareCounterCount]; // Which of them the kernel let us count (the rest stay 0)
+    std::string countersNote; // Why they were not available
+    double eventLoopCounts[hardwareCounterCount]; // Hardware counts for the whole event loop
+
+    // Total events of all kinds
+    long totalEvents() const {
+        long total = 0;
+        for(const ProfileKindStats &aKind: kinds) {
+            total += aKind.events;
+        }
+        return total;
+    }
+
+    // A hardware count for the event loop per event handled
+    double loopCountPerEvent(int counter) const {
+        long events = totalEvents();
+        return events > 0 ? eventLoopCounts[counter] / events : 0.0;
+    }
+};
+
+// Check that the profiler counts the same things for both engines, that its counts add up,
+// and that turning it on does not change the results. It reports errors to cout.
+bool testSimProfile();
+
+#endif /* SimProfile_hpp */
@@ -19,6 +19,47 @@ const long secondsPerHour{secondsPerMinute * 60}; // Converting seconds to hours
 const double secondsPerHourD{secondsPerMinute * 60.0}; // For floating point calcuations
 const long defaultTestClockSeconds{secondsPerHour * 3}; //3 hours
 
+/*
+ *******************************************************************************************
+ * Companies (types of planes)
+ * Later we could make these options as well, but for now they are hard wired into the
+ * simulation so we provide these constants to work with them. It is easy to change these
+ * here, but they are not currently user settable options like the SimSettings below.
+ *******************************************************************************************
+ */
+// enumeration of the possible companies (kinds of planes)
+enum Company {
+    Alpha = 0,
+    Bravo,
+    Charlie,
+    Delta,
+    Echo
+};
+// Allow iterating through the Company enumeration
+const Company allCompany[] = {Alpha, Bravo, Charlie, Delta, Echo};
+// Minimum and maximum elements of the Company enumeration
+const Company minCompany{Alpha};
+const Company maxCompany{Echo};
+const long companyCount = maxCompany + 1;
+
+// Reference to an array of company names
+extern const char *companyNames[];
+// Global function that takes a company enumeration and returns a company name
+const char *companyName(Company c);
+
+// These are the values of SimSettings::chargerPolicyOption. They select which waiting
+// plane gets the next free charger.
+enum ChargerPolicyOption {
+    chargerPolicyFIFO = 0, // First come, first served (the original behavior)
+    chargerPolicyShortestCharge, // The plane that will charge fastest goes first
+    chargerPolicyCompanyPriority, // Lowest SimSettings::companyPriority goes first, FIFO within a company
+    chargerPolicyPassengerValue, // Most passenger-seconds spent waiting goes first
+    chargerPolicyReservation // Earliest reservation (flight start time) goes first
+};
+const int chargerPolicyOptionCount{chargerPolicyReservation + 1};
+// Global function that describes a chargerPolicyOption value
+const char *chargerPolicyName(int option);
+
 /*
  *******************************************************************************************
  * Struct SimSettings
@@ -33,8 +74,18 @@ struct SimSettings {
     // How long with this simulation run (in simulated seconds)?
     long simulationDuration = defaultTestClockSeconds; // default 3 hours
     
-    // How may chargers will we have for this simulation?
+    // How may chargers will we have for this simulation? With more than one site, this is
+    // the number of chargers at each site.
     long chargerCount = 3;
+
+    // How many sites (vertiports) will we have? Each has its own chargers and the planes
+    // are divided evenly between them at the start.
+    long siteCount = 1;
+
+    // Where does a plane land after a flight from a site?
+    int siteFlightOption = 0;
+    // 0 = every flight returns to the site it took off from
+    // 1 = every flight lands at a random other site (only if siteCount > 1)
     
     // How many planes will we have for this simulation?
     long planeCount = 20;
@@ -65,6 +116,115 @@ struct SimSettings {
     // 1 = fault grounds plane immediately for duration of simulation
     // 2 = fault grounds plane at the end of current flight for duration of simulation
 
+    // With faultOption 0, is each fault an event in the clock?
+    int faultCountOption = 0;
+    // 0 = yes, a flight wakes up at each fault to count it
+    // 1 = no, a flight is only in the clock for its end. Its faults are counted when it ends
+    //     by walking the plane's fault intervals over the time it flew, so each flight has the
+    //     same faults from the same random numbers with far fewer events. Without the fault
+    //     events, flights landing at the same second as other events may be handled in a
+    //     different order, so runs with planes waiting for chargers can differ from option 0,
+    //     and flights cut off by the end are closed out in a different order, which decides
+    //     whether their 0 second charges are logged.
+
+    // When a charger frees up, which waiting plane gets it?
+    int chargerPolicyOption = 0;
+    // 0 = first come, first served
+    // 1 = shortest charge first
+    // 2 = company priority (lowest companyPriority value first, then first come first served)
+    // 3 = longest waiting passenger value (most passengers * seconds waited first)
+    // 4 = earliest reservation (planes book a charger when they take off)
+
+    // Used by chargerPolicyOption 2. Indexed by Company, lower values get chargers first.
+    int companyPriority[companyCount] = {0, 1, 2, 3, 4};
+
+    // Which random numbers do we use? Runs with the same settings and seed give the same results.
+    long randomSeed = 0;
+    // 0 = use a new seed for every run (it is shown with the results so a run can be repeated)
+    // > 0 = use this seed
+
+    // Which engine runs the simulation?
+    int engineOption = 0;
+    // 0 = a SimClock of EventHandler objects (Flight, ChargerQueue and PlaneQueue)
+    // 1 = the FastEngine of small fixed-size events dispatched over arrays of planes and sites.
+    //     It gives the same results for the same seed. Verbose runs always use option 0.
+    // 2 = the DecoupledEngine, which runs each plane on its own timeline, in parallel, when no
+    //     plane ever has to wait for a charger, and the FastEngine when one would. The results
+    //     are the same as the FastEngine's apart from rounding (see DecoupledEngine.hpp).
+    // 3 = the CohortEngine, which runs planes of the same company that take off together for
+    //     the same place as one cohort, and splits it when chargers or random numbers separate
+    //     them. It needs faultOption 0 and faultCountOption 1 with first come, first served
+    //     chargers, and runs the FastEngine otherwise. The results are the same as the
+    //     FastEngine's apart from rounding (see CohortEngine.hpp).
+    // 4 = the FluidModel, a mean-field approximation that follows how much of each company's
+    //     fleet is in each state instead of each plane. It takes milliseconds for any number
+    //     of planes, but the results are only close to the other engines' for large fleets
+    //     (see FluidModel.hpp). Runs with a trace use the FastEngine.
+
+    // Does the FastEngine skip ahead when the run settles into a repeating pattern?
+    int cycleOption = 0;
+    // 0 = no, every event is handled
+    // 1 = when every flight is full, leaves at once, lands back home and faults are only
+    //     counted (passengerCountOption 0, maxPassengerDelay 0, faultOption 0, siteFlightOption
+    //     0 and first come, first served chargers), look for a state of the fleet and chargers
+    //     that repeats. Then add up whole repeats up to near the end without handling them and
+    //     draw the faults for that time from each plane's flight time. Flights, charges and
+    //     passenger miles are the same as handling every event; only the faults and the event
+    //     count differ. Fleets whose landings keep lining up with other events never repeat
+    //     exactly (see FastEngineCycles.hpp) and are run as usual.
+
+    // Do the 100 runs of "Average results from 100 Simulations" each start from time 0?
+    long warmUpHours = 0;
+    // 0 = yes, each run starts from time 0 with the next seed
+    // > 0 = run once to this many hours on the FastEngine, then carry each run on from a copy
+    //     of that state with its planes' random numbers reseeded (see Simulation::branch()).
+    //     The runs share the flights and charges before then and only pay for the rest. It
+    //     needs first come, first served chargers; otherwise each run starts from time 0.
+
+    // Are faults made more likely, to see rare outcomes more often? (see RareEvents.hpp)
+    double faultBias = 1.0;
+    // 1 = no, faults come at the rates in the planeSpecifications
+    // > 1 = each fault interval is drawn as if the rate were this many times higher, and the
+    //     run's Simulation::getFaultWeight() says how much more likely its faults were without
+    //     the bias. The results themselves are not weighted, so they are only useful through
+    //     the weight. Runs other than the SimClock use the FastEngine.
+    int faultBiasCompany = -1;
+    // -1 = the bias is for every company
+    // >= 0 = the bias is only for the planes of this Company
+
+    // Are the planes' charge times changed from the planeSpecifications? (see Sensitivity.hpp)
+    double timeToChargeChange[companyCount] = {0, 0, 0, 0, 0};
+    // Indexed by Company, the hours added to its time_to_charge__hours. 0 = no change.
+
+    // Does the FastEngine follow how the run would change with the planes' charge times?
+    int chargeTimeDerivativeOption = -1;
+    // -1 = no
+    // 0 to 4 = yes, for the time_to_charge__hours of this Company. After the run,
+    //     Simulation::getPathDerivatives() has the derivatives of the wait for chargers and of
+    //     the passenger miles (see Sensitivity.hpp). It needs first come, first served
+    //     chargers. Runs other than verbose ones use the FastEngine and do not skip repeats.
+    // 5 = yes, for every company's time_to_charge__hours changed together
+
+    // Do we profile the engine? The results are in Simulation::getProfile() after a run.
+    int profileOption = 0;
+    // 0 = no profiling
+    // 1 = count events by handler kind, clock inserts and re-sorts, and time the phases of the run
+    // 2 = as 1, and also read the hardware counters (cycles, instructions, cache and branch
+    //     misses) around the event loop and the timed events. Where they are not available
+    //     this is the same as 1.
+
+    // Is there a limit on the memory a run may use? (in MB, see Simulation::getMemory())
+    long memoryBudgetMB = 0;
+    // 0 = no limit
+    // > 0 = when the run goes over this, do what memoryBudgetOption says
+
+    // What happens when a run goes over its memory budget?
+    int memoryBudgetOption = 0;
+    // 0 = stop keeping a record of every flight and charge and add them up as they happen
+    //     instead. The results are the same, but a verbose run can no longer list them.
+    //     If the run is still over its budget after that, it stops as in option 1.
+    // 1 = stop the simulation at the current time and give the results up to then
+
     // Do we show progress as the simulation proceeds?
     int progressInterval = -1; // in hours, 0 == do not show, -1 == not yet set
     // If they are on a monitor that does not honor '\r' this will fill their screen with
@@ -77,32 +237,4 @@ struct SimSettings {
     const int progressIntervalValue = 100; // default for how often we show progress, if we show it at all
 };
 
-/*
- *******************************************************************************************
- * Companies (types of planes)
- * Later we could make these options as well, but for now they are hard wired into the
- * simulation so we provide these constants to work with them. It is easy to change these
- * here, but they are not currently user settable options like those above.
- *******************************************************************************************
- */
-// enumeration of the possible companies (kinds of planes)
-enum Company {
-    Alpha = 0,
-    Bravo,
-    Charlie,
-    Delta,
-    Echo
-};
-// Allow iterating through the Company enumeration
-const Company allCompany[] = {Alpha, Bravo, Charlie, Delta, Echo};
-// Minimum and maximum elements of the Company enumeration
-const Company minCompany{Alpha};
-const Company maxCompany{Echo};
-const long companyCount = maxCompany + 1;
-
-// Reference to an array of company names
-extern const char *companyNames[];
-// Global function that takes a company enumeration and returns a company name
-const char *companyName(Company c);
-
 #endif /* SimSettings_hpp */
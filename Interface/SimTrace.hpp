@@ -0,0 +1,109 @@
+//
+//  SimTrace.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/8/25.
+//
+
+#ifndef SimTrace_hpp
+#define SimTrace_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <queue>
+#include <functional>
+#include "SimSettings.hpp"
+
+/*
+ *******************************************************************************************
+ * Class SimTrace
+ * Writes the simulated timeline of a run as Chrome trace JSON, which can be opened in
+ * https://ui.perfetto.dev or chrome://tracing. Each plane has its own track showing its
+ * flights, waits for passengers, waits for a charger, charges and when it was grounded.
+ * Each site has a track for each of its chargers showing which plane was charging, so
+ * contention for chargers is easy to see. One simulated second is shown as one second.
+ * Planes are numbered from 1 in each trace (plane numbers keep counting up from one
+ * Simulation to the next), so traces of the same run can be compared.
+ *
+ * To use it, open a SimTrace on a file, pass it to Simulation::setTrace() and run the
+ * Simulation. The engines call the functions below as things happen. Each event is
+ * formatted into a buffer that is written to the file whenever it fills up, so a trace
+ * costs little more than the run itself and the file can be much larger than memory.
+ *
+ * A SimTrace holds one run. The file is completed when close() is called (or the SimTrace
+ * is destroyed). A SimTrace made without a path keeps the trace in memory instead, so
+ * tests can compare the traces of many runs without writing files (see getText()).
+ *******************************************************************************************
+ */
+class SimTrace {
+    FILE *theFile;
+    bool inMemory; // Keep the trace in text instead of writing a file
+    std::string text; // The trace so far if it is kept in memory
+    std::vector<char> buffer; // Formatted events waiting to be written
+    size_t used; // How much of the buffer is in use
+    long eventCount; // Trace events written so far (not counting track names)
+    long simulationDuration; // When the run ends, for planes that are grounded
+    int firstPlaneNumber; // The plane number of the run's first plane, which is shown as plane 1
+
+    // What the trace knows about each plane, indexed by the plane's number within the run less one
+    struct PlaneTrack {
+        long track; // The plane's track, which is its number within the run (0 until the plane is seen)
+        std::string name; // The name of the track, such as "Plane 12 Alpha"
+        long freeSince; // When the plane was last done charging (or 0), so a wait for passengers can be shown
+        int chargerLane; // Which charger track the plane is on while it charges
+    };
+    std::vector<PlaneTrack> planes;
+    // The free charger tracks at each site. The lowest free one is used next so busy chargers stay at the top.
+    std::vector<std::priority_queue<int, std::vector<int>, std::greater<int>>> freeLanes;
+    std::vector<int> laneCount; // How many charger tracks each site has named so far
+
+    // Find the plane's track, naming it the first time the plane is seen
+    PlaneTrack &planeTrack(int planeNumber, Company theCompany);
+    // Add text or a whole number to the buffer
+    void appendText(const char *text, size_t length);
+    void appendText(const char *text);
+    void appendNumber(long value);
+    // Start one complete ("X") event in the buffer. Any args go in before endEvent() is called.
+    void beginEvent(const char *name, const char *category, long process, long track, long start, long end);
+    // Finish the event
+    void endEvent();
+    // Add the name of a process or track to the buffer
+    void writeName(const char *kind, long process, long track, const std::string &name);
+    // Start the JSON
+    void writeHeader();
+    // Write the buffer to the file (or add it to the text in memory)
+    void flush();
+public:
+    SimTrace(const std::string &path);
+    // Keep the trace in memory
+    SimTrace();
+    ~SimTrace();
+
+    // Did the file open? (always true in memory)
+    bool isOpen();
+    // The trace kept in memory. It is complete once close() has been called.
+    const std::string &getText();
+    // Finish the JSON and close the file
+    void close();
+    // How many events have been written
+    long getEventCount();
+
+    // Called by Simulation::run before the engine starts
+    void startRun(long duration, long siteCount, int nextPlaneNumber);
+    // A flight has ended (or was cut off by a fault or the end of the simulation)
+    void flight(int planeNumber, Company theCompany, long originSite, long destinationSite, long startTime, long endTime,
+                long passengerCount, long faultCount);
+    // A plane has been put on a charger
+    void chargeStarted(int planeNumber, Company theCompany, long site, long currentTime);
+    // A charge has ended (or was cut off by the end of the simulation)
+    void charge(int planeNumber, Company theCompany, long site, long startedWaiting, long startTime, long endTime);
+    // A fault has grounded a plane for the rest of the simulation
+    void grounded(int planeNumber, Company theCompany, long site, long currentTime);
+};
+
+// Trace the same seeded run with both engines and check that the traces are the same and
+// that they agree with the results. It reports errors to cout.
+bool testSimTrace();
+
+#endif /* SimTrace_hpp */
@@ -13,7 +13,14 @@
 #include <queue>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <climits>
+#include <chrono>
 #include "SimSettings.hpp"
+#include "SimRandom.hpp"
+#include "SimProfile.hpp"
+#include "SimMemory.hpp"
+#include "FlightRecorder.hpp"
 
 
 /*
@@ -32,6 +39,7 @@ struct FlightStats {
     long faultCount; // How many faults during the flight
     double passengerMiles; // Calculate the passenger miles on a per flight basis since
                         // they cannot be calculated from an aggregate number of passengers and miles
+    long siteNumber; // Site the flight took off from
 };
 /*
  *******************************************************************************************
@@ -46,6 +54,7 @@ struct ChargerStats {
     int planeNumber; // Plane number to help with debugging
     long duration; // How long on the charger. If time runs out, partial time is logged.
     long durationWithWait; // How long on the charger plus wait time. If time runs out, partial time is logged.
+    long siteNumber; // Site of the charger
 };
 // These are for the final statistics returned by each simulator run.
 // There will be one row for each company/type of plane.
@@ -85,9 +94,103 @@ struct FinalStats {
 class SimClock; // Forward reference since they reference each other
 class ChargerQueue; // Forward reference since they reference each other
 class PlaneQueue; // Forward reference since they reference each other
+class Plane; // Forward reference since they reference each other
+class SimTrace; // Forward reference, see SimTrace.hpp
+class FastEngine; // Forward reference, see FastEngine.hpp
+
+/*
+ *******************************************************************************************
+ * Struct StatsTotals
+ * The FlightStats and ChargerStats added up for each company, across all sites and at each
+ * site. run() adds up the records kept during the run when it is done, or a run that has
+ * switched to streaming aggregation adds each record as it happens. Either way they are
+ * added in the order they happened, so the results are exactly the same.
+ * *******************************************************************************************
+ */
+struct StatsTotals {
+    long flightCounts[companyCount]{};
+    FlightStats flightTotals[companyCount]{};
+    long chargeCounts[companyCount]{};
+    ChargerStats chargerTotals[companyCount]{};
+    // The site totals are indexed by site * companyCount + company
+    std::vector<long> siteFlightCounts;
+    std::vector<FlightStats> siteFlightTotals;
+    std::vector<long> siteChargeCounts;
+    std::vector<ChargerStats> siteChargerTotals;
+
+    // Clear the totals for a run with siteCount sites
+    void reset(long siteCount);
+    // Add one record to the totals for its company and site, or count records that have
+    // already been added together into one
+    void addFlight(const FlightStats &f, long count = 1);
+    void addCharge(const ChargerStats &cs, long count = 1);
+    // Add another set of totals for the same sites to these, times over (as if each of
+    // other's records had been added that many times)
+    void add(const StatsTotals &other, long times = 1);
+};
+
+/*
+ *******************************************************************************************
+ * Struct SimSite
+ * A site (vertiport) has its own bank of chargers and its own queue of planes waiting for
+ * passengers. Each queue is a separate handler in the SimClock, so an event at one site
+ * only touches that site's queues. A Simulation has SimSettings::siteCount of these.
+ * *******************************************************************************************
+ */
+struct SimSite {
+    std::shared_ptr<ChargerQueue> theChargerQueue;
+    std::shared_ptr<PlaneQueue> thePlaneQueue;
+};
+
+/*
+ *******************************************************************************************
+ * Struct SimDelta
+ * A change to the settings of a paused run, for Simulation::whatIf(). Each setting is
+ * only changed if it is not -1. The changes take effect at the time of the pause:
+ *   - More chargers take waiting planes straight away. With fewer, the planes already
+ *     charging finish, and waiting planes get a charger when fewer than the new count are
+ *     in use.
+ *   - A new passenger delay is used for planes that finish charging from then on.
+ *   - A new fault option is used for faults from then on. Planes that are already grounded
+ *     stay grounded.
+ *   - The added planes join the plane queue at their site, each with its own new random
+ *     numbers and a passenger delay as at the start of a run.
+ * *******************************************************************************************
+ */
+struct SimDelta {
+    long chargerCount = -1;
+    long maxPassengerDelay = -1;
+    int faultOption = -1;
+    std::vector<std::vector<Company>> addedPlanes; // The companies of the planes to add, indexed by site
+
+    // A short description, such as "12 chargers, 4 more planes", or "no change"
+    std::string describe() const;
+};
+
+/*
+ *******************************************************************************************
+ * Struct PathDerivatives
+ * How a run's totals would change with the time_to_charge__hours chosen by
+ * SimSettings::chargeTimeDerivativeOption, per hour of charge time. The FastEngine follows
+ * them along the run's own events, keeping the order the events came in. When a plane waits
+ * for a charger, a small change can swap which plane waits, which these miss, so they are
+ * only the derivatives of the results if waits is 0 (see Sensitivity.hpp).
+ * *******************************************************************************************
+ */
+struct PathDerivatives {
+    bool followed; // False if the run did not follow them
+    long waits; // How many times a plane waited for a charger
+    double waitSeconds; // Of the seconds waited for a charger by all the charges logged
+    double passengerMiles; // Of the passenger miles of all the flights
+};
+
 class Simulation {
    
 protected:
+    // The memory in use by this Simulation. It is the first member so it is destroyed last,
+    // after everything it counts has been freed.
+    SimMemory theMemory;
+
     // When constructed, a Simulation constructs one ovject of each of the following three
     // Class objects. They are each passed a pointer to this Simulation so they have access
     // to each other and to the other protected class members below. So those classes need
@@ -97,23 +200,127 @@ protected:
     // outside a simulation (for testing), they will each individually behave correctly
     // id pased a nullptr passed for the Simulation when they are constructed.
     // Forward references since these classes reference each other
+    // There is one ChargerQueue and one PlaneQueue for each site, indexed by site number.
     friend class SimClock;
     friend class ChargerQueue;
     friend class PlaneQueue;
     std::shared_ptr<SimClock> theSimClock;
-    std::shared_ptr<ChargerQueue> theChargerQueue;
-    std::shared_ptr<PlaneQueue> thePlaneQueue;
+    std::vector<SimSite> theSites;
     // When some of those three classes create any Flight objects, they forward the pointer
     // to this Simulation so it also needs access to the procted members of this class.
     friend class Flight;
+    // The FastEngine runs the same simulation without any of those objects, but it uses the
+    // same settings, random numbers and statistics vectors.
+    friend class FastEngine;
+    // The DecoupledEngine runs each plane on its own when no plane ever waits for a charger.
+    // It adds its totals straight into theTotals.
+    friend class DecoupledEngine;
+    // The CohortEngine runs planes that are in step as one, and also adds into theTotals.
+    friend class CohortEngine;
+    // The FluidModel follows the fleet as amounts in each state instead of planes. It adds
+    // its rounded totals into theTotals.
+    friend class FluidModel;
 
     // Shared settings for this instance of the Simulation
     std::shared_ptr<SimSettings> theSettings;
 
     // These two vectors are used by the friend classes to accumulate statistics about
     // the run of this Simulation. The Simulation constructor initializes them as empty.
-    std::vector<FlightStats> theFlightStats;
-    std::vector<ChargerStats> theChargerStats;
+    CountedVector<FlightStats> theFlightStats;
+    CountedVector<ChargerStats> theChargerStats;
+
+    // Once a run switches to streaming aggregation the stats go straight into these totals
+    // instead of those two vectors (see SimSettings::memoryBudgetOption).
+    StatsTotals theTotals;
+    bool streaming;
+    // Set when the run should stop at the current time because it is over its memory budget.
+    // The engines check it before each event.
+    bool stopRequested;
+
+    // The engines call these to record a flight or charge, which also checks the memory budget
+    void recordFlight(const FlightStats &someStats, long currentTime);
+    void recordCharge(const ChargerStats &someStats, long currentTime);
+
+    // If the run is over its memory budget (or would be after allocating moreBytes), switch to
+    // streaming aggregation or stop, as SimSettings::memoryBudgetOption says
+    void checkMemory(long currentTime, long moreBytes);
+
+    // Add up the records kept so far and free them. From now on records go into theTotals.
+    void startStreaming(long currentTime);
+
+    // The results of the last run broken down by site. Filled in by run().
+    std::vector<std::vector<FinalStats>> siteResults;
+
+    // The queues for a site. If the site does not exist these return a nullptr.
+    const std::shared_ptr<ChargerQueue> &getChargerQueue(long siteNumber);
+    const std::shared_ptr<PlaneQueue> &getPlaneQueue(long siteNumber);
+
+    // Choose where a flight taking off from fromSite will land, based on siteFlightOption.
+    // Any random choice comes from the random numbers of the plane making the flight.
+    long pickDestinationSite(long fromSite, SimRandom &random);
+
+    // The seed used for this run, the random numbers used to choose the companies of the
+    // planes, and how many planes have been made so far. Plane n gets stream n + 1 of the seed.
+    long theSeed;
+    SimRandom theRandom;
+    long planesMade;
+
+    // Create the next plane in the fleet with its own random numbers
+    std::shared_ptr<Plane> makePlane(Company theCompany);
+
+    // The planes made of each company, and how many of them the SimClock or FastEngine grounded
+    long companyPlanes[companyCount];
+    long companyGrounded[companyCount];
+    // The engines call this when a fault grounds a plane
+    void recordGrounded(Company theCompany);
+
+    // With a fault bias, every plane made, so the run's weight can be added up at the end
+    std::vector<std::shared_ptr<Plane>> weightedPlanes;
+    double faultLogWeight; // The log of getFaultWeight()
+
+    // How many events were handled by the engine in the last run
+    long eventCount;
+
+    // What the engine said about the last run (see getEngineNote())
+    std::string engineNote;
+
+    // If set, run() does not write its summary to cout
+    bool quiet;
+
+    // What the profiler found in the last run. The engine fills in the counts and event loop time.
+    SimProfile theProfile;
+
+    // The derivatives the FastEngine followed in the last run (SimSettings::chargeTimeDerivativeOption)
+    PathDerivatives thePathDerivatives;
+
+    // The last things the engine did, always kept so there is a history when something goes wrong
+    FlightRecorder theRecorder;
+
+    // If set, the engine writes the timeline of the run to this trace. The Simulation does not own it.
+    SimTrace *theTrace;
+
+    // Where the progress line measures the wall-clock rate from: when the run started (or
+    // finish() carried it on) and the simulated time then
+    std::chrono::steady_clock::time_point progressStartWall;
+    long progressStartTime;
+
+    // Run the simulation with a SimClock of EventHandler objects. The companies for the
+    // planes at each site are passed in. It returns the final simulated time.
+    long runHandlers(bool verbose, const std::vector<std::vector<Company>> &siteCompanies);
+
+    // The parts of run() before and after the engine. startRun() sets up the seed, clears
+    // the last run and chooses the companies of the planes at each site. finishRun() adds up
+    // the stats of a run that ended at finalTime and returns the results.
+    std::vector<std::vector<Company>> startRun();
+    std::vector<FinalStats> finishRun(bool verbose, long finalTime, std::chrono::high_resolution_clock::time_point startTimer);
+
+    // A FastEngine stopped by pauseAt() or copied by branch(), waiting for finish()
+    std::unique_ptr<FastEngine> pausedEngine;
+    long pausedTime; // Where it stopped, or -1
+    long pausedEvents; // The events it had handled when it stopped
+
+    // A new Simulation with a copy of this paused one's settings, stats and engine, for branch() and whatIf()
+    std::unique_ptr<Simulation> copyPaused(const SimSettings &someSettings);
 
 public:
     Simulation(SimSettings someSettings);
@@ -121,10 +328,96 @@ public:
     
     // This function runs the simulation and returns the results
     std::vector<FinalStats> run(bool verbose);
+
+    // After run(), the same results for each site. The outer vector is indexed by site number.
+    const std::vector<std::vector<FinalStats>> &getSiteResults();
+
+    // After run(), the seed that was used. Putting it in SimSettings::randomSeed repeats the run.
+    long getSeed();
+
+    // After run(), how many events the engine handled
+    long getEventCount();
+
+    // After run() with SimSettings::engineOption 2, whether the planes were run on their own
+    // and how, or why the FastEngine ran instead. With engineOption 3, how many planes each
+    // flight event held, or why the FastEngine ran instead. With engineOption 4, the fluid
+    // model's step and where the fleet was at the end. With SimSettings::cycleOption 1, what the
+    // FastEngine found when it looked for a repeat. Otherwise empty.
+    const std::string &getEngineNote();
+
+    // After run(), how many planes of a company there were, and how many a fault grounded.
+    // Only the SimClock and FastEngine count the grounded planes; the other engines leave 0.
+    long getPlaneCount(Company theCompany);
+    long getGroundedCount(Company theCompany);
+
+    // After run(), the wait for a charger that the given fraction of the charges logged waited
+    // no longer than (0.95 for the 95th percentile), in seconds. It is -1 if the run did not
+    // keep each charge: the DecoupledEngine, CohortEngine and FluidModel, skipped repeats and
+    // streaming aggregation only keep totals.
+    double getWaitPercentile(double fraction);
+
+    // After run() with SimSettings::faultBias, how much more likely the run's faults were
+    // without the bias: the product of each plane's likelihood ratio. Averaging an outcome
+    // times this weight over runs with the bias estimates the outcome without it. It is 1
+    // without a bias.
+    double getFaultWeight();
+
+    // After run(), what the profiler found (enabled is false if SimSettings::profileOption was 0)
+    const SimProfile &getProfile();
+
+    // After run(), the derivatives asked for by SimSettings::chargeTimeDerivativeOption
+    // (followed is false if it was -1 or the run could not follow them)
+    const PathDerivatives &getPathDerivatives();
+
+    // After run(), the memory the run used by category, and what happened if it went over budget
+    const SimMemory &getMemory();
+
+    // After run() (or while it runs, from an engine's error path), the last things the engine did
+    const FlightRecorder &getFlightRecorder();
+    // Write the last entries of the flight recorder (all of them if last is 0) to out
+    void dumpFlightRecorder(std::ostream &out, size_t last = flightRecorderDumpCount);
+
+    // The SimMemory of a Simulation, or nullptr for objects made outside a Simulation (for testing)
+    static SimMemory *memoryOf(Simulation *aSimulation);
+
+    // For testing: do not write the summary of each run to cout
+    void setQuiet(bool newValue);
+
+    // Write the timeline of the next run to aTrace (or nullptr for no trace). The trace must
+    // last until the run is done, and holds only one run.
+    void setTrace(SimTrace *aTrace);
     
+    // Warm starts: run the FastEngine to pauseTime once, then branch() copies of that state
+    // that each carry on with their own random numbers, so they share the time before the
+    // pause instead of each running it. pauseAt() returns where it stopped, or -1 if the run
+    // cannot be copied (see FastEngine::canBranch()) and nothing was run. It always uses the
+    // FastEngine, whatever the settings' engineOption, and it is not profiled.
+    long pauseAt(long pauseTime);
+    // A new Simulation with a copy of this paused one's state, with every plane reseeded from
+    // its own random numbers and branchNumber (see FastEngine::reseed()). Branches with
+    // different numbers go their own ways; the same number gives the same branch. Returns
+    // nullptr if this Simulation is not paused. The branch has this one's trace setting and
+    // quiet setting, and it is paused until its finish() is called.
+    std::unique_ptr<Simulation> branch(uint64_t branchNumber);
+    // What-if runs: a new Simulation with a copy of this paused one's state and aDelta applied
+    // to it at the pause, so only the time after the pause is run again for each change.
+    // The planes keep their random numbers, so a what-if with no change finishes exactly as
+    // this one would, and the difference between two what-ifs comes from their changes
+    // rather than from chance. Returns nullptr if this Simulation is not paused or the
+    // delta names a site the run does not have. The what-if's settings include the change.
+    std::unique_ptr<Simulation> whatIf(const SimDelta &aDelta);
+    // Carry a paused Simulation or a branch on to the end of the run and return the results
+    // as run() would, including the flights and charges before the pause. The engine note
+    // says where it was paused and how many events came after.
+    std::vector<FinalStats> finish();
+
     // How often do we show progress indicator (<= 0 means not at all)
     // This decides it based on settings
     long getProgressInterval();
+    // Show the progress line for a clock at clockTime of endTime, with the wall-clock time so
+    // far and how much more the rest should take at the rate of simulated time to wall-clock
+    // time since the run started. The engines call it every getProgressInterval().
+    void showProgress(long clockTime, long endTime);
 };
 
 #endif /* Simulation_hpp */
@@ -9,6 +9,7 @@
 #include <vector>
 #include <queue>
 #include <string>
+#include <algorithm>
 #include "CmdLineMenus.hpp"
 using namespace std;
 
@@ -12,6 +12,7 @@
 #include <string>
 #include <chrono>
 #include <iomanip>
+#include <memory>
 #include "DebugHelp.hpp"
 #include "CmdLineMenus.hpp"
 #include "TestsMenu.hpp"
@@ -19,6 +20,11 @@
 #include "MenuGroupWithAllOption.hpp"
 #include "Simulation.hpp"
 #include "SimSettings.hpp"
+#include "SimTrace.hpp"
+#include "RareEvents.hpp"
+#include "Sensitivity.hpp"
+#include "ChargerOptimizer.hpp"
+#include "RuntimeEstimate.hpp"
 
 using namespace std;
 
@@ -31,17 +37,42 @@ void outputSettings(const SimSettings &s)
 {
     cout << "Simulation Settings:" << endl;
     cout << "Duration: " << s.simulationDuration << " seconds" << endl;
-    cout << "Using " << s.chargerCount << " chargers and "  << s.planeCount << " planes" << endl;
+    if(s.siteCount > 1) {
+        cout << "Using " << s.siteCount << " sites with " << s.chargerCount << " chargers each and "  << s.planeCount << " planes" << endl;
+        cout << "Site Flight Option: "
+        << (s.siteFlightOption == 0 ? "Flights return to the site they left from" : "Flights land at a random other site") << endl;
+    } else {
+        cout << "Using " << s.chargerCount << " chargers and "  << s.planeCount << " planes" << endl;
+    }
     cout << "Minimum planes per kind: " << s.minPlanePerKind << endl;
     cout << "Passenger Count Option: "
     << (s.passengerCountOption == 0 ? "Planes always fly full" : "Passenger count random up to max") << endl;
     cout << "Passenger Option: "
     << (s.faultOption == 0 ? "Faults counted, but do not affect flights" : (s.faultOption == 01 ? "A fault grounds plane immediately" : "A fault grounds plane at end of current flight")) << endl;
+    if(s.faultOption == 0) {
+        cout << "Fault Count Option: " << (s.faultCountOption == 0 ? "Each fault is an event" : "Faults counted when each flight ends") << endl;
+    }
     string delayString = "No delay for passengers";
     if(s.passengerCountOption > 0) {
         delayString = "When ready to fly, planes experience a random [0 - " + to_string(s.passengerCountOption) + "] second delay for passengers";
     }
     cout << "Passenger Delay Option: " << delayString << endl;
+    cout << "Charger Policy Option: " << chargerPolicyName(s.chargerPolicyOption) << endl;
+    cout << "Engine Option: " << (s.engineOption == 0 ? "SimClock of event handlers" :
+                                  (s.engineOption == 1 ? "FastEngine" : s.engineOption == 2 ? "Decoupled planes (FastEngine if chargers are short)" :
+                                   s.engineOption == 3 ? "Cohorts of planes in step (FastEngine if faults are not counted when flights end)" :
+                                   "Fluid model of the fleet (an approximation for large fleets)")) << endl;
+    cout << "Cycle Option: " << (s.cycleOption == 0 ? "Handle every event" : "Skip repeats when nothing but faults is random") << endl;
+    cout << "Profile Option: " << (s.profileOption == 0 ? "No profiling" :
+                                   s.profileOption == 1 ? "Profile the engine" : "Profile the engine with hardware counters") << endl;
+    if(s.memoryBudgetMB > 0) {
+        cout << "Memory Budget: " << s.memoryBudgetMB << " MB, then "
+        << (s.memoryBudgetOption == 0 ? "switch to streaming aggregation" : "stop the simulation") << endl;
+    }
+    cout << "Random Seed: " << (s.randomSeed > 0 ? to_string(s.randomSeed) : string{"New seed each run"}) << endl;
+    if(s.warmUpHours > 0) {
+        cout << "Multiple Runs: branched from one run warmed up to " << s.warmUpHours << " hours" << endl;
+    }
     cout << endl;
 }
 
@@ -102,6 +133,128 @@ void outputResults(std::vector<FinalStats> results)
 
 }
 
+// This function displays one line for each site with the results for all companies at
+// that site combined. It is kept to one line per site since there may be hundreds of sites.
+void outputSiteResults(const std::vector<std::vector<FinalStats>> &siteResults)
+{
+    cout << left << setw(8) << "Site"
+    << left << setw(9) << "Flights "
+    << left << setw(9) << "Charges "
+    << left << setw(13) << "Time/Charge "
+    << left << setw(17) << "Time incl. Wait "
+    << left << setw(8) << "Faults "
+    << left << setw(15) << "Passenger Miles"
+    << endl;
+    for(size_t site = 0; site < siteResults.size(); site++) {
+        long flights{0};
+        long charges{0};
+        double chargeTime{0.0};
+        double chargeTimeWithWait{0.0};
+        long faults{0};
+        double passengerMiles{0.0};
+        for(auto r: siteResults[site]) {
+            flights += r.totalFlights;
+            charges += r.totalCharges;
+            // The averages are per company so weight them by the number of charges to combine them
+            chargeTime += r.averageTimeCharging * r.totalCharges;
+            chargeTimeWithWait += r.averageTimeChargingWithWait * r.totalCharges;
+            faults += r.totalFaults;
+            passengerMiles += r.totalPassengerMiles;
+        }
+        double chargeCountD = charges > 0 ? charges : 1.0; // so we avoid division by 0
+        cout << setprecision(2) << fixed
+        << left << setw(8) << site
+        << left << setw(9) << flights
+        << left << setw(9) << charges
+        << left << setw(13) << chargeTime / chargeCountD
+        << left << setw(17) << chargeTimeWithWait / chargeCountD
+        << left << setw(8) << faults
+        << left << setw(15) << passengerMiles
+        << endl;
+    }
+}
+
+// This function displays what the profiler found during a simulation run
+void outputProfile(const SimProfile &p)
+{
+    cout << "Engine profile:" << endl;
+    cout << left << setw(14) << "Handler"
+    << left << setw(12) << "Events"
+    << left << setw(12) << "Sampled"
+    << left << setw(14) << "Est. Seconds"
+    << left << setw(12) << "ns/Event"
+    << endl;
+    for(int kind = 0; kind < profileKindCount; kind++) {
+        const ProfileKindStats &k = p.kinds[kind];
+        if(k.events == 0) { continue; }
+        cout << setprecision(4) << fixed
+        << left << setw(14) << profileKindName(kind)
+        << left << setw(12) << k.events
+        << left << setw(12) << k.sampledEvents
+        << left << setw(14) << k.estimatedSeconds()
+        << setprecision(0)
+        << left << setw(12) << (k.sampledEvents > 0 ? k.sampledSeconds * 1e9 / k.sampledEvents : 0.0)
+        << endl;
+    }
+    cout << "Clock inserts: " << p.queueInserts << ", re-sorts: " << p.reSorts
+    << " (moved " << p.reSortDistance << " heap levels in all), peak handlers: " << p.peakHandlers << endl;
+    cout << setprecision(1) << fixed << "Events per simulated hour: " << p.eventsPerSimulatedHour << endl;
+    cout << setprecision(6) << "Setup: " << p.setupSeconds << " s, event loop: " << p.eventLoopSeconds
+    << " s, aggregation: " << p.aggregationSeconds << " s" << endl;
+    if(p.countersAvailable) {
+        // The event loop row covers every event and the close-out. The others are the timed events.
+        cout << "Hardware counters per event:" << endl;
+        cout << left << setw(14) << "Handler";
+        for(int counter = 0; counter < hardwareCounterCount; counter++) {
+            cout << left << setw(15) << (p.countersOpened[counter] ? hardwareCounterName(counter) : "(unavailable)");
+        }
+        cout << endl;
+        cout << setprecision(1) << fixed << left << setw(14) << "Event loop";
+        for(int counter = 0; counter < hardwareCounterCount; counter++) {
+            cout << left << setw(15) << p.loopCountPerEvent(counter);
+        }
+        cout << endl;
+        for(int kind = 0; kind < profileKindCount; kind++) {
+            const ProfileKindStats &k = p.kinds[kind];
+            if(k.sampledEvents == 0) { continue; }
+            cout << left << setw(14) << profileKindName(kind);
+            for(int counter = 0; counter < hardwareCounterCount; counter++) {
+                cout << left << setw(15) << k.countPerEvent(counter);
+            }
+            cout << endl;
+        }
+    } else if(p.countersRequested) {
+        cout << "Hardware counters are not available (" << p.countersNote << "), so this is timing only" << endl;
+    }
+    cout << defaultfloat;
+}
+
+// This function displays the memory a simulation run used, by category
+void outputMemory(const SimMemory &m)
+{
+    cout << "Memory use:" << endl;
+    cout << left << setw(16) << "Category"
+    << left << setw(16) << "Current KB"
+    << left << setw(16) << "Peak KB"
+    << endl;
+    for(int category = 0; category < memoryCategoryCount; category++) {
+        cout << left << setw(16) << memoryCategoryName(category)
+        << left << setw(16) << m.currentBytes[category] / 1024
+        << left << setw(16) << m.peakBytes[category] / 1024
+        << endl;
+    }
+    cout << left << setw(16) << "Total"
+    << left << setw(16) << m.currentTotal / 1024
+    << left << setw(16) << m.peakTotal / 1024
+    << endl;
+    if(m.streamingSince >= 0) {
+        cout << "Switched to streaming aggregation at " << m.streamingSince << " seconds" << endl;
+    }
+    if(m.stoppedAt >= 0) {
+        cout << "Stopped for going over the memory budget at " << m.stoppedAt << " seconds" << endl;
+    }
+}
+
 // Set up the progress indicator if it seems like this may be a longg run
 // This is done once per execution of the program to ensure that the monitor
 // or terminal program supports '\r' to allow overwriting lines on the screen
@@ -153,6 +306,9 @@ vector<MenuItem> continueLongMenus {
 };
 MenuGroup continueLongMenu = MenuGroup(continueLongMenus);
 
+// Where "Run Simulation and Write a Trace" writes the trace, in the current directory
+const char *traceFileName{"JobyTrace.json"};
+
 // Run a simulation. This function uses the memuItem selector to run different simulations
 // with the same function.
 bool runSimulation(int selector, MenuGroup &thisMenuGroup) {
@@ -172,13 +328,6 @@ bool runSimulation(int selector, MenuGroup &thisMenuGroup) {
     } else if(selector == 5) {
         runSettings.simulationDuration = secondsPerHour * 35040; // 35040 hours (4 years)
     } else if(selector == 6) {
-        // Make sure the user is read for a long run
-        cout << "This stress test could take 10 to 45 minutes depending on the computer" << endl;
-        cout << "Do you want to continue?" << endl;
-        continueLongMenu.runMenu();
-        if(!continueWithLongSimulation) { return false; }
-        cout << "This may take a while..." << endl;
-        
         runSettings.simulationDuration = secondsPerHour * 35040; // 35040 hours (4 years)
         runSettings.planeCount = 1000; // 1000 planes
         runSettings.chargerCount = 150; // 150 chargers
@@ -187,6 +336,17 @@ bool runSimulation(int selector, MenuGroup &thisMenuGroup) {
             // This means the first 500 will be allocated randomly, but constrained to have
             // 100 plane each. The last 500 planes will be completely randomly allocated.
     }
+    // For the long stress tests, time the first hours of the run to say how long all of it should take
+    if(selector >= 4 && selector <= 6) {
+        cout << "Timing a short pilot of this run..." << endl;
+        writeRuntimeEstimate(estimateRuntime(runSettings), cout);
+    }
+    if(selector == 6) {
+        // Make sure the user is ready for a long run
+        cout << "Do you want to continue?" << endl;
+        continueLongMenu.runMenu();
+        if(!continueWithLongSimulation) { return false; }
+    }
 
     // Set the progress indicator option (if needed)
     // We pass in runSettings so it decides based on the simulation that will run
@@ -195,12 +355,38 @@ bool runSimulation(int selector, MenuGroup &thisMenuGroup) {
 
     // Create and run the simulation
     Simulation aSimulation(runSettings);
+    // If the selectorValue == 7, write a trace of the run that can be opened in Perfetto or chrome://tracing
+    std::unique_ptr<SimTrace> aTrace;
+    if(selector == 7) {
+        aTrace.reset(new SimTrace(traceFileName));
+        if(!aTrace->isOpen()) {
+            cout << "Could not open " << traceFileName << " to write the trace" << endl;
+            return false;
+        }
+        aSimulation.setTrace(aTrace.get());
+    }
     // If the selectorValue == 1 that was used to run a verbose simulation (useful for testing)
     std::vector<FinalStats> results = aSimulation.run(selector == 1 ? true : false);
+    if(aTrace) {
+        aTrace->close();
+        cout << "Wrote " << aTrace->getEventCount() << " trace events to " << traceFileName
+        << " (open it at https://ui.perfetto.dev or chrome://tracing)" << endl;
+    }
     
     outputSettings(runSettings);
     cout << "Results for this simulation run:" << endl;
     outputResults(results);
+    if(runSettings.siteCount > 1) {
+        cout << endl;
+        cout << "Results by site:" << endl;
+        outputSiteResults(aSimulation.getSiteResults());
+    }
+    if(aSimulation.getProfile().enabled) {
+        cout << endl;
+        outputProfile(aSimulation.getProfile());
+    }
+    cout << endl;
+    outputMemory(aSimulation.getMemory());
 
     return false;
 }
@@ -231,12 +417,32 @@ bool runMultiple(int selector, MenuGroup &thisMenuGroup) {
 
     // The Simulator function times individual simulations, but this will time the series
     auto startTimer = std::chrono::high_resolution_clock::now();
-    
+
+    // With a warm-up, run it once and branch each run from where it stopped (see SimSettings::warmUpHours)
+    std::unique_ptr<Simulation> warmedUp;
+    if(runSettings.warmUpHours > 0) {
+        warmedUp.reset(new Simulation(runSettings));
+        if(warmedUp->pauseAt(runSettings.warmUpHours * secondsPerHour) < 0) {
+            cout << "Warm starts need first come, first served chargers, so each run starts from time 0" << endl;
+            warmedUp.reset();
+        }
+    }
+
     // Repeat the simulation with the current parameters
     for(int run = 0; run < runCount; run++) {
-        // run each simulation
-        Simulation aSimulation(runSettings);
-        std::vector<FinalStats> results = aSimulation.run(false);
+        std::vector<FinalStats> results;
+        if(warmedUp) {
+            results = warmedUp->branch(run + 1)->finish();
+        } else {
+            // run each simulation. With a fixed seed, each run uses the next seed so the
+            // series can be repeated but the runs are not all the same.
+            SimSettings seriesSettings = runSettings;
+            if(runSettings.randomSeed > 0) {
+                seriesSettings.randomSeed = runSettings.randomSeed + run;
+            }
+            Simulation aSimulation(seriesSettings);
+            results = aSimulation.run(false);
+        }
 
         // accumulate the results
         // TO-DO: Faily confident that none of these overflow the capacity of long and double as we
@@ -285,12 +491,94 @@ bool runMultiple(int selector, MenuGroup &thisMenuGroup) {
         accumulatedStats[c].totalPassengerMiles /= runCount;
     }
     outputSettings(runSettings);
-    cout << "Average results for " << runCount << " simulation runs:" << endl;
+    cout << "Average results for " << runCount << " simulation runs";
+    if(warmedUp) {
+        cout << " (all sharing the first " << runSettings.warmUpHours << " hours, seed " << warmedUp->getSeed() << ")";
+    }
+    cout << ":" << endl;
     outputResults(accumulatedStats);
 
     return false;
 }
 
+// Estimate the chance that a whole company is grounded in one run, with faults made more
+// likely and each run weighted to undo it (see RareEvents.hpp)
+bool estimateRareGrounding(int selector, MenuGroup &thisMenuGroup) {
+    debugMessage("===> Selected Estimate Rare Grounding");
+    SimSettings runSettings = currentSettings;
+    if(runSettings.faultOption != 1 && runSettings.faultOption != 2) {
+        cout << "Only a fault option that grounds planes can ground a company. Change the fault option first." << endl;
+        return false;
+    }
+    long companyNumber = 0;
+    while(companyNumber < 1 || companyNumber > companyCount) {
+        companyNumber = thisMenuGroup.getNumberFromUser("Input the company to ground (1 = Alpha, 2 = Bravo, 3 = Charlie, 4 = Delta, 5 = Echo): ");
+    }
+    long runs = 0;
+    while(runs <= 0) {
+        runs = thisMenuGroup.getNumberFromUser("Input the number of weighted runs (1000 is usually plenty): ");
+    }
+    Company theCompany = allCompany[companyNumber - 1];
+    RareEventEstimate estimate = estimateGroundingChance(runSettings, theCompany, runs);
+    outputSettings(runSettings);
+    cout << "Chance that every " << companyName(theCompany) << " plane is grounded by the end of a run: "
+    << estimate.probability << " +/- " << estimate.standardError << " (one standard error)" << endl;
+    cout << estimate.runs << " runs with " << companyName(theCompany) << " faults " << estimate.faultBias
+    << " times as likely, " << estimate.hits << " of them grounded every plane, in " << estimate.seconds << " seconds" << endl;
+    if(estimate.plainRuns > 0) {
+        cout << "Counting plain runs would take about " << std::fixed << std::setprecision(0) << estimate.plainRuns
+        << std::defaultfloat << " runs for the same standard error" << endl;
+    }
+    return false;
+}
+
+// Estimate how much the results change with a setting, from pairs of runs with the same
+// seeds and, where it can, along each run's own path (see Sensitivity.hpp)
+bool estimateSensitivities(int selector, MenuGroup &thisMenuGroup) {
+    debugMessage("===> Selected Estimate Sensitivities");
+    SimSettings runSettings = currentSettings;
+    long parameterNumber = 0;
+    while(parameterNumber < 1 || parameterNumber > sensitivityParameterCount) {
+        parameterNumber = thisMenuGroup.getNumberFromUser("Input the setting to change (1 = chargers, 2 = maximum passenger delay, 3 = charge time): ");
+    }
+    SensitivityParameter parameter = static_cast<SensitivityParameter>(parameterNumber - 1);
+    long companyNumber = 0;
+    if(parameter == sensitivityTimeToCharge) {
+        while(companyNumber < 1 || companyNumber > companyCount + 1) {
+            companyNumber = thisMenuGroup.getNumberFromUser("Input the company (1 = Alpha, 2 = Bravo, 3 = Charlie, 4 = Delta, 5 = Echo, 6 = all of them): ");
+        }
+    }
+    long runs = 0;
+    while(runs <= 1) {
+        runs = thisMenuGroup.getNumberFromUser("Input the number of seeds (each is run three times, 20 is usually plenty): ");
+    }
+    SensitivityEstimate estimate = estimateSensitivity(runSettings, parameter, static_cast<int>(std::max(0L, companyNumber - 1)), runs);
+    outputSettings(runSettings);
+    writeSensitivity(estimate, cout);
+    return false;
+}
+
+// Estimate the fewest chargers that keep the 95th percentile of the wait for a charger and the
+// flights per hour within a target, by bracketing and bisecting. The confidence is split between
+// every count the search can try, so it holds for the answer as a whole (see ChargerOptimizer.hpp).
+bool findFewestChargers(int selector, MenuGroup &thisMenuGroup) {
+    debugMessage("===> Selected Find the Fewest Chargers");
+    SimSettings runSettings = currentSettings;
+    long waitMinutes = -1;
+    while(waitMinutes < 0) {
+        waitMinutes = thisMenuGroup.getNumberFromUser("Input the longest 95th percentile wait for a charger, in minutes: ");
+    }
+    long flightsPerHour = -1;
+    while(flightsPerHour < 0) {
+        flightsPerHour = thisMenuGroup.getNumberFromUser("Input the fewest flights per hour for the fleet (0 for any): ");
+    }
+    ServiceTarget target{waitMinutes * 60.0, static_cast<double>(flightsPerHour), 0.02, 0.95};
+    ChargerSearch search = findMinimumChargers(runSettings, target);
+    outputSettings(runSettings);
+    writeChargerSearch(search, target, cout);
+    return false;
+}
+
 // This handles quitting the simulation by returning false when this is in MenuFuncPtr.
 bool doQuit(int selector, MenuGroup &thisMenuGroup) {
     debugMessage("===> Selected Quit");
@@ -303,6 +591,10 @@ vector<MenuItem> mainMenus {
     MenuItem('R', string{"Run Simulation with Current Settings"}, &runSimulation, 0),
     MenuItem('A', string{"Average results from 100 Simulations"}, &runMultiple, 0),
     MenuItem('V', string{"Run Simulation Verbose with Current Settings"}, &runSimulation, 1),
+    MenuItem('X', string{"Run Simulation with Current Settings and Write a Trace (JobyTrace.json)"}, &runSimulation, 7),
+    MenuItem('G', string{"Estimate the Chance a Whole Company Is Grounded (Rare Events)"}, &estimateRareGrounding, 0),
+    MenuItem('S', string{"Estimate Sensitivities of the Results to a Setting"}, &estimateSensitivities, 0),
+    MenuItem('O', string{"Estimate the Fewest Chargers That Meet a Service Target"}, &findFewestChargers, 0),
     MenuItem('T', string{"Run Tests"}, &runTests, 0),
     MenuItem('-', string{""}, nullptr, 0),
     MenuItem(' ', string{"Stress Test Options:"}, nullptr, 0),
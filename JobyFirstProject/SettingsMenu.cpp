@@ -88,6 +88,17 @@ bool setPassengerDelayOption(int selector, MenuGroup &thisMenuGroup) {
     return false;
 }
 
+// Implement a menu that selects the value for currentSettings.faultCountOption
+bool selectFaultCountOption(int selector, MenuGroup &thisMenuGroup) {
+    currentSettings.faultCountOption = selector;
+    return true;
+}
+vector<MenuItem> faultCountOptionMenus {
+    MenuItem('1', string{"Each Fault Is an Event"}, &selectFaultCountOption, 0),
+    MenuItem('2', string{"Count a Flight's Faults When It Ends (Fewer Events)"}, &selectFaultCountOption, 1),
+};
+MenuGroup faultCountOptionMenu = MenuGroup(faultCountOptionMenus);
+
 // Implement a menu that selects the value for currentSettings.faultOption
 bool selectFaultOption(int selector, MenuGroup &thisMenuGroup) {
     currentSettings.faultOption = selector;
@@ -101,6 +112,161 @@ vector<MenuItem> faultOptionMenus {
 MenuGroup faultOptionMenu = MenuGroup(faultOptionMenus);
 bool setFaultOption(int selector, MenuGroup &thisMenuGroup) {
     faultOptionMenu.runMenu();
+    if(currentSettings.faultOption == 0) {
+        cout << "Is each fault an event, or are they counted when each flight ends?" << endl;
+        faultCountOptionMenu.runMenu();
+    }
+    return false;
+}
+
+// Implement a menu that selects the value for currentSettings.chargerPolicyOption
+bool selectChargerPolicyOption(int selector, MenuGroup &thisMenuGroup) {
+    currentSettings.chargerPolicyOption = selector;
+    return true;
+}
+vector<MenuItem> chargerPolicyOptionMenus {
+    MenuItem('1', string{chargerPolicyName(chargerPolicyFIFO)}, &selectChargerPolicyOption, chargerPolicyFIFO),
+    MenuItem('2', string{chargerPolicyName(chargerPolicyShortestCharge)}, &selectChargerPolicyOption, chargerPolicyShortestCharge),
+    MenuItem('3', string{chargerPolicyName(chargerPolicyCompanyPriority)}, &selectChargerPolicyOption, chargerPolicyCompanyPriority),
+    MenuItem('4', string{chargerPolicyName(chargerPolicyPassengerValue)}, &selectChargerPolicyOption, chargerPolicyPassengerValue),
+    MenuItem('5', string{chargerPolicyName(chargerPolicyReservation)}, &selectChargerPolicyOption, chargerPolicyReservation),
+};
+MenuGroup chargerPolicyOptionMenu = MenuGroup(chargerPolicyOptionMenus);
+bool setChargerPolicyOption(int selector, MenuGroup &thisMenuGroup) {
+    chargerPolicyOptionMenu.runMenu();
+    // The company priority policy also needs an order for the companies
+    if(currentSettings.chargerPolicyOption == chargerPolicyCompanyPriority) {
+        for(auto c: allCompany) {
+            currentSettings.companyPriority[c] = static_cast<int>(thisMenuGroup.getNumberFromUser(
+                string{"Input charger priority for "} + companyName(c) + " (lower goes first): "));
+        }
+    }
+    return false;
+}
+
+// Get input from the user for the value for currentSettings.siteCount
+bool setSiteCount(int selector, MenuGroup &thisMenuGroup) {
+    // loop until we receive a number we can use
+    while(true) {
+        long tempSiteCount = thisMenuGroup.getNumberFromUser("Input number of sites (chargers are per site): ");
+        if(tempSiteCount >= 1) {
+            currentSettings.siteCount = tempSiteCount;
+            return false;
+        }
+        cout << "There must be at least one site" << endl;
+    }
+    return false;
+}
+
+// Implement a menu that selects the value for currentSettings.siteFlightOption
+bool selectSiteFlightOption(int selector, MenuGroup &thisMenuGroup) {
+    currentSettings.siteFlightOption = selector;
+    return true;
+}
+vector<MenuItem> siteFlightOptionMenus {
+    MenuItem('1', string{"Flights Return to the Site They Left From"}, &selectSiteFlightOption, 0),
+    MenuItem('2', string{"Flights Land at a Random Other Site"}, &selectSiteFlightOption, 1),
+};
+MenuGroup siteFlightOptionMenu = MenuGroup(siteFlightOptionMenus);
+bool setSiteFlightOption(int selector, MenuGroup &thisMenuGroup) {
+    siteFlightOptionMenu.runMenu();
+    return false;
+}
+
+// Get input from the user for the value for currentSettings.randomSeed
+bool setRandomSeed(int selector, MenuGroup &thisMenuGroup) {
+    currentSettings.randomSeed = thisMenuGroup.getNumberFromUser("Input random seed (0 = new seed each run): ");
+    return false;
+}
+
+// Implement a menu that selects the value for currentSettings.engineOption
+bool selectEngineOption(int selector, MenuGroup &thisMenuGroup) {
+    currentSettings.engineOption = selector;
+    return true;
+}
+vector<MenuItem> engineOptionMenus {
+    MenuItem('1', string{"SimClock of Event Handlers"}, &selectEngineOption, 0),
+    MenuItem('2', string{"FastEngine (not used for verbose runs)"}, &selectEngineOption, 1),
+    MenuItem('3', string{"Decoupled planes when chargers are never short, else FastEngine"}, &selectEngineOption, 2),
+    MenuItem('4', string{"Cohorts of planes in step (faults counted when flights end), else FastEngine"}, &selectEngineOption, 3),
+    MenuItem('5', string{"Fluid model of the fleet (an approximation for large fleets)"}, &selectEngineOption, 4),
+};
+MenuGroup engineOptionMenu = MenuGroup(engineOptionMenus);
+bool setEngineOption(int selector, MenuGroup &thisMenuGroup) {
+    engineOptionMenu.runMenu();
+    return false;
+}
+
+// Implement a menu that selects the value for currentSettings.cycleOption
+bool selectCycleOption(int selector, MenuGroup &thisMenuGroup) {
+    currentSettings.cycleOption = selector;
+    return true;
+}
+vector<MenuItem> cycleOptionMenus {
+    MenuItem('1', string{"Handle Every Event"}, &selectCycleOption, 0),
+    MenuItem('2', string{"FastEngine Skips Repeats When Nothing but Faults Is Random"}, &selectCycleOption, 1),
+};
+MenuGroup cycleOptionMenu = MenuGroup(cycleOptionMenus);
+bool setCycleOption(int selector, MenuGroup &thisMenuGroup) {
+    cycleOptionMenu.runMenu();
+    return false;
+}
+
+// Implement a menu that selects the value for currentSettings.profileOption
+bool selectProfileOption(int selector, MenuGroup &thisMenuGroup) {
+    currentSettings.profileOption = selector;
+    return true;
+}
+vector<MenuItem> profileOptionMenus {
+    MenuItem('1', string{"No Profiling"}, &selectProfileOption, 0),
+    MenuItem('2', string{"Profile the Engine and Show the Profile With the Results"}, &selectProfileOption, 1),
+    MenuItem('3', string{"Profile the Engine With Hardware Counters (Linux Only, Timing Only Elsewhere)"}, &selectProfileOption, 2),
+};
+MenuGroup profileOptionMenu = MenuGroup(profileOptionMenus);
+bool setProfileOption(int selector, MenuGroup &thisMenuGroup) {
+    profileOptionMenu.runMenu();
+    return false;
+}
+
+// Implement a menu that selects the value for currentSettings.memoryBudgetOption
+bool selectMemoryBudgetOption(int selector, MenuGroup &thisMenuGroup) {
+    currentSettings.memoryBudgetOption = selector;
+    return true;
+}
+vector<MenuItem> memoryBudgetOptionMenus {
+    MenuItem('1', string{"Switch to Streaming Aggregation, Then Stop If Still Over"}, &selectMemoryBudgetOption, 0),
+    MenuItem('2', string{"Stop the Simulation at the Current Time"}, &selectMemoryBudgetOption, 1),
+};
+MenuGroup memoryBudgetOptionMenu = MenuGroup(memoryBudgetOptionMenus);
+// Get input from the user for currentSettings.memoryBudgetMB and, if there is a budget, memoryBudgetOption
+bool setMemoryBudget(int selector, MenuGroup &thisMenuGroup) {
+    // loop until we receive a number we can use
+    while(true) {
+        long tempBudget = thisMenuGroup.getNumberFromUser("Input memory budget in MB (0 = no limit): ");
+        if(tempBudget >= 0) {
+            currentSettings.memoryBudgetMB = tempBudget;
+            break;
+        }
+        cout << "The memory budget cannot be negative" << endl;
+    }
+    if(currentSettings.memoryBudgetMB > 0) {
+        cout << "What happens when a run goes over its memory budget?" << endl;
+        memoryBudgetOptionMenu.runMenu();
+    }
+    return false;
+}
+
+// Get input from the user for the value for currentSettings.warmUpHours
+bool setWarmUp(int selector, MenuGroup &thisMenuGroup) {
+    // loop until we receive a number we can use
+    while(true) {
+        long tempHours = thisMenuGroup.getNumberFromUser("Input warm-up hours shared by multiple runs (0 = each run starts at 0): ");
+        if(tempHours >= 0) {
+            currentSettings.warmUpHours = tempHours;
+            return false;
+        }
+        cout << "The warm-up cannot be negative" << endl;
+    }
     return false;
 }
 
@@ -118,6 +284,15 @@ vector<MenuItem> settingsMenus {
     MenuItem('6', string{"Set Passenger Count Option"}, &setPassengerCountOption, 6),
     MenuItem('7', string{"Set Passenger Delay Option"}, &setPassengerDelayOption, 7),
     MenuItem('8', string{"Set Fault Option"}, &setFaultOption, 8),
+    MenuItem('9', string{"Set Charger Policy Option"}, &setChargerPolicyOption, 9),
+    MenuItem('S', string{"Set Site Count"}, &setSiteCount, 10),
+    MenuItem('F', string{"Set Site Flight Option"}, &setSiteFlightOption, 11),
+    MenuItem('R', string{"Set Random Seed"}, &setRandomSeed, 12),
+    MenuItem('G', string{"Set Engine Option"}, &setEngineOption, 13),
+    MenuItem('C', string{"Set Cycle Option"}, &setCycleOption, 16),
+    MenuItem('P', string{"Set Profile Option"}, &setProfileOption, 14),
+    MenuItem('B', string{"Set Memory Budget"}, &setMemoryBudget, 15),
+    MenuItem('W', string{"Set Warm-Up for Multiple Runs"}, &setWarmUp, 17),
     MenuItem('M', string{"Return to Main Menu"}, &returnToMainMenu, 0)
 };
 MenuGroup settingsMenu = MenuGroup(settingsMenus);
@@ -19,10 +19,26 @@
 
 // This is the one file in the group including main() and menu handling that includes headers
 // from the simulation other than Simulation.hpp and SimSettings.hpp. It uses the following
-// three includes to call the test functions for these classes.
+// includes to call the test functions for these classes.
 #include "SimClock.hpp"
 #include "ChargerQueue.hpp"
 #include "PlaneQueue.hpp"
+#include "ChargerPolicy.hpp"
+#include "FastEngine.hpp"
+#include "FastEngineCycles.hpp"
+#include "FastEngineBranch.hpp"
+#include "SimProfile.hpp"
+#include "SimMemory.hpp"
+#include "SimTrace.hpp"
+#include "DifferentialTest.hpp"
+#include "FlightRecorder.hpp"
+#include "DecoupledEngine.hpp"
+#include "CohortEngine.hpp"
+#include "FluidModel.hpp"
+#include "RareEvents.hpp"
+#include "Sensitivity.hpp"
+#include "ChargerOptimizer.hpp"
+#include "RuntimeEstimate.hpp"
 
 using namespace std;
 
@@ -79,6 +95,116 @@ bool testPlaneQueueMinimumPerKind(int selector) {
     testPlaneQueueForMinimumPerKind();
     return false;
 }
+// Test that the ChargerQueue heap and wait queue keep planes in the right order
+bool testChargerQueueOrdering(int selector) {
+    testChargerQueueOrder();
+    return false;
+}
+// Test that each charger policy hands out chargers in the right order
+bool testChargerPolicyOrdering(int selector) {
+    testChargerPolicies();
+    return false;
+}
+// Test that the PlaneQueue heap keeps planes in order and grounded planes apart
+bool testPlaneQueueOrdering(int selector) {
+    testPlaneQueueOrder();
+    return false;
+}
+// Time each charger policy with a long line of waiting planes
+bool benchmarkChargerPolicyOptions(int selector) {
+    benchmarkChargerPolicies();
+    return false;
+}
+// Test that the FastEngine gives the same results as the SimClock for the same seeds
+bool testFastEngineResults(int selector) {
+    testFastEngine();
+    return false;
+}
+// Test that the profiler counts match between the engines and do not change the results
+bool testProfiler(int selector) {
+    testSimProfile();
+    return false;
+}
+// Test that both engines write the same trace and that it matches the results
+bool testTraceExport(int selector) {
+    testSimTrace();
+    return false;
+}
+// Test that memory is counted and that a memory budget streams the stats or stops the run
+bool testMemoryAccounting(int selector) {
+    testSimMemory();
+    return false;
+}
+// Check the other engines against the SimClock on 1000 random scenarios
+bool testDifferentialEngines(int selector) {
+    testDifferential();
+    return false;
+}
+// Test that the flight recorder keeps the newest entries and that both engines record the same history
+bool testRecorder(int selector) {
+    testFlightRecorder();
+    return false;
+}
+// Test that the decoupled engine matches the FastEngine when no plane waits for a charger
+bool testDecoupledPlanes(int selector) {
+    testDecoupledEngine();
+    return false;
+}
+// Test that skipping repeats gives the same results as handling every event
+bool testRepeatSkipping(int selector) {
+    testCycleSkipping();
+    return false;
+}
+// Test that counting faults when flights end gives the same faults with fewer events
+bool testFaultCounting(int selector) {
+    testFaultCountOption();
+    return false;
+}
+// Test that running planes in cohorts matches the FastEngine with fewer events
+bool testCohorts(int selector) {
+    testCohortEngine();
+    return false;
+}
+// Test that a paused run carries on as if it had not paused, and that its branches differ
+bool testBranches(int selector) {
+    testBranching();
+    return false;
+}
+// Test that what-if runs from a paused run change only what they should
+bool testWhatIfRuns(int selector) {
+    testWhatIf();
+    return false;
+}
+// Test that weighted runs with faults made more likely estimate rare groundings
+bool testRareGroundings(int selector) {
+    testRareEvents();
+    return false;
+}
+// Test that sensitivities from paired runs and along each run's path agree and are tight
+bool testSensitivities(int selector) {
+    testSensitivity();
+    return false;
+}
+// Test that the search for the fewest chargers matches a sweep of every count with fewer runs
+bool testChargerSearch(int selector) {
+    testChargerOptimizer();
+    return false;
+}
+// Test that a short pilot predicts the events and memory of whole runs
+bool testRuntimeEstimates(int selector) {
+    testRuntimeEstimate();
+    return false;
+}
+// Test that the fluid model stays close to the FastEngine for fleets of a few thousand planes
+bool testFluid(int selector) {
+    testFluidModel();
+    return false;
+}
+// Compare the speed of the SimClock and the FastEngine on the stress presets
+bool benchmarkFastEngineSpeed(int selector) {
+    benchmarkFastEngine();
+    return false;
+}
 
 // This menu handles the test functions differently. All the menu items refer to the function
 // runTest which uses the selector to look up the test in this list.
@@ -90,7 +216,29 @@ vector<TestFuncPtr> tests {
     longTestChargerQueue,  // test 4
     testPlaneQueueWaits,  // test 5
     testPlaneQueueMinimumPerKind, // test 6
-    longTestSimClockClass // test 7
+    longTestSimClockClass, // test 7
+    testChargerQueueOrdering, // test 8
+    testChargerPolicyOrdering, // test 9
+    benchmarkChargerPolicyOptions, // test 10
+    testPlaneQueueOrdering, // test 11
+    testFastEngineResults, // test 12
+    benchmarkFastEngineSpeed, // test 13
+    testProfiler, // test 14
+    testTraceExport, // test 15
+    testMemoryAccounting, // test 16
+    testDifferentialEngines, // test 17
+    testRecorder, // test 18
+    testDecoupledPlanes, // test 19
+    testRepeatSkipping, // test 20
+    testFaultCounting, // test 21
+    testCohorts, // test 22
+    testFluid, // test 23
+    testBranches, // test 24
+    testWhatIfRuns, // test 25
+    testRareGroundings, // test 26
+    testSensitivities, // test 27
+    testChargerSearch, // test 28
+    testRuntimeEstimates // test 29
 };
 
 // Check that the selector is in range, then use it to choose the function to run
@@ -129,9 +277,31 @@ vector<MenuItem> testMenus {
     MenuItem('4', string{"Long Test ChargerQueue"}, &runTest, 4),
     MenuItem('5', string{"Test PlaneQueue: Waits for Passengers"}, &runTest, 5),
     MenuItem('6', string{"Test PlaneQueue: Minimum per Kind"}, &runTest, 6),
+    MenuItem('7', string{"Test ChargerQueue: Charger Order"}, &runTest, 8),
+    MenuItem('8', string{"Test ChargerQueue: Charger Policies"}, &runTest, 9),
+    MenuItem('9', string{"Test PlaneQueue: Order and Grounded Planes"}, &runTest, 11),
+    MenuItem('E', string{"Test FastEngine: Same Results as SimClock"}, &runTest, 12),
+    MenuItem('P', string{"Test Profiler"}, &runTest, 14),
+    MenuItem('X', string{"Test Trace Export"}, &runTest, 15),
+    MenuItem('Y', string{"Test Memory Accounting"}, &runTest, 16),
+    MenuItem('D', string{"Differential Test: Engines vs SimClock (1000 Scenarios)"}, &runTest, 17),
+    MenuItem('F', string{"Test Flight Recorder"}, &runTest, 18),
+    MenuItem('U', string{"Test Decoupled Engine: Uncontended Chargers"}, &runTest, 19),
+    MenuItem('R', string{"Test FastEngine: Skipping Repeats"}, &runTest, 20),
+    MenuItem('K', string{"Test Counting Faults When Flights End"}, &runTest, 21),
+    MenuItem('O', string{"Test Cohort Engine: Planes in Step"}, &runTest, 22),
+    MenuItem('V', string{"Test Fluid Model Against the FastEngine"}, &runTest, 23),
+    MenuItem('W', string{"Test Pausing and Branching Runs"}, &runTest, 24),
+    MenuItem('H', string{"Test What-If Runs from a Paused Run"}, &runTest, 25),
+    MenuItem('G', string{"Test Rare Event Estimates"}, &runTest, 26),
+    MenuItem('S', string{"Test Sensitivity Estimates"}, &runTest, 27),
+    MenuItem('Z', string{"Test the Search for the Fewest Chargers"}, &runTest, 28),
+    MenuItem('T', string{"Test Runtime Estimates from a Pilot Run"}, &runTest, 29),
     MenuItem('-', string{""}, nullptr, 0),
     MenuItem('A', string{"Run All Above Tests"}, &runAllTests, 0),
     MenuItem('L', string{"Long Test Sim Clock"}, &runTest, 7),
+    MenuItem('B', string{"Benchmark Charger Policies (10,000 waiting planes)"}, &runTest, 10),
+    MenuItem('C', string{"Benchmark SimClock and FastEngine Speed"}, &runTest, 13),
     MenuItem('M', string{"Return to Main Menu"}, &doMainMenu, 0)
 };
 MenuGroupWithAllOption testMenu = MenuGroupWithAllOption(testMenus);
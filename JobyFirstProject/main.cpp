@@ -10,6 +10,7 @@
 #include <queue>
 #include <string>
 #include <iomanip>
+#include <climits>
 #include "DebugHelp.hpp"
 #include "CmdLineMenus.hpp"
 #include "TestsMenu.hpp"
@@ -0,0 +1,354 @@
+//
+//  ChargerOptimizer.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "ChargerOptimizer.hpp"
+#include "Sensitivity.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <thread>
+
+// The runs of one charger count so far
+struct CandidateRuns {
+    std::vector<double> waits; // The 95th percentile of each run's waits
+    std::vector<double> flights; // Each run's flights per hour
+    ChargerCandidate summary;
+};
+
+// Runs the seeds of charger counts on threads, and decides each count
+class ChargerSearcher {
+    SimSettings baseSettings;
+    ServiceTarget target;
+    long firstSeed;
+    long maxRuns;
+    long batchSize;
+    unsigned threadCount;
+    double waitTolerance;
+    double flightsTolerance;
+    double intervalTail; // Of each interval, above and below it
+public:
+    std::map<long, CandidateRuns> tried;
+    long totalRuns;
+
+    double intervalConfidence;
+
+    // The search tries at most mostVisits counts
+    ChargerSearcher(const SimSettings &someSettings, const ServiceTarget &aTarget, long maxRuns, long batchSize, unsigned threadCount,
+                    long mostVisits):
+    baseSettings{someSettings}, target{aTarget}, firstSeed{someSettings.randomSeed > 0 ? someSettings.randomSeed : 1},
+    maxRuns{std::max(2L, maxRuns)}, batchSize{std::max(2L, batchSize)}, threadCount{threadCount},
+    waitTolerance{std::max(1.0, aTarget.tolerance * aTarget.waitP95)},
+    flightsTolerance{std::max(0.01, aTarget.tolerance * aTarget.flightsPerHour)}, intervalTail{0}, tried{}, totalRuns{0}, intervalConfidence{0} {
+        // Split the chance of being wrong between every interval the search could look at:
+        // two measures of each count it can try, after each batch
+        double confidence = aTarget.confidence > 0 && aTarget.confidence < 1 ? aTarget.confidence : 0.95;
+        long looks = (this->maxRuns + this->batchSize - 1) / this->batchSize;
+        double intervalMiss = (1 - confidence) / (2.0 * std::max(1L, mostVisits) * looks);
+        intervalTail = intervalMiss / 2;
+        intervalConfidence = 1 - intervalMiss;
+        // The percentile needs each charge, so the FastEngine runs every event and keeps them
+        baseSettings.engineOption = 1;
+        baseSettings.cycleOption = 0;
+        baseSettings.memoryBudgetMB = 0;
+        baseSettings.chargeTimeDerivativeOption = -1;
+        baseSettings.progressInterval = 0;
+        if(this->threadCount == 0) {
+            this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+
+    // Run count more seeds of a charger count, on threads
+    void runBatch(long chargers, CandidateRuns &someRuns, long count) {
+        long done = static_cast<long>(someRuns.waits.size());
+        std::vector<double> waits(count), flights(count);
+        SimSettings runSettings = baseSettings;
+        runSettings.chargerCount = chargers;
+        double hours = runSettings.simulationDuration / secondsPerHourD;
+        std::atomic<long> nextRun{0};
+        auto runSeeds = [&]() {
+            for(long run = nextRun++; run < count; run = nextRun++) {
+                SimSettings seedSettings = runSettings;
+                seedSettings.randomSeed = firstSeed + done + run;
+                Simulation aSimulation(seedSettings);
+                aSimulation.setQuiet(true);
+                std::vector<FinalStats> results = aSimulation.run(false);
+                long totalFlights = 0;
+                for(const FinalStats &aStats: results) {
+                    totalFlights += aStats.totalFlights;
+                }
+                waits[run] = aSimulation.getWaitPercentile(0.95);
+                flights[run] = totalFlights / hours;
+            }
+        };
+        unsigned threads = static_cast<unsigned>(std::min<long>(threadCount, count));
+        std::vector<std::thread> others{};
+        for(unsigned thread = 1; thread < threads; thread++) {
+            others.emplace_back(runSeeds);
+        }
+        runSeeds();
+        for(std::thread &aThread: others) {
+            aThread.join();
+        }
+        someRuns.waits.insert(end(someRuns.waits), begin(waits), end(waits));
+        someRuns.flights.insert(end(someRuns.flights), begin(flights), end(flights));
+        totalRuns += count;
+    }
+
+    // Run a charger count in batches until its intervals decide whether it meets the target
+    bool meetsTarget(long chargers) {
+        auto found = tried.find(chargers);
+        if(found != tried.end()) {
+            return found->second.summary.meetsTarget;
+        }
+        CandidateRuns &someRuns = tried[chargers];
+        ChargerCandidate &aCandidate = someRuns.summary;
+        aCandidate = ChargerCandidate{chargers, 0, 0, 0, 0, 0, false, false};
+        while(true) {
+            runBatch(chargers, someRuns, std::min(batchSize, maxRuns - aCandidate.runs));
+            aCandidate.runs = static_cast<long>(someRuns.waits.size());
+            double waitVariance = 0, flightsVariance = 0, ignore = 0;
+            meanAndHalfWidth(someRuns.waits, aCandidate.waitP95, ignore, waitVariance);
+            meanAndHalfWidth(someRuns.flights, aCandidate.flightsPerHour, ignore, flightsVariance);
+            double t = tQuantile(intervalTail, aCandidate.runs - 1);
+            aCandidate.waitP95HalfWidth = t * std::sqrt(waitVariance / aCandidate.runs);
+            aCandidate.flightsPerHourHalfWidth = t * std::sqrt(flightsVariance / aCandidate.runs);
+            aCandidate.meetsTarget = aCandidate.waitP95 <= target.waitP95 && aCandidate.flightsPerHour >= target.flightsPerHour;
+            // Either average clearly misses its target, or both are clearly met or close enough
+            bool waitMissed = aCandidate.waitP95 - aCandidate.waitP95HalfWidth > target.waitP95;
+            bool flightsMissed = aCandidate.flightsPerHour + aCandidate.flightsPerHourHalfWidth < target.flightsPerHour;
+            bool waitSettled = aCandidate.waitP95 + aCandidate.waitP95HalfWidth <= target.waitP95 || aCandidate.waitP95HalfWidth <= waitTolerance;
+            bool flightsSettled = aCandidate.flightsPerHour - aCandidate.flightsPerHourHalfWidth >= target.flightsPerHour ||
+                aCandidate.flightsPerHourHalfWidth <= flightsTolerance;
+            if(waitMissed || flightsMissed || (waitSettled && flightsSettled)) {
+                aCandidate.determined = true;
+                return aCandidate.meetsTarget;
+            }
+            if(aCandidate.runs >= maxRuns) {
+                return aCandidate.meetsTarget;
+            }
+        }
+    }
+};
+
+// Bracket the answer by doubling or halving, then bisect
+ChargerSearch findMinimumChargers(const SimSettings &someSettings, const ServiceTarget &aTarget, long maxRuns,
+                                  long batchSize, unsigned threadCount) {
+    ChargerSearch aSearch{-1, {}, 0, 0, 0, ""};
+    auto startTimer = std::chrono::high_resolution_clock::now();
+    // A site cannot use more chargers than the planes that can be there at once
+    long siteCount = std::max(1L, someSettings.siteCount);
+    long mostUseful = someSettings.siteFlightOption == 1 && siteCount > 1 ? someSettings.planeCount : (someSettings.planeCount + siteCount - 1) / siteCount;
+    mostUseful = std::max(1L, mostUseful);
+    // Doubling or halving and then bisecting each take at most log2(mostUseful) steps
+    long steps = 0;
+    while((1L << steps) < mostUseful) { steps++; }
+    ChargerSearcher searcher(someSettings, aTarget, maxRuns, batchSize, threadCount, 1 + 2 * steps);
+    long high = std::min(std::max(1L, someSettings.chargerCount), mostUseful);
+    long low = 0; // The most chargers known not to meet the target (0 if 1 does)
+    bool reachable = true;
+    if(searcher.meetsTarget(high)) {
+        while(high > 1) {
+            long probe = high / 2;
+            if(!searcher.meetsTarget(probe)) {
+                low = probe;
+                break;
+            }
+            high = probe;
+        }
+    } else {
+        low = high;
+        while(true) {
+            if(low >= mostUseful) {
+                reachable = false;
+                break;
+            }
+            high = std::min(2 * low, mostUseful);
+            if(searcher.meetsTarget(high)) {
+                break;
+            }
+            low = high;
+        }
+    }
+    while(reachable && high - low > 1) {
+        long middle = (low + high) / 2;
+        if(searcher.meetsTarget(middle)) {
+            high = middle;
+        } else {
+            low = middle;
+        }
+    }
+
+    if(reachable) {
+        aSearch.chargers = high;
+    } else {
+        aSearch.note = "no count meets the target, even with a charger for every plane (" + std::to_string(mostUseful) + ")";
+    }
+    std::string undetermined{};
+    for(const auto &entry: searcher.tried) {
+        aSearch.candidates.push_back(entry.second.summary);
+        if(!entry.second.summary.determined) {
+            undetermined += (undetermined.empty() ? "" : ", ") + std::to_string(entry.first);
+        }
+    }
+    if(!undetermined.empty()) {
+        aSearch.note += (aSearch.note.empty() ? "" : "; ") + std::string{"the most runs did not settle "} + undetermined +
+            " chargers, which were decided by their averages";
+    }
+    aSearch.totalRuns = searcher.totalRuns;
+    aSearch.intervalConfidence = searcher.intervalConfidence;
+    aSearch.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTimer).count();
+    return aSearch;
+}
+
+// The table of counts tried and the answer
+void writeChargerSearch(const ChargerSearch &aSearch, const ServiceTarget &aTarget, std::ostream &out) {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+    out << "Target: 95th percentile wait for a charger at most " << aTarget.waitP95 << " seconds and at least "
+    << std::setprecision(2) << aTarget.flightsPerHour << " flights per hour" << std::endl;
+    out << std::setw(9) << "Chargers" << std::setw(7) << "Runs" << std::setw(22) << "95th pct wait (s)"
+    << std::setw(22) << "Flights per hour" << "  Meets" << std::endl;
+    for(const ChargerCandidate &aCandidate: aSearch.candidates) {
+        out << std::setw(9) << aCandidate.chargers << std::setw(7) << aCandidate.runs
+        << std::setprecision(1) << std::setw(10) << aCandidate.waitP95 << " +/- " << std::setw(7) << aCandidate.waitP95HalfWidth
+        << std::setprecision(2) << std::setw(10) << aCandidate.flightsPerHour << " +/- " << std::setw(7) << aCandidate.flightsPerHourHalfWidth
+        << "  " << (aCandidate.meetsTarget ? "yes" : "no") << (aCandidate.determined ? "" : " (not determined)") << std::endl;
+    }
+    bool determined = true;
+    for(const ChargerCandidate &aCandidate: aSearch.candidates) {
+        determined = determined && aCandidate.determined;
+    }
+    double confidence = aTarget.confidence > 0 && aTarget.confidence < 1 ? aTarget.confidence : 0.95;
+    if(aSearch.chargers > 0) {
+        out << "Fewest chargers that meet the target: " << aSearch.chargers << std::endl;
+    }
+    if(determined) {
+        out << std::setprecision(0) << "With " << 100 * confidence << "% confidence overall (" << std::setprecision(3)
+        << 100 * aSearch.intervalConfidence << "% intervals), to within " << std::setprecision(0) << 100 * aTarget.tolerance
+        << "% of the target: " << (aSearch.chargers > 1 ? std::to_string(aSearch.chargers) + " chargers meet it and one fewer does not" :
+                                   aSearch.chargers == 1 ? "1 charger meets it" : "no count meets it") << std::endl;
+    } else {
+        out << "Not every count was determined, so there is no overall confidence in the answer" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+    if(!aSearch.note.empty()) {
+        out << "Note: " << aSearch.note << std::endl;
+    }
+    out << aSearch.totalRuns << " runs took " << aSearch.seconds << " seconds" << std::endl;
+}
+
+// Check the search against a sweep of every count
+bool testChargerOptimizer() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of the charger optimizer *****" << std::endl;
+
+    // Sweep every count with many runs to find the averages
+    SimSettings settings{};
+    settings.simulationDuration = 24 * secondsPerHour;
+    settings.planeCount = 20;
+    settings.maxPassengerDelay = 1800;
+    settings.passengerCountOption = 1;
+    settings.engineOption = 1;
+    settings.progressInterval = 0;
+    settings.randomSeed = 1;
+    const long sweepRuns = 100;
+    const long counts = 12;
+    double waits[counts + 1]{}, flights[counts + 1]{};
+    for(long chargers = 1; chargers <= counts; chargers++) {
+        for(long run = 0; run < sweepRuns; run++) {
+            SimSettings runSettings = settings;
+            runSettings.chargerCount = chargers;
+            runSettings.randomSeed = 1000 + run;
+            Simulation aSimulation(runSettings);
+            aSimulation.setQuiet(true);
+            std::vector<FinalStats> results = aSimulation.run(false);
+            for(const FinalStats &aStats: results) {
+                flights[chargers] += aStats.totalFlights / 24.0 / sweepRuns;
+            }
+            waits[chargers] += aSimulation.getWaitPercentile(0.95) / sweepRuns;
+        }
+    }
+
+    // Targets half way between two counts' averages have one right answer. The first is
+    // set by the wait and the second by the flights.
+    ServiceTarget targets[2]{{(waits[4] + waits[5]) / 2, 0, 0.02, 0.95}, {1e9, (flights[2] + flights[3]) / 2, 0.02, 0.95}};
+    const long answers[2]{5, 3};
+    for(int i = 0; i < 2; i++) {
+        ChargerSearch aSearch = findMinimumChargers(settings, targets[i]);
+        if(aSearch.chargers != answers[i] || aSearch.totalRuns >= counts * sweepRuns / 2) {
+            std::cout << "***** error: the search found " << aSearch.chargers << " chargers with " << aSearch.totalRuns
+            << " runs where sweeping found " << answers[i] << std::endl;
+            writeChargerSearch(aSearch, targets[i], std::cout);
+            returnValue = false;
+        }
+    }
+
+    // Searches on other seeds are each right at least as often as the target's confidence. A
+    // few may be wrong by chance, so allow three standard deviations more than that.
+    const long searches = 20;
+    long wrong = 0;
+    long searched = 0;
+    for(int i = 0; i < 2; i++) {
+        for(long search = 0; search < searches; search++) {
+            SimSettings searchSettings = settings;
+            searchSettings.randomSeed = 5000 + 1000 * search;
+            ChargerSearch aSearch = findMinimumChargers(searchSettings, targets[i]);
+            wrong += aSearch.chargers != answers[i] ? 1 : 0;
+            searched++;
+        }
+    }
+    double missRate = 1 - targets[0].confidence;
+    double allowed = searched * missRate + 3 * std::sqrt(searched * missRate * (1 - missRate));
+    if(wrong > allowed) {
+        std::cout << "***** error: " << wrong << " of " << searched << " searches on other seeds were wrong, and at "
+        << 100 * targets[0].confidence << "% confidence at most " << allowed << " should be" << std::endl;
+        returnValue = false;
+    }
+
+    // The same search from a count far above the answer, on three threads, finds the same
+    // count from the same runs of each count
+    SimSettings highSettings = settings;
+    highSettings.chargerCount = 20;
+    ChargerSearch oneThread = findMinimumChargers(highSettings, targets[0], 200, 10, 1);
+    ChargerSearch threeThreads = findMinimumChargers(highSettings, targets[0], 200, 10, 3);
+    if(oneThread.chargers != answers[0] || oneThread.totalRuns != threeThreads.totalRuns || threeThreads.chargers != oneThread.chargers) {
+        std::cout << "***** error: from 20 chargers the search found " << oneThread.chargers << " on one thread and "
+        << threeThreads.chargers << " on three" << std::endl;
+        returnValue = false;
+    }
+
+    // More flights than a charger for every plane can give
+    ChargerSearch tooMany = findMinimumChargers(settings, ServiceTarget{1e9, 2 * flights[counts], 0.02, 0.95});
+    if(tooMany.chargers != -1 || tooMany.note.empty()) {
+        std::cout << "***** error: the search found " << tooMany.chargers << " chargers for an unreachable target" << std::endl;
+        returnValue = false;
+    }
+
+    // The percentile needs each charge: a charger for every plane waits 0, and the
+    // DecoupledEngine only keeps totals
+    settings.chargerCount = 20;
+    Simulation everyPlane(settings);
+    everyPlane.setQuiet(true);
+    everyPlane.run(false);
+    settings.engineOption = 2;
+    Simulation decoupled(settings);
+    decoupled.setQuiet(true);
+    decoupled.run(false);
+    if(everyPlane.getWaitPercentile(0.95) != 0 || decoupled.getWaitPercentile(0.95) != -1) {
+        std::cout << "***** error: the wait percentiles were " << everyPlane.getWaitPercentile(0.95) << " and "
+        << decoupled.getWaitPercentile(0.95) << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of the charger optimizer " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
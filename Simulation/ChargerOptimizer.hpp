@@ -0,0 +1,94 @@
+//
+//  ChargerOptimizer.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef ChargerOptimizer_hpp
+#define ChargerOptimizer_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <iostream>
+#include "Simulation.hpp"
+
+/*
+ *******************************************************************************************
+ * Finding the fewest chargers that meet a service target
+ * "How few chargers can this fleet have and still keep the 95th percentile of the wait for
+ * a charger under X while flying at least Y flights an hour?" Each run gives its own 95th
+ * percentile and flights per hour, so a charger count meets the target if their averages
+ * over runs do. findMinimumChargers() answers it without sweeping every count:
+ *
+ *   - Bracketing: starting from the settings' chargerCount, double the count until one
+ *     meets the target (or there is a charger for every plane at a site, when more cannot
+ *     help), or halve it until one does not. Then bisect between the two.
+ *   - Deciding each count: run it on seeds in batches, shared between threads, until the
+ *     confidence interval of each average is clear of its target, or narrower than the
+ *     tolerance either side of it, when it is close enough that the difference does not
+ *     matter and the average decides. A count that reaches the most runs allowed is decided
+ *     by its average and marked as not determined.
+ *
+ * The answer holds with the target's confidence (95% in the menu) as a whole, not just each
+ * count on its own. The chance of being wrong is split evenly (Bonferroni) between every
+ * interval the search could look at: the two averages of each count the bracket can visit
+ * (at most 1 + 2 log2 of the most useful count), after each batch up to the most runs. If
+ * every one of those intervals holds its true average, which happens at least that often,
+ * every count that was determined was decided rightly or was within the tolerance of the
+ * target. So, with that confidence, the answer meets the target to within the tolerance and
+ * one fewer charger does not meet it by more than the tolerance. A count that was not
+ * determined has no such guarantee, and the search says so. The intervals are wider than
+ * 95% ones (about 99.99% for 20 planes), which costs more runs for the counts close to the
+ * target. Every count uses the same seeds, so they have the same fleets and random numbers.
+ * The search assumes more chargers never make the averages worse. The runs use the
+ * FastEngine without skipping repeats, since the percentile needs each charge.
+ *******************************************************************************************
+ */
+struct ServiceTarget {
+    double waitP95; // The average 95th percentile of the wait for a charger may be at most this, in seconds
+    double flightsPerHour; // The fleet's average flights per hour must be at least this
+    double tolerance; // As a share of each target, how close is close enough (0.02 is 2%)
+    double confidence; // How often the answer must be right, up to the tolerance (0.95 if not between 0 and 1)
+};
+
+// What the runs said about one charger count
+struct ChargerCandidate {
+    long chargers;
+    long runs;
+    double waitP95; // The average and the half width of its confidence interval
+    double waitP95HalfWidth;
+    double flightsPerHour;
+    double flightsPerHourHalfWidth;
+    bool meetsTarget;
+    bool determined; // False if it reached the most runs allowed before its intervals decided it
+};
+
+struct ChargerSearch {
+    long chargers; // The fewest chargers that meet the target, or -1 if none do
+    std::vector<ChargerCandidate> candidates; // The counts tried, fewest chargers first
+    long totalRuns;
+    double intervalConfidence; // Of each interval, once the target's confidence is split between them
+    double seconds; // Time taken by the runs
+    std::string note; // Why there is no answer, or which counts were not determined
+};
+
+// The fewest chargers (at each site) for the planes in someSettings that meet aTarget. Each
+// count is run in batches of batchSize seeds, starting at someSettings' randomSeed (or 1), up
+// to maxRuns. The runs are shared between threadCount threads, or one for each core if it
+// is 0; the results do not depend on it.
+ChargerSearch findMinimumChargers(const SimSettings &someSettings, const ServiceTarget &aTarget, long maxRuns = 200,
+                                  long batchSize = 10, unsigned threadCount = 0);
+
+// Write the counts tried and the answer to out
+void writeChargerSearch(const ChargerSearch &aSearch, const ServiceTarget &aTarget, std::ostream &out);
+
+// Check that the search finds the same count as sweeping every count with many runs, with far
+// fewer runs, that repeated searches on other seeds are right at least as often as the
+// target's confidence, that it says when no count can meet a target, that the threads do not
+// change it and that the wait percentile is only given when every charge was kept. It
+// reports errors to cout.
+bool testChargerOptimizer();
+
+#endif /* ChargerOptimizer_hpp */
@@ -0,0 +1,229 @@
+//
+//  ChargerPolicy.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/4/25.
+//
+
+#include <chrono>
+#include <algorithm>
+#include "ChargerPolicy.hpp"
+#include "ChargerQueue.hpp"
+
+extern PlaneSpecification planeSpecifications[];
+
+/*
+ *******************************************************************************************
+ * class ChargerPolicy
+ * This decides the order in which waiting planes are given a free charger.
+ * Each policy gives a waiting plane a key when it joins the queue. The plane with the
+ * lowest value of (key - agingRate * currentTime) gets the next charger, with ties going
+ * to the plane that joined the queue first.
+ *******************************************************************************************
+ */
+ChargerPolicy::~ChargerPolicy() {
+}
+
+// Only the FIFO policy overrides this
+bool ChargerPolicy::isFIFO() {
+    return false;
+}
+
+// Most policies do not change priority while a plane waits
+double ChargerPolicy::agingRate(const WaitingPlane &) {
+    return 0;
+}
+
+// First come, first served. ChargerQueue uses its RingBuffer for this so the key is only
+// used if someone puts this policy into a WaitingPlaneHeap directly.
+class FIFOChargerPolicy: public ChargerPolicy {
+public:
+    virtual const char *name() override { return "First Come First Served"; }
+    virtual bool isFIFO() override { return true; }
+    virtual double key(const WaitingPlane &aWaitingPlane) override {
+        return aWaitingPlane.timeStarted;
+    }
+};
+
+// The plane that will spend the least time on the charger goes first
+class ShortestChargeChargerPolicy: public ChargerPolicy {
+public:
+    virtual const char *name() override { return "Shortest Charge First"; }
+    virtual double key(const WaitingPlane &aWaitingPlane) override {
+        return aWaitingPlane.thePlane->calcTimeToCharge__seconds();
+    }
+};
+
+// Companies are served in a fixed priority order, FIFO within a company
+class CompanyPriorityChargerPolicy: public ChargerPolicy {
+    int companyPriority[companyCount]; // Copied from the settings, lower goes first
+public:
+    CompanyPriorityChargerPolicy(const SimSettings &theSettings) {
+        for(auto c: allCompany) {
+            companyPriority[c] = theSettings.companyPriority[c];
+        }
+    }
+    virtual const char *name() override { return "Company Priority"; }
+    virtual double key(const WaitingPlane &aWaitingPlane) override {
+        return companyPriority[aWaitingPlane.thePlane->getCompany()];
+    }
+};
+
+// The plane whose passengers have waited the most passenger-seconds goes first.
+// The value of a plane is passengers * (currentTime - timeStarted). Written as a key to
+// minimize that is passengers * timeStarted - passengers * currentTime, so the key is
+// passengers * timeStarted and the plane ages at a rate of its passenger count.
+class PassengerValueChargerPolicy: public ChargerPolicy {
+public:
+    virtual const char *name() override { return "Longest Waiting Passenger Value"; }
+    virtual double key(const WaitingPlane &aWaitingPlane) override {
+        return static_cast<double>(aWaitingPlane.thePlane->getMaxPassengerCount()) * aWaitingPlane.timeStarted;
+    }
+    virtual double agingRate(const WaitingPlane &aWaitingPlane) override {
+        return static_cast<double>(aWaitingPlane.thePlane->getMaxPassengerCount());
+    }
+};
+
+// Planes book a charger when they take off. The earliest booking goes first.
+class ReservationChargerPolicy: public ChargerPolicy {
+public:
+    virtual const char *name() override { return "Earliest Reservation"; }
+    virtual double key(const WaitingPlane &aWaitingPlane) override {
+        return aWaitingPlane.reservationTime;
+    }
+};
+
+// Create the policy selected by a SimSettings::chargerPolicyOption value
+std::shared_ptr<ChargerPolicy> ChargerPolicy::makePolicy(int option, const SimSettings &theSettings) {
+    switch(option) {
+        case chargerPolicyShortestCharge:
+            return std::make_shared<ShortestChargeChargerPolicy>();
+        case chargerPolicyCompanyPriority:
+            return std::make_shared<CompanyPriorityChargerPolicy>(theSettings);
+        case chargerPolicyPassengerValue:
+            return std::make_shared<PassengerValueChargerPolicy>();
+        case chargerPolicyReservation:
+            return std::make_shared<ReservationChargerPolicy>();
+        default:
+            return std::make_shared<FIFOChargerPolicy>();
+    }
+}
+
+// A global utility function to describe a SimSettings::chargerPolicyOption value for menus and output
+const char *chargerPolicyName(int option) {
+    switch(option) {
+        case chargerPolicyFIFO: return "First Come First Served";
+        case chargerPolicyShortestCharge: return "Shortest Charge First";
+        case chargerPolicyCompanyPriority: return "Company Priority";
+        case chargerPolicyPassengerValue: return "Longest Waiting Passenger Value";
+        case chargerPolicyReservation: return "Earliest Reservation";
+        default: return "Invalid Charger Policy";
+    }
+}
+
+// Helper for testChargerPolicies(): push planes into a heap with a policy, pop them all at
+// popTime and compare the companies in the order they come out.
+static bool checkPolicyOrder(ChargerPolicy &aPolicy, const std::vector<WaitingPlane> &planes, long popTime, const std::vector<Company> &expected) {
+    WaitingPlaneHeap<> aHeap;
+    for(const WaitingPlane &aWaitingPlane: planes) {
+        aHeap.push(aWaitingPlane, aPolicy.key(aWaitingPlane), aPolicy.agingRate(aWaitingPlane));
+    }
+    bool returnValue = true;
+    std::cout << aPolicy.name() << " at time " << popTime << ":";
+    for(Company c: expected) {
+        Company got = aHeap.pop(popTime).thePlane->getCompany();
+        std::cout << " " << companyName(got);
+        if(got != c) {
+            returnValue = false;
+        }
+    }
+    std::cout << (returnValue ? "" : "  ***** error: wrong order") << std::endl;
+    return returnValue;
+}
+
+// Check that each policy hands out chargers in the order it promises
+bool testChargerPolicies() {
+    std::cout << " ***** Starting test of ChargerPolicy Classes  *****" << std::endl;
+    SimSettings theSettings;
+    // Reverse the company order for the company priority policy
+    for(auto c: allCompany) {
+        theSettings.companyPriority[c] = maxCompany - c;
+    }
+    // One plane from each company. They joined the queue at times 0, 100, 200, 300 and 400
+    // but booked their chargers in the opposite order.
+    std::vector<WaitingPlane> planes{};
+    for(auto c: allCompany) {
+        long joined = c * 100;
+        planes.push_back(WaitingPlane{joined, std::make_shared<Plane>(planeSpecifications[c]), 1000 - joined, 0});
+    }
+    bool returnValue = true;
+    // Charge times: Bravo 720, Echo 1080, Alpha 2160, Delta 2232, Charlie 2880 seconds
+    returnValue &= checkPolicyOrder(*ChargerPolicy::makePolicy(chargerPolicyShortestCharge, theSettings),
+                                    planes, 500, {Bravo, Echo, Alpha, Delta, Charlie});
+    returnValue &= checkPolicyOrder(*ChargerPolicy::makePolicy(chargerPolicyCompanyPriority, theSettings),
+                                    planes, 500, {Echo, Delta, Charlie, Bravo, Alpha});
+    returnValue &= checkPolicyOrder(*ChargerPolicy::makePolicy(chargerPolicyReservation, theSettings),
+                                    planes, 500, {Echo, Delta, Charlie, Bravo, Alpha});
+    // Passenger value is passengers * wait. At time 500: Alpha 4*500=2000, Bravo 5*400=2000,
+    // Charlie 3*300=900, Delta 2*200=400, Echo 2*100=200. Alpha and Bravo tie so the one
+    // that joined first goes first. Much later the larger planes pull ahead: at time 100000
+    // Bravo 5*99900 > Alpha 4*100000 > Charlie 3*99800 > Delta 2*99700 > Echo 2*99600.
+    returnValue &= checkPolicyOrder(*ChargerPolicy::makePolicy(chargerPolicyPassengerValue, theSettings),
+                                    planes, 500, {Alpha, Bravo, Charlie, Delta, Echo});
+    returnValue &= checkPolicyOrder(*ChargerPolicy::makePolicy(chargerPolicyPassengerValue, theSettings),
+                                    planes, 100000, {Bravo, Alpha, Charlie, Delta, Echo});
+
+    // The same check through a ChargerQueue with one charger. The first plane takes the charger
+    // and the rest wait, so each event hands the charger to the next plane in policy order.
+    ChargerQueue aQueue(nullptr, 1, ChargerPolicy::makePolicy(chargerPolicyShortestCharge, theSettings));
+    for(const WaitingPlane &aWaitingPlane: planes) {
+        aQueue.addPlane(aWaitingPlane.timeStarted, aWaitingPlane.thePlane, aWaitingPlane.reservationTime);
+    }
+    const Company expectedOnCharger[]{Alpha, Bravo, Echo, Delta, Charlie};
+    for(Company c: expectedOnCharger) {
+        Company onCharger = aQueue.getChargers().front().thePlane->getCompany();
+        if(onCharger != c) {
+            std::cout << "***** error: ChargerQueue put " << companyName(onCharger) << " on the charger, expected " << companyName(c) << std::endl;
+            returnValue = false;
+        }
+        aQueue.handleEvent(aQueue.getNextEventTime(), false);
+    }
+    std::cout << "Test of ChargerPolicy Classes " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
+
+// Time adding and removing planes with each policy with benchmarkWaitingPlanes planes
+// waiting for a single charger
+bool benchmarkChargerPolicies() {
+    std::cout << " ***** Benchmark of ChargerPolicy Classes with " << benchmarkWaitingPlanes << " waiting planes *****" << std::endl;
+    SimSettings theSettings;
+    // Create the planes first so their construction is not part of the timing
+    std::vector<std::shared_ptr<Plane>> planes{};
+    for(long i = 0; i <= benchmarkWaitingPlanes; i++) {
+        planes.push_back(std::make_shared<Plane>(planeSpecifications[rand() % companyCount]));
+    }
+    for(int option = 0; option < chargerPolicyOptionCount; option++) {
+        ChargerQueue aQueue(nullptr, 1, ChargerPolicy::makePolicy(option, theSettings));
+        // One plane a second joins the queue. Reservations are scrambled a little so the
+        // reservation policy does not just see FIFO order.
+        auto startTimer = std::chrono::high_resolution_clock::now();
+        for(long i = 0; i <= benchmarkWaitingPlanes; i++) {
+            aQueue.addPlane(i, planes[i], i - (i % 7) * 10);
+        }
+        auto addedTimer = std::chrono::high_resolution_clock::now();
+        // Each event frees the single charger and hands it to the next waiting plane
+        long dequeues = 0;
+        while(!aQueue.isEmpty()) {
+            aQueue.handleEvent(aQueue.getNextEventTime(), false);
+            dequeues++;
+        }
+        auto stopTimer = std::chrono::high_resolution_clock::now();
+        double addNs = std::chrono::duration<double, std::nano>(addedTimer - startTimer).count() / (benchmarkWaitingPlanes + 1);
+        double dequeueNs = std::chrono::duration<double, std::nano>(stopTimer - addedTimer).count() / dequeues;
+        std::cout << chargerPolicyName(option) << ": "
+        << addNs << " ns per add, " << dequeueNs << " ns per charge completed and plane dequeued" << std::endl;
+    }
+    std::cout << std::endl;
+    return true;
+}
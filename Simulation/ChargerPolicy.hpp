@@ -0,0 +1,192 @@
+//
+//  ChargerPolicy.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/4/25.
+//
+
+#ifndef ChargerPolicy_hpp
+#define ChargerPolicy_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <queue>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include "SimSettings.hpp"
+#include "SimMemory.hpp"
+#include "Plane.hpp"
+
+/*
+ *******************************************************************************************
+ * Struct WaitingPlane
+ * This is used to store information about planes waiting for chargers.
+ * We need this information to calculate how long it waited.
+ * The reservation time is when the plane booked its charge. Planes book a charger when
+ * they take off, so for a plane coming from a flight it is the start of that flight.
+ * The FastEngine, which keeps its planes in an array, also records where the plane is in
+ * that array. ChargerQueue leaves it 0.
+ *******************************************************************************************
+ */
+struct WaitingPlane {
+    long timeStarted;
+    std::shared_ptr<Plane> thePlane;
+    long reservationTime;
+    long fleetIndex;
+};
+
+/*
+ *******************************************************************************************
+ * class ChargerPolicy
+ * This decides the order in which waiting planes are given a free charger.
+ * Each policy gives a waiting plane a key when it joins the queue. The plane with the
+ * lowest value of (key - agingRate * currentTime) gets the next charger, with ties going
+ * to the plane that joined the queue first.
+ *
+ * Most policies have an agingRate of 0 so their order never changes while planes wait.
+ * Policies whose priority grows while a plane waits give planes that age at different
+ * speeds different rates. The keys are never updated. WaitingPlaneHeap keeps one heap for
+ * each distinct rate and only compares the tops of those heaps when a charger frees up.
+ *
+ * A ChargerQueue with a nullptr policy, or the FIFO policy, uses its RingBuffer instead.
+ *******************************************************************************************
+ */
+class ChargerPolicy {
+public:
+    virtual ~ChargerPolicy();
+
+    // Name of the policy for output
+    virtual const char *name() = 0;
+
+    // Is this first come, first served? If so ChargerQueue can skip the heap entirely.
+    virtual bool isFIFO();
+
+    // The fixed part of the priority, computed once when the plane starts waiting. Lower goes first.
+    virtual double key(const WaitingPlane &aWaitingPlane) = 0;
+
+    // How much the priority improves for each second of waiting. 0 means it never changes.
+    virtual double agingRate(const WaitingPlane &aWaitingPlane);
+
+    // Create the policy selected by a SimSettings::chargerPolicyOption value.
+    // The settings supply the company priorities for chargerPolicyCompanyPriority.
+    static std::shared_ptr<ChargerPolicy> makePolicy(int option, const SimSettings &theSettings);
+};
+
+/*
+ *******************************************************************************************
+ * class WaitingPlaneHeap
+ * This is a priority queue of waiting planes for the ChargerPolicy classes.
+ * Planes are grouped by agingRate. Within a group the order never changes while the planes
+ * wait so each group is an ordinary binary heap on key. To find the next plane we look
+ * at the top of each group at the current time. There is at most one group per company
+ * so taking the next plane is O(log n + companyCount).
+ *
+ * Its storage comes from the Allocator, so a Simulation can count it (see SimMemory).
+ *******************************************************************************************
+ */
+template <typename Allocator = std::allocator<WaitingPlane>>
+class WaitingPlaneHeap {
+public:
+    struct Entry {
+        double key; // Fixed part of the priority from ChargerPolicy::key()
+        long sequence; // Order the plane joined the queue, used for ties
+        WaitingPlane waiting;
+    };
+private:
+    using EntryAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>;
+    struct RateGroup {
+        double rate; // ChargerPolicy::agingRate() shared by every entry in this group
+        std::vector<Entry, EntryAllocator> heap; // Binary heap with the lowest key (then sequence) at the front
+    };
+    using GroupAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<RateGroup>;
+    std::vector<RateGroup, GroupAllocator> groups;
+    size_t count; // Total number of planes in all groups
+    long nextSequence; // Sequence for the next plane added
+
+    // std heap functions build a max-heap so this comparison is "a goes after b"
+    static bool entryGoesAfter(const Entry &a, const Entry &b) {
+        if(a.key != b.key) {
+            return a.key > b.key;
+        }
+        return a.sequence > b.sequence;
+    }
+public:
+    WaitingPlaneHeap(const Allocator &anAllocator = Allocator()): groups(GroupAllocator(anAllocator)), count{0}, nextSequence{0} {
+    }
+
+    // Is the queue empty?
+    bool empty() const { return count == 0; }
+
+    // How many planes are waiting?
+    size_t size() const { return count; }
+
+    // Add a plane with the key and rate from its policy
+    void push(const WaitingPlane &aWaitingPlane, double key, double rate) {
+        // Find the group for this rate. There are only a few so a linear search is fastest.
+        RateGroup *theGroup = nullptr;
+        for(RateGroup &aGroup: groups) {
+            if(aGroup.rate == rate) {
+                theGroup = &aGroup;
+                break;
+            }
+        }
+        if(!theGroup) {
+            groups.push_back(RateGroup{rate, std::vector<Entry, EntryAllocator>(EntryAllocator(groups.get_allocator()))});
+            theGroup = &groups.back();
+        }
+        theGroup->heap.push_back(Entry{key, nextSequence++, aWaitingPlane});
+        std::push_heap(begin(theGroup->heap), end(theGroup->heap), entryGoesAfter);
+        count++;
+    }
+
+    // Remove and return the plane with the best priority at currentTime.
+    // Only call this if the queue is not empty.
+    WaitingPlane pop(long currentTime) {
+        // Compare the top of each group at the current time. Keys and rates are products of
+        // integers well below 2^53 so these doubles are exact and ties really are ties.
+        RateGroup *bestGroup = nullptr;
+        double bestPriority = 0;
+        long bestSequence = 0;
+        for(RateGroup &aGroup: groups) {
+            if(aGroup.heap.empty()) { continue; }
+            const Entry &top = aGroup.heap.front();
+            double priority = top.key - aGroup.rate * currentTime;
+            if(!bestGroup || priority < bestPriority || (priority == bestPriority && top.sequence < bestSequence)) {
+                bestGroup = &aGroup;
+                bestPriority = priority;
+                bestSequence = top.sequence;
+            }
+        }
+        std::pop_heap(begin(bestGroup->heap), end(bestGroup->heap), entryGoesAfter);
+        WaitingPlane result = bestGroup->heap.back().waiting;
+        bestGroup->heap.pop_back();
+        count--;
+        return result;
+    }
+
+    // For testing: visit every waiting plane without changing anything.
+    // The planes are visited group by group in heap order, not priority order.
+    template <typename F>
+    void forEach(F visit) const {
+        for(const RateGroup &aGroup: groups) {
+            for(const Entry &anEntry: aGroup.heap) {
+                visit(anEntry.waiting);
+            }
+        }
+    }
+};
+
+// The waiting planes of a ChargerQueue or a FastEngine site, counted in the Simulation's memory
+typedef WaitingPlaneHeap<CountingAllocator<WaitingPlane>> CountedWaitingPlaneHeap;
+
+// Check that each policy hands out chargers in the order it promises.
+// It reports errors to cout.
+bool testChargerPolicies();
+
+// Time adding and removing planes with each policy with benchmarkWaitingPlanes planes
+// waiting for a single charger. Results are written to cout in ns per operation.
+const long benchmarkWaitingPlanes{10000};
+bool benchmarkChargerPolicies();
+
+#endif /* ChargerPolicy_hpp */
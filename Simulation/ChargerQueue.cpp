@@ -6,34 +6,104 @@
 //
 
 #include "ChargerQueue.hpp"
+#include "SimProfile.hpp"
+#include "SimTrace.hpp"
 #include "Plane.hpp"
 #include "Flight.hpp"
 #include "PlaneQueue.hpp"
 #include "Passenger.hpp"
 
+extern PlaneSpecification planeSpecifications[];
+
 /*
  *******************************************************************************************
  * class ChargerQueue
  * This manages a queue of planes waiting for chargers.
- * It also manages a vector of chargers assigned to planes.
+ * It also manages a heap of chargers assigned to planes.
  * After planes fly, they move to this class to recharge unless they are grounded.
  *
+ * The active chargers are a binary min-heap on timeDone. Its storage is reserved from
+ * chargerCount when the object is created so it never allocates during a simulation, and
+ * putting a plane on a charger or taking one off is O(log chargerCount).
+ * The planes waiting for a charger are in a RingBuffer so they can be listed for testing
+ * without emptying and refilling the queue. If a ChargerPolicy other than first come, first
+ * served is in use, they are in a WaitingPlaneHeap instead.
+ *
  * This is a child of eventHandler. As such, it will be added to the SimClock queue.
  *
- * A Simulation object will contain exactly one ChargerQueue object.
- * If the ChargerQueue object is in a Simulation it has a pointer to that Simulation object.
+ * A Simulation object will contain one ChargerQueue object for each site.
+ * If the ChargerQueue object is in a Simulation it has a pointer to that Simulation object
+ * and knows its site number.
  * For testing, a ChargerQueue may have a nullptr for theSimulation property.
  *******************************************************************************************
  */
-ChargerQueue::ChargerQueue(Simulation *theSimulation, long chargerCount):
+ChargerQueue::ChargerQueue(Simulation *theSimulation, long chargerCount, std::shared_ptr<ChargerPolicy> thePolicy, long siteNumber):
 // Set our nextEventTime initially to LONG_MAX so we can be in the SimClock handler list, but
 // not receive events until something happens to activate us such as adding planes that
 // need to be charged.
-EventHandler(LONG_MAX), theSimulation{theSimulation}, chargerCount{chargerCount}, verboseTesting{false},chargers{}, planesWaiting{} {
+EventHandler(LONG_MAX, profileChargerQueue, siteNumber), theSimulation{theSimulation}, chargerCount{chargerCount}, verboseTesting{false},
+chargers(CountingAllocator<Charger>(Simulation::memoryOf(theSimulation), memoryQueues)),
+planesWaiting(16, CountingAllocator<WaitingPlane>(Simulation::memoryOf(theSimulation), memoryQueues)),
+planesWaitingByPolicy(CountingAllocator<WaitingPlane>(Simulation::memoryOf(theSimulation), memoryQueues)), thePolicy{thePolicy}, nextChargerSequence{0}, siteNumber{siteNumber} {
+    // The FIFO policy is exactly what the RingBuffer does so we do not need the policy at all
+    if(this->thePolicy && this->thePolicy->isFIFO()) {
+        this->thePolicy = nullptr;
+    }
+    // There are never more than chargerCount active chargers so reserve that much now
+    if(chargerCount > 0) {
+        chargers.reserve(chargerCount);
+    }
 }
 ChargerQueue::~ChargerQueue() {
 }
 
+// The chargers vector is a heap with the charger done soonest at the front. std::push_heap
+// and std::pop_heap build a max-heap, so this comparison is "a is done after b". Chargers
+// done at the same time are ordered by sequence so the first one started is the first one done.
+static bool chargerDoneLater(const Charger &a, const Charger &b) {
+    if(a.timeDone != b.timeDone) {
+        return a.timeDone > b.timeDone;
+    }
+    return a.sequence > b.sequence;
+}
+
+// If we are in a simulation, log a charge that is done or cut off by the end of the simulation
+void ChargerQueue::logCharge(const Charger &aCharger, long currentTime) {
+    if(theSimulation) {
+        ChargerStats someStats{aCharger.thePlane->getCompany(),
+            aCharger.thePlane->getPlaneNumber(),
+            currentTime - aCharger.timeStarted, currentTime - aCharger.timeStartedIncludingWait, siteNumber};
+        theSimulation->recordCharge(someStats, currentTime);
+        if(theSimulation->theTrace) {
+            theSimulation->theTrace->charge(aCharger.thePlane->getPlaneNumber(), aCharger.thePlane->getCompany(), siteNumber,
+                                            aCharger.timeStartedIncludingWait, aCharger.timeStarted, currentTime);
+        }
+    }
+}
+
+// Remove the charger that will be done first from the heap and return it
+Charger ChargerQueue::popCharger() {
+    std::pop_heap(begin(chargers), end(chargers), chargerDoneLater);
+    Charger aCharger = chargers.back();
+    chargers.pop_back();
+    return aCharger;
+}
+
+// How many planes are waiting in whichever structure the policy uses?
+size_t ChargerQueue::waitingCount() {
+    return thePolicy ? planesWaitingByPolicy.size() : planesWaiting.size();
+}
+
+// Remove the next waiting plane according to the policy
+WaitingPlane ChargerQueue::popWaiting(long currentTime) {
+    if(thePolicy) {
+        return planesWaitingByPolicy.pop(currentTime);
+    }
+    WaitingPlane aWaitingPlane = planesWaiting.front();
+    planesWaiting.pop();
+    return aWaitingPlane;
+}
+
 // As a child of EventHandler, ChargerQueue has a nextEventTime. Each time the SimClock
 // reaches the nextEventTime, it will call handleEvent(). If handleEvent returns false,
 // the SimClock will remove this object from the simulation, but there should always be
@@ -45,13 +115,7 @@ bool ChargerQueue::handleEvent(long currentTime, bool closeOut) {
         // If we are closing out the simualtion, mark all chargers as done
         for(auto aCharger: chargers) {
             aCharger.timeDone = currentTime;
-            if(theSimulation) {
-                // if we are in a simulation, log this charge
-                ChargerStats someStats{aCharger.thePlane->getCompany(),
-                    aCharger.thePlane->getPlaneNumber(),
-                    currentTime - aCharger.timeStarted, currentTime - aCharger.timeStartedIncludingWait};
-                theSimulation->theChargerStats.push_back(someStats);
-            }
+            logCharge(aCharger, currentTime);
         }
         // The simulation is over so we do not need to keep "this" object in the Event queue
         return false;
@@ -62,38 +126,31 @@ bool ChargerQueue::handleEvent(long currentTime, bool closeOut) {
         return false;
     }
     // Handle any planes that are now fully charged
-    while(!chargers.empty() && chargers.back().timeDone <= currentTime) {
-        // We keep the chargers sorted with the first to be done at the back of the vector
-        // If the charger that will be done next is ready, remove the plane from the charger
-        std::shared_ptr<Plane> thePlane = chargers.back().thePlane;
-        if(theSimulation) {
-            // log this charge as completed
-            Charger aCharger = chargers.back();
-            ChargerStats someStats{aCharger.thePlane->getCompany(),
-                aCharger.thePlane->getPlaneNumber(),
-                currentTime - aCharger.timeStarted, currentTime - aCharger.timeStartedIncludingWait};
-            theSimulation->theChargerStats.push_back(someStats);
-        }
+    while(!chargers.empty() && chargers.front().timeDone <= currentTime) {
+        // We keep the chargers in a heap with the first to be done at the front of the vector
+        // If the charger that will be done next is ready, remove it from the heap
+        Charger aCharger = popCharger();
+        std::shared_ptr<Plane> thePlane = aCharger.thePlane;
+        // log this charge as completed
+        logCharge(aCharger, currentTime);
 
-        // Remove the object charger from the vector. The object will be discarded, but we already saved a pointer to the plane.
-        chargers.pop_back();
-        if(theSimulation && theSimulation->thePlaneQueue) {
+        // The plane waits for passengers at this site
+        if(theSimulation && theSimulation->getPlaneQueue(siteNumber)) {
             // If we are in a simulation get the passenger delay setting, otherwise default to 0.
             long maxPassengerDelay = 0;
             if(theSimulation->theSettings) { maxPassengerDelay = theSimulation->theSettings->maxPassengerDelay; }
             // Add the plane to the plane queue, ready to fly, asking a static Passenger class function to assign an actual
             // delay for this plane at this time. If maxPassengerDelay > 0 it will be set to some value in [0 - maxPassengerDelay].
-            theSimulation->thePlaneQueue->addPlane(currentTime + Passenger::getPassengerDelay(maxPassengerDelay),thePlane);
+            theSimulation->getPlaneQueue(siteNumber)->addPlane(currentTime + Passenger::getPassengerDelay(maxPassengerDelay, thePlane->getRandom()),thePlane);
         } else if(verboseTesting) {
             // if we are not in a simulation and are being verbose, mention what we would have done if we could
             std::cout << "Would add flight for " << thePlane->describe() << "to thePlaneQueue if Sim full simulation" << std::endl;
         }
     }
     // If there are chargers available, move planes from waiting queue to charger vector
-    while(!planesWaiting.empty() && chargers.size() < chargerCount) {
-        // Remove a plane from the waiting queue, alwasy manages FIFO
-        WaitingPlane aWaitingPlane = planesWaiting.front();
-        planesWaiting.pop();
+    while(waitingCount() > 0 && static_cast<long>(chargers.size()) < chargerCount) {
+        // Remove a plane from the waiting queue, FIFO unless we have some other policy
+        WaitingPlane aWaitingPlane = popWaiting(currentTime);
         // Create a charger option and add the plane to the vector of chargers being used
         addCharger(currentTime, aWaitingPlane.timeStarted, aWaitingPlane.thePlane);
     }
@@ -102,8 +159,8 @@ bool ChargerQueue::handleEvent(long currentTime, bool closeOut) {
         // nextEventTime to a value that assures our handleEvent will not be called until something changes elsewhere.
         nextEventTime = LONG_MAX;
     } else  {
-        // Otherwise set our next time to the last charger in the queue (the first to be done)
-        nextEventTime = chargers.back().timeDone;
+        // Otherwise set our next time to the charger at the top of the heap (the first to be done)
+        nextEventTime = chargers.front().timeDone;
     }
     // When we return true, the SimClock event handlers (which already removed us from it's vector of handlers) will insert us back in at
     // the right place keeping all the handlers sosrted.
@@ -112,60 +169,68 @@ bool ChargerQueue::handleEvent(long currentTime, bool closeOut) {
 
 // For testing: total how may planes are in the wait queue or a charger
 long ChargerQueue::countPlanes() {
-    return static_cast<long>(chargers.size() + planesWaiting.size());
+    return static_cast<long>(chargers.size() + waitingCount());
 }
 
 // For testing: describe the object and counts of the queue and vector
 const std::string ChargerQueue::describe() {
-    std::string description = "Charger Queue with " + std::to_string(chargers.size()) + " planes on chargers and " + std::to_string(planesWaiting.size()) + " planes waiting";
+    std::string description = "Charger Queue with " + std::to_string(chargers.size()) + " planes on chargers and " + std::to_string(waitingCount()) + " planes waiting";
     return description;
 }
 
+// Which ProfileKind the profiler counts this handler as
+int ChargerQueue::profileKind() {
+    return profileChargerQueue;
+}
+
 // Are the vector and chargers both empty?
 bool ChargerQueue::isEmpty() {
-    return planesWaiting.empty() && chargers.empty();
+    return waitingCount() == 0 && chargers.empty();
 }
 
 // If a charger is available, assign the plane, immediately. Otherwise add it to the wait
-// queue which is managed FIFO.
+// queue which is managed FIFO unless we have some other ChargerPolicy.
 // When a charger is done, the plane will be moved back to the PlaneQueue. From there
 // the plane will be put into a flight as soon as it has passengers available.
-void ChargerQueue::addPlane(long currentTime, std::shared_ptr<Plane> aPlane) {
-    if(chargers.size() >= chargerCount) {
-        WaitingPlane aWaitingPlane = WaitingPlane{currentTime, aPlane};
-        planesWaiting.push(aWaitingPlane);
+void ChargerQueue::addPlane(long currentTime, std::shared_ptr<Plane> aPlane, long reservationTime) {
+    if(static_cast<long>(chargers.size()) >= chargerCount) {
+        WaitingPlane aWaitingPlane = WaitingPlane{currentTime, aPlane, reservationTime < 0 ? currentTime : reservationTime, 0};
+        if(thePolicy) {
+            planesWaitingByPolicy.push(aWaitingPlane, thePolicy->key(aWaitingPlane), thePolicy->agingRate(aWaitingPlane));
+        } else {
+            planesWaiting.push(aWaitingPlane);
+        }
     } else {
         addCharger(currentTime, currentTime, aPlane);
     }
 }
 void ChargerQueue::addCharger(long currentTime, long startedWaiting, std::shared_ptr<Plane> aPlane) {
-    if(chargers.size() >= chargerCount) {
+    if(static_cast<long>(chargers.size()) >= chargerCount) {
         // Catch an error. This should never be called if all chargers are full.
         std::cout <<"error: trying to add too many chargers " << std::endl;
         return;
     } else {
-        // Keep chargers sorted with soonest time at the end.
+        // Keep chargers in a heap with soonest time at the front.
         // First calculate when this plane will be charged.
         long timeToCharged = currentTime + aPlane->calcTimeToCharge__seconds();
-        // Insert the new charger into the first location that will keep it sorted.
-        auto chargerPtr = begin(chargers);
-        while(chargerPtr != end(chargers) &&  chargerPtr->timeDone > timeToCharged) {
-            chargerPtr++;
-        }
         // Create a charger object for the plane to keep track of starting and ending time of the charge
-        Charger aCharger = Charger{currentTime, startedWaiting, timeToCharged, aPlane};
-        // Insert the charger into the righ tplace in the chargers vector
-        chargers.insert(chargerPtr, aCharger);
-        
-        if(nextEventTime != chargers.back().timeDone) {
+        Charger aCharger = Charger{currentTime, startedWaiting, timeToCharged, aPlane, nextChargerSequence++};
+        // Add the charger to the heap. The space was reserved so this does not allocate.
+        chargers.push_back(aCharger);
+        std::push_heap(begin(chargers), end(chargers), chargerDoneLater);
+        if(theSimulation && theSimulation->theTrace) {
+            theSimulation->theTrace->chargeStarted(aPlane->getPlaneNumber(), aPlane->getCompany(), siteNumber, currentTime);
+        }
+
+        if(nextEventTime != chargers.front().timeDone) {
             // If our earliest charger done time has changed, we need to be resorted in the SimClock
             // This could happen when the first charger is put into use, but also if a plane is put
             // on a charger that charges so much faster than other planes charging that it will be
             // done first.
-            nextEventTime = chargers.back().timeDone; // adjust the next time for our queue
-            // Ask the theSimClock to re-sort this in it's queue (sorted vector).
-            if(theSimulation && theSimulation->theSimClock && theSimulation->theChargerQueue) {
-                theSimulation->theSimClock->reSortHandler(theSimulation->theChargerQueue);
+            nextEventTime = chargers.front().timeDone; // adjust the next time for our queue
+            // Ask the theSimClock to re-sort this in it's queue (a heap).
+            if(theSimulation && theSimulation->theSimClock && theSimulation->getChargerQueue(siteNumber)) {
+                theSimulation->theSimClock->reSortHandler(theSimulation->getChargerQueue(siteNumber));
             }
         }
     }
@@ -186,30 +251,27 @@ void ChargerQueue::describeQueues(long currentTime) {
         std::cout << "No planes on a charger" << std::endl;
    } else {
         std::cout << "Planes on Chargers" << std::endl;
-        for(auto aCharger: chargers) {
+        // These are listed in heap order which is not necessarily the order they will be done
+        for(const Charger &aCharger: chargers) {
             std::cout << "    " << aCharger.thePlane->describe() << " done at " << aCharger.timeDone << std::endl;
         }
     }
     // List the planes waiting for chargers
-    if(planesWaiting.empty()) {
+    if(waitingCount() == 0) {
         std::cout << "No planes waiting for a Charger" << std::endl;
+   } else if(thePolicy) {
+        std::cout << "Planes waiting for a Charger (" << thePolicy->name() << ", not in priority order)" << std::endl;
+        planesWaitingByPolicy.forEach([currentTime](const WaitingPlane &aWaitingPlane) {
+            std::cout << "    " << "Waiting " << currentTime - aWaitingPlane.timeStarted
+            << " seconds: " << aWaitingPlane.thePlane->describe() << std::endl;
+        });
    } else {
         std::cout << "Planes waiting for a Charger" << std::endl;
-        // To view a queue we must pull everything off of it (and then put it all back)
-        // This is not at all effecient, but we only do it for testing
-        // Regular usage operates with normal queue functionality
-        std::vector<WaitingPlane> tempPlanes{};
-        // pull planes off planesWaiting, describe them and save them in tempPlanes
-        while(!planesWaiting.empty()) {
-            WaitingPlane aWaitingPlane = planesWaiting.front();
-            planesWaiting.pop();
+        // The ring buffer can be indexed front to back without changing it
+        for(size_t i = 0; i < planesWaiting.size(); i++) {
+            const WaitingPlane &aWaitingPlane = planesWaiting[i];
             std::cout << "    " << "Waiting " << currentTime - aWaitingPlane.timeStarted
             << " seconds: " << aWaitingPlane.thePlane->describe() << std::endl;
-            tempPlanes.push_back(aWaitingPlane);
-        }
-        // restore planes to tempQueue
-        for(auto planeToRestore: tempPlanes) {
-            planesWaiting.push(planeToRestore);
         }
     }
     std::cout << std::endl;
@@ -218,32 +280,39 @@ void ChargerQueue::describeQueues(long currentTime) {
 std::vector<ChargerQueueStatusItem> ChargerQueue::getQueueStatus() {
     // Set up a result vector
     std::vector<ChargerQueueStatusItem> result{};
+    result.reserve(chargers.size() + waitingCount());
     // Push information on current chargers into the vector
-    for(auto aCharger: chargers) {
+    for(const Charger &aCharger: chargers) {
         ChargerQueueStatusItem anItem{true,aCharger.thePlane->getPlaneNumber()};
         result.push_back(anItem);
     }
-    // Push information on current waiting planes into the vector
-
-    // To view a queue we must pull everything off of it (and then put it all back)
-    // This is not at all effecient, but we only do it for testing
-    // Regular usage operates with normal queue functionality
-    std::vector<WaitingPlane> tempPlanes{};
-    // pull planes off planesWaiting, describe them and save them in tempPlanes
-    while(!planesWaiting.empty()) {
-        WaitingPlane aWaitingPlane = planesWaiting.front();
-        planesWaiting.pop();
-        ChargerQueueStatusItem anItem{false,aWaitingPlane.thePlane->getPlaneNumber()};
+    // Push information on current waiting planes into the vector, front of the queue first
+    for(size_t i = 0; i < planesWaiting.size(); i++) {
+        ChargerQueueStatusItem anItem{false,planesWaiting[i].thePlane->getPlaneNumber()};
         result.push_back(anItem);
-        tempPlanes.push_back(aWaitingPlane);
-    }
-    // restore planes to tempQueue
-    for(auto planeToRestore: tempPlanes) {
-        planesWaiting.push(planeToRestore);
     }
+    // Or, if there is a policy, in heap order
+    planesWaitingByPolicy.forEach([&result](const WaitingPlane &aWaitingPlane) {
+        result.push_back(ChargerQueueStatusItem{false, aWaitingPlane.thePlane->getPlaneNumber()});
+    });
     return result;
 }
 
+// For testing: look at the active chargers without changing them (in heap order)
+const CountedVector<Charger> &ChargerQueue::getChargers() const {
+    return chargers;
+}
+
+// For testing: look at the waiting planes without changing them (front to back)
+const WaitingPlaneBuffer &ChargerQueue::getPlanesWaiting() const {
+    return planesWaiting;
+}
+
+// For testing: look at the waiting planes of a non-FIFO policy without changing them (heap order)
+const CountedWaitingPlaneHeap &ChargerQueue::getPlanesWaitingByPolicy() const {
+    return planesWaitingByPolicy;
+}
+
 // This does a longer test of the ChargerQueue class outputing verbose information
 // as it "simulates" being part of a simulation.
 bool testChargerQueueLong() {
@@ -318,3 +387,63 @@ bool testChargerQueueShort() {
     std::cout << std::endl;
     return returnValue;
 }
+
+// This checks that the charger heap releases planes in timeDone order (FIFO for ties) and
+// that listing the waiting planes does not change the queue. It reports errors to cout.
+bool testChargerQueueOrder() {
+    const int testChargers{3};
+    // Charge times: Bravo 720, Alpha 2160, Echo 1080, Charlie 2880, Delta 2232 seconds.
+    // The two Bravo planes finish at the same time so they check the tie breaking.
+    const Company testCompanies[]{Bravo, Alpha, Bravo, Echo, Charlie, Delta, Echo};
+
+    bool returnValue = true;
+    long currentTime = 0;
+    std::cout << " ***** Starting order test of ChargerQueue Class  *****" << std::endl;
+    ChargerQueue aQueue(nullptr, testChargers);
+    std::vector<int> expectedWaiting{};
+    for(Company c: testCompanies) {
+        std::shared_ptr<Plane> aPlane = std::make_shared<Plane>(planeSpecifications[c]);
+        if(aQueue.getChargers().size() >= testChargers) {
+            expectedWaiting.push_back(aPlane->getPlaneNumber());
+        }
+        aQueue.addPlane(currentTime, aPlane);
+    }
+    // Listing the queue twice must give the same answer both times
+    for(int pass = 0; pass < 2; pass++) {
+        const WaitingPlaneBuffer &waiting = aQueue.getPlanesWaiting();
+        bool matches = waiting.size() == expectedWaiting.size();
+        for(size_t i = 0; matches && i < waiting.size(); i++) {
+            matches = waiting[i].thePlane->getPlaneNumber() == expectedWaiting[i];
+        }
+        if(!matches) {
+            std::cout << "***** error: waiting planes changed or out of order on pass " << pass + 1 << std::endl;
+            returnValue = false;
+        }
+    }
+    long lastEventTime = 0;
+    while(!aQueue.isEmpty()) {
+        // The next event time must always be the soonest charger and never go backwards
+        currentTime = aQueue.getNextEventTime();
+        long soonest = LONG_MAX;
+        for(const Charger &aCharger: aQueue.getChargers()) {
+            soonest = std::min(soonest, aCharger.timeDone);
+        }
+        if(currentTime != soonest || currentTime < lastEventTime) {
+            std::cout << "***** error: next event time " << currentTime << " but soonest charger done at " << soonest << std::endl;
+            returnValue = false;
+            break;
+        }
+        // After the event, no charger that is done by now may still be active
+        aQueue.handleEvent(currentTime, false);
+        for(const Charger &aCharger: aQueue.getChargers()) {
+            if(aCharger.timeDone <= currentTime) {
+                std::cout << "***** error: charger done at " << aCharger.timeDone << " still active at " << currentTime << std::endl;
+                returnValue = false;
+            }
+        }
+        lastEventTime = currentTime;
+    }
+    std::cout << "Order test of ChargerQueue Class " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
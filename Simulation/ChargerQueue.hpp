@@ -14,6 +14,8 @@
 #include <string>
 #include "SimClock.hpp"
 #include "Plane.hpp"
+#include "RingBuffer.hpp"
+#include "ChargerPolicy.hpp"
 
 /*
  *******************************************************************************************
@@ -21,6 +23,8 @@
  * This is used to store information about active chargers.
  * In addition to the plane, we need the time charging is done.
  * And for statistics, we also need when it started so we can caluclate duration.
+ * The sequence number breaks ties between chargers done at the same time so the
+ * plane put on a charger first is also taken off first.
  *******************************************************************************************
  */
 struct Charger {
@@ -28,19 +32,8 @@ struct Charger {
     long timeStartedIncludingWait;
     long timeDone;
     std::shared_ptr<Plane> thePlane;
+    long sequence;
 };
-/*
- *******************************************************************************************
- * Struct WaitingPlane
- * This is used to store information about planes waiting for chargers.
- * We need this information to calculate how long it waited.
- *******************************************************************************************
- */
-struct WaitingPlane {
-    long timeStarted;
-    std::shared_ptr<Plane> thePlane;
-};
-
 /*
  *******************************************************************************************
  * Struct ChargerQueueStatusItem
@@ -55,24 +48,52 @@ struct ChargerQueueStatusItem { // for testing
  *******************************************************************************************
  * class ChargerQueue
  * This manages a queue of planes waiting for chargers.
- * It also manages a vector of chargers assigned to planes.
+ * It also manages a heap of chargers assigned to planes.
  * After planes fly, they move to this class to recharge unless they are grounded.
  *
+ * The active chargers are a binary min-heap on timeDone. Its storage is reserved from
+ * chargerCount when the object is created so it never allocates during a simulation, and
+ * putting a plane on a charger or taking one off is O(log chargerCount).
+ * The planes waiting for a charger are in a RingBuffer so they can be listed for testing
+ * without emptying and refilling the queue. If a ChargerPolicy other than first come, first
+ * served is in use, they are in a WaitingPlaneHeap instead.
+ *
  * This is a child of eventHandler. As such, it will be added to the SimClock queue.
  *
- * A Simulation object will contain exactly one ChargerQueue object.
- * If the ChargerQueue object is in a Simulation it has a pointer to that Simulation object.
+ * A Simulation object will contain one ChargerQueue object for each site.
+ * If the ChargerQueue object is in a Simulation it has a pointer to that Simulation object
+ * and knows its site number.
  * For testing, a ChargerQueue may have a nullptr for theSimulation property.
  *******************************************************************************************
  */
+// The planes waiting for a charger, counted in the Simulation's memory
+typedef RingBuffer<WaitingPlane, CountingAllocator<WaitingPlane>> WaitingPlaneBuffer;
+
 class ChargerQueue: public EventHandler {
     Simulation *theSimulation; // Simulation object containing current simulation or nullptr
     long chargerCount; // How many chargers in this simulation
     bool verboseTesting; // For testing, provides more details to cout
-    std::vector<Charger> chargers; // Zero or more chargers (<= chargerCount)
-    std::queue<WaitingPlane> planesWaiting; // Planes waiting for a charger
+    CountedVector<Charger> chargers; // Zero or more chargers (<= chargerCount) kept as a min-heap on timeDone
+    WaitingPlaneBuffer planesWaiting; // Planes waiting for a charger (FIFO policy)
+    CountedWaitingPlaneHeap planesWaitingByPolicy; // Planes waiting for a charger (any other policy)
+    std::shared_ptr<ChargerPolicy> thePolicy; // How we choose the next waiting plane, nullptr for FIFO
+    long nextChargerSequence; // Sequence number for the next charger so ties are handled FIFO
+    long siteNumber; // Which site in theSimulation these chargers are at
+
+    // Remove the charger that will be done first from the heap and return it
+    Charger popCharger();
+
+    // How many planes are waiting in whichever structure the policy uses?
+    size_t waitingCount();
+
+    // Remove the next waiting plane according to the policy
+    WaitingPlane popWaiting(long currentTime);
+
+    // If we are in a simulation, log a charge that is done or cut off by the end of the simulation
+    void logCharge(const Charger &aCharger, long currentTime);
 public:
-    ChargerQueue(Simulation *theSimulation, long chargerCount);
+    // If thePolicy is nullptr or FIFO, waiting planes are handled first come, first served
+    ChargerQueue(Simulation *theSimulation, long chargerCount, std::shared_ptr<ChargerPolicy> thePolicy = nullptr, long siteNumber = 0);
     virtual ~ChargerQueue() override;
     
     // As a child of EventHandler, ChargerQueue has a nextEventTime. Each time the SimClock
@@ -88,16 +109,21 @@ public:
 
     // For testing: describe the object and counts of the queue and vector
     virtual const std::string describe() override;
+    
+    // Which ProfileKind the profiler counts this handler as
+    virtual int profileKind() override;
 
     // Are the vector and chargers both empty?
     bool isEmpty();
 
     // If a charger is available, assign the plane,
-    // otherwise add it to the queue which is handled FIFO.
+    // otherwise add it to the queue which is handled according to the ChargerPolicy.
     // When a charger is done, the plane is put in a flight or if we have passenger delays,
     // When the SimClock currentTime >= delayUntil the next call to handleEvent will put
     // the plane back into the planeQueue until it can be put into a flight.
-    void addPlane(long currentTime, std::shared_ptr<Plane> aPlane);
+    // The reservationTime is when the plane booked the charger (the start of its flight).
+    // If it is < 0 the plane booked it now.
+    void addPlane(long currentTime, std::shared_ptr<Plane> aPlane, long reservationTime = -1);
     
     // Add a plane to the charger. Should only be called if there are available chargers
     // Captures the time the plane has already started waited in the queue (if any).
@@ -113,6 +139,13 @@ public:
 
     // Get status information in a vector so automated testing can check things
     std::vector<ChargerQueueStatusItem> getQueueStatus();
+
+    // For testing: look at the active chargers and waiting planes without changing them.
+    // The chargers are in heap order, not sorted. The waiting planes are front to back.
+    // With a policy other than FIFO the waiting planes are in getPlanesWaitingByPolicy().
+    const CountedVector<Charger> &getChargers() const;
+    const WaitingPlaneBuffer &getPlanesWaiting() const;
+    const CountedWaitingPlaneHeap &getPlanesWaitingByPolicy() const;
 };
 
 // These are here to allow the test menus access to call them.
@@ -127,4 +160,8 @@ bool testChargerQueueLong();
 // testing using expected values of the result vector for known inputs.
 bool testChargerQueueShort();
 
+// This checks that the charger heap releases planes in timeDone order (FIFO for ties) and
+// that listing the waiting planes does not change the queue. It reports errors to cout.
+bool testChargerQueueOrder();
+
 #endif /* ChargerQueue_hpp */
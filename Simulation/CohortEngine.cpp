@@ -0,0 +1,513 @@
+//
+//  CohortEngine.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "CohortEngine.hpp"
+#include "FastEngine.hpp"
+#include "Passenger.hpp"
+#include "ChargerPolicy.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/*
+ *******************************************************************************************
+ * class CohortEngine
+ * The FastEngine's clock and handlers with a list of planes in place of each plane. See
+ * CohortEngine.hpp.
+ *******************************************************************************************
+ */
+CohortEngine::CohortEngine(Simulation *theSimulation): theSimulation{theSimulation}, endTime{0}, chargerCount{0},
+maxPassengerDelay{0}, fleet(CountingAllocator<CohortPlane>(&theSimulation->theMemory, memoryPlanes)), companies{}, sites{},
+groups(CountingAllocator<CountedVector<long>>(&theSimulation->theMemory, memoryQueues)),
+freeGroups(CountingAllocator<long>(&theSimulation->theMemory, memoryQueues)),
+flights(CountingAllocator<CohortFlight>(&theSimulation->theMemory, memoryHandlers)),
+freeFlights(CountingAllocator<long>(&theSimulation->theMemory, memoryHandlers)),
+flightKeys(CountingAllocator<ClockKey>(&theSimulation->theMemory, memoryHandlers)),
+chargerKeys(CountingAllocator<ClockKey>(&theSimulation->theMemory, memoryHandlers)),
+planeQueueKeys(CountingAllocator<ClockKey>(&theSimulation->theMemory, memoryHandlers)),
+events(CountingAllocator<CohortEvent>(&theSimulation->theMemory, memoryHandlers)),
+startingFlights(CountingAllocator<StartingFlight>(&theSimulation->theMemory, memoryQueues)), nextSequence{0}, eventCount{0},
+flightEvents{0}, flightPlanes{0}, note{}, theRecorder{&theSimulation->theRecorder} {
+}
+
+// Faults must be counted when each flight ends, the chargers must be first come, first
+// served, and there must be no trace or memory budget
+bool CohortEngine::canRun(const SimSettings &someSettings, const SimTrace *aTrace) {
+    std::shared_ptr<ChargerPolicy> aPolicy = ChargerPolicy::makePolicy(someSettings.chargerPolicyOption, someSettings);
+    return aTrace == nullptr && someSettings.memoryBudgetMB <= 0 && someSettings.faultOption == 0 &&
+        someSettings.faultCountOption == 1 && (!aPolicy || aPolicy->isFIFO());
+}
+
+// A flight has no plane number of its own, so it is recorded under its first plane's
+long CohortEngine::recorderIdFor(uint32_t kind, long id) {
+    return kind == fastFlightEvent ? fleet[groups[flights[id].group].front()].thePlane->getPlaneNumber() : id;
+}
+
+// A new empty list of planes. The lists are reused so their memory is too.
+long CohortEngine::newGroup() {
+    if(freeGroups.empty()) {
+        groups.emplace_back(CountingAllocator<long>(&theSimulation->theMemory, memoryQueues));
+        return static_cast<long>(groups.size()) - 1;
+    }
+    long group = freeGroups.back();
+    freeGroups.pop_back();
+    groups[group].clear();
+    return group;
+}
+void CohortEngine::freeGroup(long group) {
+    freeGroups.push_back(group);
+}
+
+// The clock key for an event kind and flight or site number
+CohortEngine::ClockKey &CohortEngine::keyFor(uint32_t kind, long id) {
+    switch(kind) {
+        case fastFlightEvent: return flightKeys[id];
+        case fastChargerEvent: return chargerKeys[id];
+        default: return planeQueueKeys[id];
+    }
+}
+
+// Put something in the clock at a time with the next sequence (FastEngine::schedule)
+void CohortEngine::schedule(uint32_t kind, long id, long time) {
+    ClockKey &key = keyFor(kind, id);
+    key.time = time;
+    key.sequence = nextSequence++;
+    key.inClock = true;
+    if(time != LONG_MAX) {
+        events.push_back(CohortEvent{time, key.sequence, kind, id});
+        std::push_heap(begin(events), end(events), eventLater<CohortEvent>);
+    }
+}
+
+// Move something already in the clock to a new time (FastEngine::reschedule)
+void CohortEngine::reschedule(uint32_t kind, long id, long time) {
+    if(keyFor(kind, id).inClock) {
+        schedule(kind, id, time);
+    }
+}
+
+// Handle one event
+bool CohortEngine::dispatch(uint32_t kind, long id, long currentTime, bool closeOut) {
+    switch(kind) {
+        case fastFlightEvent: return handleFlight(id, currentTime);
+        case fastChargerEvent: return handleChargers(id, currentTime, closeOut);
+        default: return handlePlaneQueue(id, currentTime, closeOut);
+    }
+}
+
+// The time the queue wants next after it has been handled. A flight never stays in the clock.
+long CohortEngine::nextTimeFor(uint32_t kind, long id) {
+    return kind == fastChargerEvent ? sites[id].chargerNextTime : sites[id].planeQueueNextTime;
+}
+
+// FastEngine::handleFlight for every plane in the cohort. This is also called to close out a
+// flight. Each plane counts its own faults, then they go to the chargers in order.
+bool CohortEngine::handleFlight(long flight, long currentTime) {
+    CohortFlight aFlight = flights[flight];
+    freeFlights.push_back(flight);
+    long duration = currentTime - aFlight.startTime;
+    long passengerCount = 0;
+    long faultCount = 0;
+    for(long plane: groups[aFlight.group]) {
+        passengerCount += fleet[plane].passengerCount;
+        faultCount += fleet[plane].thePlane->countFaults(duration);
+    }
+    long count = static_cast<long>(groups[aFlight.group].size());
+    double passengerMiles = duration * passengerCount * companies[aFlight.company].milesPerHour;
+    passengerMiles /= secondsPerHourD;
+    theSimulation->theTotals.addFlight(FlightStats{aFlight.company, 0, duration * count, passengerCount,
+        faultCount, passengerMiles, aFlight.originSite}, count);
+    addToChargers(aFlight.destinationSite, currentTime, aFlight.group);
+    return false;
+}
+
+// FastEngine::handleChargers for charger and waiting entries
+bool CohortEngine::handleChargers(long site, long currentTime, bool closeOut) {
+    CohortSite &aSite = sites[site];
+    if(closeOut) {
+        // Log the charges still in progress
+        for(const CohortCharger &aCharger: aSite.chargers) {
+            logCharges(site, aCharger, currentTime);
+        }
+        return false;
+    }
+    // Handle any planes that are now fully charged. Each draws its own passenger delay.
+    while(!aSite.chargers.empty() && aSite.chargers.front().timeDone <= currentTime) {
+        std::pop_heap(begin(aSite.chargers), end(aSite.chargers), doneLater<CohortCharger>);
+        CohortCharger aCharger = aSite.chargers.back();
+        aSite.chargers.pop_back();
+        logCharges(site, aCharger, currentTime);
+        size_t count = groups[aCharger.group].size();
+        aSite.chargersInUse -= static_cast<long>(count);
+        // addToPlaneQueue can add lists, so the list is looked up each time
+        for(size_t i = 0; i < count; i++) {
+            long plane = groups[aCharger.group][i];
+            long delay = Passenger::getPassengerDelay(maxPassengerDelay, fleet[plane].thePlane->getRandom());
+            addToPlaneQueue(site, currentTime + delay, plane);
+        }
+        freeGroup(aCharger.group);
+    }
+    // If there are chargers available, move planes from the front of the waiting queue to them
+    while(aSite.chargersInUse < chargerCount && !aSite.planesWaiting.empty()) {
+        CohortWaiting &aWaiting = aSite.planesWaiting.front();
+        size_t count = std::min(groups[aWaiting.group].size() - aWaiting.first, static_cast<size_t>(chargerCount - aSite.chargersInUse));
+        addChargers(site, currentTime, aWaiting.timeStarted, aWaiting.group, aWaiting.first, count);
+        aWaiting.first += count;
+        if(aWaiting.first == groups[aWaiting.group].size()) {
+            freeGroup(aWaiting.group);
+            aSite.planesWaiting.pop();
+        }
+    }
+    aSite.chargerNextTime = aSite.chargers.empty() ? LONG_MAX : aSite.chargers.front().timeDone;
+    return true;
+}
+
+// FastEngine::handlePlaneQueue. Each plane draws its own passengers and destination, and the
+// planes of each company going to each destination take off together.
+bool CohortEngine::handlePlaneQueue(long site, long currentTime, bool closeOut) {
+    if(closeOut) {
+        return false;
+    }
+    CohortSite &aSite = sites[site];
+    aSite.lastReadyGroup = -1;
+    while(!aSite.planesReady.empty() && aSite.planesReady.front().nextFlightTime <= currentTime) {
+        std::pop_heap(begin(aSite.planesReady), end(aSite.planesReady), readyLater<CohortReady>);
+        long readyGroup = aSite.planesReady.back().group;
+        aSite.planesReady.pop_back();
+        for(size_t i = 0; i < groups[readyGroup].size(); i++) {
+            long plane = groups[readyGroup][i];
+            CohortPlane &aPlane = fleet[plane];
+            aPlane.passengerCount = Passenger::getPassengerCount(companies[aPlane.company].maxPassengers, theSimulation->theSettings, aPlane.thePlane->getRandom());
+            long destinationSite = theSimulation->pickDestinationSite(site, aPlane.thePlane->getRandom());
+            // The plane joins the last flight landing at the same time and place if it is of
+            // the same company. Two companies can have the same flight time, and then a plane
+            // of the other company in between has to land between them.
+            long flightTime = companies[aPlane.company].timeOnFullCharge;
+            auto starting = std::find_if(startingFlights.rbegin(), startingFlights.rend(), [&](const StartingFlight &s) {
+                return companies[s.company].timeOnFullCharge == flightTime && s.destinationSite == destinationSite;
+            });
+            long group;
+            if(starting != startingFlights.rend() && starting->company == aPlane.company) {
+                group = starting->group;
+            } else {
+                group = newGroup();
+                startingFlights.push_back(StartingFlight{aPlane.company, destinationSite, group});
+            }
+            groups[group].push_back(plane);
+        }
+        freeGroup(readyGroup);
+    }
+    // The FastEngine schedules each plane's flight as it is taken from the queue. Nothing else
+    // lands at the same time and place between the planes of one flight, so only the first
+    // plane of each matters to the order, and they are scheduled in that order.
+    for(const StartingFlight &aStart: startingFlights) {
+        startFlight(aStart.group, aStart.company, currentTime, site, aStart.destinationSite);
+    }
+    startingFlights.clear();
+    aSite.planeQueueNextTime = aSite.planesReady.empty() ? LONG_MAX : aSite.planesReady.front().nextFlightTime;
+    return true;
+}
+
+// FastEngine::startFlight for a cohort
+void CohortEngine::startFlight(long group, Company company, long currentTime, long originSite, long destinationSite) {
+    long flight;
+    if(freeFlights.empty()) {
+        flight = static_cast<long>(flights.size());
+        flights.emplace_back();
+        flightKeys.push_back(ClockKey{LONG_MAX, 0, false});
+    } else {
+        flight = freeFlights.back();
+        freeFlights.pop_back();
+    }
+    flights[flight] = CohortFlight{group, company, currentTime, currentTime + companies[company].timeOnFullCharge, originSite, destinationSite};
+    schedule(fastFlightEvent, flight, flights[flight].endTime);
+}
+
+// FastEngine::addToChargers for a landing cohort: the planes get chargers in order while
+// there are any free, and the rest wait together
+void CohortEngine::addToChargers(long site, long currentTime, long group) {
+    CohortSite &aSite = sites[site];
+    size_t count = groups[group].size();
+    size_t onChargers = std::min(count, static_cast<size_t>(std::max(0L, chargerCount - aSite.chargersInUse)));
+    if(onChargers > 0) {
+        addChargers(site, currentTime, currentTime, group, 0, onChargers);
+    }
+    if(onChargers < count) {
+        aSite.planesWaiting.push(CohortWaiting{currentTime, group, onChargers});
+    } else {
+        freeGroup(group);
+    }
+}
+
+// FastEngine::addCharger for count planes of one company. They are done at the same time
+// and the FastEngine would have given them sequences one after another, so one entry holds them.
+void CohortEngine::addChargers(long site, long currentTime, long startedWaiting, long group, size_t first, size_t count) {
+    CohortSite &aSite = sites[site];
+    Company company = fleet[groups[group][first]].company;
+    long chargerGroup = newGroup();
+    const CountedVector<long> &planes = groups[group];
+    groups[chargerGroup].assign(begin(planes) + static_cast<long>(first), begin(planes) + static_cast<long>(first + count));
+    aSite.chargers.push_back(CohortCharger{currentTime, startedWaiting, currentTime + companies[company].timeToCharge,
+        aSite.nextChargerSequence++, chargerGroup});
+    std::push_heap(begin(aSite.chargers), end(aSite.chargers), doneLater<CohortCharger>);
+    aSite.chargersInUse += static_cast<long>(count);
+    if(aSite.chargerNextTime != aSite.chargers.front().timeDone) {
+        aSite.chargerNextTime = aSite.chargers.front().timeDone;
+        reschedule(fastChargerEvent, site, aSite.chargerNextTime);
+    }
+}
+
+// FastEngine::addToPlaneQueue. A plane ready at the same time as the last one added to
+// the queue joins its entry, since no other entry could come between them.
+void CohortEngine::addToPlaneQueue(long site, long delayUntil, long plane) {
+    CohortSite &aSite = sites[site];
+    if(aSite.lastReadyGroup >= 0 && aSite.lastReadyTime == delayUntil) {
+        groups[aSite.lastReadyGroup].push_back(plane);
+        return;
+    }
+    long group = newGroup();
+    groups[group].push_back(plane);
+    aSite.planesReady.push_back(CohortReady{delayUntil, aSite.nextPlaneSequence++, group});
+    std::push_heap(begin(aSite.planesReady), end(aSite.planesReady), readyLater<CohortReady>);
+    aSite.lastReadyGroup = group;
+    aSite.lastReadyTime = delayUntil;
+    if(aSite.planeQueueNextTime != aSite.planesReady.front().nextFlightTime) {
+        aSite.planeQueueNextTime = aSite.planesReady.front().nextFlightTime;
+        reschedule(fastPlaneQueueEvent, site, aSite.planeQueueNextTime);
+    }
+}
+
+// Log the charges of every plane in a charger entry that are done or cut off by the end
+void CohortEngine::logCharges(long site, const CohortCharger &aCharger, long currentTime) {
+    long count = static_cast<long>(groups[aCharger.group].size());
+    Company company = fleet[groups[aCharger.group].front()].company;
+    theSimulation->theTotals.addCharge(ChargerStats{company, 0, count * (currentTime - aCharger.timeStarted),
+        count * (currentTime - aCharger.timeStartedIncludingWait), site}, count);
+}
+
+// Create the planes for each site and run the simulation. It returns the final simulated time.
+long CohortEngine::run(const std::vector<std::vector<Company>> &siteCompanies) {
+    std::shared_ptr<SimSettings> theSettings = theSimulation->theSettings;
+    endTime = theSettings->simulationDuration;
+    chargerCount = theSettings->chargerCount;
+    maxPassengerDelay = theSettings->maxPassengerDelay;
+
+    // Set up the sites and create the planes in the same order as PlaneQueue::generatePlanes
+    long siteCount = static_cast<long>(siteCompanies.size());
+    SimMemory *theMemory = &theSimulation->theMemory;
+    sites.assign(siteCount, CohortSite{CountedVector<CohortCharger>(CountingAllocator<CohortCharger>(theMemory, memoryQueues)), 0,
+        RingBuffer<CohortWaiting, CountingAllocator<CohortWaiting>>(16, CountingAllocator<CohortWaiting>(theMemory, memoryQueues)), 0, LONG_MAX,
+        CountedVector<CohortReady>(CountingAllocator<CohortReady>(theMemory, memoryQueues)), 0, -1, 0, LONG_MAX});
+    chargerKeys.assign(siteCount, ClockKey{LONG_MAX, 0, false});
+    planeQueueKeys.assign(siteCount, ClockKey{LONG_MAX, 0, false});
+    bool companySeen[companyCount]{};
+    for(long site = 0; site < siteCount; site++) {
+        for(Company c: siteCompanies[site]) {
+            std::shared_ptr<Plane> thePlane = theSimulation->makePlane(c);
+            if(!companySeen[c]) {
+                companies[c] = CompanyInfo{thePlane->getMilesPerHour(), thePlane->calcTimeOnFullCharge__seconds(),
+                    thePlane->calcTimeToCharge__seconds(), thePlane->getMaxPassengerCount()};
+                companySeen[c] = true;
+            }
+            long plane = static_cast<long>(fleet.size());
+            fleet.push_back(CohortPlane{thePlane, c, 0});
+            long waitForPassengers = Passenger::getPassengerDelay(maxPassengerDelay, thePlane->getRandom());
+            addToPlaneQueue(site, waitForPassengers, plane);
+        }
+    }
+    for(long site = 0; site < siteCount; site++) {
+        schedule(fastChargerEvent, site, sites[site].chargerNextTime);
+        schedule(fastPlaneQueueEvent, site, sites[site].planeQueueNextTime);
+    }
+
+    // Decide if we need to share progress status, as SimClock::run does
+    long progressInterval = theSimulation->getProgressInterval();
+    long nextProgressUpdate = progressInterval > 0 ? progressInterval : LONG_MAX;
+
+#if SIMPROFILE
+    SimProfile *theProfile = theSimulation->theProfile.enabled ? &theSimulation->theProfile : nullptr;
+#endif
+    auto loopStartTimer = std::chrono::high_resolution_clock::now();
+    long currentTime{0};
+    while(true) {
+        // Skip events for anything that has since moved
+        dropStaleEvents(events, [this](const CohortEvent &anEvent) -> const ClockKey & {
+            return keyFor(anEvent.kind, anEvent.id);
+        });
+        long nextTime = events.empty() ? LONG_MAX : events.front().time;
+        if(nextTime >= nextProgressUpdate && progressInterval > 0) {
+            theSimulation->showProgress(std::min(nextTime, endTime), endTime);
+            nextProgressUpdate += progressInterval;
+        }
+        if(nextTime >= endTime) {
+            currentTime = endTime;
+            break;
+        }
+        CohortEvent anEvent = events.front();
+        std::pop_heap(begin(events), end(events), eventLater<CohortEvent>);
+        events.pop_back();
+        keyFor(anEvent.kind, anEvent.id).inClock = false;
+        currentTime = anEvent.time;
+        eventCount++;
+        if(anEvent.kind == fastFlightEvent) {
+            flightEvents++;
+            flightPlanes += static_cast<long>(groups[flights[anEvent.id].group].size());
+        }
+#if SIMPROFILE
+        if(theProfile) {
+            theProfile->kinds[anEvent.kind].events++;
+        }
+#endif
+        long recorderId = recorderIdFor(anEvent.kind, anEvent.id);
+        theRecorder->record(currentTime, anEvent.kind, recorderId, recordHandle);
+        if(dispatch(anEvent.kind, anEvent.id, currentTime, false)) {
+            long newTime = nextTimeFor(anEvent.kind, anEvent.id);
+            if(currentTime >= newTime) {
+                reportBadReinsert("CohortEngine::run()", *theRecorder, newTime, anEvent.kind, recorderId);
+            } else {
+                theRecorder->record(newTime, anEvent.kind, recorderId, recordKeep);
+                schedule(anEvent.kind, anEvent.id, newTime);
+            }
+        } else {
+            theRecorder->record(currentTime, anEvent.kind, recorderId, recordRemove);
+        }
+    }
+    if(nextProgressUpdate < LONG_MAX) {
+        std::cout << std::endl;
+    }
+
+    // Close out everything still in the clock, latest first, as the FastEngine does
+    closeOutClock(static_cast<long>(flights.size()), static_cast<long>(sites.size()),
+                  [this](uint32_t kind, long id) -> ClockKey & { return keyFor(kind, id); },
+                  [this, currentTime](uint32_t kind, long id) {
+        theRecorder->record(currentTime, kind, recorderIdFor(kind, id), recordCloseOut);
+        dispatch(kind, id, currentTime, true);
+    });
+    double loopSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loopStartTimer).count();
+#if SIMPROFILE
+    if(theProfile) {
+        // Only the events and the time are counted
+        theProfile->eventLoopSeconds = loopSeconds;
+        if(theProfile->countersRequested) {
+            theProfile->countersNote = "the cohort engine does not read the hardware counters";
+        }
+    }
+#else
+    (void)loopSeconds;
+#endif
+
+    char average[32];
+    snprintf(average, sizeof(average), "%.1f", flightEvents > 0 ? static_cast<double>(flightPlanes) / flightEvents : 0.0);
+    note = "cohorts, " + std::to_string(flightEvents) + " flight events for " + std::to_string(flightPlanes) +
+        " flights (" + average + " planes each)";
+    return currentTime;
+}
+
+// How many events were handled (not counting the close-out)
+long CohortEngine::getEventCount() {
+    return eventCount;
+}
+
+// How many planes the flight events held on average
+const std::string &CohortEngine::getNote() {
+    return note;
+}
+
+// The counts must match exactly. The averages and passenger miles are added up in a
+// different order, so they may differ in the last bits.
+static bool closeValue(double a, double b) {
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+}
+static bool closeResults(const std::vector<FinalStats> &a, const std::vector<FinalStats> &b) {
+    if(a.size() != b.size()) { return false; }
+    for(size_t i = 0; i < a.size(); i++) {
+        if(a[i].theCompany != b[i].theCompany || a[i].totalFlights != b[i].totalFlights ||
+           a[i].totalCharges != b[i].totalCharges || a[i].totalFaults != b[i].totalFaults ||
+           !closeValue(a[i].averageTimePerFlight, b[i].averageTimePerFlight) ||
+           !closeValue(a[i].averageDistancePerFlight, b[i].averageDistancePerFlight) ||
+           !closeValue(a[i].averageTimeCharging, b[i].averageTimeCharging) ||
+           !closeValue(a[i].averageTimeChargingWithWait, b[i].averageTimeChargingWithWait) ||
+           !closeValue(a[i].totalPassengerMiles, b[i].totalPassengerMiles)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run settings through the FastEngine and this engine and check that the results are the
+// same with fewer events, and that settings it cannot run use the FastEngine. It reports
+// errors to cout.
+bool testCohortEngine() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of the cohort engine *****" << std::endl;
+    struct TestCase {
+        const char *description;
+        long hours, planes, chargers, sites;
+        int passengerCountOption, siteFlightOption, faultCountOption;
+        long maxPassengerDelay;
+        bool fewerEvents; // The cohorts should need fewer events than the FastEngine
+        const char *expected; // Part of the engine note the run should give
+    };
+    const TestCase testCases[]{
+        {"defaults", 300, 20, 3, 1, 0, 0, 1, 0, true, "cohorts"},
+        {"large fleet", 300, 2000, 150, 1, 0, 0, 1, 0, true, "cohorts"},
+        {"one charger", 300, 25, 1, 1, 0, 0, 1, 0, true, "cohorts"},
+        {"no chargers short", 300, 50, 50, 1, 0, 0, 1, 0, true, "cohorts"},
+        {"random passengers", 300, 200, 20, 1, 1, 0, 1, 0, true, "cohorts"},
+        {"passenger delays", 300, 60, 10, 1, 1, 0, 1, 1800, false, "cohorts"},
+        {"sites, fly between", 300, 300, 20, 3, 0, 1, 1, 0, true, "cohorts"},
+        {"sites, delays", 300, 90, 6, 3, 1, 1, 1, 600, false, "cohorts"},
+        {"fault events", 300, 40, 5, 1, 0, 0, 0, 0, false, "FastEngine"},
+    };
+    const long seeds[]{1, 12345};
+    for(const TestCase &aCase: testCases) {
+        for(long seed: seeds) {
+            SimSettings settings{};
+            settings.simulationDuration = aCase.hours * secondsPerHour;
+            settings.planeCount = aCase.planes;
+            settings.chargerCount = aCase.chargers;
+            settings.siteCount = aCase.sites;
+            settings.passengerCountOption = aCase.passengerCountOption;
+            settings.siteFlightOption = aCase.siteFlightOption;
+            settings.faultCountOption = aCase.faultCountOption;
+            settings.maxPassengerDelay = aCase.maxPassengerDelay;
+            settings.randomSeed = seed;
+            settings.progressInterval = 0;
+            std::vector<FinalStats> results[2];
+            std::vector<std::vector<FinalStats>> siteResults[2];
+            long events[2]{};
+            std::string engineNote;
+            const int engines[]{1, 3};
+            for(int engine = 0; engine < 2; engine++) {
+                settings.engineOption = engines[engine];
+                Simulation aSimulation(settings);
+                aSimulation.setQuiet(true);
+                results[engine] = aSimulation.run(false);
+                siteResults[engine] = aSimulation.getSiteResults();
+                events[engine] = aSimulation.getEventCount();
+                engineNote = aSimulation.getEngineNote();
+            }
+            bool same = closeResults(results[0], results[1]);
+            for(size_t site = 0; same && site < siteResults[0].size(); site++) {
+                same = closeResults(siteResults[0][site], siteResults[1][site]);
+            }
+            if(!same || engineNote.find(aCase.expected) == std::string::npos) {
+                std::cout << "***** error: " << aCase.description << " with seed " << seed << " (" << engineNote
+                << ") does not match the FastEngine" << std::endl;
+                returnValue = false;
+            }
+            if(aCase.fewerEvents && events[1] >= events[0]) {
+                std::cout << "***** error: " << aCase.description << " with seed " << seed << " had " << events[1]
+                << " events with cohorts and " << events[0] << " without" << std::endl;
+                returnValue = false;
+            }
+        }
+    }
+    std::cout << "Test of the cohort engine " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
@@ -0,0 +1,201 @@
+//
+//  CohortEngine.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef CohortEngine_hpp
+#define CohortEngine_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "Simulation.hpp"
+#include "Plane.hpp"
+#include "RingBuffer.hpp"
+#include "EngineClock.hpp"
+
+/*
+ *******************************************************************************************
+ * class CohortEngine
+ * Planes of the same company that take off from the same site at the same second for the
+ * same destination land at the same second too, and from then on nothing tells them apart
+ * but their own random numbers. This engine keeps such planes together as a cohort: one
+ * flight event for all of them, one charger entry for the ones that get chargers together,
+ * one waiting entry for the ones that do not and one entry in the plane queue for the ones
+ * that are ready together. A cohort only splits when the chargers run out part way through
+ * it, or when the planes' own passenger delays or destinations differ, and planes ready at
+ * the same second at a site take off together in new cohorts. The flights and charges are
+ * added to the totals once per cohort, weighted by how many planes are in it.
+ *
+ * Otherwise it follows the FastEngine's rules: the same clock of flights, charger queues and
+ * plane queues with ties handled in the order they were scheduled, and the same close-out.
+ * A cohort holds its planes in the order the FastEngine would handle them, and it is only
+ * formed from planes the FastEngine would schedule one after another with nothing of theirs
+ * in between, so each plane has the same timeline as in the FastEngine. The counts are the
+ * same and only the passenger miles and averages may differ, in the last bits of rounding.
+ *
+ * Each plane still draws its own passengers, passenger delay, destination and faults, so
+ * the work per event grows with the planes in it, but the clock has one event per cohort
+ * instead of one per plane. A fault event would split its plane from its cohort part way
+ * through a flight, so it needs the faults counted when each flight ends (faultOption 0 and
+ * faultCountOption 1). It also needs first come, first served chargers, since the other
+ * policies choose between planes one at a time. Other settings run on the FastEngine.
+ *******************************************************************************************
+ */
+class CohortEngine {
+public:
+    // Where one cohort flight, charger queue or plane queue is in the clock. The sequence has
+    // 64 bits so it never has to be renumbered.
+    using ClockKey = EngineClockKey<uint64_t>;
+private:
+    // One scheduled event, as in the FastEngine
+    struct CohortEvent {
+        long time;
+        uint64_t sequence;
+        uint32_t kind;
+        long id;
+    };
+    // One plane: its random numbers and fault interval, and its passengers on this flight
+    struct CohortPlane {
+        std::shared_ptr<Plane> thePlane;
+        Company company;
+        long passengerCount;
+    };
+    // What every plane of a company shares
+    struct CompanyInfo {
+        double milesPerHour;
+        long timeOnFullCharge;
+        long timeToCharge;
+        long maxPassengers;
+    };
+    // Planes in flight together, all of the same company and between the same sites
+    struct CohortFlight {
+        long group;
+        Company company;
+        long startTime;
+        long endTime;
+        long originSite;
+        long destinationSite;
+    };
+    // Planes of one company that got chargers at the same time
+    struct CohortCharger {
+        long timeStarted;
+        long timeStartedIncludingWait;
+        long timeDone;
+        long sequence;
+        long group;
+    };
+    // Planes waiting for a charger, first come, first served. The ones before first have gone.
+    struct CohortWaiting {
+        long timeStarted;
+        long group;
+        size_t first;
+    };
+    // Planes taking off together in one plane queue event
+    struct StartingFlight {
+        Company company;
+        long destinationSite;
+        long group;
+    };
+    // Planes that are ready to take off at the same time
+    struct CohortReady {
+        long nextFlightTime;
+        long sequence;
+        long group;
+    };
+    // The chargers and planes at one site
+    struct CohortSite {
+        CountedVector<CohortCharger> chargers; // Min-heap on (timeDone, sequence)
+        long chargersInUse; // Planes on chargers, across all the entries
+        RingBuffer<CohortWaiting, CountingAllocator<CohortWaiting>> planesWaiting;
+        long nextChargerSequence;
+        long chargerNextTime;
+        CountedVector<CohortReady> planesReady; // Min-heap on (nextFlightTime, sequence)
+        long nextPlaneSequence;
+        long lastReadyGroup; // The last entry added to planesReady if it is still there, otherwise -1
+        long lastReadyTime; // When the planes in lastReadyGroup are ready
+        long planeQueueNextTime;
+    };
+
+    Simulation *theSimulation;
+    long endTime;
+    long chargerCount;
+    long maxPassengerDelay;
+    // These are counted in the Simulation's memory like the FastEngine's
+    CountedVector<CohortPlane> fleet;
+    CompanyInfo companies[companyCount];
+    std::vector<CohortSite> sites;
+    // Lists of planes. Each flight, charger, waiting or ready entry has one.
+    CountedVector<CountedVector<long>> groups;
+    CountedVector<long> freeGroups;
+    CountedVector<CohortFlight> flights;
+    CountedVector<long> freeFlights;
+    CountedVector<ClockKey> flightKeys; // Indexed like flights
+    CountedVector<ClockKey> chargerKeys; // Indexed by site
+    CountedVector<ClockKey> planeQueueKeys; // Indexed by site
+    CountedVector<CohortEvent> events; // Min-heap on (time, sequence)
+    CountedVector<StartingFlight> startingFlights; // Kept so each plane queue event does not allocate
+    uint64_t nextSequence;
+    long eventCount;
+    long flightEvents;
+    long flightPlanes; // Planes in all the flight events, for the note
+    std::string note;
+    FlightRecorder *theRecorder; // The Simulation's flight recorder
+
+    // What the flight recorder calls a flight (the number of its first plane) or a queue (its
+    // site), as FastEngine::record does. A flight's planes may be gone once it is handled, so
+    // this is looked up before.
+    long recorderIdFor(uint32_t kind, long id);
+
+    // A new empty list of planes, and give one back
+    long newGroup();
+    void freeGroup(long group);
+
+    ClockKey &keyFor(uint32_t kind, long id);
+    void schedule(uint32_t kind, long id, long time);
+    void reschedule(uint32_t kind, long id, long time);
+
+    // Handle one event. These return true if the queue stays in the clock.
+    bool dispatch(uint32_t kind, long id, long currentTime, bool closeOut);
+    bool handleFlight(long flight, long currentTime);
+    bool handleChargers(long site, long currentTime, bool closeOut);
+    bool handlePlaneQueue(long site, long currentTime, bool closeOut);
+    long nextTimeFor(uint32_t kind, long id);
+
+    // The FastEngine steps for a whole cohort. Each takes its planes from
+    // groups[group][first] on, in order.
+    void startFlight(long group, Company company, long currentTime, long originSite, long destinationSite);
+    void addToChargers(long site, long currentTime, long group);
+    void addChargers(long site, long currentTime, long startedWaiting, long group, size_t first, size_t count);
+    void addToPlaneQueue(long site, long delayUntil, long plane);
+    void logCharges(long site, const CohortCharger &aCharger, long currentTime);
+public:
+    CohortEngine(Simulation *theSimulation);
+
+    // True if the settings let this engine run at all (see above). A trace needs each plane's
+    // events and a memory budget needs the records counted as they are made, so both use
+    // the FastEngine. The memory this engine uses is still counted, so getMemory() and a
+    // runtime estimate see it.
+    static bool canRun(const SimSettings &someSettings, const SimTrace *aTrace);
+
+    // Create the planes for each site and run the simulation. It adds the results to the
+    // Simulation's totals and returns the final simulated time.
+    long run(const std::vector<std::vector<Company>> &siteCompanies);
+
+    // How many events were handled (not counting the close-out)
+    long getEventCount();
+
+    // How many planes the flight events held on average, or why it could not be used
+    const std::string &getNote();
+};
+
+// Run settings through the FastEngine and this engine and check that the results are the
+// same with fewer events, and that settings it cannot run use the FastEngine. It reports
+// errors to cout.
+bool testCohortEngine();
+
+#endif /* CohortEngine_hpp */
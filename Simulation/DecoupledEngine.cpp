@@ -0,0 +1,501 @@
+//
+//  DecoupledEngine.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "DecoupledEngine.hpp"
+#include "Passenger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+/*
+ *******************************************************************************************
+ * class DecoupledEngine
+ * When no plane ever waits for a charger, each plane is run on its own with the same rules
+ * as the FastEngine: in closed form if its timeline is a fixed cycle, otherwise by stepping
+ * through its flights, charges and waits for passengers. See DecoupledEngine.hpp.
+ *******************************************************************************************
+ */
+unsigned DecoupledEngine::threadCountOverride = 0;
+
+DecoupledEngine::DecoupledEngine(Simulation *theSimulation): theSimulation{theSimulation},
+theSettings{theSimulation->theSettings}, endTime{0}, siteCount{0}, keepCharges{false}, closedForm{false}, faultsAtEnd{false},
+fleet{}, blocks{}, eventCount{0}, note{} {
+}
+
+// A trace needs the events in time order, and a memory budget needs the records counted
+// as they are made, so both use the FastEngine
+bool DecoupledEngine::canRun(const SimSettings &someSettings, const SimTrace *aTrace) {
+    return aTrace == nullptr && someSettings.memoryBudgetMB <= 0;
+}
+
+// Add a flight to a block's totals, as Flight::recordFlight would log it
+void DecoupledEngine::addFlight(BlockResult &aBlock, const DecoupledPlane &aPlane, long duration, long passengerCount, long faultCount, long site) {
+    double passengerMiles = duration * passengerCount * aPlane.thePlane->getMilesPerHour();
+    passengerMiles /= secondsPerHourD;
+    aBlock.totals.addFlight(FlightStats{aPlane.company, aPlane.thePlane->getPlaneNumber(), duration,
+        passengerCount, faultCount, passengerMiles, site});
+}
+
+// Add a charge to a block's totals. No plane waits, so the time with the wait is the same.
+void DecoupledEngine::addCharge(BlockResult &aBlock, const DecoupledPlane &aPlane, long duration, long site) {
+    aBlock.totals.addCharge(ChargerStats{aPlane.company, aPlane.thePlane->getPlaneNumber(), duration, duration, site});
+}
+
+// Note a charge that is done at timeDone in a block's SiteAtEnd for its site
+void DecoupledEngine::noteCharge(BlockResult &aBlock, long site, long timeStarted, long timeDone) {
+    SiteAtEnd &aSite = aBlock.sitesAtEnd[site];
+    if(timeDone < endTime) {
+        aSite.lastDone = std::max(aSite.lastDone, timeDone);
+    } else if(timeDone < aSite.firstDone || (timeDone == aSite.firstDone && timeStarted < aSite.firstDoneStarted)) {
+        aSite.firstDone = timeDone;
+        aSite.firstDoneStarted = timeStarted;
+    }
+}
+
+// Work out the complete cycles of a plane with a fixed cycle that is ready to fly at
+// readyTime, and return when it is ready for the first flight after them. A cycle is
+// complete if its charge is done before the end of the run. The faults are counted by
+// walking the fault intervals over the plane's total flight time, since faults that are
+// only counted do not change the timeline.
+long DecoupledEngine::runCycles(const DecoupledPlane &aPlane, BlockResult &aBlock, long readyTime) {
+    Plane &thePlane = *aPlane.thePlane;
+    long timeOnFullCharge = thePlane.calcTimeOnFullCharge__seconds();
+    long timeToCharge = thePlane.calcTimeToCharge__seconds();
+    long cycleTime = timeOnFullCharge + timeToCharge;
+    if(timeOnFullCharge <= 0 || timeToCharge <= 0 || readyTime >= endTime) {
+        return readyTime;
+    }
+    long cycles = (endTime - readyTime - 1) / cycleTime;
+    if(cycles <= 0) {
+        return readyTime;
+    }
+    // Each fault interval starts where the last one ended, in flight time. A fault at the
+    // end of a flight is handled with the end of the flight, so it is not an event of its own.
+    long flown = cycles * timeOnFullCharge;
+    long nextFault = thePlane.getNextFaultInterval();
+    long faultCount = 0;
+    long faultEvents = 0;
+    while(nextFault <= flown) {
+        faultCount++;
+        if(!faultsAtEnd && nextFault % timeOnFullCharge != 0) { faultEvents++; }
+        nextFault += thePlane.createFaultInterval();
+    }
+    // Leave the part of the fault interval that was not flown for the next flight
+    thePlane.decrementNextFaultInterval(thePlane.getNextFaultInterval() - (nextFault - flown));
+
+    long maxPassengers = thePlane.getMaxPassengerCount();
+    double passengerMiles = timeOnFullCharge * maxPassengers * thePlane.getMilesPerHour();
+    passengerMiles /= secondsPerHourD;
+    aBlock.totals.addFlight(FlightStats{aPlane.company, thePlane.getPlaneNumber(), flown, cycles * maxPassengers,
+        faultCount, passengerMiles * cycles, aPlane.homeSite}, cycles);
+    aBlock.totals.addCharge(ChargerStats{aPlane.company, thePlane.getPlaneNumber(), cycles * timeToCharge,
+        cycles * timeToCharge, aPlane.homeSite}, cycles);
+    noteCharge(aBlock, aPlane.homeSite, readyTime + cycles * cycleTime - timeToCharge, readyTime + cycles * cycleTime);
+    aBlock.kindEvents[profilePlaneQueue] += cycles;
+    aBlock.kindEvents[profileFlight] += cycles + faultEvents;
+    aBlock.kindEvents[profileChargerQueue] += cycles;
+    aBlock.closedFormPlanes++;
+    return readyTime + cycles * cycleTime;
+}
+
+// Follow one plane's timeline to the end of the run. Each step is what the FastEngine's
+// handlePlaneQueue, handleFlight and handleChargers do for this plane, and the end is what
+// its close-out does.
+void DecoupledEngine::runPlane(const DecoupledPlane &aPlane, BlockResult &aBlock) {
+    Plane &thePlane = *aPlane.thePlane;
+    SimRandom &random = thePlane.getRandom();
+    long maxPassengerDelay = theSettings->maxPassengerDelay;
+    int faultOption = theSettings->faultOption;
+    long timeOnFullCharge = thePlane.calcTimeOnFullCharge__seconds();
+    long timeToCharge = thePlane.calcTimeToCharge__seconds();
+    long maxPassengers = thePlane.getMaxPassengerCount();
+    long site = aPlane.homeSite;
+
+    // The first wait for passengers, drawn when the plane is made
+    long readyTime = Passenger::getPassengerDelay(maxPassengerDelay, random);
+    if(closedForm) {
+        readyTime = runCycles(aPlane, aBlock, readyTime);
+    }
+    // A plane still waiting for passengers at the end is not logged
+    while(readyTime < endTime) {
+        // The passengers and destination come from the plane's own random numbers, in that order
+        aBlock.kindEvents[profilePlaneQueue]++;
+        long passengerCount = Passenger::getPassengerCount(maxPassengers, theSettings, random);
+        long destinationSite = theSimulation->pickDestinationSite(site, random);
+        long startTime = readyTime;
+        long flightEnd = startTime + timeOnFullCharge;
+        long nextFaultTime = faultsAtEnd ? LONG_MAX : startTime + thePlane.getNextFaultInterval();
+        long faultCount = 0;
+        long scheduledAt = startTime;
+        while(true) {
+            // The flight is closed out at the end of the run if it is waiting for a later time
+            long keyTime = std::min(flightEnd, nextFaultTime);
+            bool closeOut = keyTime >= endTime;
+            long currentTime = closeOut ? endTime : keyTime;
+            if(!closeOut) {
+                aBlock.kindEvents[profileFlight]++;
+            }
+            if(currentTime == nextFaultTime) {
+                faultCount++;
+                nextFaultTime = currentTime + thePlane.createFaultInterval();
+                if(faultOption == 1) {
+                    // The fault grounds the plane immediately. The flight is logged to its planned end.
+                    addFlight(aBlock, aPlane, flightEnd - startTime, passengerCount, faultCount, site);
+                    return;
+                }
+                if(std::min(flightEnd, nextFaultTime) > currentTime) {
+                    if(closeOut) {
+                        // Still in the air at the end, so it is not logged
+                        return;
+                    }
+                    scheduledAt = currentTime;
+                    continue;
+                }
+            }
+            // Finish the flight, using up the part of the fault interval that was flown
+            if(faultsAtEnd) {
+                faultCount = thePlane.countFaults(currentTime - startTime);
+            } else {
+                long startOfCurrentFaultInterval = nextFaultTime - thePlane.getNextFaultInterval();
+                thePlane.decrementNextFaultInterval(currentTime - startOfCurrentFaultInterval);
+            }
+            addFlight(aBlock, aPlane, currentTime - startTime, passengerCount, faultCount, site);
+            if(faultOption == 2 && faultCount > 0) {
+                return;
+            }
+            site = destinationSite;
+            if(closeOut) {
+                // Cut off by the end of the run. Whether its 0 second charge is logged depends on the other planes.
+                aBlock.cutOffFlights.push_back(CutOffFlight{site, aPlane.company, keyTime, scheduledAt});
+                if(keepCharges) {
+                    aBlock.charges.push_back(ChargeInterval{site, endTime, endTime});
+                }
+                return;
+            }
+            readyTime = currentTime;
+            break;
+        }
+        // No plane waits, so the charge starts as soon as the plane lands
+        long chargeDone = readyTime + timeToCharge;
+        if(keepCharges) {
+            aBlock.charges.push_back(ChargeInterval{site, readyTime, chargeDone});
+        }
+        noteCharge(aBlock, site, readyTime, chargeDone);
+        if(chargeDone >= endTime) {
+            // Still charging at the end, so the close-out logs it cut off
+            addCharge(aBlock, aPlane, endTime - readyTime, site);
+            return;
+        }
+        aBlock.kindEvents[profileChargerQueue]++;
+        addCharge(aBlock, aPlane, timeToCharge, site);
+        readyTime = chargeDone + Passenger::getPassengerDelay(maxPassengerDelay, random);
+    }
+}
+
+// Run the blocks from nextBlock on until there are none left (one thread does this).
+// Each block only touches its own planes and its own BlockResult.
+void DecoupledEngine::runBlocks(std::atomic<long> &nextBlock) {
+    long blockCount = static_cast<long>(blocks.size());
+    long fleetSize = static_cast<long>(fleet.size());
+    for(long block = nextBlock++; block < blockCount; block = nextBlock++) {
+        long last = std::min(fleetSize, (block + 1) * blockSize);
+        for(long plane = block * blockSize; plane < last; plane++) {
+            runPlane(fleet[plane], blocks[block]);
+        }
+    }
+}
+
+// True if some site had more planes on chargers at once than it has chargers. A charge that
+// starts at the moment another is done counts as overlapping it, since which one the
+// FastEngine handles first depends on the order they were scheduled. The kept charges are
+// freed as they are sorted by site.
+bool DecoupledEngine::chargersContended(long &site, long &time) {
+    long chargerCount = theSettings->chargerCount;
+    std::vector<std::vector<long>> starts(siteCount), dones(siteCount);
+    for(BlockResult &aBlock: blocks) {
+        for(const ChargeInterval &aCharge: aBlock.charges) {
+            starts[aCharge.site].push_back(aCharge.timeStarted);
+            dones[aCharge.site].push_back(aCharge.timeDone);
+        }
+        std::vector<ChargeInterval>().swap(aBlock.charges);
+    }
+    for(site = 0; site < siteCount; site++) {
+        std::sort(begin(starts[site]), end(starts[site]));
+        std::sort(begin(dones[site]), end(dones[site]));
+        // The charges on at a start are those started by then less those done before it
+        size_t doneBefore = 0;
+        for(size_t started = 0; started < starts[site].size(); started++) {
+            time = starts[site][started];
+            while(doneBefore < dones[site].size() && dones[site][doneBefore] < time) {
+                doneBefore++;
+            }
+            if(static_cast<long>(started + 1 - doneBefore) > chargerCount) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Create the planes for each site and run each of them to the end
+long DecoupledEngine::run(const std::vector<std::vector<Company>> &siteCompanies) {
+    endTime = theSettings->simulationDuration;
+    siteCount = static_cast<long>(siteCompanies.size());
+    bool planesMove = theSettings->siteFlightOption == 1 && siteCount >= 2;
+    // A site is never short of chargers if it has at least as many as the planes that can land there
+    long mostPlanesAtASite = 0;
+    for(const std::vector<Company> &companies: siteCompanies) {
+        mostPlanesAtASite = std::max(mostPlanesAtASite, planesMove ? theSettings->planeCount : static_cast<long>(companies.size()));
+    }
+    keepCharges = mostPlanesAtASite > theSettings->chargerCount;
+    faultsAtEnd = theSettings->faultOption == 0 && theSettings->faultCountOption == 1;
+    closedForm = !keepCharges && theSettings->maxPassengerDelay <= 0 && theSettings->passengerCountOption == 0 &&
+        theSettings->faultOption == 0 && !planesMove;
+
+    // Create the planes in the same order as PlaneQueue::generatePlanes so each gets the same random numbers
+    for(long site = 0; site < siteCount; site++) {
+        for(Company c: siteCompanies[site]) {
+            fleet.push_back(DecoupledPlane{theSimulation->makePlane(c), c, site});
+        }
+    }
+    long blockCount = (static_cast<long>(fleet.size()) + blockSize - 1) / blockSize;
+    blocks.resize(blockCount);
+    for(BlockResult &aBlock: blocks) {
+        aBlock.totals.reset(siteCount);
+        aBlock.sitesAtEnd.assign(siteCount, SiteAtEnd{-1, LONG_MAX, LONG_MAX});
+        std::fill(aBlock.kindEvents, aBlock.kindEvents + profileKindCount, 0L);
+        aBlock.closedFormPlanes = 0;
+    }
+
+    // Run the blocks on as many threads as there are cores (and blocks)
+    auto loopStartTimer = std::chrono::high_resolution_clock::now();
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    if(threadCountOverride > 0) { threadCount = threadCountOverride; }
+    threadCount = static_cast<unsigned>(std::min<long>(threadCount, std::max(1L, blockCount)));
+    std::atomic<long> nextBlock{0};
+    std::vector<std::thread> threads{};
+    for(unsigned thread = 1; thread < threadCount; thread++) {
+        threads.emplace_back(&DecoupledEngine::runBlocks, this, std::ref(nextBlock));
+    }
+    runBlocks(nextBlock);
+    for(std::thread &aThread: threads) {
+        aThread.join();
+    }
+
+    // Check the kept charges. They are counted as queue memory while they are checked.
+    if(keepCharges) {
+        long bytes = 0;
+        for(const BlockResult &aBlock: blocks) {
+            bytes += static_cast<long>(aBlock.charges.capacity() * sizeof(ChargeInterval));
+        }
+        theSimulation->theMemory.allocated(memoryQueues, bytes);
+        long site{0}, time{0};
+        bool contended = chargersContended(site, time);
+        theSimulation->theMemory.released(memoryQueues, bytes);
+        if(contended) {
+            note = "a plane would wait for a charger at site " + std::to_string(site) + " at " + std::to_string(time) +
+                " seconds, so the FastEngine ran it";
+            return -1;
+        }
+    }
+
+    // Add up the blocks in order. A cut off flight's 0 second charge is logged if its site's
+    // charger queue is closed out after it. The close-out goes latest first, so that is when
+    // the queue is waiting for an earlier time, or the same time and it was put in the clock
+    // first. It was last put there at the last charge done before the end, or when the first
+    // charge to be done after the end started, whichever was later.
+    std::vector<SiteAtEnd> sitesAtEnd(siteCount, SiteAtEnd{-1, LONG_MAX, LONG_MAX});
+    for(const BlockResult &aBlock: blocks) {
+        for(long site = 0; site < siteCount; site++) {
+            const SiteAtEnd &blockSite = aBlock.sitesAtEnd[site];
+            SiteAtEnd &aSite = sitesAtEnd[site];
+            aSite.lastDone = std::max(aSite.lastDone, blockSite.lastDone);
+            if(blockSite.firstDone < aSite.firstDone || (blockSite.firstDone == aSite.firstDone && blockSite.firstDoneStarted < aSite.firstDoneStarted)) {
+                aSite.firstDone = blockSite.firstDone;
+                aSite.firstDoneStarted = blockSite.firstDoneStarted;
+            }
+        }
+    }
+    StatsTotals &theTotals = theSimulation->theTotals;
+    long closedFormPlanes = 0;
+    long kindEvents[profileKindCount]{};
+    for(const BlockResult &aBlock: blocks) {
+        theTotals.add(aBlock.totals);
+        for(const CutOffFlight &aFlight: aBlock.cutOffFlights) {
+            const SiteAtEnd &aSite = sitesAtEnd[aFlight.site];
+            if(aSite.firstDone < aFlight.keyTime ||
+               (aSite.firstDone == aFlight.keyTime && std::max(aSite.lastDone, aSite.firstDoneStarted) <= aFlight.scheduledAt)) {
+                theTotals.addCharge(ChargerStats{aFlight.company, 0, 0, 0, aFlight.site});
+            }
+        }
+        for(int kind = 0; kind < profileKindCount; kind++) {
+            kindEvents[kind] += aBlock.kindEvents[kind];
+        }
+        closedFormPlanes += aBlock.closedFormPlanes;
+    }
+    eventCount = 0;
+    for(int kind = 0; kind < profileKindCount; kind++) {
+        eventCount += kindEvents[kind];
+    }
+    note = "decoupled, " + std::to_string(fleet.size()) + " planes on " + std::to_string(threadCount) + " threads";
+    if(closedForm) {
+        note += ", " + std::to_string(closedFormPlanes) + " of them in closed form";
+    }
+
+#if SIMPROFILE
+    SimProfile &theProfile = theSimulation->theProfile;
+    if(theProfile.enabled) {
+        // There is no clock, so only the events and the time are counted
+        for(int kind = 0; kind < profileKindCount; kind++) {
+            theProfile.kinds[kind].events = kindEvents[kind];
+        }
+        theProfile.eventLoopSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loopStartTimer).count();
+        if(theProfile.countersRequested) {
+            theProfile.countersNote = "the decoupled engine runs the planes on several threads";
+        }
+    }
+#endif
+    return endTime;
+}
+
+// How many events the planes had (not counting the close-out)
+long DecoupledEngine::getEventCount() {
+    return eventCount;
+}
+
+// What the engine did (how many planes in closed form, or why it could not be used)
+const std::string &DecoupledEngine::getNote() {
+    return note;
+}
+
+// The counts must match exactly. The averages and passenger miles are added up in a
+// different order, so they may differ in the last bits.
+static bool closeValue(double a, double b) {
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+}
+static bool closeResults(const std::vector<FinalStats> &a, const std::vector<FinalStats> &b) {
+    if(a.size() != b.size()) { return false; }
+    for(size_t i = 0; i < a.size(); i++) {
+        if(a[i].theCompany != b[i].theCompany || a[i].totalFlights != b[i].totalFlights ||
+           a[i].totalCharges != b[i].totalCharges || a[i].totalFaults != b[i].totalFaults ||
+           !closeValue(a[i].averageTimePerFlight, b[i].averageTimePerFlight) ||
+           !closeValue(a[i].averageDistancePerFlight, b[i].averageDistancePerFlight) ||
+           !closeValue(a[i].averageTimeCharging, b[i].averageTimeCharging) ||
+           !closeValue(a[i].averageTimeChargingWithWait, b[i].averageTimeChargingWithWait) ||
+           !closeValue(a[i].totalPassengerMiles, b[i].totalPassengerMiles)) {
+            return false;
+        }
+    }
+    return true;
+}
+// Exactly the same, for runs that should have added the same numbers in the same order
+static bool identicalResults(const std::vector<FinalStats> &a, const std::vector<FinalStats> &b) {
+    if(a.size() != b.size()) { return false; }
+    for(size_t i = 0; i < a.size(); i++) {
+        if(a[i].totalFlights != b[i].totalFlights || a[i].totalCharges != b[i].totalCharges || a[i].totalFaults != b[i].totalFaults ||
+           a[i].averageTimePerFlight != b[i].averageTimePerFlight || a[i].averageDistancePerFlight != b[i].averageDistancePerFlight ||
+           a[i].averageTimeCharging != b[i].averageTimeCharging || a[i].totalPassengerMiles != b[i].totalPassengerMiles) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run uncontended settings through the FastEngine and this engine and check that the results
+// are the same, that contended settings fall back to the FastEngine, and that the number of
+// threads does not change anything. It reports errors to cout.
+bool testDecoupledEngine() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of the decoupled engine *****" << std::endl;
+    struct TestCase {
+        const char *description;
+        long hours, planes, chargers, sites;
+        int faultOption, passengerCountOption, siteFlightOption;
+        long maxPassengerDelay;
+        const char *expected; // Part of the engine note the run should give
+    };
+    const TestCase testCases[]{
+        {"fixed cycle", 1000, 50, 50, 1, 0, 0, 0, 0, "closed form"},
+        {"random passengers and delays", 300, 20, 20, 1, 0, 1, 0, 600, "decoupled"},
+        {"ground immediately", 300, 20, 20, 1, 1, 0, 0, 600, "decoupled"},
+        {"ground after flight", 300, 20, 20, 1, 2, 1, 0, 600, "decoupled"},
+        {"sites, fly between", 300, 30, 30, 3, 0, 1, 1, 1800, "decoupled"},
+        {"sites, return home", 300, 20, 10, 2, 0, 0, 0, 0, "closed form"},
+        {"more planes than chargers", 300, 40, 30, 1, 0, 1, 0, 3 * secondsPerHour, ""},
+        {"contended", 300, 20, 3, 1, 0, 0, 0, 0, "FastEngine"},
+    };
+    const long seeds[]{1, 12345};
+    for(const TestCase &aCase: testCases) {
+        for(long seed: seeds) {
+            SimSettings settings{};
+            settings.simulationDuration = aCase.hours * secondsPerHour;
+            settings.planeCount = aCase.planes;
+            settings.chargerCount = aCase.chargers;
+            settings.siteCount = aCase.sites;
+            settings.faultOption = aCase.faultOption;
+            settings.passengerCountOption = aCase.passengerCountOption;
+            settings.siteFlightOption = aCase.siteFlightOption;
+            settings.maxPassengerDelay = aCase.maxPassengerDelay;
+            settings.randomSeed = seed;
+            settings.progressInterval = 0;
+            std::vector<FinalStats> results[2];
+            std::vector<std::vector<FinalStats>> siteResults[2];
+            std::string engineNote;
+            for(int engine = 0; engine < 2; engine++) {
+                settings.engineOption = engine + 1;
+                Simulation aSimulation(settings);
+                aSimulation.setQuiet(true);
+                results[engine] = aSimulation.run(false);
+                siteResults[engine] = aSimulation.getSiteResults();
+                engineNote = aSimulation.getEngineNote();
+            }
+            // A run that fell back to the FastEngine made its planes again from the same
+            // streams, so it is exactly the FastEngine's run
+            bool fellBack = engineNote.find("FastEngine") != std::string::npos;
+            bool same = fellBack ? identicalResults(results[0], results[1]) : closeResults(results[0], results[1]);
+            for(size_t site = 0; same && site < siteResults[0].size(); site++) {
+                same = fellBack ? identicalResults(siteResults[0][site], siteResults[1][site]) : closeResults(siteResults[0][site], siteResults[1][site]);
+            }
+            if(!same || engineNote.find(aCase.expected) == std::string::npos) {
+                std::cout << "***** error: " << aCase.description << " with seed " << seed << " (" << engineNote
+                << ") does not match the FastEngine" << std::endl;
+                returnValue = false;
+            }
+        }
+    }
+
+    // More planes than one block, with one thread and with all of them
+    SimSettings settings{};
+    settings.simulationDuration = 100 * secondsPerHour;
+    settings.planeCount = 3 * DecoupledEngine::blockSize + 5;
+    settings.chargerCount = settings.planeCount;
+    settings.siteCount = 3;
+    settings.siteFlightOption = 1;
+    settings.passengerCountOption = 1;
+    settings.maxPassengerDelay = secondsPerHour;
+    settings.randomSeed = 7;
+    settings.progressInterval = 0;
+    settings.engineOption = 2;
+    std::vector<FinalStats> threadResults[2];
+    long threadEvents[2]{};
+    for(int run = 0; run < 2; run++) {
+        DecoupledEngine::threadCountOverride = run == 0 ? 1 : 4;
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        threadResults[run] = aSimulation.run(false);
+        threadEvents[run] = aSimulation.getEventCount();
+    }
+    DecoupledEngine::threadCountOverride = 0;
+    if(!identicalResults(threadResults[0], threadResults[1]) || threadEvents[0] != threadEvents[1]) {
+        std::cout << "***** error: the results depend on the number of threads" << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of the decoupled engine " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
@@ -0,0 +1,147 @@
+//
+//  DecoupledEngine.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef DecoupledEngine_hpp
+#define DecoupledEngine_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include "Simulation.hpp"
+#include "Plane.hpp"
+
+/*
+ *******************************************************************************************
+ * class DecoupledEngine
+ * When a plane never has to wait for a charger, nothing one plane does changes what any
+ * other plane does. Each plane just goes round flight, charge, wait for passengers on its
+ * own, and all of its random numbers come from its own stream. Then a shared clock is pure
+ * overhead, so this engine follows each plane's timeline on its own instead, with the same
+ * rules as the FastEngine. The planes are split into fixed blocks which are run in parallel,
+ * one thread per core, and the blocks' totals are added up in block order so the results
+ * do not depend on how many threads there were.
+ *
+ * With no passenger delay, full planes, faults that are only counted and flights back to
+ * the same site, a plane's timeline is a fixed cycle. Then the complete cycles are worked
+ * out in closed form and only the faults (which still come from the plane's own stream)
+ * and the last part cycle are stepped through.
+ *
+ * A site is provably never short of chargers if it has at least as many chargers as planes
+ * that can land there. Otherwise each charge is kept and, after all the planes have run,
+ * checked: if any site ever had more planes charging (or starting or finishing a charge)
+ * at the same moment than it has chargers, someone would have waited and the run is done
+ * again with the FastEngine. So the results are always those of a run where no plane waits.
+ *
+ * The results match the FastEngine's except for the last bit of rounding (the totals are
+ * added in a different order) and one tie at the end. A flight that is cut off by the end
+ * of the run adds a charge of 0 seconds, which the FastEngine only logs if that site's
+ * charger queue is closed out after the flight: if the queue is waiting for an earlier time,
+ * or the same time and it was scheduled first. Each block notes what it needs to work out
+ * when each site's queue was scheduled, but if the queue and the flight were both scheduled
+ * at the same second, which was first depends on the other events then, and the charge is
+ * logged. The event count is the sum of each plane's own events, so events at a site at the
+ * same second that the FastEngine handles together are counted separately. With many
+ * planes at a site that can be several times the FastEngine's count.
+ *******************************************************************************************
+ */
+class DecoupledEngine {
+public:
+    // How many threads to use, or 0 for one per core. Tests set this to check that the
+    // number of threads does not change the results.
+    static unsigned threadCountOverride;
+    // How many planes are in each block of work
+    static const long blockSize{1024};
+private:
+    // One plane and what it needs to follow its timeline
+    struct DecoupledPlane {
+        std::shared_ptr<Plane> thePlane; // For the plane's random numbers and fault interval
+        Company company;
+        long homeSite;
+    };
+    // A charge, kept to check that no site ever needs more chargers than it has
+    struct ChargeInterval {
+        long site;
+        long timeStarted;
+        long timeDone;
+    };
+    // A flight cut off by the end of the run. It adds a 0 second charge at its destination.
+    struct CutOffFlight {
+        long site;
+        Company company;
+        long keyTime; // The time the flight was waiting for when the run ended
+        long scheduledAt; // When it was last put in the clock (its start or its last fault)
+    };
+    // What decides when a site's charger queue was last put in the clock before the end: the
+    // last charge done before the end, and the first charge to be done after it
+    struct SiteAtEnd {
+        long lastDone; // -1 if no charge was done before the end
+        long firstDone; // LONG_MAX if nothing was charging at the end
+        long firstDoneStarted; // When the first of the charges done at firstDone started
+    };
+    // Everything one block of planes produces
+    struct BlockResult {
+        StatsTotals totals;
+        std::vector<ChargeInterval> charges;
+        std::vector<CutOffFlight> cutOffFlights;
+        std::vector<SiteAtEnd> sitesAtEnd; // By site
+        long kindEvents[profileKindCount]; // The events each kind of handler would have had
+        long closedFormPlanes;
+    };
+
+    Simulation *theSimulation;
+    std::shared_ptr<SimSettings> theSettings;
+    long endTime;
+    long siteCount;
+    bool keepCharges; // False if every site has been shown to have enough chargers
+    bool closedForm; // True if every plane's timeline is a fixed cycle
+    bool faultsAtEnd; // Faults are counted when each flight ends (SimSettings::faultCountOption)
+    std::vector<DecoupledPlane> fleet;
+    std::vector<BlockResult> blocks;
+    long eventCount;
+    std::string note;
+
+    // Follow one plane's timeline to the end of the run
+    void runPlane(const DecoupledPlane &aPlane, BlockResult &aBlock);
+    // Work out the complete cycles of a plane with a fixed cycle that is ready to fly at
+    // readyTime, and return when it is ready for the first flight after them
+    long runCycles(const DecoupledPlane &aPlane, BlockResult &aBlock, long readyTime);
+    // Note a charge that is done at timeDone in a block's SiteAtEnd for its site
+    void noteCharge(BlockResult &aBlock, long site, long timeStarted, long timeDone);
+    // Add a flight or charge to a block's totals
+    void addFlight(BlockResult &aBlock, const DecoupledPlane &aPlane, long duration, long passengerCount, long faultCount, long site);
+    void addCharge(BlockResult &aBlock, const DecoupledPlane &aPlane, long duration, long site);
+    // Run the blocks from nextBlock on until there are none left (one thread does this)
+    void runBlocks(std::atomic<long> &nextBlock);
+    // True if some site had more planes on chargers at once than it has chargers
+    bool chargersContended(long &site, long &time);
+public:
+    DecoupledEngine(Simulation *theSimulation);
+
+    // True if the settings let this engine run at all. A trace needs the events in time order,
+    // and a memory budget needs the records counted as they are made, so both use the FastEngine.
+    static bool canRun(const SimSettings &someSettings, const SimTrace *aTrace);
+
+    // Create the planes for each site and run each of them to the end. It adds the results to
+    // the Simulation's totals and returns the final simulated time, or it returns -1 if the
+    // chargers would have been contended, having added nothing, so the run must be done again.
+    long run(const std::vector<std::vector<Company>> &siteCompanies);
+
+    // How many events the planes had (not counting the close-out)
+    long getEventCount();
+
+    // What the engine did (how many planes in closed form, or why it could not be used)
+    const std::string &getNote();
+};
+
+// Run uncontended settings through the FastEngine and this engine and check that the results
+// are the same, that contended settings fall back to the FastEngine, and that the number of
+// threads does not change anything. It reports errors to cout.
+bool testDecoupledEngine();
+
+#endif /* DecoupledEngine_hpp */
@@ -0,0 +1,325 @@
+//
+//  DifferentialTest.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "DifferentialTest.hpp"
+#include "Simulation.hpp"
+#include "SimTrace.hpp"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+
+/*
+ *******************************************************************************************
+ * Differential testing
+ * Runs randomized seeded scenarios through the reference SimClock and through each
+ * alternative engine and compares everything they produce. The trace of a run lists every
+ * flight, wait, charge and grounding in the order they happened with their times, so two
+ * runs with the same trace did the same things at the same times. A mismatch is shrunk to
+ * the simplest scenario that still fails so it is easy to debug.
+ *******************************************************************************************
+ */
+
+// Use the FastEngine
+static void selectFastEngine(SimSettings &settings) {
+    settings.engineOption = 1;
+}
+
+// The implementations checked against the reference
+const std::vector<DifferentialEngine> &differentialEngines() {
+    static const std::vector<DifferentialEngine> engines {
+        DifferentialEngine{"FastEngine", &selectFastEngine},
+    };
+    return engines;
+}
+
+// The SimSettings for a run of this scenario
+SimSettings DifferentialScenario::makeSettings() const {
+    SimSettings settings{};
+    settings.simulationDuration = simulationDuration;
+    settings.planeCount = planeCount;
+    settings.chargerCount = chargerCount;
+    settings.siteCount = siteCount;
+    settings.siteFlightOption = siteFlightOption;
+    settings.minPlanePerKind = minPlanePerKind;
+    settings.passengerCountOption = passengerCountOption;
+    settings.maxPassengerDelay = maxPassengerDelay;
+    settings.faultOption = faultOption;
+    settings.faultCountOption = faultCountOption;
+    settings.chargerPolicyOption = chargerPolicyOption;
+    for(auto c: allCompany) {
+        settings.companyPriority[c] = companyPriority[c];
+    }
+    settings.randomSeed = randomSeed;
+    settings.progressInterval = 0;
+    return settings;
+}
+
+// One line describing the scenario
+std::string DifferentialScenario::describe() const {
+    std::stringstream description;
+    description << "duration " << simulationDuration << " s, " << planeCount << " planes, " << chargerCount << " chargers, "
+    << siteCount << " sites, site flight option " << siteFlightOption << ", min per kind " << minPlanePerKind
+    << ", passenger count option " << passengerCountOption << ", max passenger delay " << maxPassengerDelay
+    << ", fault option " << faultOption << ", fault count option " << faultCountOption << ", charger policy " << chargerPolicyOption;
+    if(chargerPolicyOption == chargerPolicyCompanyPriority) {
+        description << " (priorities";
+        for(auto c: allCompany) {
+            description << " " << companyPriority[c];
+        }
+        description << ")";
+    }
+    description << ", seed " << randomSeed;
+    return description.str();
+}
+
+// Make a random scenario. Most are a day or so with a few dozen planes, with enough longer
+// and odd ones (no chargers, one plane, many sites) to reach the corners.
+DifferentialScenario randomScenario(SimRandom &random) {
+    DifferentialScenario aScenario{};
+    long lengthChoice = random.uniformLong(0, 19);
+    long hours = lengthChoice < 14 ? random.uniformLong(1, 30) : (lengthChoice < 19 ? random.uniformLong(30, 300) : random.uniformLong(300, 1000));
+    aScenario.simulationDuration = hours * secondsPerHour - random.uniformLong(0, secondsPerHour - 1);
+    aScenario.planeCount = random.uniformLong(0, 9) == 0 ? random.uniformLong(1, 5) : random.uniformLong(5, 60);
+    aScenario.chargerCount = random.uniformLong(0, 19) == 0 ? 0 : random.uniformLong(1, 8);
+    aScenario.siteCount = random.uniformLong(1, 4);
+    aScenario.siteFlightOption = static_cast<int>(random.uniformLong(0, 1));
+    aScenario.minPlanePerKind = random.uniformLong(0, aScenario.planeCount / companyCount);
+    aScenario.passengerCountOption = static_cast<int>(random.uniformLong(0, 1));
+    aScenario.maxPassengerDelay = random.uniformLong(0, 1) == 0 ? 0 : random.uniformLong(1, secondsPerHour);
+    aScenario.faultOption = static_cast<int>(random.uniformLong(0, 2));
+    aScenario.faultCountOption = static_cast<int>(random.uniformLong(0, 1));
+    aScenario.chargerPolicyOption = static_cast<int>(random.uniformLong(0, chargerPolicyOptionCount - 1));
+    for(auto c: allCompany) {
+        aScenario.companyPriority[c] = static_cast<int>(random.uniformLong(0, companyCount - 1));
+    }
+    aScenario.randomSeed = random.uniformLong(1, LONG_MAX >> 1);
+    return aScenario;
+}
+
+// Everything a run produces that the engines must agree on
+struct DifferentialRun {
+    std::vector<FinalStats> results;
+    std::vector<std::vector<FinalStats>> siteResults;
+    long eventCount;
+    std::string trace;
+};
+static DifferentialRun runScenario(const SimSettings &settings) {
+    DifferentialRun aRun{};
+    SimTrace aTrace;
+    Simulation aSimulation(settings);
+    aSimulation.setQuiet(true);
+    aSimulation.setTrace(&aTrace);
+    aRun.results = aSimulation.run(false);
+    aRun.siteResults = aSimulation.getSiteResults();
+    aRun.eventCount = aSimulation.getEventCount();
+    aTrace.close();
+    aRun.trace = aTrace.getText();
+    return aRun;
+}
+
+// Describe the first difference between two sets of results, or return an empty string.
+// The engines add up the same numbers in the same order, so the values must be exactly equal.
+static std::string compareResults(const std::vector<FinalStats> &a, const std::vector<FinalStats> &b, const std::string &what) {
+    if(a.size() != b.size()) {
+        return what + " have " + std::to_string(a.size()) + " rows and " + std::to_string(b.size());
+    }
+    for(size_t i = 0; i < a.size(); i++) {
+        std::stringstream difference;
+        const FinalStats &x = a[i];
+        const FinalStats &y = b[i];
+        if(x.theCompany != y.theCompany) {
+            difference << "company " << x.theCompany << " vs " << y.theCompany;
+        } else if(x.totalFlights != y.totalFlights) {
+            difference << "flights " << x.totalFlights << " vs " << y.totalFlights;
+        } else if(x.averageTimePerFlight != y.averageTimePerFlight) {
+            difference << "average flight time " << x.averageTimePerFlight << " vs " << y.averageTimePerFlight;
+        } else if(x.averageDistancePerFlight != y.averageDistancePerFlight) {
+            difference << "average distance " << x.averageDistancePerFlight << " vs " << y.averageDistancePerFlight;
+        } else if(x.totalCharges != y.totalCharges) {
+            difference << "charges " << x.totalCharges << " vs " << y.totalCharges;
+        } else if(x.averageTimeCharging != y.averageTimeCharging) {
+            difference << "average charge time " << x.averageTimeCharging << " vs " << y.averageTimeCharging;
+        } else if(x.averageTimeChargingWithWait != y.averageTimeChargingWithWait) {
+            difference << "average charge time with wait " << x.averageTimeChargingWithWait << " vs " << y.averageTimeChargingWithWait;
+        } else if(x.totalFaults != y.totalFaults) {
+            difference << "faults " << x.totalFaults << " vs " << y.totalFaults;
+        } else if(x.totalPassengerMiles != y.totalPassengerMiles) {
+            difference << "passenger miles " << x.totalPassengerMiles << " vs " << y.totalPassengerMiles;
+        }
+        if(!difference.str().empty()) {
+            return what + " for " + companyName(x.theCompany) + " differ: " + difference.str();
+        }
+    }
+    return "";
+}
+
+// Describe the first line that differs between two traces, or return an empty string
+static std::string compareTraces(const std::string &a, const std::string &b) {
+    if(a == b) {
+        return "";
+    }
+    size_t at = 0;
+    long line = 1;
+    while(at < a.size() && at < b.size() && a[at] == b[at]) {
+        if(a[at] == '\n') { line++; }
+        at++;
+    }
+    // Show the whole line each trace has there
+    size_t lineStart = at;
+    while(lineStart > 0 && a[lineStart - 1] != '\n') { lineStart--; }
+    auto lineAt = [lineStart](const std::string &trace) {
+        size_t lineEnd = trace.find('\n', lineStart);
+        return trace.substr(lineStart, (lineEnd == std::string::npos ? trace.size() : lineEnd) - lineStart);
+    };
+    return "traces differ at line " + std::to_string(line) + ":\n    reference: " + lineAt(a) + "\n    engine:    " + lineAt(b);
+}
+
+// Run the scenario with the reference and with anEngine and describe the first difference
+std::string compareWithReference(const DifferentialScenario &aScenario, const DifferentialEngine &anEngine) {
+    SimSettings referenceSettings = aScenario.makeSettings();
+    DifferentialRun reference = runScenario(referenceSettings);
+    SimSettings engineSettings = aScenario.makeSettings();
+    anEngine.select(engineSettings);
+    DifferentialRun other = runScenario(engineSettings);
+
+    std::string difference = compareTraces(reference.trace, other.trace);
+    if(difference.empty()) {
+        difference = compareResults(reference.results, other.results, "results");
+    }
+    for(size_t site = 0; difference.empty() && site < reference.siteResults.size() && site < other.siteResults.size(); site++) {
+        difference = compareResults(reference.siteResults[site], other.siteResults[site], "results at site " + std::to_string(site));
+    }
+    if(difference.empty() && reference.siteResults.size() != other.siteResults.size()) {
+        difference = "results for " + std::to_string(reference.siteResults.size()) + " sites and " + std::to_string(other.siteResults.size());
+    }
+    if(difference.empty() && reference.eventCount != other.eventCount) {
+        difference = "event counts differ: " + std::to_string(reference.eventCount) + " vs " + std::to_string(other.eventCount);
+    }
+    return difference;
+}
+
+// The simpler versions of a scenario to try, simplest first for each setting
+static std::vector<DifferentialScenario> simplerScenarios(const DifferentialScenario &aScenario) {
+    std::vector<DifferentialScenario> candidates{};
+    auto tryChange = [&](std::function<void(DifferentialScenario &)> change) {
+        DifferentialScenario candidate = aScenario;
+        change(candidate);
+        // Keep the minimum per kind possible for the number of planes
+        candidate.minPlanePerKind = std::min(candidate.minPlanePerKind, candidate.planeCount / companyCount);
+        if(candidate.describe() != aScenario.describe()) {
+            candidates.push_back(candidate);
+        }
+    };
+    // Shorter
+    tryChange([](DifferentialScenario &s) { s.simulationDuration = std::max(secondsPerMinute, s.simulationDuration / 2); });
+    tryChange([](DifferentialScenario &s) { s.simulationDuration = std::max(secondsPerMinute, s.simulationDuration - secondsPerHour); });
+    tryChange([](DifferentialScenario &s) { s.simulationDuration = std::max(secondsPerMinute, s.simulationDuration - secondsPerMinute); });
+    // Fewer planes, sites and chargers
+    tryChange([](DifferentialScenario &s) { s.planeCount = std::max(1L, s.planeCount / 2); });
+    tryChange([](DifferentialScenario &s) { s.planeCount = std::max(1L, s.planeCount - 1); });
+    tryChange([](DifferentialScenario &s) { s.siteCount = 1; });
+    tryChange([](DifferentialScenario &s) { s.siteCount = std::max(1L, s.siteCount - 1); });
+    tryChange([](DifferentialScenario &s) { s.chargerCount = s.chargerCount / 2; });
+    tryChange([](DifferentialScenario &s) { s.chargerCount = std::max(0L, s.chargerCount - 1); });
+    // Options back to their defaults
+    tryChange([](DifferentialScenario &s) { s.siteFlightOption = 0; });
+    tryChange([](DifferentialScenario &s) { s.minPlanePerKind = 0; });
+    tryChange([](DifferentialScenario &s) { s.passengerCountOption = 0; });
+    tryChange([](DifferentialScenario &s) { s.maxPassengerDelay = 0; });
+    tryChange([](DifferentialScenario &s) { s.maxPassengerDelay = s.maxPassengerDelay / 2; });
+    tryChange([](DifferentialScenario &s) { s.faultOption = 0; });
+    tryChange([](DifferentialScenario &s) { s.faultCountOption = 0; });
+    tryChange([](DifferentialScenario &s) { s.chargerPolicyOption = chargerPolicyFIFO; });
+    tryChange([](DifferentialScenario &s) {
+        for(auto c: allCompany) { s.companyPriority[c] = c; }
+    });
+    return candidates;
+}
+
+// Make a failing scenario as simple as possible
+DifferentialScenario shrinkScenario(DifferentialScenario aScenario, const std::function<bool(const DifferentialScenario &)> &fails) {
+    bool shrunk = true;
+    while(shrunk) {
+        shrunk = false;
+        for(const DifferentialScenario &candidate: simplerScenarios(aScenario)) {
+            if(fails(candidate)) {
+                aScenario = candidate;
+                shrunk = true;
+                break;
+            }
+        }
+    }
+    return aScenario;
+}
+
+// Only this many mismatches are shrunk, since each one takes many runs
+static const long maxMismatchesShrunk{3};
+
+// Check scenarioCount random scenarios made from seed against every engine
+long runDifferentialTest(long scenarioCount, uint64_t seed) {
+    auto startTimer = std::chrono::high_resolution_clock::now();
+    SimRandom random(seed);
+    long mismatches = 0;
+    for(long scenario = 0; scenario < scenarioCount; scenario++) {
+        DifferentialScenario aScenario = randomScenario(random);
+        for(const DifferentialEngine &anEngine: differentialEngines()) {
+            std::string difference = compareWithReference(aScenario, anEngine);
+            if(difference.empty()) {
+                continue;
+            }
+            mismatches++;
+            std::cout << "***** " << anEngine.name << " does not match the SimClock for scenario " << scenario << ": "
+            << aScenario.describe() << std::endl;
+            std::cout << "  " << difference << std::endl;
+            if(mismatches <= maxMismatchesShrunk) {
+                DifferentialScenario smallest = shrinkScenario(aScenario, [&anEngine](const DifferentialScenario &candidate) {
+                    return !compareWithReference(candidate, anEngine).empty();
+                });
+                std::string smallestDifference = compareWithReference(smallest, anEngine);
+                std::cout << "  Simplest failing scenario: " << smallest.describe() << std::endl;
+                std::cout << "  " << (smallestDifference.empty() ? std::string{"(it did not fail again, so the failure is not repeatable)"} : smallestDifference) << std::endl;
+            }
+        }
+    }
+    double secondsTaken = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTimer).count();
+    std::cout << "Checked " << scenarioCount << " scenarios (seed " << seed << ") against " << differentialEngines().size()
+    << " engine(s) in " << secondsTaken << " seconds: " << mismatches << " mismatches" << std::endl;
+    return mismatches;
+}
+
+// Run 1000 random scenarios and check that shrinking finds the simplest failing scenario
+// for a made up failure. It reports errors to cout.
+bool testDifferential() {
+    bool returnValue = true;
+    std::cout << " ***** Starting differential test of the engines *****" << std::endl;
+    if(runDifferentialTest(1000, 2025) != 0) {
+        returnValue = false;
+    }
+
+    // A made up failure that needs at least 7 planes, a fault option and 2 hours shrinks to just that
+    // (the duration goes down a minute at a time at the end)
+    SimRandom random(99);
+    DifferentialScenario aScenario = randomScenario(random);
+    aScenario.simulationDuration = 200 * secondsPerHour;
+    aScenario.planeCount = 50;
+    aScenario.siteCount = 3;
+    aScenario.faultOption = 2;
+    aScenario.chargerPolicyOption = chargerPolicyShortestCharge;
+    DifferentialScenario smallest = shrinkScenario(aScenario, [](const DifferentialScenario &s) {
+        return s.planeCount >= 7 && s.faultOption != 0 && s.simulationDuration >= 2 * secondsPerHour;
+    });
+    if(smallest.planeCount != 7 || smallest.faultOption != 2 || smallest.simulationDuration >= 2 * secondsPerHour + secondsPerMinute ||
+       smallest.siteCount != 1 || smallest.chargerCount != 0 || smallest.chargerPolicyOption != chargerPolicyFIFO ||
+       smallest.maxPassengerDelay != 0 || smallest.minPlanePerKind != 0 || smallest.randomSeed != aScenario.randomSeed) {
+        std::cout << "***** error: shrinking gave " << smallest.describe() << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Differential test of the engines " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
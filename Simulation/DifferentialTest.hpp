@@ -0,0 +1,83 @@
+//
+//  DifferentialTest.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef DifferentialTest_hpp
+#define DifferentialTest_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include "SimSettings.hpp"
+#include "SimRandom.hpp"
+
+/*
+ *******************************************************************************************
+ * Struct DifferentialScenario
+ * The settings a differential test varies. Everything else keeps its default. SimSettings
+ * has const members so it cannot be assigned, which the shrinking needs, so the scenario
+ * is kept here and turned into SimSettings for each run.
+ *******************************************************************************************
+ */
+struct DifferentialScenario {
+    long simulationDuration; // in seconds
+    long planeCount;
+    long chargerCount;
+    long siteCount;
+    int siteFlightOption;
+    long minPlanePerKind;
+    int passengerCountOption;
+    long maxPassengerDelay;
+    int faultOption;
+    int faultCountOption;
+    int chargerPolicyOption;
+    int companyPriority[companyCount];
+    long randomSeed;
+
+    // The SimSettings for a run of this scenario
+    SimSettings makeSettings() const;
+    // One line describing the scenario, so a failure can be repeated from the settings menu
+    std::string describe() const;
+};
+
+/*
+ *******************************************************************************************
+ * Struct DifferentialEngine
+ * An implementation to check against the reference, which is the SimClock of EventHandler
+ * objects with its heap of handlers, ChargerQueue and PlaneQueue. select() changes
+ * the settings of a run to use it. To check a new engine or queue backend, add it to the
+ * list in differentialEngines().
+ *******************************************************************************************
+ */
+struct DifferentialEngine {
+    const char *name;
+    void (*select)(SimSettings &settings);
+};
+const std::vector<DifferentialEngine> &differentialEngines();
+
+// Make a random scenario. Most are small so thousands of them run in seconds.
+DifferentialScenario randomScenario(SimRandom &random);
+
+// Run the scenario with the reference and with anEngine and compare the ordered trace of
+// every flight, charge and grounding, the results, the results by site and the event count.
+// It returns an empty string if they match, otherwise a description of the first difference.
+std::string compareWithReference(const DifferentialScenario &aScenario, const DifferentialEngine &anEngine);
+
+// Make a failing scenario as simple as possible. It tries simpler versions one setting at a
+// time (shorter, fewer planes, chargers and sites, options back to 0) and keeps any that
+// still fail, until none of them do. The seed is kept so the run stays comparable.
+DifferentialScenario shrinkScenario(DifferentialScenario aScenario, const std::function<bool(const DifferentialScenario &)> &fails);
+
+// Check scenarioCount random scenarios made from seed against every engine, shrinking and
+// reporting each mismatch to cout. It returns how many scenarios did not match.
+long runDifferentialTest(long scenarioCount, uint64_t seed);
+
+// Run 1000 random scenarios and check that shrinking finds the simplest failing scenario
+// for a made up failure. It reports errors to cout.
+bool testDifferential();
+
+#endif /* DifferentialTest_hpp */
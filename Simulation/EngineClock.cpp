@@ -0,0 +1,16 @@
+//
+//  EngineClock.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "EngineClock.hpp"
+#include <iostream>
+
+// Say what went wrong and keep the history that led up to it
+void reportBadReinsert(const char *where, FlightRecorder &theRecorder, long time, uint32_t kind, long recorderId) {
+    std::cout << "Error in " << where << ": Attempt to reschedule event not in future time" << std::endl;
+    theRecorder.record(time, static_cast<int>(kind), recorderId, recordBadReinsert);
+    theRecorder.dump(std::cout, flightRecorderDumpCount);
+}
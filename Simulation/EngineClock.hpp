@@ -0,0 +1,105 @@
+//
+//  EngineClock.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef EngineClock_hpp
+#define EngineClock_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "FlightRecorder.hpp"
+
+/*
+ *******************************************************************************************
+ * The clock of the FastEngine and the CohortEngine
+ * Both engines keep where each flight, charger queue and plane queue is in the clock in a
+ * key, and its events in one binary heap ordered by time and then by the order they were
+ * scheduled. When something moves, its old event is left in the heap and skipped when it
+ * comes up, and at the end everything still in the clock is closed out latest first, as
+ * the SimClock does. These are the parts of that they share.
+ *******************************************************************************************
+ */
+// The kinds of event. They have the same values as the matching ProfileKind values.
+enum FastEventKind : uint32_t {
+    fastFlightEvent = 0, // A plane in flight reaches the end of its flight or a fault
+    fastChargerEvent = 1, // A charger at a site is done
+    fastPlaneQueueEvent = 2 // A plane at a site has its passengers and can take off
+};
+
+// Where one flight, charger queue or plane queue is in the clock
+template <typename Sequence>
+struct EngineClockKey {
+    long time; // The time it is waiting for
+    Sequence sequence; // The order it was scheduled
+    bool inClock; // False while it is being handled or after it leaves the clock
+};
+
+// std::push_heap and std::pop_heap build a max-heap, so these comparisons are "a comes after b".
+// Ties go to the lower sequence, which was scheduled first.
+template <typename T>
+bool eventLater(const T &a, const T &b) {
+    if(a.time != b.time) { return a.time > b.time; }
+    return a.sequence > b.sequence;
+}
+template <typename T>
+bool doneLater(const T &a, const T &b) {
+    if(a.timeDone != b.timeDone) { return a.timeDone > b.timeDone; }
+    return a.sequence > b.sequence;
+}
+template <typename T>
+bool readyLater(const T &a, const T &b) {
+    if(a.nextFlightTime != b.nextFlightTime) { return a.nextFlightTime > b.nextFlightTime; }
+    return a.sequence > b.sequence;
+}
+
+// Drop the events at the front of the heap for anything that has since moved or left the
+// clock. keyOf gives the key of an event.
+template <typename Events, typename KeyOf>
+void dropStaleEvents(Events &events, KeyOf keyOf) {
+    using Event = typename Events::value_type;
+    while(!events.empty()) {
+        const Event &top = events.front();
+        const auto &key = keyOf(top);
+        if(key.inClock && key.sequence == top.sequence) { break; }
+        std::pop_heap(begin(events), end(events), eventLater<Event>);
+        events.pop_back();
+    }
+}
+
+// Take everything still in the clock out of it, then pass each one's kind and number to
+// closeOne latest first. They all leave the clock first so nothing they do during the
+// close-out moves anything. keyFor gives the key of a kind and number.
+template <typename KeyFor, typename CloseOne>
+void closeOutClock(long flightCount, long siteCount, KeyFor keyFor, CloseOne closeOne) {
+    struct Remaining { long time; uint64_t sequence; uint32_t kind; long id; };
+    std::vector<Remaining> remaining{};
+    const uint32_t kinds[]{fastFlightEvent, fastChargerEvent, fastPlaneQueueEvent};
+    for(uint32_t kind: kinds) {
+        long count = kind == fastFlightEvent ? flightCount : siteCount;
+        for(long id = 0; id < count; id++) {
+            auto &key = keyFor(kind, id);
+            if(key.inClock) {
+                remaining.push_back(Remaining{key.time, key.sequence, kind, id});
+                key.inClock = false;
+            }
+        }
+    }
+    std::sort(begin(remaining), end(remaining), [](const Remaining &a, const Remaining &b) {
+        return a.time > b.time || (a.time == b.time && a.sequence > b.sequence);
+    });
+    for(const Remaining &aRemaining: remaining) {
+        closeOne(aRemaining.kind, aRemaining.id);
+    }
+}
+
+// Something asked to go back in the clock at or before the time being handled, which should
+// never happen. Say so in where, record it under recorderId and dump the flight recorder, as
+// SimClock::run does for an event out of order.
+void reportBadReinsert(const char *where, FlightRecorder &theRecorder, long time, uint32_t kind, long recorderId);
+
+#endif /* EngineClock_hpp */
@@ -6,6 +6,7 @@
 //
 
 #include "EventHandler.hpp"
+#include "SimProfile.hpp"
 
 /*
  *******************************************************************************************
@@ -17,7 +18,8 @@
  * As nextEventTime arrves, the SimClock will call handleEvent() to process that event.
  *******************************************************************************************
  */
-EventHandler::EventHandler(long nextEventTime):  nextEventTime{nextEventTime} {
+EventHandler::EventHandler(long nextEventTime, int recorderKind, long recorderId):  nextEventTime{nextEventTime}, clockTime{LONG_MAX}, clockSequence{-1}, clockIndex{-1},
+recorderKind{recorderKind}, recorderId{recorderId} {
 }
 
 EventHandler::~EventHandler() {
@@ -54,3 +56,8 @@ const std::string EventHandler::describe() {
     std::string description = "Generic EventHandler";
     return description;
 }
+
+// Which ProfileKind this handler is counted as by the profiler
+int EventHandler::profileKind() {
+    return profileOther;
+}
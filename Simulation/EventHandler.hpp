@@ -13,6 +13,9 @@
 #include <queue>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <climits>
+#include "SimProfile.hpp"
 
 /*
  *******************************************************************************************
@@ -27,8 +30,21 @@
 class EventHandler {
 protected:
     long nextEventTime; // this is the next time this handler wants to be called
+
+    // These are maintained by SimClock so it can find this handler quickly in its heap.
+    // They record the nextEventTime the handler had when it was put in the heap, the order in
+    // which it was put there and where it is now. clockIndex is -1 when it is not in the heap.
+    friend class SimClock;
+    long clockTime;
+    long clockSequence;
+    long clockIndex;
+
+    // What the flight recorder calls this handler: its ProfileKind and the plane number for a
+    // Flight or the site for a queue. They are kept here so recording needs no virtual call.
+    int recorderKind;
+    long recorderId;
 public:
-    EventHandler(long nextEventTime);
+    EventHandler(long nextEventTime, int recorderKind = profileOther, long recorderId = 0);
     virtual ~EventHandler();
     
     // Get protected variable (for testing since children access it directly)
@@ -49,6 +65,9 @@ public:
 
     // For testing: provide a description of the object
     virtual const std::string describe();
+
+    // Which ProfileKind this handler is counted as by the profiler
+    virtual int profileKind();
 };
 
 #endif /* EventHandler_hpp */
@@ -0,0 +1,790 @@
+//
+//  FastEngine.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/5/25.
+//
+
+#include "FastEngine.hpp"
+#include "Passenger.hpp"
+#include "SimTrace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+/*
+ *******************************************************************************************
+ * class FastEngine
+ * This runs the same simulation as the SimClock of EventHandler objects without creating
+ * an object for each flight or calling any virtual functions. Planes and sites are kept in
+ * arrays and the events are FastEvents in a single binary heap. Each event is handled by a
+ * switch on its kind.
+ *
+ * It follows the SimClock rules exactly so it gives the same results for the same seed:
+ *   - Each flight, charger queue and plane queue has one place in the clock at a time.
+ *     Events at the same time are handled in the order they were scheduled, and moving
+ *     something to a new time counts as scheduling it again, as SimClock::reSortHandler does.
+ *   - Anything being handled is out of the clock until it is done, so asking to move it
+ *     does nothing, just like SimClock.
+ *   - At the end, everything still in the clock is closed out latest first.
+ * When something moves, its old event is left in the heap and skipped when it comes up.
+ *
+ * It uses the same Plane objects, since they hold each plane's random numbers, and it
+ * fills the Simulation's theFlightStats and theChargerStats so the results are summarized
+ * by the same code.
+ *
+ * With SimSettings::cycleOption 1 it can also find the period of a run that repeats and
+ * skip whole periods (see FastEngineCycles.hpp).
+ *******************************************************************************************
+ */
+uint32_t FastEngine::sequenceLimit = UINT32_MAX;
+
+FastEngine::FastEngine(Simulation *theSimulation): theSimulation{theSimulation}, thePolicy{},
+endTime{0}, chargerCount{0}, maxPassengerDelay{0}, faultOption{0}, faultsAtEnd{false},
+fleet(CountingAllocator<FastPlane>(&theSimulation->theMemory, memoryPlanes)), sites{},
+events(CountingAllocator<FastEvent>(&theSimulation->theMemory, memoryHandlers)),
+flightKeys(CountingAllocator<ClockKey>(&theSimulation->theMemory, memoryHandlers)),
+chargerKeys(CountingAllocator<ClockKey>(&theSimulation->theMemory, memoryHandlers)),
+planeQueueKeys(CountingAllocator<ClockKey>(&theSimulation->theMemory, memoryHandlers)), nextSequence{0}, eventCount{0}, theProfile{nullptr}, inClockCount{0}, theTrace{theSimulation->theTrace},
+theRecorder{&theSimulation->theRecorder}, cycleSearch{false},
+checkpoints(0, std::hash<uint64_t>{}, std::equal_to<uint64_t>{}, CountingAllocator<std::pair<const uint64_t, CycleCheckpoint>>(&theSimulation->theMemory, memoryHandlers)),
+stateWords(CountingAllocator<long>(&theSimulation->theMemory, memoryHandlers)), fingerprintWork{0}, lastLandingTie{-1}, note{},
+followDerivatives{false}, chargeTimeDerivatives{},
+planeDerivatives(CountingAllocator<double>(&theSimulation->theMemory, memoryPlanes)),
+chargeDerivatives(CountingAllocator<double>(&theSimulation->theMemory, memoryPlanes)),
+freedDerivatives(CountingAllocator<double>(&theSimulation->theMemory, memoryQueues)), currentTime{0}, progressInterval{0}, nextProgressUpdate{LONG_MAX} {
+#if SIMPROFILE
+    // Only profile if the Simulation asked for it
+    if(theSimulation->theProfile.enabled) {
+        theProfile = &theSimulation->theProfile;
+    }
+#endif
+}
+
+// The clock key for an event kind and plane or site number
+FastEngine::ClockKey &FastEngine::keyFor(uint32_t kind, long id) {
+    switch(kind) {
+        case fastFlightEvent: return flightKeys[id];
+        case fastChargerEvent: return chargerKeys[id];
+        default: return planeQueueKeys[id];
+    }
+}
+
+// Put something in the clock at a time with the next sequence (SimClock::addHandler).
+// Nothing waiting for LONG_MAX can happen before the end, so it gets a key for the close-out
+// order but no event.
+void FastEngine::schedule(uint32_t kind, long id, long time) {
+    if(nextSequence >= sequenceLimit) {
+        renumber();
+    }
+    ClockKey &key = keyFor(kind, id);
+#if SIMPROFILE
+    if(theProfile) {
+        if(key.inClock) {
+            theProfile->reSorts++;
+        } else {
+            theProfile->queueInserts++;
+            theProfile->peakHandlers = std::max(theProfile->peakHandlers, ++inClockCount);
+        }
+    }
+#endif
+    key.time = time;
+    key.sequence = nextSequence++;
+    key.inClock = true;
+    if(time != LONG_MAX) {
+        events.push_back(FastEvent{time, key.sequence, (kind << fastKindShift) | static_cast<uint32_t>(id)});
+        std::push_heap(begin(events), end(events), eventLater<FastEvent>);
+    }
+}
+
+// Move something already in the clock to a new time (SimClock::reSortHandler).
+// If it is being handled right now this does nothing. It is scheduled when it is done.
+void FastEngine::reschedule(uint32_t kind, long id, long time) {
+    if(keyFor(kind, id).inClock) {
+        schedule(kind, id, time);
+    }
+}
+
+// Give everything in the clock new sequence numbers starting from 0, keeping their order.
+// Old events are dropped from the heap at the same time.
+void FastEngine::renumber() {
+    struct Entry { long time; uint32_t sequence; uint32_t kind; long id; };
+    std::vector<Entry> entries{};
+    const uint32_t kinds[]{fastFlightEvent, fastChargerEvent, fastPlaneQueueEvent};
+    for(uint32_t kind: kinds) {
+        long count = static_cast<long>(kind == fastFlightEvent ? flightKeys.size() : sites.size());
+        for(long id = 0; id < count; id++) {
+            const ClockKey &key = keyFor(kind, id);
+            if(key.inClock) { entries.push_back(Entry{key.time, key.sequence, kind, id}); }
+        }
+    }
+    std::sort(begin(entries), end(entries), [](const Entry &a, const Entry &b) {
+        return a.time < b.time || (a.time == b.time && a.sequence < b.sequence);
+    });
+    events.clear();
+    nextSequence = 0;
+    for(const Entry &anEntry: entries) {
+        ClockKey &key = keyFor(anEntry.kind, anEntry.id);
+        key.sequence = nextSequence++;
+        if(key.time != LONG_MAX) {
+            events.push_back(FastEvent{key.time, key.sequence, (anEntry.kind << fastKindShift) | static_cast<uint32_t>(anEntry.id)});
+        }
+    }
+    // The entries were sorted soonest first, which is already a valid min-heap
+}
+
+// Handle one event
+bool FastEngine::dispatch(uint32_t kind, long id, long currentTime, bool closeOut) {
+    switch(kind) {
+        case fastFlightEvent: return handleFlight(id, currentTime);
+        case fastChargerEvent: return handleChargers(id, currentTime, closeOut);
+        default: return handlePlaneQueue(id, currentTime, closeOut);
+    }
+}
+
+#if SIMPROFILE
+// Handle one event and count it in the profile. Every event is counted, but the clock is
+// only read for a sample of them.
+bool FastEngine::dispatchProfiled(uint32_t kind, long id, long currentTime) {
+    inClockCount--;
+    ProfileKindStats &kindStats = theProfile->kinds[kind];
+    if(kindStats.events++ % profileSampleInterval != 0) {
+        return dispatch(kind, id, currentTime, false);
+    }
+    // The counters are read outside the timing, as SimClock::handleProfiledEvent does
+    double countsBefore[hardwareCounterCount];
+    bool counting = theCounters.isOpen() && theCounters.read(countsBefore);
+    auto eventStartTimer = std::chrono::high_resolution_clock::now();
+    bool returnValue = dispatch(kind, id, currentTime, false);
+    kindStats.sampledSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - eventStartTimer).count();
+    if(counting) {
+        theCounters.addSince(countsBefore, kindStats.sampledCounts);
+    }
+    kindStats.sampledEvents++;
+    return returnValue;
+}
+#endif
+
+// The time the flight or queue wants next after it has been handled
+long FastEngine::nextTimeFor(uint32_t kind, long id) {
+    switch(kind) {
+        case fastFlightEvent: return fleet[id].nextEventTime;
+        case fastChargerEvent: return sites[id].chargerNextTime;
+        default: return sites[id].planeQueueNextTime;
+    }
+}
+
+// Flight::handleEvent. This is also called to close out a flight, as SimClock does.
+bool FastEngine::handleFlight(long plane, long currentTime) {
+    FastPlane &aPlane = fleet[plane];
+    if(currentTime == aPlane.nextFaultTime) {
+        // We hit a fault interval so handle the fault
+        aPlane.faultCount++;
+        aPlane.nextFaultTime = currentTime + aPlane.thePlane->createFaultInterval();
+        if(faultOption == 1) {
+            // The fault grounds the plane immediately
+            recordFlight(aPlane);
+            recordGrounded(aPlane, currentTime);
+            addToPlaneQueue(aPlane.destinationSite, LONG_MAX, plane);
+            return false;
+        }
+        aPlane.nextEventTime = std::min(aPlane.endTime, aPlane.nextFaultTime);
+        if(aPlane.nextEventTime > currentTime) {
+            return true;
+        }
+    }
+    // finish the flight, using up the part of the fault interval that was flown
+    if(followDerivatives && currentTime < aPlane.endTime) {
+        // Cut off by the end, so it flies less the later it took off
+        theSimulation->thePathDerivatives.passengerMiles -= planeDerivatives[plane] * aPlane.passengerCount * aPlane.milesPerHour / secondsPerHourD;
+    }
+    aPlane.endTime = currentTime;
+    if(faultsAtEnd) {
+        aPlane.faultCount = aPlane.thePlane->countFaults(aPlane.endTime - aPlane.startTime);
+    } else {
+        long startOfCurrentFaultInterval = aPlane.nextFaultTime - aPlane.thePlane->getNextFaultInterval();
+        aPlane.thePlane->decrementNextFaultInterval(aPlane.endTime - startOfCurrentFaultInterval);
+    }
+    recordFlight(aPlane);
+    if(faultOption == 2 && aPlane.faultCount > 0) {
+        recordGrounded(aPlane, currentTime);
+        addToPlaneQueue(aPlane.destinationSite, LONG_MAX, plane);
+    } else {
+        addToChargers(aPlane.destinationSite, currentTime, plane, aPlane.startTime);
+    }
+    return false;
+}
+
+// ChargerQueue::handleEvent
+bool FastEngine::handleChargers(long site, long currentTime, bool closeOut) {
+    FastSite &aSite = sites[site];
+    if(closeOut) {
+        // Log the charges still in progress
+        for(const FastCharger &aCharger: aSite.chargers) {
+            logCharge(site, aCharger, currentTime);
+        }
+        return false;
+    }
+    if(aSite.chargers.empty()) {
+        std::cout << "FastEngine::handleChargers should not be called with no chargers in use" << std::endl;
+        return false;
+    }
+    // Handle any planes that are now fully charged
+    if(followDerivatives) {
+        freedDerivatives.clear();
+    }
+    while(!aSite.chargers.empty() && aSite.chargers.front().timeDone <= currentTime) {
+        std::pop_heap(begin(aSite.chargers), end(aSite.chargers), doneLater<FastCharger>);
+        FastCharger aCharger = aSite.chargers.back();
+        aSite.chargers.pop_back();
+        logCharge(site, aCharger, currentTime);
+        if(followDerivatives) {
+            // The passenger delay is fixed, so the plane is ready and takes off as much later as it was done
+            double done = chargeDerivatives[aCharger.plane] + chargeTimeDerivatives[fleet[aCharger.plane].company];
+            planeDerivatives[aCharger.plane] = done;
+            freedDerivatives.push_back(done);
+        }
+        long delay = Passenger::getPassengerDelay(maxPassengerDelay, fleet[aCharger.plane].thePlane->getRandom());
+        addToPlaneQueue(site, currentTime + delay, aCharger.plane);
+    }
+    // If there are chargers available, move planes from the waiting queue to a charger
+    if(followDerivatives) {
+        std::sort(begin(freedDerivatives), end(freedDerivatives));
+    }
+    size_t freed = 0;
+    while(static_cast<long>(aSite.chargers.size()) < chargerCount) {
+        if(thePolicy) {
+            if(aSite.planesWaitingByPolicy.empty()) { break; }
+            WaitingPlane aWaitingPlane = aSite.planesWaitingByPolicy.pop(currentTime);
+            addCharger(site, currentTime, aWaitingPlane.timeStarted, aWaitingPlane.fleetIndex);
+        } else {
+            if(aSite.planesWaiting.empty()) { break; }
+            FastWaiting aWaitingPlane = aSite.planesWaiting.front();
+            aSite.planesWaiting.pop();
+            if(followDerivatives) {
+                followWait(aWaitingPlane.plane, freed++);
+            }
+            addCharger(site, currentTime, aWaitingPlane.timeStarted, aWaitingPlane.plane);
+        }
+    }
+    aSite.chargerNextTime = aSite.chargers.empty() ? LONG_MAX : aSite.chargers.front().timeDone;
+    return true;
+}
+
+// PlaneQueue::handleEvent
+bool FastEngine::handlePlaneQueue(long site, long currentTime, bool closeOut) {
+    if(closeOut) {
+        return false;
+    }
+    FastSite &aSite = sites[site];
+    if(aSite.planesReady.empty()) {
+        std::cout << "FastEngine::handlePlaneQueue should not be called with no planes waiting" << std::endl;
+        return false;
+    }
+    while(!aSite.planesReady.empty() && aSite.planesReady.front().nextFlightTime <= currentTime) {
+        std::pop_heap(begin(aSite.planesReady), end(aSite.planesReady), readyLater<FastReady>);
+        long plane = aSite.planesReady.back().plane;
+        aSite.planesReady.pop_back();
+        // The passengers and destination come from the plane's own random numbers, in that order.
+        FastPlane &aPlane = fleet[plane];
+        long passengerCount = Passenger::getPassengerCount(aPlane.maxPassengers, theSimulation->theSettings, aPlane.thePlane->getRandom());
+        long destinationSite = theSimulation->pickDestinationSite(site, aPlane.thePlane->getRandom());
+        startFlight(plane, currentTime, passengerCount, site, destinationSite);
+    }
+    aSite.planeQueueNextTime = aSite.planesReady.empty() ? LONG_MAX : aSite.planesReady.front().nextFlightTime;
+    return true;
+}
+
+// The Flight constructor and SimClock::addHandler for the new flight
+void FastEngine::startFlight(long plane, long currentTime, long passengerCount, long originSite, long destinationSite) {
+    FastPlane &aPlane = fleet[plane];
+    aPlane.startTime = currentTime;
+    aPlane.endTime = currentTime + aPlane.timeOnFullCharge;
+    aPlane.nextFaultTime = faultsAtEnd ? LONG_MAX : currentTime + aPlane.thePlane->getNextFaultInterval();
+    aPlane.nextEventTime = std::min(aPlane.endTime, aPlane.nextFaultTime);
+    aPlane.passengerCount = passengerCount;
+    aPlane.faultCount = 0;
+    aPlane.originSite = originSite;
+    aPlane.destinationSite = destinationSite;
+    schedule(fastFlightEvent, plane, aPlane.nextEventTime);
+}
+
+// Flight::recordFlight
+void FastEngine::recordFlight(FastPlane &aPlane) {
+    long flightDuration = aPlane.endTime - aPlane.startTime;
+    double passengerMiles = flightDuration * aPlane.passengerCount * aPlane.milesPerHour;
+    passengerMiles /= secondsPerHourD;
+    theSimulation->recordFlight(FlightStats{aPlane.company, aPlane.planeNumber, flightDuration,
+        aPlane.passengerCount, aPlane.faultCount, passengerMiles, aPlane.originSite}, aPlane.endTime);
+    if(theTrace) {
+        theTrace->flight(aPlane.planeNumber, aPlane.company, aPlane.originSite, aPlane.destinationSite,
+                         aPlane.startTime, aPlane.endTime, aPlane.passengerCount, aPlane.faultCount);
+    }
+}
+
+// Flight::recordGrounded
+void FastEngine::recordGrounded(const FastPlane &aPlane, long currentTime) {
+    theSimulation->recordGrounded(aPlane.company);
+    if(theTrace) {
+        theTrace->grounded(aPlane.planeNumber, aPlane.company, aPlane.destinationSite, currentTime);
+    }
+}
+
+// ChargerQueue::addPlane
+void FastEngine::addToChargers(long site, long currentTime, long plane, long reservationTime) {
+    FastSite &aSite = sites[site];
+    if(static_cast<long>(aSite.chargers.size()) >= chargerCount) {
+        if(thePolicy) {
+            WaitingPlane aWaitingPlane{currentTime, fleet[plane].thePlane, reservationTime < 0 ? currentTime : reservationTime, plane};
+            aSite.planesWaitingByPolicy.push(aWaitingPlane, thePolicy->key(aWaitingPlane), thePolicy->agingRate(aWaitingPlane));
+        } else {
+            aSite.planesWaiting.push(FastWaiting{currentTime, plane});
+        }
+        if(followDerivatives) {
+            theSimulation->thePathDerivatives.waits++;
+        }
+    } else {
+        if(followDerivatives) {
+            chargeDerivatives[plane] = planeDerivatives[plane];
+        }
+        addCharger(site, currentTime, currentTime, plane);
+    }
+}
+
+// ChargerQueue::addCharger
+void FastEngine::addCharger(long site, long currentTime, long startedWaiting, long plane) {
+    FastSite &aSite = sites[site];
+    aSite.chargers.push_back(FastCharger{currentTime, startedWaiting, currentTime + fleet[plane].timeToCharge,
+        aSite.nextChargerSequence++, plane});
+    std::push_heap(begin(aSite.chargers), end(aSite.chargers), doneLater<FastCharger>);
+    if(theTrace) {
+        theTrace->chargeStarted(fleet[plane].planeNumber, fleet[plane].company, site, currentTime);
+    }
+    if(aSite.chargerNextTime != aSite.chargers.front().timeDone) {
+        aSite.chargerNextTime = aSite.chargers.front().timeDone;
+        reschedule(fastChargerEvent, site, aSite.chargerNextTime);
+    }
+}
+
+// PlaneQueue::addPlane
+void FastEngine::addToPlaneQueue(long site, long delayUntil, long plane) {
+    FastSite &aSite = sites[site];
+    if(delayUntil == LONG_MAX) {
+        aSite.groundedCount++;
+        return;
+    }
+    aSite.planesReady.push_back(FastReady{delayUntil, aSite.nextPlaneSequence++, plane});
+    std::push_heap(begin(aSite.planesReady), end(aSite.planesReady), readyLater<FastReady>);
+    if(aSite.planeQueueNextTime != aSite.planesReady.front().nextFlightTime) {
+        aSite.planeQueueNextTime = aSite.planesReady.front().nextFlightTime;
+        reschedule(fastPlaneQueueEvent, site, aSite.planeQueueNextTime);
+    }
+}
+
+// Log a charge that is done or cut off by the end of the simulation
+void FastEngine::logCharge(long site, const FastCharger &aCharger, long currentTime) {
+    const FastPlane &aPlane = fleet[aCharger.plane];
+    theSimulation->recordCharge(ChargerStats{aPlane.company, aPlane.planeNumber,
+        currentTime - aCharger.timeStarted, currentTime - aCharger.timeStartedIncludingWait, site}, currentTime);
+    if(theTrace) {
+        theTrace->charge(aPlane.planeNumber, aPlane.company, site, aCharger.timeStartedIncludingWait, aCharger.timeStarted, currentTime);
+    }
+}
+
+// Create the planes for each site and run the simulation. It returns the final simulated time.
+long FastEngine::run(const std::vector<std::vector<Company>> &siteCompanies) {
+    start(siteCompanies);
+#if SIMPROFILE
+    if(theProfile) {
+        theCounters.start(*theProfile);
+    }
+    auto loopStartTimer = std::chrono::high_resolution_clock::now();
+#endif
+    runUntil(endTime);
+    closeOut();
+#if SIMPROFILE
+    if(theProfile) {
+        theProfile->eventLoopSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loopStartTimer).count();
+        theCounters.finish(*theProfile);
+    }
+#endif
+    return currentTime;
+}
+
+// Create the planes for each site and put the queues in the clock
+void FastEngine::start(const std::vector<std::vector<Company>> &siteCompanies) {
+    std::shared_ptr<SimSettings> theSettings = theSimulation->theSettings;
+    endTime = theSettings->simulationDuration;
+    chargerCount = theSettings->chargerCount;
+    maxPassengerDelay = theSettings->maxPassengerDelay;
+    faultOption = theSettings->faultOption;
+    faultsAtEnd = faultOption == 0 && theSettings->faultCountOption == 1;
+    thePolicy = ChargerPolicy::makePolicy(theSettings->chargerPolicyOption, *theSettings);
+    if(thePolicy && thePolicy->isFIFO()) {
+        thePolicy = nullptr;
+    }
+
+    // Set up the sites and create the planes in the same order as PlaneQueue::generatePlanes
+    long siteCount = static_cast<long>(siteCompanies.size());
+    SimMemory *theMemory = &theSimulation->theMemory;
+    sites.assign(siteCount, FastSite{CountedVector<FastCharger>(CountingAllocator<FastCharger>(theMemory, memoryQueues)),
+        RingBuffer<FastWaiting, CountingAllocator<FastWaiting>>(16, CountingAllocator<FastWaiting>(theMemory, memoryQueues)),
+        CountedWaitingPlaneHeap(CountingAllocator<WaitingPlane>(theMemory, memoryQueues)), 0, LONG_MAX, CountedVector<FastReady>(CountingAllocator<FastReady>(theMemory, memoryQueues)), 0, 0, LONG_MAX, -1, 0, false});
+    chargerKeys.assign(siteCount, ClockKey{LONG_MAX, 0, false});
+    planeQueueKeys.assign(siteCount, ClockKey{LONG_MAX, 0, false});
+    for(long site = 0; site < siteCount; site++) {
+        if(chargerCount > 0) { sites[site].chargers.reserve(chargerCount); }
+        for(Company c: siteCompanies[site]) {
+            std::shared_ptr<Plane> thePlane = theSimulation->makePlane(c);
+            long plane = static_cast<long>(fleet.size());
+            fleet.push_back(FastPlane{thePlane, c, thePlane->getPlaneNumber(), thePlane->getMilesPerHour(),
+                thePlane->calcTimeOnFullCharge__seconds(), thePlane->calcTimeToCharge__seconds(), thePlane->getMaxPassengerCount(),
+                0, 0, 0, LONG_MAX, 0, 0, site, site});
+            long waitForPassengers = Passenger::getPassengerDelay(maxPassengerDelay, thePlane->getRandom());
+            addToPlaneQueue(site, waitForPassengers, plane);
+        }
+    }
+    flightKeys.assign(fleet.size(), ClockKey{LONG_MAX, 0, false});
+    events.reserve(fleet.size() + 2 * siteCount);
+
+    startDerivatives(theSettings->chargeTimeDerivativeOption);
+    for(long site = 0; site < siteCount; site++) {
+        schedule(fastChargerEvent, site, sites[site].chargerNextTime);
+        schedule(fastPlaneQueueEvent, site, sites[site].planeQueueNextTime);
+    }
+
+    // Look for a repeating state only if the settings can give one
+    cycleSearch = theSettings->cycleOption == 1 && cyclesPossible();
+
+    // Decide if we need to share progress status, as SimClock::run does
+    progressInterval = theSimulation->getProgressInterval();
+    nextProgressUpdate = progressInterval > 0 ? progressInterval : LONG_MAX;
+    currentTime = 0;
+}
+
+// Handle the events before stopTime, which is at most the end time. The clock is then at
+// stopTime, unless the Simulation asked to stop early.
+long FastEngine::runUntil(long stopTime) {
+    while(true) {
+        // Stop at the current time if the Simulation has gone over its memory budget, as SimClock::run does
+        if(theSimulation->stopRequested) {
+            break;
+        }
+        // Skip events for anything that has since moved or left the clock
+        dropStaleEvents(events, [this](const FastEvent &anEvent) -> const ClockKey & {
+            return keyFor(anEvent.kindAndId >> fastKindShift, anEvent.kindAndId & fastIdMask);
+        });
+        long nextTime = events.empty() ? LONG_MAX : events.front().time;
+        if(nextTime >= nextProgressUpdate && progressInterval > 0) {
+            theSimulation->showProgress(std::min(nextTime, endTime), endTime);
+            nextProgressUpdate += progressInterval;
+        }
+        if(nextTime >= stopTime) {
+            currentTime = stopTime;
+            break;
+        }
+        FastEvent anEvent = events.front();
+        std::pop_heap(begin(events), end(events), eventLater<FastEvent>);
+        events.pop_back();
+        uint32_t kind = anEvent.kindAndId >> fastKindShift;
+        long id = anEvent.kindAndId & fastIdMask;
+        keyFor(kind, id).inClock = false;
+        currentTime = anEvent.time;
+        eventCount++;
+        record(currentTime, kind, id, recordHandle);
+#if SIMPROFILE
+        bool keep = theProfile ? dispatchProfiled(kind, id, currentTime) : dispatch(kind, id, currentTime, false);
+#else
+        bool keep = dispatch(kind, id, currentTime, false);
+#endif
+        if(keep) {
+            long newTime = nextTimeFor(kind, id);
+            if(currentTime >= newTime) {
+                reportBadReinsert("FastEngine::run()", *theRecorder, newTime, kind, kind == fastFlightEvent ? fleet[id].planeNumber : id);
+            } else {
+                record(newTime, kind, id, recordKeep);
+                schedule(kind, id, newTime);
+            }
+        } else {
+            record(currentTime, kind, id, recordRemove);
+        }
+        if(cycleSearch && !faultsAtEnd && (kind != fastFlightEvent || !keep)) {
+            // Events at a site at the same second are handled in the order they were scheduled.
+            // A fault reschedules its flight, so if a landing is tied with another event at its
+            // site, a fault in a later repeat could change the order. Without fault events
+            // (faultCountOption 1) the order is always the same.
+            FastSite &aSite = sites[kind == fastFlightEvent ? fleet[id].destinationSite : id];
+            if(aSite.lastEventTime != currentTime) {
+                aSite.lastEventTime = currentTime;
+                aSite.eventsAtLastTime = 0;
+                aSite.landingAtLastTime = false;
+            }
+            aSite.eventsAtLastTime++;
+            aSite.landingAtLastTime = aSite.landingAtLastTime || kind == fastFlightEvent;
+            if(aSite.eventsAtLastTime > 1 && aSite.landingAtLastTime) {
+                lastLandingTie = currentTime;
+            }
+        }
+        // Repeats are only skipped on the way to the end, not before a pause
+        if(cycleSearch && stopTime == endTime && kind == fastChargerEvent && id == 0) {
+            long delta = skipRepeats(currentTime);
+            currentTime += delta;
+            while(progressInterval > 0 && delta > 0 && nextProgressUpdate <= currentTime) {
+                nextProgressUpdate += progressInterval;
+            }
+        }
+    }
+    return currentTime;
+}
+
+// Close out everything still in the clock at the current time. It returns the final time.
+long FastEngine::closeOut() {
+    if(nextProgressUpdate < LONG_MAX) {
+        std::cout << std::endl;
+    }
+
+    // Close out everything still in the clock, latest first as SimClock does
+    closeOutClock(static_cast<long>(fleet.size()), static_cast<long>(sites.size()),
+                  [this](uint32_t kind, long id) -> ClockKey & { return keyFor(kind, id); },
+                  [this](uint32_t kind, long id) {
+        record(currentTime, kind, id, recordCloseOut);
+        dispatch(kind, id, currentTime, true);
+    });
+    theSimulation->thePathDerivatives.followed = followDerivatives;
+    return currentTime;
+}
+
+// How many events were handled (not counting the close-out)
+long FastEngine::getEventCount() {
+    return eventCount;
+}
+
+// What the cycle search found, or an empty string if it did not look
+const std::string &FastEngine::getNote() {
+    return note;
+}
+
+bool sameValue(double a, double b) {
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+}
+bool sameResults(const std::vector<FinalStats> &a, const std::vector<FinalStats> &b) {
+    if(a.size() != b.size()) { return false; }
+    for(size_t i = 0; i < a.size(); i++) {
+        if(a[i].theCompany != b[i].theCompany || a[i].totalFlights != b[i].totalFlights ||
+           a[i].totalCharges != b[i].totalCharges || a[i].totalFaults != b[i].totalFaults ||
+           !sameValue(a[i].averageTimePerFlight, b[i].averageTimePerFlight) ||
+           !sameValue(a[i].averageDistancePerFlight, b[i].averageDistancePerFlight) ||
+           !sameValue(a[i].averageTimeCharging, b[i].averageTimeCharging) ||
+           !sameValue(a[i].averageTimeChargingWithWait, b[i].averageTimeChargingWithWait) ||
+           !sameValue(a[i].totalPassengerMiles, b[i].totalPassengerMiles)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run a set of settings through both engines with the same seeds and check that the
+// results and event counts are the same. It reports errors to cout.
+bool testFastEngine() {
+    struct TestCase {
+        const char *description;
+        long hours, planes, chargers, sites;
+        int faultOption, passengerCountOption, siteFlightOption, chargerPolicyOption;
+        long maxPassengerDelay;
+    };
+    const TestCase testCases[]{
+        {"defaults", 3, 20, 3, 1, 0, 0, 0, chargerPolicyFIFO, 0},
+        {"300 hours", 300, 20, 3, 1, 0, 0, 0, chargerPolicyFIFO, 0},
+        {"ground immediately", 300, 20, 3, 1, 1, 0, 0, chargerPolicyFIFO, 0},
+        {"ground after flight", 300, 20, 3, 1, 2, 0, 0, chargerPolicyFIFO, 0},
+        {"random passengers and delays", 300, 40, 5, 1, 0, 1, 0, chargerPolicyFIFO, 1800},
+        {"shortest charge", 300, 40, 4, 1, 0, 0, 0, chargerPolicyShortestCharge, 600},
+        {"company priority", 300, 40, 4, 1, 0, 0, 0, chargerPolicyCompanyPriority, 0},
+        {"passenger value", 300, 40, 4, 1, 0, 1, 0, chargerPolicyPassengerValue, 0},
+        {"reservation", 300, 40, 4, 1, 2, 0, 0, chargerPolicyReservation, 300},
+        {"sites, return home", 300, 60, 2, 5, 0, 0, 0, chargerPolicyFIFO, 600},
+        {"sites, fly between", 300, 60, 2, 5, 1, 1, 1, chargerPolicyFIFO, 600},
+        {"sites, policy", 300, 60, 2, 5, 0, 1, 1, chargerPolicyPassengerValue, 0},
+        {"no chargers", 30, 10, 0, 1, 0, 0, 0, chargerPolicyFIFO, 0},
+    };
+    const long seeds[]{1, 12345};
+
+    bool returnValue = true;
+    std::cout << " ***** Starting test of FastEngine against SimClock *****" << std::endl;
+    // Run once normally and once renumbering the clock very often
+    const uint32_t limits[]{UINT32_MAX, 50};
+    for(uint32_t limit: limits) {
+        FastEngine::sequenceLimit = limit;
+        for(const TestCase &aCase: testCases) {
+            for(long seed: seeds) {
+                SimSettings settings{};
+                settings.simulationDuration = aCase.hours * secondsPerHour;
+                settings.planeCount = aCase.planes;
+                settings.chargerCount = aCase.chargers;
+                settings.siteCount = aCase.sites;
+                settings.faultOption = aCase.faultOption;
+                settings.passengerCountOption = aCase.passengerCountOption;
+                settings.siteFlightOption = aCase.siteFlightOption;
+                settings.chargerPolicyOption = aCase.chargerPolicyOption;
+                settings.maxPassengerDelay = aCase.maxPassengerDelay;
+                settings.randomSeed = seed;
+                settings.progressInterval = 0;
+
+                settings.engineOption = 0;
+                Simulation handlerSimulation(settings);
+                handlerSimulation.setQuiet(true);
+                std::vector<FinalStats> handlerResults = handlerSimulation.run(false);
+                settings.engineOption = 1;
+                Simulation fastSimulation(settings);
+                fastSimulation.setQuiet(true);
+                std::vector<FinalStats> fastResults = fastSimulation.run(false);
+
+                bool same = sameResults(handlerResults, fastResults) &&
+                    handlerSimulation.getEventCount() == fastSimulation.getEventCount();
+                for(size_t site = 0; same && site < handlerSimulation.getSiteResults().size(); site++) {
+                    same = sameResults(handlerSimulation.getSiteResults()[site], fastSimulation.getSiteResults()[site]);
+                }
+                if(!same) {
+                    std::cout << "***** error: different results for " << aCase.description << " with seed " << seed
+                    << (limit != UINT32_MAX ? " while renumbering" : "") << " ("
+                    << handlerSimulation.getEventCount() << " and " << fastSimulation.getEventCount() << " events)" << std::endl;
+                    returnValue = false;
+                }
+            }
+        }
+    }
+    FastEngine::sequenceLimit = UINT32_MAX;
+    std::cout << "Test of FastEngine " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
+
+// Run the stress presets through both engines and report events per second for each
+bool benchmarkFastEngine() {
+    struct Preset {
+        const char *description;
+        long hours, planes, chargers, minPerKind, maxPassengerDelay;
+    };
+    // The 1000 plane preset is run for 300 hours instead of 4 years to keep this short
+    const Preset presets[]{
+        {"30 hours", 30, 20, 3, 1, 0},
+        {"300 hours", 300, 20, 3, 1, 0},
+        {"3,000 hours", 3000, 20, 3, 1, 0},
+        {"35,040 hours", 35040, 20, 3, 1, 0},
+        {"300 hours, 1000 planes, 150 chargers", 300, 1000, 150, 100, secondsPerHour},
+    };
+    std::cout << " ***** Comparing SimClock and FastEngine speed *****" << std::endl;
+    std::cout << std::left << std::setw(40) << "Preset" << std::setw(12) << "Events"
+    << std::setw(18) << "SimClock ev/sec" << std::setw(18) << "FastEngine ev/sec" << "Speedup" << std::endl;
+    bool returnValue = true;
+    for(const Preset &aPreset: presets) {
+        SimSettings settings{};
+        settings.simulationDuration = aPreset.hours * secondsPerHour;
+        settings.planeCount = aPreset.planes;
+        settings.chargerCount = aPreset.chargers;
+        settings.minPlanePerKind = aPreset.minPerKind;
+        settings.maxPassengerDelay = aPreset.maxPassengerDelay;
+        settings.randomSeed = 42;
+        settings.progressInterval = 0;
+        double eventsPerSecond[2]{};
+        long eventCounts[2]{};
+        for(int engine = 0; engine < 2; engine++) {
+            settings.engineOption = engine;
+            Simulation aSimulation(settings);
+            aSimulation.setQuiet(true);
+            auto startTimer = std::chrono::high_resolution_clock::now();
+            aSimulation.run(false);
+            auto stopTimer = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration<double>(stopTimer - startTimer).count();
+            eventCounts[engine] = aSimulation.getEventCount();
+            eventsPerSecond[engine] = seconds > 0 ? eventCounts[engine] / seconds : 0;
+        }
+        if(eventCounts[0] != eventCounts[1]) {
+            std::cout << "***** error: the engines handled " << eventCounts[0] << " and " << eventCounts[1] << " events" << std::endl;
+            returnValue = false;
+        }
+        std::cout << std::left << std::setw(40) << aPreset.description << std::setw(12) << eventCounts[1]
+        << std::fixed << std::setprecision(0) << std::setw(18) << eventsPerSecond[0] << std::setw(18) << eventsPerSecond[1]
+        << std::setprecision(2) << (eventsPerSecond[0] > 0 ? eventsPerSecond[1] / eventsPerSecond[0] : 0) << "x"
+        << std::defaultfloat << std::endl;
+    }
+    std::cout << std::endl;
+    return returnValue;
+}
+
+// Check that counting faults when each flight ends gives the same results with fewer events
+// when no plane waits for a charger, and that both engines agree when planes do wait. It
+// reports errors to cout.
+bool testFaultCountOption() {
+    struct TestCase {
+        const char *description;
+        long planes, chargers, sites;
+        int passengerCountOption, siteFlightOption;
+        long maxPassengerDelay;
+        bool contended;
+    };
+    const TestCase testCases[]{
+        {"chargers for every plane", 20, 20, 1, 0, 0, 0, false},
+        {"random passengers and delays", 30, 30, 1, 1, 0, 1800, false},
+        {"sites, fly between", 30, 30, 3, 1, 1, 600, false},
+        {"planes wait for chargers", 40, 4, 1, 0, 0, 0, true},
+        {"sites, planes wait", 60, 2, 5, 1, 1, 600, true},
+    };
+    bool returnValue = true;
+    std::cout << " ***** Starting test of counting faults when flights end *****" << std::endl;
+    for(const TestCase &aCase: testCases) {
+        SimSettings settings{};
+        settings.simulationDuration = 300 * secondsPerHour;
+        settings.planeCount = aCase.planes;
+        settings.chargerCount = aCase.chargers;
+        settings.siteCount = aCase.sites;
+        settings.passengerCountOption = aCase.passengerCountOption;
+        settings.siteFlightOption = aCase.siteFlightOption;
+        settings.maxPassengerDelay = aCase.maxPassengerDelay;
+        settings.randomSeed = 11;
+        settings.progressInterval = 0;
+
+        std::vector<FinalStats> results[2][2];
+        long events[2][2];
+        for(int engine = 0; engine < 2; engine++) {
+            for(int option = 0; option < 2; option++) {
+                settings.engineOption = engine;
+                settings.faultCountOption = option;
+                Simulation aSimulation(settings);
+                aSimulation.setQuiet(true);
+                results[engine][option] = aSimulation.run(false);
+                events[engine][option] = aSimulation.getEventCount();
+            }
+        }
+        for(int option = 0; option < 2; option++) {
+            if(!sameResults(results[0][option], results[1][option]) || events[0][option] != events[1][option]) {
+                std::cout << "***** error: " << aCase.description << " gave different results from the two engines with fault count option "
+                << option << std::endl;
+                returnValue = false;
+            }
+        }
+        // With no plane waiting, the order of events at the same second does not matter, so each
+        // flight has the same faults either way. Only the 0 second charges of flights cut off by
+        // the end can differ, since the flights are closed out in a different order.
+        for(size_t i = 0; !aCase.contended && i < results[1][0].size() && i < results[1][1].size(); i++) {
+            const FinalStats &a = results[1][0][i];
+            const FinalStats &b = results[1][1][i];
+            if(a.totalFlights != b.totalFlights || a.totalFaults != b.totalFaults ||
+               !sameValue(a.averageTimePerFlight, b.averageTimePerFlight) || !sameValue(a.totalPassengerMiles, b.totalPassengerMiles) ||
+               std::labs(a.totalCharges - b.totalCharges) > aCase.planes) {
+                std::cout << "***** error: " << aCase.description << " changed the results for " << companyName(a.theCompany)
+                << " without fault events" << std::endl;
+                returnValue = false;
+            }
+        }
+        if(events[1][1] >= events[1][0]) {
+            std::cout << "***** error: " << aCase.description << " had " << events[1][1] << " events without fault events and "
+            << events[1][0] << " with them" << std::endl;
+            returnValue = false;
+        }
+    }
+    std::cout << "Test of counting faults when flights end " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
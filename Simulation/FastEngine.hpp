@@ -0,0 +1,300 @@
+//
+//  FastEngine.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/5/25.
+//
+
+#ifndef FastEngine_hpp
+#define FastEngine_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "Simulation.hpp"
+#include "Plane.hpp"
+#include "RingBuffer.hpp"
+#include "ChargerPolicy.hpp"
+#include "SimProfile.hpp"
+#include "HardwareCounters.hpp"
+#include "EngineClock.hpp"
+
+/*
+ *******************************************************************************************
+ * Struct FastEvent
+ * One scheduled event in the FastEngine. It is 16 bytes: the time, the order it was
+ * scheduled (for ties) and which kind of thing it is for packed with the plane or site
+ * number. The kind is in the top two bits.
+ *******************************************************************************************
+ */
+// The kinds are FastEventKind values (see EngineClock.hpp).
+struct FastEvent {
+    long time;
+    uint32_t sequence;
+    uint32_t kindAndId;
+};
+const int fastKindShift{30};
+const uint32_t fastIdMask{(1u << fastKindShift) - 1};
+
+/*
+ *******************************************************************************************
+ * class FastEngine
+ * This runs the same simulation as the SimClock of EventHandler objects without creating
+ * an object for each flight or calling any virtual functions. Planes and sites are kept in
+ * arrays and the events are FastEvents in a single binary heap. Each event is handled by a
+ * switch on its kind.
+ *
+ * It follows the SimClock rules exactly so it gives the same results for the same seed:
+ *   - Each flight, charger queue and plane queue has one place in the clock at a time.
+ *     Events at the same time are handled in the order they were scheduled, and moving
+ *     something to a new time counts as scheduling it again, as SimClock::reSortHandler does.
+ *   - Anything being handled is out of the clock until it is done, so asking to move it
+ *     does nothing, just like SimClock.
+ *   - At the end, everything still in the clock is closed out latest first.
+ * When something moves, its old event is left in the heap and skipped when it comes up.
+ *
+ * It uses the same Plane objects, since they hold each plane's random numbers, and it
+ * fills the Simulation's theFlightStats and theChargerStats so the results are summarized
+ * by the same code.
+ *
+ * With SimSettings::cycleOption 1 it can also find the period of a run that repeats and
+ * skip whole periods (see FastEngineCycles.hpp).
+ *******************************************************************************************
+ */
+class FastEngine {
+public:
+    // Where one flight, charger queue or plane queue is in the clock
+    using ClockKey = EngineClockKey<uint32_t>;
+
+    // The sequence number that makes the engine renumber everything in the clock.
+    // Tests lower this to make sure renumbering does not change any results.
+    static uint32_t sequenceLimit;
+private:
+    // A plane and its current flight
+    struct FastPlane {
+        std::shared_ptr<Plane> thePlane; // For the plane's random numbers and fault interval
+        Company company;
+        int planeNumber;
+        double milesPerHour;
+        long timeOnFullCharge;
+        long timeToCharge;
+        long maxPassengers;
+        long startTime; // The rest are for the current flight, as in the Flight class
+        long endTime;
+        long nextFaultTime;
+        long nextEventTime;
+        long passengerCount;
+        long faultCount;
+        long originSite;
+        long destinationSite;
+    };
+    // A plane on a charger
+    struct FastCharger {
+        long timeStarted;
+        long timeStartedIncludingWait;
+        long timeDone;
+        long sequence;
+        long plane;
+    };
+    // A plane waiting for a charger, first come, first served
+    struct FastWaiting {
+        long timeStarted;
+        long plane;
+    };
+    // A plane waiting for passengers
+    struct FastReady {
+        long nextFlightTime;
+        long sequence;
+        long plane;
+    };
+    // The chargers and planes at one site
+    struct FastSite {
+        CountedVector<FastCharger> chargers; // Min-heap on (timeDone, sequence)
+        RingBuffer<FastWaiting, CountingAllocator<FastWaiting>> planesWaiting; // Planes waiting for a charger (FIFO policy)
+        CountedWaitingPlaneHeap planesWaitingByPolicy; // Planes waiting for a charger (any other policy)
+        long nextChargerSequence;
+        long chargerNextTime; // The ChargerQueue nextEventTime
+        CountedVector<FastReady> planesReady; // Min-heap on (nextFlightTime, sequence)
+        long nextPlaneSequence;
+        long groundedCount;
+        long planeQueueNextTime; // The PlaneQueue nextEventTime
+        long lastEventTime; // The rest find landings tied with other events (cycleOption)
+        long eventsAtLastTime; // Not counting faults in flight
+        bool landingAtLastTime;
+    };
+
+    Simulation *theSimulation;
+    std::shared_ptr<ChargerPolicy> thePolicy; // nullptr for first come, first served
+    long endTime;
+    long chargerCount;
+    long maxPassengerDelay;
+    int faultOption;
+    bool faultsAtEnd; // Faults are counted when each flight ends (SimSettings::faultCountOption)
+    // These are counted in the Simulation's memory like the objects the SimClock would use
+    CountedVector<FastPlane> fleet;
+    std::vector<FastSite> sites;
+    CountedVector<FastEvent> events; // Min-heap on (time, sequence)
+    CountedVector<ClockKey> flightKeys; // Indexed by plane
+    CountedVector<ClockKey> chargerKeys; // Indexed by site
+    CountedVector<ClockKey> planeQueueKeys; // Indexed by site
+    uint32_t nextSequence;
+    long eventCount;
+    SimProfile *theProfile; // The Simulation's profile if profiling is on, otherwise nullptr
+#if SIMPROFILE
+    HardwareCounters theCounters; // Open during run() if the profile asked for hardware counters
+#endif
+    long inClockCount; // How many things are in the clock, kept only while profiling
+    SimTrace *theTrace; // The Simulation's trace if it has one, otherwise nullptr
+    FlightRecorder *theRecorder; // The Simulation's flight recorder
+
+    // Where the run was after an event at site 0's chargers, for finding a repeat
+    struct CycleCheckpoint {
+        long time;
+        uint64_t check; // A second fingerprint, so a match of the first is not chance
+        long eventCount;
+        size_t flightsLogged;
+        size_t chargesLogged;
+        long kindEvents[profileKindCount]; // The profile's counts, if it is on
+    };
+    using CheckpointMap = std::unordered_map<uint64_t, CycleCheckpoint, std::hash<uint64_t>, std::equal_to<uint64_t>,
+        CountingAllocator<std::pair<const uint64_t, CycleCheckpoint>>>;
+    bool cycleSearch; // Still looking for a repeat (SimSettings::cycleOption)
+    CheckpointMap checkpoints; // By fingerprint
+    CountedVector<long> stateWords; // The state being fingerprinted
+    long fingerprintWork; // How many words have been fingerprinted, to know when to give up
+    long lastLandingTie; // The last time a landing was tied with another event at its site
+    std::string note; // What the cycle search found
+    // With SimSettings::chargeTimeDerivativeOption, the derivatives of the run's times with
+    // respect to the charge time it names, in seconds per hour of charge time
+    bool followDerivatives;
+    double chargeTimeDerivatives[companyCount]; // Of each company's charge: 3600 or 0
+    CountedVector<double> planeDerivatives; // Of each plane's last landing, or of when it is ready and takes off
+    CountedVector<double> chargeDerivatives; // Of when each plane started its last charge
+    CountedVector<double> freedDerivatives; // Of when the charges done in the charger event being handled were done, soonest first
+    // Start following them for chargeTimeDerivativeOption, once the fleet is made (see FastEngineDerivatives.cpp)
+    void startDerivatives(int derivativeOption);
+    // A waiting plane got the charger freed by the freed-th of freedDerivatives
+    void followWait(long plane, size_t freed);
+
+    long currentTime; // The time of the event being handled, or where the clock stopped
+    long progressInterval; // As SimClock::run shows progress
+    long nextProgressUpdate;
+
+    // Looking for repeats and skipping them (see FastEngineCycles.hpp)
+    // True if the settings make the run repeat (see SimSettings::cycleOption)
+    bool cyclesPossible();
+    // Fingerprint the state at currentTime, with a second independent fingerprint in check
+    uint64_t fingerprint(long currentTime, uint64_t &check);
+    // Fingerprint the state and, if it has been seen before, skip the whole repeats that fit
+    // before the end. It returns how far the times were moved on (0 if nothing was skipped).
+    long skipRepeats(long currentTime);
+    // Move every time in the state on by delta
+    void shiftTimes(long delta);
+
+    // Record an entry in the flight recorder for a flight (by plane number) or a queue (by site),
+    // as SimClock::record does
+    void record(long time, uint32_t kind, long id, RecorderAction action) {
+        theRecorder->record(time, kind, kind == fastFlightEvent ? fleet[id].planeNumber : id, action);
+    }
+
+    // The clock key for an event kind and plane or site number
+    ClockKey &keyFor(uint32_t kind, long id);
+
+    // Put something in the clock at a time with the next sequence (SimClock::addHandler)
+    void schedule(uint32_t kind, long id, long time);
+
+    // Move something already in the clock to a new time (SimClock::reSortHandler)
+    void reschedule(uint32_t kind, long id, long time);
+
+    // Give everything in the clock new sequence numbers starting from 0, keeping their order
+    void renumber();
+
+    // Handle one event. These return true if the flight or queue stays in the clock.
+    bool dispatch(uint32_t kind, long id, long currentTime, bool closeOut);
+#if SIMPROFILE
+    bool dispatchProfiled(uint32_t kind, long id, long currentTime);
+#endif
+    bool handleFlight(long plane, long currentTime);
+    bool handleChargers(long site, long currentTime, bool closeOut);
+    bool handlePlaneQueue(long site, long currentTime, bool closeOut);
+
+    // The time the flight or queue wants next after it has been handled
+    long nextTimeFor(uint32_t kind, long id);
+
+    // The same steps as the Flight, ChargerQueue and PlaneQueue functions with the same names
+    void startFlight(long plane, long currentTime, long passengerCount, long originSite, long destinationSite);
+    void recordFlight(FastPlane &aPlane);
+    void recordGrounded(const FastPlane &aPlane, long currentTime);
+    void addToChargers(long site, long currentTime, long plane, long reservationTime);
+    void addCharger(long site, long currentTime, long startedWaiting, long plane);
+    void addToPlaneQueue(long site, long delayUntil, long plane);
+    void logCharge(long site, const FastCharger &aCharger, long currentTime);
+public:
+    FastEngine(Simulation *theSimulation);
+
+    // A copy of another engine's stopped run for a new Simulation that already has a copy of
+    // the other Simulation's stats. Each plane is copied with its random numbers, so the copy
+    // carries on exactly as the original would. It does not look for repeats it found
+    // before, and it is not profiled or traced.
+    FastEngine(const FastEngine &other, Simulation *theSimulation);
+
+    // Create the planes for each site and run the simulation. It returns the final simulated time.
+    long run(const std::vector<std::vector<Company>> &siteCompanies);
+
+    // The steps of run(), so a run can stop part way and be copied (see Simulation::pauseAt()).
+    // start() creates the planes, runUntil() handles the events before stopTime (at most the
+    // end) and leaves the clock at stopTime, and closeOut() ends the run at the current time
+    // and returns it.
+    void start(const std::vector<std::vector<Company>> &siteCompanies);
+    long runUntil(long stopTime);
+    long closeOut();
+
+    // Copying and changing a stopped run (see FastEngineBranch.hpp)
+    // True if a run with these settings can be stopped and copied: the copy needs first
+    // come, first served chargers (the other policies' queues hold the planes themselves),
+    // a trace holds only one run, and a fault bias weights the intervals each plane drew.
+    static bool canBranch(const SimSettings &someSettings, const SimTrace *aTrace);
+
+    // Give every plane new random numbers from its own and branchNumber, so copies of the
+    // same run with different branch numbers go their own ways from here. The time to each
+    // plane's next fault is drawn again too, which exponential intervals allow.
+    void reseed(uint64_t branchNumber);
+
+    // Change the settings of a stopped run at the time it stopped (see SimDelta), for a copy
+    // in a Simulation whose settings already have the change. When faults stop being counted
+    // at the end of each flight, the faults so far in each flight are counted and the rest
+    // come as fault events. When they start being counted at the end, they stay as events,
+    // which count the same.
+    void applyDelta(const SimDelta &aDelta);
+
+    // How many events were handled (not counting the close-out). Skipped repeats count the
+    // events of the period they repeat, whose faults were different.
+    long getEventCount();
+
+    // What the cycle search found, or an empty string if it did not look
+    const std::string &getNote();
+};
+
+// Compare two result values or two sets of results, for the tests of the engines and the
+// options they share. The counts must match exactly. The averages and passenger miles are
+// sums of the same numbers in the same order so they should match too, but we allow for the
+// last bit of rounding.
+bool sameValue(double a, double b);
+bool sameResults(const std::vector<FinalStats> &a, const std::vector<FinalStats> &b);
+
+// Run a set of settings through both engines with the same seeds and check that the
+// results and event counts are the same. It reports errors to cout.
+bool testFastEngine();
+
+// Check that counting faults when each flight ends gives the same results with fewer events
+// when no plane waits for a charger, and that both engines agree when planes do wait. It
+// reports errors to cout.
+bool testFaultCountOption();
+
+// Run the stress presets through both engines and report events per second for each
+bool benchmarkFastEngine();
+
+#endif /* FastEngine_hpp */
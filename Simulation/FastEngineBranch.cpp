@@ -0,0 +1,371 @@
+//
+//  FastEngineBranch.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "FastEngineBranch.hpp"
+#include "Passenger.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+// A copy of another engine's stopped run, counted in the new Simulation's memory
+FastEngine::FastEngine(const FastEngine &other, Simulation *theSimulation): FastEngine(theSimulation) {
+    SimMemory *theMemory = &theSimulation->theMemory;
+    endTime = other.endTime;
+    chargerCount = other.chargerCount;
+    maxPassengerDelay = other.maxPassengerDelay;
+    faultOption = other.faultOption;
+    faultsAtEnd = other.faultsAtEnd;
+    theProfile = nullptr;
+    theTrace = nullptr;
+    fleet.reserve(other.fleet.size());
+    for(const FastPlane &aPlane: other.fleet) {
+        fleet.push_back(aPlane);
+        fleet.back().thePlane = std::allocate_shared<Plane>(CountingAllocator<Plane>(theMemory, memoryPlanes), *aPlane.thePlane);
+    }
+    sites.reserve(other.sites.size());
+    for(const FastSite &aSite: other.sites) {
+        RingBuffer<FastWaiting, CountingAllocator<FastWaiting>> planesWaiting(aSite.planesWaiting.size(), CountingAllocator<FastWaiting>(theMemory, memoryQueues));
+        for(size_t i = 0; i < aSite.planesWaiting.size(); i++) {
+            planesWaiting.push(aSite.planesWaiting[i]);
+        }
+        sites.push_back(FastSite{CountedVector<FastCharger>(begin(aSite.chargers), end(aSite.chargers), CountingAllocator<FastCharger>(theMemory, memoryQueues)),
+            planesWaiting, CountedWaitingPlaneHeap(CountingAllocator<WaitingPlane>(theMemory, memoryQueues)), aSite.nextChargerSequence, aSite.chargerNextTime,
+            CountedVector<FastReady>(begin(aSite.planesReady), end(aSite.planesReady), CountingAllocator<FastReady>(theMemory, memoryQueues)),
+            aSite.nextPlaneSequence, aSite.groundedCount, aSite.planeQueueNextTime, aSite.lastEventTime, aSite.eventsAtLastTime, aSite.landingAtLastTime});
+        if(chargerCount > 0) { sites.back().chargers.reserve(chargerCount); }
+    }
+    events.assign(begin(other.events), end(other.events));
+    flightKeys.assign(begin(other.flightKeys), end(other.flightKeys));
+    chargerKeys.assign(begin(other.chargerKeys), end(other.chargerKeys));
+    planeQueueKeys.assign(begin(other.planeQueueKeys), end(other.planeQueueKeys));
+    nextSequence = other.nextSequence;
+    eventCount = other.eventCount;
+    cycleSearch = other.cycleSearch;
+    lastLandingTie = other.lastLandingTie;
+    note = other.note;
+    currentTime = other.currentTime;
+    progressInterval = other.progressInterval;
+    nextProgressUpdate = other.nextProgressUpdate;
+}
+
+// A stopped run can be copied with first come, first served chargers, no trace and no fault bias
+bool FastEngine::canBranch(const SimSettings &someSettings, const SimTrace *aTrace) {
+    if(aTrace || someSettings.faultBias != 1.0) {
+        return false;
+    }
+    std::shared_ptr<ChargerPolicy> aPolicy = ChargerPolicy::makePolicy(someSettings.chargerPolicyOption, someSettings);
+    return !aPolicy || aPolicy->isFIFO();
+}
+
+// New random numbers for every plane, and new times to their next faults from now
+void FastEngine::reseed(uint64_t branchNumber) {
+    for(size_t plane = 0; plane < fleet.size(); plane++) {
+        FastPlane &aPlane = fleet[plane];
+        SimRandom &random = aPlane.thePlane->getRandom();
+        random.seed(SimRandom::streamSeed(random.next(), branchNumber));
+        aPlane.thePlane->createFaultInterval();
+        // A flight waiting for a fault event gets one at the new interval from now. Its flight
+        // time up to now was used by the interval that is gone, as decrementNextFaultInterval expects.
+        if(!faultsAtEnd && flightKeys[plane].inClock && aPlane.nextFaultTime != LONG_MAX) {
+            aPlane.nextFaultTime = currentTime + aPlane.thePlane->getNextFaultInterval();
+            aPlane.nextEventTime = std::min(aPlane.endTime, aPlane.nextFaultTime);
+            schedule(fastFlightEvent, static_cast<long>(plane), aPlane.nextEventTime);
+        }
+    }
+}
+
+// Change the chargers, passenger delay, fault option and fleet from the current time
+void FastEngine::applyDelta(const SimDelta &aDelta) {
+    if(aDelta.maxPassengerDelay >= 0) {
+        maxPassengerDelay = aDelta.maxPassengerDelay;
+    }
+    if(aDelta.faultOption >= 0) {
+        faultOption = aDelta.faultOption;
+        if(faultsAtEnd && !(faultOption == 0 && theSimulation->theSettings->faultCountOption == 1)) {
+            // The flights in the air count their faults so far, and wait for the next one as
+            // an event. handleFlight() uses up the rest of the interval from now.
+            faultsAtEnd = false;
+            for(size_t plane = 0; plane < fleet.size(); plane++) {
+                FastPlane &aPlane = fleet[plane];
+                if(flightKeys[plane].inClock) {
+                    aPlane.faultCount = aPlane.thePlane->countFaults(currentTime - aPlane.startTime);
+                    aPlane.nextFaultTime = currentTime + aPlane.thePlane->getNextFaultInterval();
+                    aPlane.nextEventTime = std::min(aPlane.endTime, aPlane.nextFaultTime);
+                    schedule(fastFlightEvent, static_cast<long>(plane), aPlane.nextEventTime);
+                }
+            }
+        }
+    }
+    if(aDelta.chargerCount >= 0) {
+        chargerCount = aDelta.chargerCount;
+        // New chargers take the planes that have waited longest, as handleChargers() would
+        for(size_t site = 0; site < sites.size(); site++) {
+            FastSite &aSite = sites[site];
+            while(static_cast<long>(aSite.chargers.size()) < chargerCount && !aSite.planesWaiting.empty()) {
+                FastWaiting aWaitingPlane = aSite.planesWaiting.front();
+                aSite.planesWaiting.pop();
+                addCharger(static_cast<long>(site), currentTime, aWaitingPlane.timeStarted, aWaitingPlane.plane);
+            }
+        }
+    }
+    // New planes join the plane queues as at the start of a run
+    for(size_t site = 0; site < aDelta.addedPlanes.size() && site < sites.size(); site++) {
+        for(Company c: aDelta.addedPlanes[site]) {
+            std::shared_ptr<Plane> thePlane = theSimulation->makePlane(c);
+            long plane = static_cast<long>(fleet.size());
+            fleet.push_back(FastPlane{thePlane, c, thePlane->getPlaneNumber(), thePlane->getMilesPerHour(),
+                thePlane->calcTimeOnFullCharge__seconds(), thePlane->calcTimeToCharge__seconds(), thePlane->getMaxPassengerCount(),
+                0, 0, 0, LONG_MAX, 0, 0, static_cast<long>(site), static_cast<long>(site)});
+            flightKeys.push_back(ClockKey{LONG_MAX, 0, false});
+            long waitForPassengers = Passenger::getPassengerDelay(maxPassengerDelay, thePlane->getRandom());
+            addToPlaneQueue(static_cast<long>(site), currentTime + waitForPassengers, plane);
+        }
+    }
+    // The change may leave settings that cannot repeat
+    cycleSearch = cycleSearch && cyclesPossible();
+}
+// Check that pausing a run and finishing it gives the same results as running it, that a
+// branch number always gives the same branch and different ones differ, and that branches
+// of a warmed-up run average close to runs from the start. It reports errors to cout.
+bool testBranching() {
+    struct TestCase {
+        const char *description;
+        long planes, chargers, sites;
+        int faultOption, faultCountOption, passengerCountOption, siteFlightOption;
+        long maxPassengerDelay;
+    };
+    const TestCase testCases[]{
+        {"chargers for every plane", 20, 20, 1, 0, 0, 0, 0, 0},
+        {"planes wait for chargers", 60, 6, 1, 0, 0, 1, 0, 1800},
+        {"faults counted when flights end", 60, 6, 1, 0, 1, 1, 0, 1800},
+        {"sites, fly between", 90, 4, 3, 0, 0, 1, 1, 600},
+        {"ground immediately", 60, 10, 1, 1, 0, 0, 0, 600},
+        {"ground after flight", 60, 10, 1, 2, 0, 0, 0, 600},
+    };
+    bool returnValue = true;
+    std::cout << " ***** Starting test of pausing and branching runs *****" << std::endl;
+    for(const TestCase &aCase: testCases) {
+        SimSettings settings{};
+        settings.simulationDuration = 200 * secondsPerHour;
+        settings.planeCount = aCase.planes;
+        settings.chargerCount = aCase.chargers;
+        settings.siteCount = aCase.sites;
+        settings.faultOption = aCase.faultOption;
+        settings.faultCountOption = aCase.faultCountOption;
+        settings.passengerCountOption = aCase.passengerCountOption;
+        settings.siteFlightOption = aCase.siteFlightOption;
+        settings.maxPassengerDelay = aCase.maxPassengerDelay;
+        settings.engineOption = 1;
+        settings.randomSeed = 17;
+        settings.progressInterval = 0;
+
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        std::vector<FinalStats> results = aSimulation.run(false);
+        long events = aSimulation.getEventCount();
+        // Pausing and carrying on is the same as not pausing
+        Simulation pausedSimulation(settings);
+        pausedSimulation.setQuiet(true);
+        if(pausedSimulation.pauseAt(50 * secondsPerHour) != 50 * secondsPerHour) {
+            std::cout << "***** error: " << aCase.description << " did not pause at 50 hours" << std::endl;
+            returnValue = false;
+            continue;
+        }
+        std::unique_ptr<Simulation> branches[3]{pausedSimulation.branch(5), pausedSimulation.branch(5), pausedSimulation.branch(6)};
+        std::vector<FinalStats> pausedResults = pausedSimulation.finish();
+        if(!sameResults(results, pausedResults) || pausedSimulation.getEventCount() != events) {
+            std::cout << "***** error: " << aCase.description << " gave different results when paused" << std::endl;
+            returnValue = false;
+        }
+        // The same branch number gives the same branch, and another number a different one
+        std::vector<FinalStats> branchResults[3];
+        for(int i = 0; i < 3; i++) {
+            branchResults[i] = branches[i]->finish();
+        }
+        if(!sameResults(branchResults[0], branchResults[1])) {
+            std::cout << "***** error: " << aCase.description << " gave different results for the same branch" << std::endl;
+            returnValue = false;
+        }
+        if(sameResults(branchResults[0], branchResults[2]) || sameResults(branchResults[0], results)) {
+            std::cout << "***** error: " << aCase.description << " gave the same results for different branches" << std::endl;
+            returnValue = false;
+        }
+    }
+
+    // Branches from a warm-up average about the same as runs from the start
+    SimSettings settings{};
+    settings.simulationDuration = 200 * secondsPerHour;
+    settings.planeCount = 200;
+    settings.minPlanePerKind = 40; // So every run has the same fleet
+    settings.chargerCount = 30;
+    settings.passengerCountOption = 1;
+    settings.maxPassengerDelay = 1800;
+    settings.engineOption = 1;
+    settings.progressInterval = 0;
+    const long runCount = 20;
+    double flights[2]{}, waits[2]{};
+    settings.randomSeed = 23;
+    Simulation warmedUp(settings);
+    warmedUp.setQuiet(true);
+    warmedUp.pauseAt(50 * secondsPerHour);
+    for(long run = 0; run < runCount; run++) {
+        settings.randomSeed = 23 + run;
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        std::vector<FinalStats> results[2]{aSimulation.run(false), warmedUp.branch(run + 1)->finish()};
+        for(int i = 0; i < 2; i++) {
+            for(const FinalStats &f: results[i]) {
+                flights[i] += f.totalFlights;
+                waits[i] += f.averageTimeChargingWithWait - f.averageTimeCharging;
+            }
+        }
+    }
+    if(std::fabs(flights[1] - flights[0]) > 0.01 * flights[0] || std::fabs(waits[1] - waits[0]) > 0.05 * waits[0]) {
+        std::cout << "***** error: branches averaged " << flights[1] / runCount << " flights and runs from the start "
+        << flights[0] / runCount << std::endl;
+        returnValue = false;
+    }
+
+    // Other charger policies cannot be paused, and only a paused run can be branched
+    settings.chargerPolicyOption = chargerPolicyShortestCharge;
+    Simulation policySimulation(settings);
+    policySimulation.setQuiet(true);
+    if(policySimulation.pauseAt(secondsPerHour) != -1 || policySimulation.branch(1)) {
+        std::cout << "***** error: a run with another charger policy was paused" << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of pausing and branching runs " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
+
+// Check what-if runs from a paused run against the paused run and against runs from the start
+bool testWhatIf() {
+    auto change = [](long chargerCount, long maxPassengerDelay, int faultOption) {
+        SimDelta aDelta{};
+        aDelta.chargerCount = chargerCount;
+        aDelta.maxPassengerDelay = maxPassengerDelay;
+        aDelta.faultOption = faultOption;
+        return aDelta;
+    };
+    bool returnValue = true;
+    std::cout << " ***** Starting test of what-if runs *****" << std::endl;
+    SimSettings settings{};
+    settings.simulationDuration = 200 * secondsPerHour;
+    settings.planeCount = 60;
+    settings.chargerCount = 6;
+    settings.siteCount = 2;
+    settings.passengerCountOption = 1;
+    settings.maxPassengerDelay = 1800;
+    settings.engineOption = 1;
+    settings.randomSeed = 31;
+    settings.progressInterval = 0;
+
+    // A what-if with no change finishes as the paused run does
+    const int faultCountOptions[]{0, 1};
+    for(int faultCountOption: faultCountOptions) {
+        settings.faultCountOption = faultCountOption;
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        std::vector<FinalStats> results = aSimulation.run(false);
+        Simulation pausedSimulation(settings);
+        pausedSimulation.setQuiet(true);
+        pausedSimulation.pauseAt(50 * secondsPerHour);
+        std::unique_ptr<Simulation> noChange = pausedSimulation.whatIf(SimDelta{});
+        if(!noChange || !sameResults(results, noChange->finish()) || noChange->getEventCount() != aSimulation.getEventCount()) {
+            std::cout << "***** error: a what-if with no change gave different results" << std::endl;
+            returnValue = false;
+        }
+    }
+
+    // Changes at time 0 are the same as running with them from the start. Nothing has flown or
+    // charged yet, so only the passenger delays already drawn could differ, and they are not changed.
+    struct StartCase {
+        const char *description;
+        int faultOption, faultCountOption;
+        SimDelta aDelta;
+    };
+    const StartCase startCases[]{
+        {"more chargers", 0, 0, change(12, -1, -1)},
+        {"fewer chargers", 0, 0, change(3, -1, -1)},
+        {"ground immediately", 0, 0, change(-1, -1, 1)},
+        {"ground after flight, faults were counted at the end", 0, 1, change(8, -1, 2)},
+        {"no more grounding", 2, 0, change(-1, -1, 0)},
+    };
+    for(const StartCase &aCase: startCases) {
+        settings.faultOption = aCase.faultOption;
+        settings.faultCountOption = aCase.faultCountOption;
+        Simulation pausedSimulation(settings);
+        pausedSimulation.setQuiet(true);
+        pausedSimulation.pauseAt(0);
+        std::unique_ptr<Simulation> aWhatIf = pausedSimulation.whatIf(aCase.aDelta);
+        SimSettings changedSettings = settings;
+        changedSettings.chargerCount = aCase.aDelta.chargerCount >= 0 ? aCase.aDelta.chargerCount : settings.chargerCount;
+        changedSettings.faultOption = aCase.aDelta.faultOption >= 0 ? aCase.aDelta.faultOption : settings.faultOption;
+        Simulation aSimulation(changedSettings);
+        aSimulation.setQuiet(true);
+        if(!aWhatIf || !sameResults(aSimulation.run(false), aWhatIf->finish())) {
+            std::cout << "***** error: " << aCase.description << " from time 0 differs from a run with the change" << std::endl;
+            returnValue = false;
+        }
+    }
+
+    // Changes part way through move the results the way they should
+    settings.faultOption = 0;
+    settings.faultCountOption = 1;
+    Simulation pausedSimulation(settings);
+    pausedSimulation.setQuiet(true);
+    pausedSimulation.pauseAt(50 * secondsPerHour);
+    // With chargers for every plane the added planes only add flights
+    SimDelta morePlanes = change(40, -1, -1);
+    morePlanes.addedPlanes = {{Alpha, Alpha, Bravo}, {Alpha, Charlie}};
+    struct Totals { long flights, faults; double waits; };
+    auto totalsOf = [](Simulation &aSimulation) {
+        Totals totals{0, 0, 0};
+        for(const FinalStats &f: aSimulation.finish()) {
+            totals.flights += f.totalFlights;
+            totals.faults += f.totalFaults;
+            totals.waits += (f.averageTimeChargingWithWait - f.averageTimeCharging) * f.totalCharges;
+        }
+        return totals;
+    };
+    Totals base = totalsOf(*pausedSimulation.whatIf(SimDelta{}));
+    Totals moreChargers = totalsOf(*pausedSimulation.whatIf(change(12, -1, -1)));
+    Totals enoughChargers = totalsOf(*pausedSimulation.whatIf(change(40, -1, -1)));
+    Totals longerDelay = totalsOf(*pausedSimulation.whatIf(change(-1, 4 * secondsPerHour, -1)));
+    Totals grounding = totalsOf(*pausedSimulation.whatIf(change(-1, -1, 1)));
+    std::unique_ptr<Simulation> withPlanes = pausedSimulation.whatIf(morePlanes);
+    Totals planesAdded = totalsOf(*withPlanes);
+    if(moreChargers.waits >= base.waits || moreChargers.flights <= base.flights) {
+        std::cout << "***** error: more chargers did not cut the waits" << std::endl;
+        returnValue = false;
+    }
+    if(longerDelay.flights >= base.flights) {
+        std::cout << "***** error: a longer passenger delay did not cut the flights" << std::endl;
+        returnValue = false;
+    }
+    if(grounding.flights >= base.flights || grounding.faults == 0) {
+        std::cout << "***** error: grounding planes at faults did not cut the flights" << std::endl;
+        returnValue = false;
+    }
+    if(planesAdded.flights <= enoughChargers.flights || withPlanes->getEngineNote().find("5 more planes") == std::string::npos) {
+        std::cout << "***** error: adding planes did not add flights" << std::endl;
+        returnValue = false;
+    }
+
+    // Only a paused run can be changed, and only at sites it has
+    SimDelta badSite{};
+    badSite.addedPlanes.resize(3);
+    Simulation notPaused(settings);
+    if(notPaused.whatIf(SimDelta{}) || pausedSimulation.whatIf(badSite)) {
+        std::cout << "***** error: a what-if was made that should not have been" << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of what-if runs " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
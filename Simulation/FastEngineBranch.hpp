@@ -0,0 +1,42 @@
+//
+//  FastEngineBranch.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef FastEngineBranch_hpp
+#define FastEngineBranch_hpp
+
+#include <stdio.h>
+#include "FastEngine.hpp"
+
+/*
+ *******************************************************************************************
+ * Copying and changing a stopped FastEngine
+ * Simulation::pauseAt() runs the FastEngine part way and stops it, and Simulation::branch()
+ * copies it into a new Simulation with a copy of the stats so far. The copy constructor
+ * copies every plane with its random numbers, every site's queues and the whole clock, so
+ * the copy carries on exactly as the original would. reseed() then gives each plane new
+ * random numbers from its own and the branch number. canBranch() says which settings allow
+ * it: the other charger policies' queues hold the planes themselves, a trace holds one run,
+ * and a fault bias weights the intervals each plane drew.
+ *
+ * Simulation::whatIf() copies it the same way but keeps the random numbers, and
+ * applyDelta() changes the copy's chargers, passenger delay, fault option or fleet at the
+ * time it stopped. New chargers take the planes that have waited longest and new planes
+ * join the plane queues as at the start of a run.
+ *******************************************************************************************
+ */
+
+// Check that pausing a run and finishing it gives the same results as running it, that a
+// branch number always gives the same branch and different ones differ, and that branches
+// of a warmed-up run average close to runs from the start. It reports errors to cout.
+bool testBranching();
+
+// Check that a what-if with no change finishes as the paused run would, that changes made
+// at the start match runs with those settings, and that changes part way through move the
+// results the way they should. It reports errors to cout.
+bool testWhatIf();
+
+#endif /* FastEngineBranch_hpp */
@@ -0,0 +1,295 @@
+//
+//  FastEngineCycles.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "FastEngineCycles.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+// Stop looking for a repeat after fingerprinting this many words of state
+static const long maxFingerprintWords{20000000};
+
+// True if the settings make the run repeat: nothing is random but the faults, and they
+// are only counted. A trace or memory budget needs every event handled, a fault bias
+// needs every fault interval drawn and the derivatives are followed along every event.
+bool FastEngine::cyclesPossible() {
+    std::shared_ptr<SimSettings> theSettings = theSimulation->theSettings;
+    return theSettings->passengerCountOption == 0 && maxPassengerDelay <= 0 && faultOption == 0 &&
+        (theSettings->siteFlightOption != 1 || sites.size() < 2) && !thePolicy && chargerCount > 0 &&
+        !theTrace && theSettings->memoryBudgetMB <= 0 && theSettings->faultBias == 1.0 && !followDerivatives;
+}
+
+// Fingerprint the state at currentTime: the clock in order, then each site's chargers,
+// waiting planes and planes waiting for passengers, all with times relative to now. A
+// flight is placed in the clock by the end of the flight, not its next fault. The second
+// fingerprint in check uses a different hash of the same words.
+uint64_t FastEngine::fingerprint(long currentTime, uint64_t &check) {
+    auto relative = [currentTime](long time) { return time == LONG_MAX ? -1L : time - currentTime; };
+    stateWords.clear();
+    struct Entry { long time; uint32_t sequence; uint32_t kind; long id; };
+    std::vector<Entry> entries{};
+    const uint32_t kinds[]{fastFlightEvent, fastChargerEvent, fastPlaneQueueEvent};
+    for(uint32_t kind: kinds) {
+        long count = static_cast<long>(kind == fastFlightEvent ? fleet.size() : sites.size());
+        for(long id = 0; id < count; id++) {
+            const ClockKey &key = keyFor(kind, id);
+            if(key.inClock) {
+                entries.push_back(Entry{kind == fastFlightEvent ? fleet[id].endTime : key.time, key.sequence, kind, id});
+            }
+        }
+    }
+    std::sort(begin(entries), end(entries), [](const Entry &a, const Entry &b) {
+        return a.time < b.time || (a.time == b.time && a.sequence < b.sequence);
+    });
+    for(const Entry &anEntry: entries) {
+        stateWords.push_back(anEntry.kind);
+        stateWords.push_back(anEntry.id);
+        stateWords.push_back(relative(anEntry.time));
+        if(anEntry.kind == fastFlightEvent) {
+            stateWords.push_back(relative(fleet[anEntry.id].startTime));
+            stateWords.push_back(fleet[anEntry.id].destinationSite);
+        }
+    }
+    for(const FastSite &aSite: sites) {
+        stateWords.push_back(-2);
+        std::vector<FastCharger> chargers(begin(aSite.chargers), end(aSite.chargers));
+        std::sort(begin(chargers), end(chargers), [](const FastCharger &a, const FastCharger &b) { return doneLater(b, a); });
+        for(const FastCharger &aCharger: chargers) {
+            stateWords.push_back(aCharger.plane);
+            stateWords.push_back(relative(aCharger.timeDone));
+            stateWords.push_back(relative(aCharger.timeStarted));
+            stateWords.push_back(relative(aCharger.timeStartedIncludingWait));
+        }
+        stateWords.push_back(-3);
+        for(size_t index = 0; index < aSite.planesWaiting.size(); index++) {
+            stateWords.push_back(aSite.planesWaiting[index].plane);
+            stateWords.push_back(relative(aSite.planesWaiting[index].timeStarted));
+        }
+        stateWords.push_back(-4);
+        std::vector<FastReady> ready(begin(aSite.planesReady), end(aSite.planesReady));
+        std::sort(begin(ready), end(ready), [](const FastReady &a, const FastReady &b) { return readyLater(b, a); });
+        for(const FastReady &aReady: ready) {
+            stateWords.push_back(aReady.plane);
+            stateWords.push_back(relative(aReady.nextFlightTime));
+        }
+        stateWords.push_back(-5);
+        stateWords.push_back(aSite.groundedCount);
+    }
+    fingerprintWork += static_cast<long>(stateWords.size());
+    // FNV-1a over the bytes of each word, and a multiply and rotate hash for the check
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    check = 0x9E3779B97F4A7C15ULL;
+    for(long word: stateWords) {
+        uint64_t value = static_cast<uint64_t>(word);
+        for(int shift = 0; shift < 64; shift += 8) {
+            hash = (hash ^ ((value >> shift) & 0xFF)) * 0x100000001B3ULL;
+        }
+        check = (check ^ (value * 0xBF58476D1CE4E5B9ULL)) * 0x94D049BB133111EBULL;
+        check = (check << 31) | (check >> 33);
+    }
+    return hash;
+}
+
+// Fingerprint the state and, if it has been seen before, skip the whole repeats that fit
+// before the end. The flights and charges logged since the state was last seen are one
+// period. It returns how far the times were moved on (0 if nothing was skipped).
+long FastEngine::skipRepeats(long currentTime) {
+    CountedVector<FlightStats> &flights = theSimulation->theFlightStats;
+    CountedVector<ChargerStats> &charges = theSimulation->theChargerStats;
+    uint64_t check{0};
+    uint64_t hash = fingerprint(currentTime, check);
+    CycleCheckpoint now{currentTime, check, eventCount, flights.size(), charges.size(), {}};
+#if SIMPROFILE
+    if(theProfile) {
+        for(int kind = 0; kind < profileKindCount; kind++) { now.kindEvents[kind] = theProfile->kinds[kind].events; }
+    }
+#endif
+    auto found = checkpoints.find(hash);
+    if(found == checkpoints.end() || found->second.check != check) {
+        if(fingerprintWork > maxFingerprintWords) {
+            cycleSearch = false;
+            CheckpointMap(0, std::hash<uint64_t>{}, std::equal_to<uint64_t>{}, checkpoints.get_allocator()).swap(checkpoints);
+            note = "no repeat found by " + std::to_string(currentTime) + " seconds, every event was handled";
+        } else {
+            checkpoints[hash] = now;
+        }
+        return 0;
+    }
+    CycleCheckpoint before = found->second;
+    if(lastLandingTie >= before.time) {
+        // The same state came round, but the faults could have changed what happened in between
+        found->second = now;
+        return 0;
+    }
+    cycleSearch = false;
+    CheckpointMap(0, std::hash<uint64_t>{}, std::equal_to<uint64_t>{}, checkpoints.get_allocator()).swap(checkpoints);
+    long period = currentTime - before.time;
+    long repeats = period > 0 ? (endTime - 1 - currentTime) / period : 0;
+    note = "repeats every " + std::to_string(period) + " seconds from " + std::to_string(before.time) + " seconds";
+    if(repeats <= 0) {
+        note += ", too near the end to skip any";
+        return 0;
+    }
+
+    // Add up one period without its faults, and how long each plane flew in it
+    StatsTotals onePeriod{};
+    onePeriod.reset(static_cast<long>(sites.size()));
+    std::vector<long> flown(fleet.size(), 0);
+    long firstPlaneNumber = fleet.empty() ? 0 : fleet[0].planeNumber;
+    for(size_t index = before.flightsLogged; index < now.flightsLogged; index++) {
+        FlightStats aFlight = flights[index];
+        long plane = aFlight.planeNumber - firstPlaneNumber;
+        if(plane >= 0 && plane < static_cast<long>(fleet.size())) { flown[plane] += aFlight.duration; }
+        aFlight.faultCount = 0;
+        onePeriod.addFlight(aFlight);
+    }
+    for(size_t index = before.chargesLogged; index < now.chargesLogged; index++) {
+        onePeriod.addCharge(charges[index]);
+    }
+    StatsTotals &theTotals = theSimulation->theTotals;
+    theTotals.add(onePeriod, repeats);
+    // Each plane's faults in the skipped flight time come from its own random numbers. Without
+    // fault events the plane's fault intervals are walked over that time, as its flights would.
+    // With them, the current interval belongs to the flight in the air, so the count is drawn.
+    for(size_t plane = 0; plane < fleet.size(); plane++) {
+        if(flown[plane] <= 0) { continue; }
+        FastPlane &aPlane = fleet[plane];
+        long faults = faultsAtEnd ? aPlane.thePlane->countFaults(flown[plane] * repeats) :
+            aPlane.thePlane->getRandom().poisson(static_cast<double>(flown[plane]) * repeats / aPlane.thePlane->calcMeanTimeBetweenFaults());
+        if(faults > 0) {
+            theTotals.addFlight(FlightStats{aPlane.company, aPlane.planeNumber, 0, 0, faults, 0.0, aPlane.originSite}, 0);
+        }
+    }
+    eventCount += repeats * (now.eventCount - before.eventCount);
+#if SIMPROFILE
+    if(theProfile) {
+        for(int kind = 0; kind < profileKindCount; kind++) {
+            theProfile->kinds[kind].events += repeats * (now.kindEvents[kind] - before.kindEvents[kind]);
+        }
+    }
+#endif
+    long delta = repeats * period;
+    shiftTimes(delta);
+    note += ", skipped " + std::to_string(repeats) + " repeats (" + std::to_string(delta / secondsPerHour) + " hours)";
+    return delta;
+}
+
+// Move every time in the state on by delta. The heaps stay in order since every time moves
+// the same amount.
+void FastEngine::shiftTimes(long delta) {
+    auto shift = [delta](long &time) { if(time != LONG_MAX) { time += delta; } };
+    for(size_t plane = 0; plane < fleet.size(); plane++) {
+        if(flightKeys[plane].inClock) {
+            FastPlane &aPlane = fleet[plane];
+            shift(aPlane.startTime);
+            shift(aPlane.endTime);
+            shift(aPlane.nextFaultTime);
+            shift(aPlane.nextEventTime);
+        }
+    }
+    for(CountedVector<ClockKey> *keys: {&flightKeys, &chargerKeys, &planeQueueKeys}) {
+        for(ClockKey &key: *keys) {
+            if(key.inClock) { shift(key.time); }
+        }
+    }
+    for(FastEvent &anEvent: events) {
+        shift(anEvent.time);
+    }
+    for(FastSite &aSite: sites) {
+        for(FastCharger &aCharger: aSite.chargers) {
+            shift(aCharger.timeStarted);
+            shift(aCharger.timeStartedIncludingWait);
+            shift(aCharger.timeDone);
+        }
+        for(size_t index = 0; index < aSite.planesWaiting.size(); index++) {
+            shift(aSite.planesWaiting[index].timeStarted);
+        }
+        for(FastReady &aReady: aSite.planesReady) {
+            shift(aReady.nextFlightTime);
+        }
+        shift(aSite.chargerNextTime);
+        shift(aSite.planeQueueNextTime);
+    }
+}
+
+// Check that skipping repeats gives the same flights, charges and passenger miles as handling
+// every event, with faults close to the same, and that it only skips when it should. It
+// reports errors to cout.
+bool testCycleSkipping() {
+    struct TestCase {
+        const char *description;
+        long hours, planes, chargers, sites;
+        long maxPassengerDelay;
+        bool skips;
+    };
+    const TestCase testCases[]{
+        {"one plane", 3000, 1, 1, 1, 0, true},
+        {"waiting for chargers", 3000, 17, 2, 1, 0, true},
+        {"defaults, no repeat", 300, 20, 3, 1, 0, false},
+        {"passenger delay", 300, 20, 3, 1, 600, false},
+    };
+    bool returnValue = true;
+    std::cout << " ***** Starting test of skipping repeats *****" << std::endl;
+    for(const TestCase &aCase: testCases) {
+        SimSettings settings{};
+        settings.simulationDuration = aCase.hours * secondsPerHour;
+        settings.planeCount = aCase.planes;
+        settings.chargerCount = aCase.chargers;
+        settings.siteCount = aCase.sites;
+        settings.maxPassengerDelay = aCase.maxPassengerDelay;
+        settings.randomSeed = 7;
+        settings.progressInterval = 0;
+        settings.engineOption = 1;
+
+        settings.cycleOption = 0;
+        Simulation plainSimulation(settings);
+        plainSimulation.setQuiet(true);
+        std::vector<FinalStats> plainResults = plainSimulation.run(false);
+
+        settings.cycleOption = 1;
+        Simulation skippingSimulation(settings);
+        skippingSimulation.setQuiet(true);
+        std::vector<FinalStats> skippingResults = skippingSimulation.run(false);
+        const std::string &note = skippingSimulation.getEngineNote();
+
+        bool skipped = note.find("skipped") != std::string::npos;
+        if(skipped != aCase.skips || (!aCase.skips && !note.empty())) {
+            std::cout << "***** error: " << aCase.description << " gave the note \"" << note << "\"" << std::endl;
+            returnValue = false;
+        }
+        if(skippingResults.size() != plainResults.size()) {
+            std::cout << "***** error: " << aCase.description << " gave a different number of results" << std::endl;
+            returnValue = false;
+            continue;
+        }
+        if(!aCase.skips && !sameResults(skippingResults, plainResults)) {
+            std::cout << "***** error: " << aCase.description << " changed the results without skipping" << std::endl;
+            returnValue = false;
+        }
+        for(size_t i = 0; i < plainResults.size(); i++) {
+            const FinalStats &a = plainResults[i];
+            const FinalStats &b = skippingResults[i];
+            // The faults are a different draw, so allow about five standard deviations
+            double faultTolerance = 5.0 * std::sqrt(static_cast<double>(a.totalFaults)) + 5.0;
+            if(a.theCompany != b.theCompany || a.totalFlights != b.totalFlights || a.totalCharges != b.totalCharges ||
+               !sameValue(a.averageTimePerFlight, b.averageTimePerFlight) ||
+               !sameValue(a.averageDistancePerFlight, b.averageDistancePerFlight) ||
+               !sameValue(a.averageTimeCharging, b.averageTimeCharging) ||
+               !sameValue(a.averageTimeChargingWithWait, b.averageTimeChargingWithWait) ||
+               !sameValue(a.totalPassengerMiles, b.totalPassengerMiles) ||
+               std::fabs(static_cast<double>(a.totalFaults - b.totalFaults)) > faultTolerance) {
+                std::cout << "***** error: " << aCase.description << " gave different results for "
+                << companyName(a.theCompany) << " (" << a.totalFlights << " flights, " << a.totalFaults << " faults against "
+                << b.totalFlights << ", " << b.totalFaults << ")" << std::endl;
+                returnValue = false;
+            }
+        }
+    }
+    std::cout << "Test of skipping repeats " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
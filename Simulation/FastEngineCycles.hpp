@@ -0,0 +1,48 @@
+//
+//  FastEngineCycles.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef FastEngineCycles_hpp
+#define FastEngineCycles_hpp
+
+#include <stdio.h>
+#include "FastEngine.hpp"
+
+/*
+ *******************************************************************************************
+ * Skipping repeats in the FastEngine
+ * With SimSettings::cycleOption 1 and settings where nothing is random but the faults, the
+ * fleet can settle into a pattern that repeats. After each event at site 0's chargers it
+ * takes a fingerprint of the state: the clock in order, every charger, waiting plane and
+ * plane waiting for passengers, with times relative to now and without the faults. When a
+ * fingerprint comes round again the time between is one period. The flights and charges
+ * logged in one period are added to the totals once for each whole period that fits before
+ * the end, every time in the state is moved on by those periods, and the run carries on to
+ * the end from there. Each plane's faults in the skipped time are a Poisson count for its
+ * flight time from its own random numbers. If there is no repeat before the fingerprints
+ * have cost about as much as a few million events, it stops looking.
+ *
+ * A fault moves its flight to a new place in the clock, so it can change which of two
+ * events at the same second is handled first. A period only counts as a repeat if no plane
+ * landed at the same second as another event at its site during it, since a fault in a
+ * later period could change what happened then. So the flights and charges are exactly
+ * those of handling every event, but fleets whose landings keep lining up with other
+ * events are never skipped. With SimSettings::faultCountOption 1 there are no fault events,
+ * so any repeat counts, and the skipped faults come from walking each plane's fault
+ * intervals over its skipped flight time instead of a Poisson draw.
+ *
+ * These are the FastEngine functions cyclesPossible(), fingerprint(), skipRepeats() and
+ * shiftTimes(). runUntil() calls skipRepeats() after each event at site 0's chargers while
+ * it is still looking.
+ *******************************************************************************************
+ */
+
+// Check that skipping repeats gives the same flights, charges and passenger miles as handling
+// every event, with faults close to the same, and that it only skips when it should. It
+// reports errors to cout.
+bool testCycleSkipping();
+
+#endif /* FastEngineCycles_hpp */
@@ -0,0 +1,45 @@
+//
+//  FastEngineDerivatives.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "FastEngine.hpp"
+#include <algorithm>
+
+/*
+ *******************************************************************************************
+ * Following the derivatives in the FastEngine
+ * With SimSettings::chargeTimeDerivativeOption the FastEngine carries the derivative of each
+ * plane's landing and charge start with respect to the charge time along the run (see
+ * Sensitivity.hpp). The handlers add to them as they go: a charge that is done adds the
+ * charge time's derivative, a plane that waited starts from the later of its landing and the
+ * charge it follows, and a flight cut off at the end loses passenger miles. These are the
+ * parts that are not in the handlers.
+ *******************************************************************************************
+ */
+
+// Follow the derivatives if they were asked for. Every plane's first passenger delay is
+// fixed, so they start at 0. The other charger policies choose planes by keys that the
+// derivatives cannot follow.
+void FastEngine::startDerivatives(int derivativeOption) {
+    followDerivatives = derivativeOption >= 0 && !thePolicy;
+    if(followDerivatives) {
+        for(Company c: allCompany) {
+            chargeTimeDerivatives[c] = derivativeOption == c || derivativeOption >= companyCount ? secondsPerHourD : 0.0;
+        }
+        planeDerivatives.assign(fleet.size(), 0.0);
+        chargeDerivatives.assign(fleet.size(), 0.0);
+    }
+}
+
+// A plane that waited starts charging when it landed or when the charger it gets is freed,
+// whichever is later. Moving the charge time a little, the charges done at the same time are
+// done in the order of their derivatives, so the first waiting plane gets the smallest.
+void FastEngine::followWait(long plane, size_t freed) {
+    double landed = planeDerivatives[plane];
+    double started = freed < freedDerivatives.size() ? std::max(landed, freedDerivatives[freed]) : landed;
+    chargeDerivatives[plane] = started;
+    theSimulation->thePathDerivatives.waitSeconds += started - landed;
+}
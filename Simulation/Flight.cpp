@@ -7,6 +7,8 @@
 
 #include "SimSettings.hpp"
 #include "Flight.hpp"
+#include "SimProfile.hpp"
+#include "SimTrace.hpp"
 #include "ChargerQueue.hpp"
 #include "PlaneQueue.hpp"
 
@@ -17,19 +19,26 @@
  *
  * This is a child of eventHandler. As such, it will be added to the SimClock queue.
  * It will respond to events that complete the flight or that represent faults.
- * After a flight it transfers the plane to theChargerQueue or thePlaneQueue.
+ * After a flight it transfers the plane to the ChargerQueue or PlaneQueue of the site where
+ * it lands.
  *
  * A Simulation object may contain zero or more Flight objects.
  * If the Flight object is in a Simulation it has a pointer to that Simulation object.
  * For testing, a Flight may have a nullptr for theSimulation property.
  *******************************************************************************************
  */
-Flight::Flight(Simulation *theSimulation, long startTime, long passengerCount, std::shared_ptr<Plane> aPlane):
+Flight::Flight(Simulation *theSimulation, long startTime, long passengerCount, std::shared_ptr<Plane> aPlane, long originSite, long destinationSite):
 // Calculate the endtime based on startTime and the time a plane will go on a full charge
 // The next faultTime is the start time of the flight plus the plane's current fault interval. If the nextFaultTime
 // is beyond the end of the flight, then at the end of the flight we will adjust the plane's nextFault interval to
 // subtract the time already used by the flight.
-EventHandler(LONG_MAX),theSimulation{theSimulation}, startTime{startTime}, endTime{startTime+aPlane->calcTimeOnFullCharge__seconds()}, nextFaultTime{startTime+aPlane->getNextFaultInterval()}, passengerCount{passengerCount},thePlane{aPlane} {
+EventHandler(LONG_MAX, profileFlight, aPlane->getPlaneNumber()),theSimulation{theSimulation}, startTime{startTime}, endTime{startTime+aPlane->calcTimeOnFullCharge__seconds()}, nextFaultTime{startTime+aPlane->getNextFaultInterval()}, passengerCount{passengerCount},thePlane{aPlane}, originSite{originSite}, destinationSite{destinationSite} {
+    // With SimSettings::faultCountOption 1 the faults are not events, so the flight is only in
+    // the clock for its end and counts its faults then
+    if(theSimulation && theSimulation->theSettings && theSimulation->theSettings->faultOption == 0 &&
+       theSimulation->theSettings->faultCountOption == 1) {
+        nextFaultTime = LONG_MAX;
+    }
     // Set our nextEventTime to the end of the flight or the time of our plane's next fault, whichever happens first
     nextEventTime = std::min(endTime, nextFaultTime);
     faultCount = 0;
@@ -58,10 +67,11 @@ bool Flight::handleEvent(long currentTime, bool closeOut) {
         // The default is to record the fault and keep going
         if(faultOption == 1) { // if the option is 1 then the fault grounds the plane immediately
             recordFlight(); // record the portion of the flight completed
-            if(theSimulation && theSimulation->thePlaneQueue) {
+            recordGrounded(currentTime);
+            if(theSimulation && theSimulation->getPlaneQueue(destinationSite)) {
                 // "this" will be deleted so the plane will be owned by the plane queue
                 // We ground it by giving it an infinite delay
-                theSimulation->thePlaneQueue->addPlane(LONG_MAX, thePlane);
+                theSimulation->getPlaneQueue(destinationSite)->addPlane(LONG_MAX, thePlane);
             }
             return false; // do not keep us in the event queue
         } else { // record fault and continue
@@ -87,27 +97,34 @@ bool Flight::handleEvent(long currentTime, bool closeOut) {
     // to decide that it should have processed that next fault before it started the flight. Fortunately the
     // SimClock detects and reports attempts to go backwards in time.
 
-    // We used up the duration of the flight from the next fault interval for this plane.
-    // We may have had a fault during this flight so our current interval may not have started at the beginning of the flight
-    long startOfCurrentFaultInterval = nextFaultTime - thePlane->getNextFaultInterval();
-    // Knowing when the current fault interval started its timing we can know how much of this flight it was active
-    // and remove that from the tiem for the fault to maifest.
-    thePlane->decrementNextFaultInterval(endTime - startOfCurrentFaultInterval);
+    if(nextFaultTime == LONG_MAX) {
+        // The faults were not events, so count them all now
+        faultCount = thePlane->countFaults(endTime - startTime);
+    } else {
+        // We used up the duration of the flight from the next fault interval for this plane.
+        // We may have had a fault during this flight so our current interval may not have started at the beginning of the flight
+        long startOfCurrentFaultInterval = nextFaultTime - thePlane->getNextFaultInterval();
+        // Knowing when the current fault interval started its timing we can know how much of this flight it was active
+        // and remove that from the tiem for the fault to maifest.
+        thePlane->decrementNextFaultInterval(endTime - startOfCurrentFaultInterval);
+    }
 
     // Record the flight into the Simulation record of dompleted flights
     recordFlight();
     if(faultOption == 2 && faultCount > 0) {
         // faultOption == 2 means we ground flight with a fault afer the flight completes
-        if(theSimulation && theSimulation->thePlaneQueue) {
+        recordGrounded(currentTime);
+        if(theSimulation && theSimulation->getPlaneQueue(destinationSite)) {
             // We ground it by giving it an infinite delay
-            theSimulation->thePlaneQueue->addPlane(LONG_MAX, thePlane);
+            theSimulation->getPlaneQueue(destinationSite)->addPlane(LONG_MAX, thePlane);
         }
         // if there is no simulation this plane will be done anyway
    } else {
         // Otherwise try to put it back on a charger
-        if(theSimulation && theSimulation->theChargerQueue) {
+        if(theSimulation && theSimulation->getChargerQueue(destinationSite)) {
             // "this" will be deleted so the plane will be owned by the battery queue
-            theSimulation->theChargerQueue->addPlane(currentTime, thePlane);
+            // The plane booked its charger at the destination when this flight took off
+            theSimulation->getChargerQueue(destinationSite)->addPlane(currentTime, thePlane, startTime);
         }
     }
     // by returning false "this" will be removed from the eventHandler queue
@@ -125,6 +142,11 @@ const std::string Flight::describe() {
     std::string description = "Flight for plane #" + thePlane->describe() + " endTime: " + std::to_string(endTime) + " nextFaultTime: " + std::to_string(nextFaultTime);
     return description;
 }
+
+// Which ProfileKind the profiler counts this handler as
+int Flight::profileKind() {
+    return profileFlight;
+}
 // When the flight completes, record its information for simulation statistics
 void Flight::recordFlight() {
     // We can only record the flight if there is a Simulation in which to record it.
@@ -136,9 +158,23 @@ void Flight::recordFlight() {
         double passengerMiles = flightDuration * passengerCount * thePlane->getMilesPerHour();
         passengerMiles /= secondsPerHourD;
         // Create a flightStats object
-        FlightStats someStats{thePlane->getCompany(),thePlane->getPlaneNumber(), flightDuration,passengerCount,faultCount, passengerMiles};
+        FlightStats someStats{thePlane->getCompany(),thePlane->getPlaneNumber(), flightDuration,passengerCount,faultCount, passengerMiles, originSite};
         // Add it to the vector of saved flights
-        theSimulation->theFlightStats.push_back(someStats);
+        theSimulation->recordFlight(someStats, endTime);
+        if(theSimulation->theTrace) {
+            theSimulation->theTrace->flight(thePlane->getPlaneNumber(), thePlane->getCompany(), originSite, destinationSite,
+                                            startTime, endTime, passengerCount, faultCount);
+        }
+    }
+}
+// Count the plane as grounded and, if the simulation is being traced, show it grounded at
+// its destination from now on
+void Flight::recordGrounded(long currentTime) {
+    if(theSimulation) {
+        theSimulation->recordGrounded(thePlane->getCompany());
+    }
+    if(theSimulation && theSimulation->theTrace) {
+        theSimulation->theTrace->grounded(thePlane->getPlaneNumber(), thePlane->getCompany(), destinationSite, currentTime);
     }
 }
 
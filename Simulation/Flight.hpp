@@ -22,7 +22,8 @@
  *
  * This is a child of eventHandler. As such, it will be added to the SimClock queue.
  * It will respond to events that complete the flight or that represent faults.
- * After a flight it transfers the plane to theChargerQueue or thePlaneQueue.
+ * After a flight it transfers the plane to the ChargerQueue or PlaneQueue of the site where
+ * it lands.
  *
  * A Simulation object may contain zero or more Flight objects.
  * If the Flight object is in a Simulation it has a pointer to that Simulation object.
@@ -37,8 +38,10 @@ class Flight: public EventHandler {
     long faultCount; // How many faults have happened so far on this flight?
     std::shared_ptr<Plane> thePlane; // The plane assigned to this flight
     Simulation *theSimulation; // Simulation object containing current simulation or nullptr
+    long originSite; // Site the flight took off from
+    long destinationSite; // Site the flight will land at
 public:
-    Flight(Simulation *theSimulation, long startTime, long passengerCount, std::shared_ptr<Plane> aPlane);
+    Flight(Simulation *theSimulation, long startTime, long passengerCount, std::shared_ptr<Plane> aPlane, long originSite = 0, long destinationSite = 0);
     virtual ~Flight() override;
 
     // Handle events when the flight is done, the simulation is done or a fault occurs
@@ -50,8 +53,15 @@ public:
     // For testing: provide a description of this object
     virtual const std::string describe() override;
     
+    // Which ProfileKind the profiler counts this handler as
+    virtual int profileKind() override;
+    
     // When the flight completes, record its information for simulation statistics
     void recordFlight();
+
+    // Count the plane as grounded and, if the simulation is being traced, show it grounded
+    // at its destination from now on
+    void recordGrounded(long currentTime);
 };
 
 #endif /* Flight_hpp */
@@ -0,0 +1,147 @@
+//
+//  FlightRecorder.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "FlightRecorder.hpp"
+#include "Simulation.hpp"
+#include "Plane.hpp"
+#include <sstream>
+#include <iomanip>
+
+const char *recorderActionName(int action) {
+    switch(action) {
+        case recordHandle: return "handle";
+        case recordKeep: return "keep until";
+        case recordRemove: return "remove";
+        case recordCloseOut: return "close out";
+        case recordFlightLogged: return "flight logged";
+        case recordChargeLogged: return "charge logged";
+        case recordOutOfOrder: return "ERROR out of order";
+        default: return "ERROR reinsert not in future";
+    }
+}
+
+// Room for at least capacity entries (rounded up to a power of two)
+FlightRecorder::FlightRecorder(size_t capacity): entries{}, mask{0}, count{0} {
+    size_t roundedCapacity = 1;
+    while(roundedCapacity < capacity) { roundedCapacity <<= 1; }
+    entries.resize(roundedCapacity);
+    mask = roundedCapacity - 1;
+}
+
+// Forget everything, for the start of a run
+void FlightRecorder::clear() {
+    count = 0;
+}
+
+// How many entries are kept now
+size_t FlightRecorder::size() const {
+    return count < entries.size() ? static_cast<size_t>(count) : entries.size();
+}
+
+// How many entries were ever recorded
+uint64_t FlightRecorder::getCount() const {
+    return count;
+}
+
+// Look at a kept entry. Index 0 is the oldest.
+const RecorderEntry &FlightRecorder::operator[](size_t index) const {
+    return entries[(count - size() + index) & mask];
+}
+
+// Write the last entries (all of them if last is 0) to out, oldest first, one per line
+void FlightRecorder::dump(std::ostream &out, size_t last) const {
+    size_t kept = size();
+    size_t first = last > 0 && last < kept ? kept - last : 0;
+    out << "Flight recorder: last " << kept - first << " of " << count << " entries" << std::endl;
+    for(size_t index = first; index < kept; index++) {
+        const RecorderEntry &anEntry = (*this)[index];
+        const char *idName = anEntry.kind == profileFlight || anEntry.action == recordChargeLogged ? "plane" : "site";
+        out << "  #" << std::left << std::setw(10) << count - kept + index
+        << " time " << std::setw(10) << anEntry.time
+        << std::setw(14) << profileKindName(anEntry.kind)
+        << idName << " " << std::setw(7) << anEntry.id
+        << recorderActionName(anEntry.action) << std::right << std::endl;
+    }
+}
+
+// Check the ring buffer, and that both engines record the same history for the same run.
+// It reports errors to cout.
+bool testFlightRecorder() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of the flight recorder *****" << std::endl;
+
+    // A small recorder keeps only the newest entries, oldest first
+    FlightRecorder aRecorder(6);
+    for(long i = 0; i < 20; i++) {
+        aRecorder.record(i, profileFlight, i, recordHandle);
+    }
+    if(aRecorder.size() != 8 || aRecorder.getCount() != 20 || aRecorder[0].time != 12 || aRecorder[7].time != 19) {
+        std::cout << "***** error: the recorder kept " << aRecorder.size() << " entries starting at " << aRecorder[0].time << std::endl;
+        returnValue = false;
+    }
+    std::stringstream dumped;
+    aRecorder.dump(dumped, 3);
+    if(dumped.str().find("last 3 of 20") == std::string::npos || dumped.str().find("#17") == std::string::npos ||
+       dumped.str().find("#16") != std::string::npos) {
+        std::cout << "***** error: unexpected dump:" << std::endl << dumped.str();
+        returnValue = false;
+    }
+
+    // Both engines handle the same events in the same order, so they record the same history.
+    // Plane numbers keep counting up from one Simulation to the next, so they are compared
+    // relative to the first plane of each run.
+    SimSettings settings{};
+    settings.simulationDuration = 200 * secondsPerHour;
+    settings.planeCount = 30;
+    settings.chargerCount = 3;
+    settings.siteCount = 2;
+    settings.siteFlightOption = 1;
+    settings.maxPassengerDelay = 600;
+    settings.randomSeed = 13;
+    settings.progressInterval = 0;
+    std::vector<RecorderEntry> histories[2];
+    uint64_t counts[2]{};
+    for(int engine = 0; engine < 2; engine++) {
+        settings.engineOption = engine;
+        long firstPlane = Plane::getNextPlaneNumber();
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        aSimulation.run(false);
+        const FlightRecorder &theRecorder = aSimulation.getFlightRecorder();
+        counts[engine] = theRecorder.getCount();
+        for(size_t index = 0; index < theRecorder.size(); index++) {
+            RecorderEntry anEntry = theRecorder[index];
+            if(anEntry.kind == profileFlight || anEntry.action == recordChargeLogged) {
+                anEntry.id -= static_cast<int32_t>(firstPlane);
+            }
+            histories[engine].push_back(anEntry);
+        }
+        // The run is long enough to fill the recorder, and it ends with the close-out (which may
+        // log the flights and charges that were cut off)
+        bool closedOut = false;
+        for(const RecorderEntry &anEntry: histories[engine]) {
+            closedOut = anEntry.action == recordCloseOut || (closedOut && anEntry.action >= recordFlightLogged);
+        }
+        if(theRecorder.size() != defaultFlightRecorderSize || counts[engine] <= defaultFlightRecorderSize || !closedOut) {
+            std::cout << "***** error: engine " << engine << " recorded " << counts[engine] << " entries" << std::endl;
+            returnValue = false;
+        }
+    }
+    bool sameHistory = counts[0] == counts[1] && histories[0].size() == histories[1].size();
+    for(size_t index = 0; sameHistory && index < histories[0].size(); index++) {
+        const RecorderEntry &a = histories[0][index];
+        const RecorderEntry &b = histories[1][index];
+        sameHistory = a.time == b.time && a.id == b.id && a.kind == b.kind && a.action == b.action;
+    }
+    if(!sameHistory) {
+        std::cout << "***** error: the SimClock and FastEngine recorded different histories" << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of the flight recorder " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
@@ -0,0 +1,365 @@
+//
+//  FluidModel.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "FluidModel.hpp"
+#include "Plane.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+extern PlaneSpecification planeSpecifications[];
+
+/*
+ *******************************************************************************************
+ * class FluidModel
+ * Each step, at each site: the charges that are done start their passenger delay, the
+ * landings join the charger queue, the queue fills any free chargers and the planes that
+ * are ready take off. Then the time in the air and on chargers and the faults are added up
+ * for the step. See FluidModel.hpp.
+ *******************************************************************************************
+ */
+FluidModel::FluidModel(Simulation *theSimulation): theSimulation{theSimulation}, stepSeconds{minimumStep},
+siteCount{0}, ringSteps{0}, readySteps{1}, faultOption{0}, planesMove{false}, chargerCount{0}, companies{},
+groups{}, landings{}, chargesDone{}, readyChanges{}, queues{}, stepCount{0}, note{} {
+}
+
+// Add planes to a group's ring at a time that may fall between two steps. They are split
+// between the two steps so they arrive at the right time on average.
+void FluidModel::scheduleAt(std::vector<double> &ring, long group, double step, double planes) {
+    long whole = static_cast<long>(step);
+    double part = step - whole;
+    ring[group * ringSteps + whole % ringSteps] += planes * (1.0 - part);
+    ring[group * ringSteps + (whole + 1) % ringSteps] += planes * part;
+}
+
+// Planes that finished charging at step wait for passengers for between 0 and
+// maxPassengerDelay seconds, evenly spread
+void FluidModel::becomeReady(long group, long step, double planes) {
+    groups[group].waitingForPassengers += planes;
+    double perStep = planes / readySteps;
+    readyChanges[group * ringSteps + step % ringSteps] += perStep;
+    readyChanges[group * ringSteps + (step + readySteps) % ringSteps] -= perStep;
+}
+
+// Take what a ring holds for this step and clear it for the step ringSteps later
+static double takeStep(std::vector<double> &ring, long index) {
+    double value = ring[index];
+    ring[index] = 0.0;
+    return value;
+}
+
+// One step of the whole fleet
+void FluidModel::runStep(long step, double seconds) {
+    // Everything that lands this step, by the site it took off from
+    double landedByCompany[companyCount]{};
+    std::vector<double> landed(groups.size());
+    for(size_t group = 0; group < groups.size(); group++) {
+        landed[group] = takeStep(landings, static_cast<long>(group) * ringSteps + step % ringSteps);
+        groups[group].flying = std::max(0.0, groups[group].flying - landed[group]);
+        landedByCompany[group % companyCount] += landed[group];
+    }
+    for(long site = 0; site < siteCount; site++) {
+        std::deque<FluidBatch> &queue = queues[site];
+        FluidBatch arriving{step, {}, 0.0};
+        double inUse = 0.0;
+        for(Company c: allCompany) {
+            long group = site * companyCount + c;
+            FluidGroup &aGroup = groups[group];
+            // Charges that are done start their wait for passengers
+            double done = takeStep(chargesDone, group * ringSteps + step % ringSteps);
+            if(done > 0.0) {
+                aGroup.charging = std::max(0.0, aGroup.charging - done);
+                aGroup.chargesDone += done;
+                becomeReady(group, step, done);
+            }
+            inUse += aGroup.charging;
+            // Landings here, from this site or shared evenly from the others. A flight that is
+            // grounded by a fault (faultOption 1) is counted as flown to its end, as the
+            // discrete engines record it, so it is grounded here too.
+            double arrivals = planesMove ? (landedByCompany[c] - landed[group]) / (siteCount - 1) : landed[group];
+            double grounded = arrivals * companies[c].groundedAtLanding;
+            aGroup.grounded += grounded;
+            arriving.planes[c] = arrivals - grounded;
+            arriving.total += arriving.planes[c];
+        }
+        if(arriving.total > 0.0) {
+            queue.push_back(arriving);
+            for(Company c: allCompany) {
+                groups[site * companyCount + c].waitingForCharger += arriving.planes[c];
+            }
+        }
+        // Fill the free chargers from the front of the queue
+        double free = chargerCount - inUse;
+        while(free > 1e-12 && !queue.empty()) {
+            FluidBatch &front = queue.front();
+            double taken = std::min(free, front.total);
+            double share = taken / front.total;
+            for(Company c: allCompany) {
+                double planes = front.planes[c] * share;
+                if(planes <= 0.0) { continue; }
+                FluidGroup &aGroup = groups[site * companyCount + c];
+                aGroup.waitingForCharger = std::max(0.0, aGroup.waitingForCharger - planes);
+                aGroup.charging += planes;
+                aGroup.waitTime += planes * static_cast<double>((step - front.step) * stepSeconds);
+                scheduleAt(chargesDone, site * companyCount + c, step + companies[c].chargeSteps, planes);
+                front.planes[c] -= planes;
+            }
+            free -= taken;
+            front.total -= taken;
+            if(front.total <= 1e-12 * std::max(1.0, taken)) {
+                queue.pop_front();
+            }
+        }
+        // The planes that have their passengers take off, then the step's time is added up
+        for(Company c: allCompany) {
+            long group = site * companyCount + c;
+            FluidGroup &aGroup = groups[group];
+            const FluidCompany &aCompany = companies[c];
+            aGroup.readyRate += takeStep(readyChanges, group * ringSteps + step % ringSteps);
+            double takingOff = std::min(std::max(0.0, aGroup.readyRate), aGroup.waitingForPassengers);
+            if(takingOff > 0.0) {
+                aGroup.waitingForPassengers -= takingOff;
+                aGroup.flights += takingOff;
+                aGroup.flying += takingOff;
+                scheduleAt(landings, group, step + aCompany.flightSteps, takingOff);
+            }
+            aGroup.flightTime += aGroup.flying * seconds;
+            aGroup.faults += aGroup.flying * seconds * aCompany.faultsPerSecond;
+            aGroup.chargeTime += aGroup.charging * seconds;
+        }
+    }
+}
+
+// Run the model for the planes at each site and add the results to the Simulation's totals
+long FluidModel::run(const std::vector<std::vector<Company>> &siteCompanies) {
+    std::shared_ptr<SimSettings> theSettings = theSimulation->theSettings;
+    long endTime = theSettings->simulationDuration;
+    siteCount = static_cast<long>(siteCompanies.size());
+    faultOption = theSettings->faultOption;
+    planesMove = theSettings->siteFlightOption == 1 && siteCount >= 2;
+    chargerCount = theSettings->chargerCount;
+
+    // The same times as Plane::calcTimeOnFullCharge__seconds and calcTimeToCharge__seconds.
+    // The steps stay well below the shortest of them so nothing lands in the step it took off.
+    long flightSeconds[companyCount], chargeSeconds[companyCount];
+    long shortest = LONG_MAX;
+    for(Company c: allCompany) {
+        const PlaneSpecification &aSpec = planeSpecifications[c];
+        flightSeconds[c] = lround(aSpec.battery_capacity__kWh / aSpec.energy_use__kWh_per_mile * secondsPerHourD / aSpec.cruise_speed__mph);
+        chargeSeconds[c] = lround((aSpec.time_to_charge__hours + theSettings->timeToChargeChange[c]) * secondsPerHourD);
+        shortest = std::min(shortest, std::min(flightSeconds[c], chargeSeconds[c]));
+    }
+    stepSeconds = std::max(minimumStep, std::min((endTime + maxSteps - 1) / maxSteps, shortest / 8));
+    long maxPassengerDelay = theSettings->maxPassengerDelay;
+    readySteps = maxPassengerDelay > 0 ? lround(static_cast<double>(maxPassengerDelay) / stepSeconds) + 1 : 1;
+    double longest = 0.0;
+    for(Company c: allCompany) {
+        const PlaneSpecification &aSpec = planeSpecifications[c];
+        double flightHours = flightSeconds[c] / secondsPerHourD;
+        FluidCompany &aCompany = companies[c];
+        aCompany.flightSteps = static_cast<double>(flightSeconds[c]) / stepSeconds;
+        aCompany.chargeSteps = static_cast<double>(chargeSeconds[c]) / stepSeconds;
+        // The share of flights with at least one fault. With faultOption 1 that is the one
+        // fault such a flight has, spread over the flight.
+        double faulted = 1.0 - std::exp(-aSpec.probability_fault__per_hour * flightHours);
+        aCompany.faultsPerSecond = faultOption == 1 ? faulted / flightSeconds[c] : aSpec.probability_fault__per_hour / secondsPerHourD;
+        aCompany.groundedAtLanding = faultOption == 0 ? 0.0 : faulted;
+        aCompany.passengersPerFlight = theSettings->passengerCountOption == 0 ? aSpec.passenger_count : (1.0 + aSpec.passenger_count) / 2.0;
+        aCompany.milesPerHour = aSpec.cruise_speed__mph;
+        longest = std::max(longest, std::max(aCompany.flightSteps, aCompany.chargeSteps));
+    }
+    ringSteps = static_cast<long>(std::ceil(longest)) + readySteps + 2;
+
+    // Every plane starts waiting for passengers
+    long groupCount = siteCount * companyCount;
+    groups.assign(groupCount, FluidGroup{});
+    landings.assign(groupCount * ringSteps, 0.0);
+    chargesDone.assign(groupCount * ringSteps, 0.0);
+    readyChanges.assign(groupCount * ringSteps, 0.0);
+    queues.assign(siteCount, std::deque<FluidBatch>{});
+    double fleetSize = 0.0;
+    for(long site = 0; site < siteCount; site++) {
+        for(Company c: siteCompanies[site]) {
+            becomeReady(site * companyCount + c, 0, 1.0);
+            fleetSize += 1.0;
+        }
+    }
+
+    auto loopStartTimer = std::chrono::high_resolution_clock::now();
+    stepCount = (endTime + stepSeconds - 1) / stepSeconds;
+    for(long step = 0; step < stepCount; step++) {
+        runStep(step, static_cast<double>(std::min(stepSeconds, endTime - step * stepSeconds)));
+    }
+
+    // Add the totals, rounded, and see where the fleet ended up
+    StatsTotals &theTotals = theSimulation->theTotals;
+    double inState[5]{};
+    for(long site = 0; site < siteCount; site++) {
+        for(Company c: allCompany) {
+            const FluidGroup &aGroup = groups[site * companyCount + c];
+            const FluidCompany &aCompany = companies[c];
+            double passengerMiles = aGroup.flightTime / secondsPerHourD * aCompany.milesPerHour * aCompany.passengersPerFlight;
+            theTotals.addFlight(FlightStats{c, 0, lround(aGroup.flightTime), lround(aGroup.flights * aCompany.passengersPerFlight),
+                lround(aGroup.faults), passengerMiles, site}, lround(aGroup.flights));
+            // Charges in progress at the end are counted, as the discrete engines log them
+            theTotals.addCharge(ChargerStats{c, 0, lround(aGroup.chargeTime), lround(aGroup.chargeTime + aGroup.waitTime), site},
+                lround(aGroup.chargesDone + aGroup.charging));
+            inState[0] += aGroup.flying;
+            inState[1] += aGroup.waitingForPassengers;
+            inState[2] += aGroup.waitingForCharger;
+            inState[3] += aGroup.charging;
+            inState[4] += aGroup.grounded;
+        }
+    }
+#if SIMPROFILE
+    SimProfile &theProfile = theSimulation->theProfile;
+    if(theProfile.enabled) {
+        theProfile.eventLoopSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loopStartTimer).count();
+    }
+#else
+    (void)loopStartTimer;
+#endif
+
+    std::ostringstream noteStream;
+    double fleet = std::max(1.0, fleetSize);
+    noteStream << std::fixed << std::setprecision(1) << "fluid model, " << stepCount << " steps of " << stepSeconds
+    << " seconds; at the end " << 100.0 * inState[0] / fleet << "% flying, " << 100.0 * inState[1] / fleet
+    << "% waiting for passengers, " << 100.0 * inState[2] / fleet << "% waiting for a charger, "
+    << 100.0 * inState[3] / fleet << "% charging, " << 100.0 * inState[4] / fleet << "% grounded";
+    double accountedFor = inState[0] + inState[1] + inState[2] + inState[3] + inState[4];
+    if(std::fabs(accountedFor - fleetSize) > 1e-6 * fleet) {
+        noteStream << std::setprecision(6) << "; planes not conserved (" << accountedFor << " of " << fleetSize << ")";
+    }
+    note = noteStream.str();
+    return endTime;
+}
+
+// How many time steps it took
+long FluidModel::getEventCount() {
+    return stepCount;
+}
+
+// The step size and how the fleet was split between the states at the end
+const std::string &FluidModel::getNote() {
+    return note;
+}
+
+// Run the settings on the FastEngine and the fluid model with seedCount seeds and compare them
+FluidValidation validateFluidModel(const SimSettings &someSettings, long seedCount, std::ostream &out) {
+    FluidValidation returnValue{0.0, "", 0.0, 0.0};
+    // Each company's values, added up over the seeds: flights, charges, faults, charge time
+    // with the wait (the total, not the average) and passenger miles
+    const int valueCount{5};
+    const char *valueNames[valueCount]{"Flights", "Charges", "Faults", "Charge+Wait", "Pass. Miles"};
+    double totals[2][companyCount][valueCount]{};
+    for(long seed = 0; seed < seedCount; seed++) {
+        SimSettings settings = someSettings;
+        settings.randomSeed = (someSettings.randomSeed > 0 ? someSettings.randomSeed : 1) + seed;
+        settings.progressInterval = 0;
+        const int engines[]{1, 4};
+        for(int engine = 0; engine < 2; engine++) {
+            settings.engineOption = engines[engine];
+            auto startTimer = std::chrono::high_resolution_clock::now();
+            Simulation aSimulation(settings);
+            aSimulation.setQuiet(true);
+            std::vector<FinalStats> results = aSimulation.run(false);
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTimer).count();
+            (engine == 0 ? returnValue.discreteSeconds : returnValue.fluidSeconds) += seconds;
+            for(const FinalStats &f: results) {
+                double *values = totals[engine][f.theCompany];
+                values[0] += f.totalFlights;
+                values[1] += f.totalCharges;
+                values[2] += f.totalFaults;
+                values[3] += f.averageTimeChargingWithWait * f.totalCharges;
+                values[4] += f.totalPassengerMiles;
+            }
+        }
+    }
+    out << std::left << std::setw(10) << "Company" << std::setw(14) << "Value" << std::right << std::setw(16) << "FastEngine"
+    << std::setw(16) << "Fluid" << std::setw(12) << "Difference" << std::endl;
+    for(Company c: allCompany) {
+        // Too few flights to say anything about this company
+        if(totals[0][c][0] < 100.0 * seedCount) {
+            continue;
+        }
+        for(int value = 0; value < valueCount; value++) {
+            double discrete = totals[0][c][value] / seedCount;
+            double fluid = totals[1][c][value] / seedCount;
+            // The charge time with the wait is compared as an average per charge
+            if(value == 3) {
+                discrete /= std::max(1.0, totals[0][c][1] / seedCount);
+                fluid /= std::max(1.0, totals[1][c][1] / seedCount);
+            }
+            double error = std::fabs(fluid - discrete) / std::max(1.0, std::fabs(discrete));
+            out << std::left << std::setw(10) << companyName(c) << std::setw(14) << valueNames[value] << std::right
+            << std::fixed << std::setprecision(1) << std::setw(16) << discrete << std::setw(16) << fluid
+            << std::setw(11) << 100.0 * error << "%" << std::defaultfloat << std::endl;
+            if(error > returnValue.worstError) {
+                returnValue.worstError = error;
+                returnValue.worstValue = std::string{companyName(c)} + " " + valueNames[value];
+            }
+        }
+    }
+    out << "Worst difference " << std::fixed << std::setprecision(1) << 100.0 * returnValue.worstError << "% ("
+    << returnValue.worstValue << "); FastEngine " << std::setprecision(3) << returnValue.discreteSeconds
+    << " seconds, fluid model " << returnValue.fluidSeconds << " seconds" << std::defaultfloat << std::endl;
+    return returnValue;
+}
+
+// Check that the fluid model stays close to the FastEngine on fleets of a few thousand
+// planes, and that it conserves planes. It reports errors to cout.
+bool testFluidModel() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of the fluid model *****" << std::endl;
+    struct TestCase {
+        const char *description;
+        long hours, planes, chargers, sites;
+        int faultOption, passengerCountOption, siteFlightOption;
+        long maxPassengerDelay;
+        double tolerance; // The largest relative difference allowed. Faults and grounding are noisy.
+    };
+    const TestCase testCases[]{
+        {"plenty of chargers", 200, 2000, 2000, 1, 0, 0, 0, 0, 0.06},
+        {"short of chargers", 200, 2000, 300, 1, 0, 1, 0, 1800, 0.06},
+        {"ground after flight", 200, 10000, 3000, 1, 2, 0, 0, 600, 0.08},
+        {"ground immediately", 200, 10000, 3000, 1, 1, 0, 0, 600, 0.08},
+        {"sites, fly between", 200, 3000, 150, 3, 0, 1, 1, 1200, 0.06},
+    };
+    for(const TestCase &aCase: testCases) {
+        SimSettings settings{};
+        settings.simulationDuration = aCase.hours * secondsPerHour;
+        settings.planeCount = aCase.planes;
+        settings.chargerCount = aCase.chargers;
+        settings.siteCount = aCase.sites;
+        settings.faultOption = aCase.faultOption;
+        settings.passengerCountOption = aCase.passengerCountOption;
+        settings.siteFlightOption = aCase.siteFlightOption;
+        settings.maxPassengerDelay = aCase.maxPassengerDelay;
+        std::ostringstream table;
+        FluidValidation aValidation = validateFluidModel(settings, 4, table);
+        if(aValidation.worstError > aCase.tolerance) {
+            std::cout << "***** error: " << aCase.description << " differs from the FastEngine by "
+            << 100.0 * aValidation.worstError << "% (" << aValidation.worstValue << ")" << std::endl << table.str();
+            returnValue = false;
+        }
+        settings.engineOption = 4;
+        settings.randomSeed = 1;
+        settings.progressInterval = 0;
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        aSimulation.run(false);
+        if(aSimulation.getEngineNote().find("not conserved") != std::string::npos) {
+            std::cout << "***** error: " << aCase.description << ": " << aSimulation.getEngineNote() << std::endl;
+            returnValue = false;
+        }
+    }
+    std::cout << "Test of the fluid model " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
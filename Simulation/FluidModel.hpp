@@ -0,0 +1,144 @@
+//
+//  FluidModel.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef FluidModel_hpp
+#define FluidModel_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <iostream>
+#include "Simulation.hpp"
+
+/*
+ *******************************************************************************************
+ * class FluidModel
+ * A mean-field approximation for fleets too large to be worth simulating plane by plane.
+ * Instead of planes it follows how much of each company's fleet at each site is in each
+ * state: flying, waiting for passengers, waiting for a charger, charging and grounded. The
+ * amounts are real numbers, and they move between the states at the rates the
+ * planeSpecifications give, on a time grid of a few seconds. So the cost depends on the
+ * simulated time, the sites and the companies, but not on the number of planes.
+ *
+ * The flights and charges take a fixed time, so what lands now is what took off one flight
+ * time ago (split between the two nearest steps so the mean is exact), and the same for
+ * charges. A passenger delay spreads what finishes charging evenly over the next
+ * maxPassengerDelay seconds. Faults come at each company's rate per hour of flight, and
+ * with faultOption 2 the share of landings that had at least one fault is grounded. With
+ * option 1 that share is grounded too, each with one fault: the discrete engines record a
+ * flight that a fault grounds as if it flew to its planned end. A site's
+ * chargers are filled from its queue first come, first served, with each step's landings
+ * joining the queue together, so the waits come out of the queue itself. Every charger
+ * policy is treated as first come, first served. With siteFlightOption 1 a site's flights
+ * are shared evenly between the other sites.
+ *
+ * Like the discrete engines, a flight is counted when it ends (or is cut off at the end),
+ * charges in progress at the end are counted, and the results are added to the Simulation's
+ * totals, rounded to whole flights, charges and faults. The averages match the discrete
+ * engines closely for large fleets, but the fluid has no randomness: fleets that start
+ * together stay in step, as they do with full planes and no passenger delay, and the
+ * differences that come from planes being whole are lost (see validateFluidModel).
+ *******************************************************************************************
+ */
+class FluidModel {
+public:
+    // The steps are at least this many seconds, and there are at most maxSteps of them
+    static const long minimumStep{10};
+    static const long maxSteps{1000000};
+private:
+    // The fleet at one site of one company, in planes
+    struct FluidGroup {
+        double flying; // In the air, having taken off from this site
+        double waitingForPassengers;
+        double charging;
+        double waitingForCharger;
+        double grounded;
+        double readyRate; // How many planes become ready each step (the running sum of readyChanges)
+        // The totals so far. Flights are by the site they took off from, charges by their site.
+        double flights;
+        double flightTime;
+        double faults;
+        double chargesDone;
+        double chargeTime;
+        double waitTime; // Time waited by planes that have got a charger
+    };
+    // The planes that joined a site's charger queue in one step
+    struct FluidBatch {
+        long step;
+        double planes[companyCount];
+        double total;
+    };
+    // What every plane of a company shares, in steps where it is a time
+    struct FluidCompany {
+        double flightSteps;
+        double chargeSteps;
+        double faultsPerSecond;
+        double groundedAtLanding; // The share of landings that are grounded (faultOption 1 or 2)
+        double passengersPerFlight;
+        double milesPerHour;
+    };
+
+    Simulation *theSimulation;
+    long stepSeconds;
+    long siteCount;
+    long ringSteps; // The length of each ring of future steps
+    long readySteps; // How many steps a passenger delay is spread over
+    int faultOption;
+    bool planesMove;
+    long chargerCount;
+    FluidCompany companies[companyCount];
+    std::vector<FluidGroup> groups; // Indexed by site * companyCount + company
+    // Rings of future steps, one per group: planes landing (by the site they took off from),
+    // planes done charging and changes to readyRate
+    std::vector<double> landings;
+    std::vector<double> chargesDone;
+    std::vector<double> readyChanges;
+    std::vector<std::deque<FluidBatch>> queues; // Each site's charger queue, oldest first
+    long stepCount;
+    std::string note;
+
+    // Add planes to a group's ring at a time that may fall between two steps
+    void scheduleAt(std::vector<double> &ring, long group, double step, double planes);
+    // Planes that finished charging at step: spread them over the passenger delay
+    void becomeReady(long group, long step, double planes);
+    // One step of the whole fleet, from step * stepSeconds for seconds
+    void runStep(long step, double seconds);
+public:
+    FluidModel(Simulation *theSimulation);
+
+    // Run the model for the planes at each site and add the results to the Simulation's totals.
+    // It returns the final simulated time.
+    long run(const std::vector<std::vector<Company>> &siteCompanies);
+
+    // How many time steps it took
+    long getEventCount();
+
+    // The step size and how the fleet was split between the states at the end
+    const std::string &getNote();
+};
+
+// How close the fluid model came to the FastEngine on one set of settings
+struct FluidValidation {
+    double worstError; // The largest relative difference in any compared value of any company
+    std::string worstValue; // Which value and company that was
+    double fluidSeconds; // Time taken by the fluid model runs
+    double discreteSeconds; // Time taken by the FastEngine runs
+};
+
+// Run the settings on the FastEngine and the fluid model with seedCount seeds and write a
+// table of each company's flights, charges, faults, average charge time with the wait and
+// passenger miles from each, with their relative differences, to out. Each seed gives both
+// the same fleet, and the results are averaged over the seeds. Companies with fewer than 100
+// flights per seed are not compared.
+FluidValidation validateFluidModel(const SimSettings &someSettings, long seedCount, std::ostream &out);
+
+// Check that the fluid model stays close to the FastEngine on fleets of a few thousand
+// planes, and that it conserves planes. It reports errors to cout.
+bool testFluidModel();
+
+#endif /* FluidModel_hpp */
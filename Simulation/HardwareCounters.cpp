@@ -0,0 +1,175 @@
+//
+//  HardwareCounters.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "HardwareCounters.hpp"
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+HardwareCounters::HardwareCounters(): groupFd{-1}, openedCount{0}, note{}, loopStart{} {
+    for(int counter = 0; counter < hardwareCounterCount; counter++) {
+        counterFds[counter] = -1;
+        slots[counter] = -1;
+    }
+}
+HardwareCounters::~HardwareCounters() {
+    close();
+}
+
+#if defined(__linux__)
+// The perf_event_open type and config for each HardwareCounter
+static void counterEvent(int counter, __u32 &type, __u64 &config) {
+    const __u64 readMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch(counter) {
+        case counterCycles: type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case counterInstructions: type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case counterL1Misses: type = PERF_TYPE_HW_CACHE; config = PERF_COUNT_HW_CACHE_L1D | readMiss; break;
+        case counterLLCMisses: type = PERF_TYPE_HW_CACHE; config = PERF_COUNT_HW_CACHE_LL | readMiss; break;
+        default: type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    }
+}
+#endif
+
+// Open and start the counters. It returns false (and sets the note) if none are available.
+bool HardwareCounters::open() {
+    close();
+    note.clear();
+#if defined(__linux__)
+    std::string firstError{};
+    for(int counter = 0; counter < hardwareCounterCount; counter++) {
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        counterEvent(counter, attributes.type, attributes.config);
+        // The leader starts disabled so the whole group is started together below
+        attributes.disabled = groupFd < 0 ? 1 : 0;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, groupFd, 0));
+        if(fd < 0) {
+            if(firstError.empty()) {
+                firstError = std::string{hardwareCounterName(counter)} + ": " + std::strerror(errno);
+            }
+            continue;
+        }
+        if(groupFd < 0) {
+            groupFd = fd;
+        }
+        counterFds[counter] = fd;
+        slots[counter] = openedCount++;
+    }
+    if(groupFd < 0) {
+        note = "perf_event_open failed (" + firstError + ")";
+        return false;
+    }
+    ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    note = "hardware counters need Linux perf_event_open";
+    return false;
+#endif
+}
+
+void HardwareCounters::close() {
+#if defined(__linux__)
+    for(int counter = 0; counter < hardwareCounterCount; counter++) {
+        if(counterFds[counter] >= 0) {
+            ::close(counterFds[counter]);
+        }
+    }
+#endif
+    for(int counter = 0; counter < hardwareCounterCount; counter++) {
+        counterFds[counter] = -1;
+        slots[counter] = -1;
+    }
+    groupFd = -1;
+    openedCount = 0;
+}
+
+bool HardwareCounters::isOpen() const {
+    return groupFd >= 0;
+}
+
+const std::string &HardwareCounters::getNote() const {
+    return note;
+}
+
+// The counts since open(), scaled up if the kernel had to share the hardware with other
+// counters. Counters that did not open are 0. It returns false if the read failed.
+bool HardwareCounters::read(double values[hardwareCounterCount]) {
+    for(int counter = 0; counter < hardwareCounterCount; counter++) {
+        values[counter] = 0.0;
+    }
+#if defined(__linux__)
+    if(groupFd < 0) {
+        return false;
+    }
+    // The group read is the number of counters, the time enabled and running, then each value
+    uint64_t buffer[3 + hardwareCounterCount];
+    ssize_t size = ::read(groupFd, buffer, sizeof(buffer));
+    if(size < static_cast<ssize_t>((3 + openedCount) * sizeof(uint64_t)) || buffer[2] == 0) {
+        return false;
+    }
+    double scale = static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]);
+    for(int counter = 0; counter < hardwareCounterCount; counter++) {
+        if(slots[counter] >= 0) {
+            values[counter] = static_cast<double>(buffer[3 + slots[counter]]) * scale;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Add the counts since before was read to totals
+void HardwareCounters::addSince(const double before[hardwareCounterCount], double totals[hardwareCounterCount]) {
+    double now[hardwareCounterCount];
+    if(!read(now)) {
+        return;
+    }
+    for(int counter = 0; counter < hardwareCounterCount; counter++) {
+        totals[counter] += now[counter] - before[counter];
+    }
+}
+
+// For an engine's run: open the counters if the profile asks for them and note in the
+// profile whether they are available
+void HardwareCounters::start(SimProfile &aProfile) {
+    if(!aProfile.countersRequested) {
+        return;
+    }
+    aProfile.countersAvailable = open() && read(loopStart);
+    if(!aProfile.countersAvailable) {
+        if(note.empty()) {
+            note = "the counters could not be read";
+        }
+        aProfile.countersNote = note;
+        close();
+        return;
+    }
+    for(int counter = 0; counter < hardwareCounterCount; counter++) {
+        aProfile.countersOpened[counter] = slots[counter] >= 0;
+    }
+}
+
+// Add the event loop's counts to the profile and close the counters
+void HardwareCounters::finish(SimProfile &aProfile) {
+    if(!isOpen()) {
+        return;
+    }
+    addSince(loopStart, aProfile.eventLoopCounts);
+    close();
+}
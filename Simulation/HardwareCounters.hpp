@@ -0,0 +1,64 @@
+//
+//  HardwareCounters.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef HardwareCounters_hpp
+#define HardwareCounters_hpp
+
+#include <stdio.h>
+#include <string>
+#include "SimProfile.hpp"
+
+/*
+ *******************************************************************************************
+ * Class HardwareCounters
+ * Reads the CPU's performance counters for this thread with Linux perf_event_open, so the
+ * profiler can report cycles, instructions, cache misses and branch misses per event and
+ * not just time. The counters are opened as one group so they are all counting over the
+ * same stretch of code, and one read() gets them all.
+ *
+ * Many containers and virtual machines do not offer them, and other systems do not have
+ * perf_event_open at all. Then open() returns false with a note saying why, and the profiler
+ * carries on with the timing only. If only some of them open, the rest read as 0.
+ *
+ * The engines have one each. They open it at the start of a profiled run that asked for
+ * counters and close it at the end, so nothing is held open between runs.
+ *******************************************************************************************
+ */
+class HardwareCounters {
+    int groupFd; // The group leader, or -1 if nothing is open
+    int counterFds[hardwareCounterCount]; // -1 for counters that did not open
+    int slots[hardwareCounterCount]; // Where each counter is in a group read, or -1
+    int openedCount;
+    std::string note; // Why the counters are not available
+    double loopStart[hardwareCounterCount]; // The counts when start() was called
+
+public:
+    HardwareCounters();
+    ~HardwareCounters();
+    HardwareCounters(const HardwareCounters &) = delete;
+    HardwareCounters &operator=(const HardwareCounters &) = delete;
+
+    // Open and start the counters. It returns false (and sets the note) if none are available.
+    bool open();
+    void close();
+    bool isOpen() const;
+    const std::string &getNote() const;
+
+    // The counts since open(), scaled up if the kernel had to share the hardware with other
+    // counters. Counters that did not open are 0. It returns false if the read failed.
+    bool read(double values[hardwareCounterCount]);
+
+    // Add the counts since before was read to totals
+    void addSince(const double before[hardwareCounterCount], double totals[hardwareCounterCount]);
+
+    // For an engine's run: open the counters if the profile asks for them and note in the
+    // profile whether they are available, then add the event loop's counts to it in finish().
+    void start(SimProfile &aProfile);
+    void finish(SimProfile &aProfile);
+};
+
+#endif /* HardwareCounters_hpp */
@@ -9,23 +9,18 @@
 #include <random>
 #include "Passenger.hpp"
 
-
-std::random_device Passenger::a_random_device;
-std::mt19937 Passenger::generator(a_random_device());
-
 // This is called at the start of each flight to get the number of passengers.
 // There is an alternative controlled by the passengerCountOption setting.
 // The default value (0) is to always fly with a full plane.
 // If passengerCountOption == 1 then each plane files with a randome number
 // of passengers in the range [1 - maxPassengers].
-long Passenger::getPassengerCount(long maxPassengers,  std::shared_ptr<SimSettings> theSettings) {
+long Passenger::getPassengerCount(long maxPassengers, const std::shared_ptr<SimSettings> &theSettings, SimRandom &random) {
     // if there are no settings or the option is 0, planes fly full
     if(theSettings == nullptr || theSettings->passengerCountOption == 0) {
         return maxPassengers;
     }
     // Get a random number of passengers in [1 - maxPassengers]
-    std::uniform_int_distribution<> passengerDistribution(1, static_cast<int>(maxPassengers));
-    return passengerDistribution(generator);
+    return random.uniformLong(1, maxPassengers);
 };
 
 // This determines how long a delay there will be for a particular flight.
@@ -35,12 +30,11 @@ long Passenger::getPassengerCount(long maxPassengers,  std::shared_ptr<SimSettin
 // then each time a plane is put in PlaneQueue it is given a delay for passengers arriving
 // in the range [0 - maxPassengerDelay]. Planes that are grounded are also put into
 // PlaneQueue, but are given a dealy of LONG_MAX so they never are assigned to a flight.
-long Passenger::getPassengerDelay(long maxPassengerDelay) {
+long Passenger::getPassengerDelay(long maxPassengerDelay, SimRandom &random) {
     // If the maximum delay is not greater than 0 then there is no delay
     if(maxPassengerDelay <= 0) {
         return 0;
     }
     // Get a random number of delays in [0 - maxPassengerDelay]
-    std::uniform_int_distribution<> delayDistribution(0, static_cast<int>(maxPassengerDelay));
-    return delayDistribution(generator);
+    return random.uniformLong(0, maxPassengerDelay);
 }
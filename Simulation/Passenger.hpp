@@ -14,8 +14,10 @@
 #include <string>
 #include <iostream>
 #include <random>
+#include <memory>
 
 #include "SimSettings.hpp"
+#include "SimRandom.hpp"
 
 
 /*
@@ -23,22 +25,20 @@
  * class Passenger
  * This virtual class provides access to two routines that manage passenger information.
  * If there is later a need to model passenger behavior, this could become a regular class.
+ * The random numbers come from the plane the passengers are boarding.
  *******************************************************************************************
  */
 class Passenger {
     Passenger() = delete;
-
-    static std::random_device a_random_device;
-    static std::mt19937 generator;
 public:
     // This provides the number of passengers on a flight. It takes the maximum number
     // and the settings and determines if it should return that maximum number or a
     // random number between 1 and the maximum.
-    static long getPassengerCount(long maxPassengers, std::shared_ptr<SimSettings> theSettings);
+    static long getPassengerCount(long maxPassengers, const std::shared_ptr<SimSettings> &theSettings, SimRandom &random);
 
     // This determines how long a delay there will be for a particular flight.
     // Depending on the settings it may return 0 delay or some randome delay
-    static long getPassengerDelay(long maxPassengerDelay);
+    static long getPassengerDelay(long maxPassengerDelay, SimRandom &random);
 };
 
 #endif /* Passenger_hpp */
@@ -6,6 +6,8 @@
 //
 
 #include <random>
+#include <algorithm>
+#include <cfloat>
 #include "Plane.hpp"
 #include "Passenger.hpp"
 
@@ -49,8 +51,11 @@ PlaneSpecification planeSpecifications[]{
 };
 
 // Each plane is assigned a plane number (mostly for testing)
-int Plane::NextPlaneNumber = 1; // We use this static member to keep track of next number to assign
-Plane::Plane(PlaneSpecification &spec): mySpecs(spec) {
+std::atomic<int> Plane::NextPlaneNumber{1}; // We use this static member to keep track of next number to assign
+Plane::Plane(PlaneSpecification &spec): Plane(spec, SimRandom().next()) {
+}
+Plane::Plane(PlaneSpecification &spec, uint64_t seed, double faultBias): mySpecs(spec), random{seed},
+faultBias{faultBias}, faultLogWeight{0}, lastDrawLogWeight{0}, drawnFaultInterval{0} {
     // To aoid divide by 0 and other silly errors
     // we should validate specs before creating Plane, this is extra checking
     if(!validateSpecs(mySpecs)) {
@@ -79,6 +84,11 @@ int Plane::getPlaneNumber() {
     return planeNumber;
 }
 
+// The number the next plane made will get
+int Plane::getNextPlaneNumber() {
+    return NextPlaneNumber;
+}
+
 // For testing: provide a description of this plane
 const std::string Plane::describe(){
     std::string description = "plane #" + std::to_string(planeNumber) + " from " + getCompanyName();
@@ -137,6 +147,20 @@ long Plane::decrementNextFaultInterval(long seconds) {
     return seconds;
 }
 
+// Count the faults in flown seconds of flight, starting with the current fault interval, as a
+// flight with an event at each fault would: a fault at the very end counts, and the part of
+// the last interval that was not flown is left for the next flight.
+long Plane::countFaults(long flown) {
+    long faults = 0;
+    long nextFault = nextFaultInterval;
+    while(nextFault <= flown) {
+        faults++;
+        nextFault += createFaultInterval();
+    }
+    nextFaultInterval = nextFault - flown;
+    return faults;
+}
+
 // Across a population we can create the effect of a fault per time rate by having each object
 // randomly assigned an interval to its next fault in a way that matches the distribution.
 // This function does that calcuation. Knwoing in advance the next fault interval for a plane
@@ -145,11 +169,15 @@ long Plane::decrementNextFaultInterval(long seconds) {
 // It works because the fault per hour probabiilty is still honored across the population as long
 // as every plane is assigned the an intervaly according to the right random distribution.
 long Plane::createFaultInterval() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    // First generate a random real number between 0 and 1
-    std::uniform_real_distribution<> distrib(0, 1);
-    double random0to1 = distrib(gen);
+    // First generate a random real number between 0 and 1 from this plane's own random numbers
+    double random0to1 = random.uniform01();
+    if(faultBias != 1.0) {
+        // A bias draws u^(1/faultBias) instead, which has density faultBias * u^(faultBias - 1), so
+        // the intervals are as if the rate were faultBias times higher. Keep the ratio of the densities.
+        random0to1 = std::pow(random0to1, 1.0 / faultBias);
+        lastDrawLogWeight = -std::log(faultBias) - (faultBias - 1.0) * std::log(std::max(random0to1, DBL_MIN));
+        faultLogWeight += lastDrawLogWeight;
+    }
     // We then take the ln (natural logarithm) of that number and divide it by the fault rate
     // But ln(0) is infinity so we avoid the occasional very small number
     if (random0to1 < 0.001) { random0to1 = 0.001; };
@@ -160,9 +188,31 @@ long Plane::createFaultInterval() {
     if(nextFaultInterval <= 0) {
         nextFaultInterval = 1;
     }
+    drawnFaultInterval = nextFaultInterval;
     return nextFaultInterval;
 }
 
+// The log of the likelihood ratio of this plane's fault intervals. The last interval has not
+// ended in a fault, so instead of its density it counts the chance of lasting as long as it
+// has: for used seconds that is exp(-rate * (used + 0.5)) without the bias (for the rounding
+// to whole seconds) and that to the power faultBias with it.
+double Plane::getFaultLogWeight() {
+    if(faultBias == 1.0) {
+        return 0.0;
+    }
+    double logWeight = faultLogWeight - lastDrawLogWeight;
+    long used = drawnFaultInterval - nextFaultInterval;
+    if(used > 0) {
+        logWeight += (faultBias - 1.0) * mySpecs.probability_fault__per_hour * (used + 0.5) / secondsPerHourD;
+    }
+    return logWeight;
+}
+
+// The random numbers for anything that happens to this plane
+SimRandom &Plane::getRandom() {
+    return random;
+}
+
 // This is to validate that the specifications are reasonable
 // Later, particularly if we load them from a file, we need to
 // do more rigorous validation.
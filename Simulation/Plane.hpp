@@ -13,7 +13,11 @@
 #include <queue>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <climits>
+#include <atomic>
 #include "SimSettings.hpp"
+#include "SimRandom.hpp"
 
 // Specifications provided by the assigned task
 /*
@@ -58,9 +62,20 @@ class Plane {
                             // fault we decrement this inteval by the duration of the
                             // flight passed without a fault.
     int planeNumber; // Each plane is assigned a plane number (mostly for testing)
-    static int NextPlaneNumber; // Keep track of next number to assign
+    static std::atomic<int> NextPlaneNumber; // Keep track of next number to assign (Simulations may run on several threads)
+    SimRandom random; // This plane's own random numbers
+    // With a fault bias, each interval is drawn as if faults were faultBias times as likely.
+    // The log of how much more likely the intervals drawn so far were without the bias is
+    // kept, counting the last one as if it had ended in a fault.
+    double faultBias;
+    double faultLogWeight;
+    double lastDrawLogWeight;
+    long drawnFaultInterval; // The last interval as it was drawn
 public:
+    // A plane created without a seed gets a random one. A Simulation seeds each plane
+    // from its own seed so runs can be repeated.
     Plane(PlaneSpecification &spec);
+    Plane(PlaneSpecification &spec, uint64_t seed, double faultBias = 1.0);
     ~Plane();
 
     // For testing: get the Company enum assigned to this plane
@@ -72,6 +87,9 @@ public:
     // For testing: get the plane number
     int getPlaneNumber();
 
+    // The number the next plane made will get
+    static int getNextPlaneNumber();
+
     // For testing: provide a description of this plane
     const std::string describe();
 
@@ -103,10 +121,20 @@ public:
     // decrement the full flight time, only the time since this
     // fault interval was set up. The Flight remembers that.
     long decrementNextFaultInterval(long seconds);
+    // Count the faults in a flight of flown seconds without an event for each one
+    long countFaults(long flown);
 
     // Use the MTBF to generate a random next fault interval
     long createFaultInterval();
 
+    // With a fault bias, the log of how much more likely this plane's fault intervals were
+    // without it: the ones that ended in faults, and the last one for the flight time it has
+    // used so far without a fault. It is 0 without a bias.
+    double getFaultLogWeight();
+
+    // The random numbers for anything that happens to this plane
+    SimRandom &getRandom();
+
     // Validate the plane specifications are (somewhat) valid
     static bool validateSpecs(PlaneSpecification &spec);
 
@@ -6,34 +6,69 @@
 //
 
 #include "PlaneQueue.hpp"
+#include "SimProfile.hpp"
 #include "Flight.hpp"
 #include "Passenger.hpp"
+#include <algorithm>
 
 extern PlaneSpecification planeSpecifications[];
 
 /*
  *******************************************************************************************
  * Class PlaneQueue
- * This manages a vector of planes waiting for passengers. If the options are that planes
+ * This manages a heap of planes waiting for passengers. If the options are that planes
  * never wait for passengers, then this is a place to create the initial collection of planes.
  * It is also a place to put planes that are grounded due to faults if that option is chosen.
  *
+ * The planes waiting for passengers are a binary min-heap on (nextFlightTime, sequence) so
+ * adding a plane or taking the next one is O(log n). Grounded planes never fly again, so
+ * they are kept in a separate vector where adding one is O(1) and they do not slow down the
+ * heap.
+ *
  * This is a child of eventHandler. As such, it will be added to the SimClock queue.
  *
- * A Simulation object will contain exactly one PlaneQueue.
- * If the PlaneQueue object is in a Simulation it has a pointer to that Simulation object.
+ * A Simulation object will contain one PlaneQueue for each site.
+ * If the PlaneQueue object is in a Simulation it has a pointer to that Simulation object
+ * and knows its site number.
  * For testing, a PlaneQueue may have a nullptr for theSimulation property.
  *******************************************************************************************
  */
-PlaneQueue::PlaneQueue(Simulation *theSimulation):
+PlaneQueue::PlaneQueue(Simulation *theSimulation, long siteNumber):
 // Set our nextEventTime initially to LONG_MAX so we can be in the SimClock handler list, but
 // not receive events until something happens to activate us such as adding planes that
 // are ready to fly.
-EventHandler(LONG_MAX),theSimulation{theSimulation}, verboseTesting{}, planesWaiting{} {
+EventHandler(LONG_MAX, profilePlaneQueue, siteNumber),theSimulation{theSimulation}, verboseTesting{},
+planesWaiting(CountingAllocator<PlaneQueueItem>(Simulation::memoryOf(theSimulation), memoryQueues)),
+planesGrounded(CountingAllocator<std::shared_ptr<Plane>>(Simulation::memoryOf(theSimulation), memoryQueues)), nextPlaneSequence{0}, siteNumber{siteNumber} {
 }
 PlaneQueue::~PlaneQueue() {
 }
 
+// The planesWaiting vector is a heap with the plane ready soonest at the front. std::push_heap
+// and std::pop_heap build a max-heap, so this comparison is "a is ready after b". Planes
+// ready at the same time are ordered by sequence so the first one added is the first to fly.
+static bool planeReadyLater(const PlaneQueueItem &a, const PlaneQueueItem &b) {
+    if(a.nextFlightTime != b.nextFlightTime) {
+        return a.nextFlightTime > b.nextFlightTime;
+    }
+    return a.sequence > b.sequence;
+}
+
+// Remove the plane that is ready first from the heap and return it
+PlaneQueueItem PlaneQueue::popPlane() {
+    std::pop_heap(begin(planesWaiting), end(planesWaiting), planeReadyLater);
+    PlaneQueueItem anItem = planesWaiting.back();
+    planesWaiting.pop_back();
+    return anItem;
+}
+
+// For testing: the planes waiting, sorted the way the old vector was (soonest at the back)
+std::vector<PlaneQueueItem> PlaneQueue::sortedPlanesWaiting() {
+    std::vector<PlaneQueueItem> sorted(planesWaiting.begin(), planesWaiting.end());
+    std::sort(begin(sorted), end(sorted), planeReadyLater);
+    return sorted;
+}
+
 // As a child of EventHandler, PlaneQueue has a nextEventTime. Each time the SimClock
 // reaches the nextEventTime, it will call handleEvent(). If handleEvent returns false,
 // the SimClock will remove this object from the simulation, but there should always be
@@ -54,18 +89,19 @@ bool PlaneQueue::handleEvent(long currentTime, bool closeOut) {
         std::cout << std::endl;
         return false;
     }
-    while(!planesWaiting.empty() && planesWaiting.back().nextFlightTime <= currentTime) {
+    while(!planesWaiting.empty() && planesWaiting.front().nextFlightTime <= currentTime) {
         // While we have any plane that is ready to fly and has hit its assigned passenger wait time,
         // remove it from the wait queue and put it into a new flight.
-        // First, get the next plane ready to go. Planes with equal nextFlightTime are stored so they
-        // will be handled FIFO.
-        std::shared_ptr<Plane> thePlane = planesWaiting.back().thePlane;
-        // Remove the plane from the queue because it will be handed to a Flight object
-        planesWaiting.pop_back();
+        // Remove the next plane ready to go from the heap because it will be handed to a Flight object.
+        // Planes with equal nextFlightTime come out FIFO.
+        std::shared_ptr<Plane> thePlane = popPlane().thePlane;
         if(theSimulation && theSimulation->theSimClock) {
             // Create a flight object containing the plane and add it to theSimClock
-            theSimulation->theSimClock->addHandler(std::make_shared<Flight>(theSimulation,
-              currentTime, Passenger::getPassengerCount(thePlane->getMaxPassengerCount(),theSimulation->theSettings),thePlane));
+            // The passengers and destination come from the plane's own random numbers, in that order.
+            long passengerCount = Passenger::getPassengerCount(thePlane->getMaxPassengerCount(),theSimulation->theSettings, thePlane->getRandom());
+            long destinationSite = theSimulation->pickDestinationSite(siteNumber, thePlane->getRandom());
+            theSimulation->theSimClock->addHandler(std::allocate_shared<Flight>(CountingAllocator<Flight>(&theSimulation->theMemory, memoryHandlers),
+              theSimulation, currentTime, passengerCount, thePlane, siteNumber, destinationSite));
         } else if(verboseTesting) {
             // If testing and being verbose, explain what we would have done if part of an actual simulation.
             std::cout << "Would add flight for " << thePlane->describe() << "to SimClock if full simulation" << std::endl;
@@ -75,15 +111,15 @@ bool PlaneQueue::handleEvent(long currentTime, bool closeOut) {
         // No planes waiting now so keep us in SimClock, but do not pass events to us until something changes
         nextEventTime = LONG_MAX;
     } else  {
-        // Updaate our next time to the plane at the back of the vector (the next one that will be ready)
-        nextEventTime = planesWaiting.back().nextFlightTime;
+        // Updaate our next time to the plane at the top of the heap (the next one that will be ready)
+        nextEventTime = planesWaiting.front().nextFlightTime;
     }
     return true;
 }
 
-// For testing: total how may planes are in the wait queue
+// For testing: total how may planes are in the wait queue, including grounded planes
 long PlaneQueue::countPlanes() {
-    return static_cast<long>(planesWaiting.size());
+    return static_cast<long>(planesWaiting.size() + planesGrounded.size());
 }
 
 // For testing: describe the object and the count od planes in the object
@@ -92,34 +128,45 @@ const std::string PlaneQueue::describe() {
     return description;
 }
 
+// Which ProfileKind the profiler counts this handler as
+int PlaneQueue::profileKind() {
+    return profilePlaneQueue;
+}
+
 
-// Is vector empty?
+// Are the heap and the grounded pool both empty?
 bool PlaneQueue::isEmpty() {
-    return planesWaiting.empty();
+    return planesWaiting.empty() && planesGrounded.empty();
 }
 
-// Insert a plane into the proper position in the waiting vector so the plane ready
-// soonest is at the back wit equal ready times being FIFO.
+// How many planes have been grounded at this site?
+long PlaneQueue::getGroundedCount() {
+    return static_cast<long>(planesGrounded.size());
+}
+
+// Add a plane to the heap so the plane ready soonest is at the front with equal ready
+// times being FIFO.
 // After adding the plane during a handleEvent cycle, if it is immediatley ready
 // the handleEvent function will notice that and move it to a Flight. If outside
 // our own handleEvent function then it would be put into a flight when it is next called.
+// A plane with a delay of LONG_MAX is grounded and goes into the grounded pool instead.
 void PlaneQueue::addPlane(long delayUntil, std::shared_ptr<Plane> aPlane) {
     if(verboseTesting) {
         std::cout << "Adding " << aPlane->describe() << " with delay until " << delayUntil << std::endl;
     }
-    // Keep planes sorted with soonest ready time at the end.
-    auto planePtr = begin(planesWaiting);
-    while(planePtr != end(planesWaiting) &&  planePtr->nextFlightTime > delayUntil) {
-        planePtr++;
+    if(delayUntil == LONG_MAX) {
+        // Grounded planes never change our nextEventTime so there is nothing else to do
+        planesGrounded.push_back(aPlane);
+        return;
     }
-    PlaneQueueItem queueItem = PlaneQueueItem{aPlane, delayUntil};
-    planesWaiting.insert(planePtr, queueItem);
+    planesWaiting.push_back(PlaneQueueItem{aPlane, delayUntil, nextPlaneSequence++});
+    std::push_heap(begin(planesWaiting), end(planesWaiting), planeReadyLater);
     
     // if our nextFlightTime time has changed, we need to be resorted in the SimClock
-    if(nextEventTime != planesWaiting.back().nextFlightTime) {
-        nextEventTime = planesWaiting.back().nextFlightTime; // adjust the next time for our queue
-        if(theSimulation && theSimulation->theSimClock && theSimulation->thePlaneQueue) {
-            theSimulation->theSimClock->reSortHandler(theSimulation->thePlaneQueue);
+    if(nextEventTime != planesWaiting.front().nextFlightTime) {
+        nextEventTime = planesWaiting.front().nextFlightTime; // adjust the next time for our queue
+        if(theSimulation && theSimulation->theSimClock && theSimulation->getPlaneQueue(siteNumber)) {
+            theSimulation->theSimClock->reSortHandler(theSimulation->getPlaneQueue(siteNumber));
         }
     }
 
@@ -129,6 +176,25 @@ void PlaneQueue::addPlane(long delayUntil, std::shared_ptr<Plane> aPlane) {
 // for each kind. This algorithm can only work correctly if the options meet this condition:
 //      count >= minOfEachKind * numberOfKinds.
 void PlaneQueue::generatePlanes(long currentTime, long count, long minOfEachCompany, long maxPassengerDelay) {
+    SimRandom random;
+    generatePlanes(currentTime, chooseCompanies(count, minOfEachCompany, random), maxPassengerDelay);
+}
+
+// Add a plane for each company in companyChoices, each with its own wait for passengers.
+// In a Simulation the planes come from the Simulation so they get their share of its seed.
+void PlaneQueue::generatePlanes(long currentTime, const std::vector<Company> &companyChoices, long maxPassengerDelay) {
+    for(Company thisChoice: companyChoices) {
+        std::shared_ptr<Plane> aPlane = theSimulation ? theSimulation->makePlane(thisChoice) : std::make_shared<Plane>(planeSpecifications[thisChoice]);
+        // set up this plane's wait for passengers
+        long waitForPassengers = Passenger::getPassengerDelay(maxPassengerDelay, aPlane->getRandom());
+        // actually add the random plane
+        addPlane(waitForPassengers, aPlane);
+    }
+}
+
+// Choose the companies for "count" planes semi-randomly. Make sure at least "minOfEachKind"
+// are chosen for each kind. The choices are returned in the order they were made.
+std::vector<Company> PlaneQueue::chooseCompanies(long count, long minOfEachCompany, SimRandom &random) {
     
     // Set up an array of how many minimum are needed of each kind
     long neededOfCompany[companyCount]{};
@@ -143,7 +209,7 @@ void PlaneQueue::generatePlanes(long currentTime, long count, long minOfEachComp
     std::vector<Company> companyChoices(count);
     for(long planesAllocated = 0; planesAllocated < count; planesAllocated++) {
         // Select a random company.
-        long thisCompany = rand() % companyCount;
+        long thisCompany = random.uniformLong(0, companyCount - 1);
         // As long as we need some minimums, make sure we do those first
         // Otherwise just go with the intial random choice
         if(totalCompanyStillNeeded > 0) {
@@ -170,32 +236,33 @@ void PlaneQueue::generatePlanes(long currentTime, long count, long minOfEachComp
         // Remember the choice
         companyChoices[planesAllocated] = allCompany[thisCompany];
     }
-
     // We do the actual allocation of planes as a separate step in case we want to add more processing first
-    for(long thisChoice: companyChoices) {
-        // set up this plane's wait for passengers
-        long waitForPassengers = Passenger::getPassengerDelay(maxPassengerDelay);
-        // actually add the random plane
-        addPlane(waitForPassengers, std::make_shared<Plane>(planeSpecifications[thisChoice]));
-    }
+    return companyChoices;
 }
 
-// For testing: remove the next Plane ready from the vector independent of timing
-// and return it to the caller.
+// For testing: remove the next Plane ready from the heap independent of timing
+// and return it to the caller. Once the heap is empty it returns grounded planes.
 std::shared_ptr<Plane> PlaneQueue::removeNextPlane() {
     if(planesWaiting.empty()) {
-        // no planes to remove
-        return nullptr;
+        if(planesGrounded.empty()) {
+            // no planes to remove
+            return nullptr;
+        }
+        // Grounded planes do not affect our nextEventTime
+        std::shared_ptr<Plane> returnValue = planesGrounded.back();
+        planesGrounded.pop_back();
+        return returnValue;
     }
     // Get a pointer to the plane and remove it from this object
-    std::shared_ptr<Plane> returnValue = planesWaiting.back().thePlane;
-    planesWaiting.pop_back();
+    std::shared_ptr<Plane> returnValue = popPlane().thePlane;
 
-    // if our earliest nextFlightTime time has changed, we need to be resorted in the SimClock
-    if(nextEventTime != planesWaiting.back().nextFlightTime) {
-        nextEventTime = planesWaiting.back().nextFlightTime; // adjust the next time for our queue
-        if(theSimulation && theSimulation->theSimClock && theSimulation->thePlaneQueue) {
-            theSimulation->theSimClock->reSortHandler(theSimulation->thePlaneQueue);
+    // if our earliest nextFlightTime time has changed, we need to be resorted in the SimClock.
+    // If that was the last plane waiting, we have no next event.
+    long newNextEventTime = planesWaiting.empty() ? LONG_MAX : planesWaiting.front().nextFlightTime;
+    if(nextEventTime != newNextEventTime) {
+        nextEventTime = newNextEventTime; // adjust the next time for our queue
+        if(theSimulation && theSimulation->theSimClock && theSimulation->getPlaneQueue(siteNumber)) {
+            theSimulation->theSimClock->reSortHandler(theSimulation->getPlaneQueue(siteNumber));
         }
     }
     return returnValue;
@@ -217,7 +284,7 @@ void PlaneQueue::describeQueue(long currentTime) {
         std::cout << "No planes in PlaneQueue" << std::endl;
    } else {
         std::cout << "Planes in PlaneQueue" << std::endl;
-       for(auto aPlaneQueueItem: planesWaiting) {
+       for(auto aPlaneQueueItem: sortedPlanesWaiting()) {
            if(verboseTesting) {
                std::cout << "    " << aPlaneQueueItem.thePlane->describe() << " next fight time " << aPlaneQueueItem.nextFlightTime << std::endl;
            } else {
@@ -225,6 +292,9 @@ void PlaneQueue::describeQueue(long currentTime) {
            }
         }
     }
+    if(!planesGrounded.empty()) {
+        std::cout << planesGrounded.size() << " planes grounded" << std::endl;
+    }
     std::cout << std::endl;
 }
 
@@ -232,8 +302,12 @@ void PlaneQueue::describeQueue(long currentTime) {
 std::vector<PlaneQueueStatusItem> PlaneQueue::getQueueStatus() {
     // Set up a result vector
     std::vector<PlaneQueueStatusItem> result{};
-    // Push information on current waiting planes into the vector
-   for(auto aPlaneQueueItem: planesWaiting) {
+    // Push information on grounded planes (which never fly) and then current waiting planes
+    // into the vector, the plane ready soonest last
+    for(auto aPlane: planesGrounded) {
+        result.push_back(PlaneQueueStatusItem{aPlane->getPlaneNumber(), aPlane->getCompany(), LONG_MAX});
+    }
+   for(auto aPlaneQueueItem: sortedPlanesWaiting()) {
         PlaneQueueStatusItem anItem{aPlaneQueueItem.thePlane->getPlaneNumber(), aPlaneQueueItem.thePlane->getCompany(), aPlaneQueueItem.nextFlightTime};
         result.push_back(anItem);
     }
@@ -311,3 +385,64 @@ bool testPlaneQueueForMinimumPerKind() {
     std::cout << std::endl;
     return returnValue;
 }
+
+// Test that planes come out of the heap in time order, FIFO for equal times, and that
+// grounded planes are kept apart and counted
+bool testPlaneQueueOrder() {
+    // Delays for the test planes. Equal delays check the tie breaking and LONG_MAX grounds a plane.
+    const long testDelays[]{50, 10, LONG_MAX, 30, 10, 50, LONG_MAX, 0};
+
+    bool returnValue = true;
+    std::cout << " ***** Starting order test of PlaneQueue Class *****" << std::endl;
+    PlaneQueue aQueue(nullptr);
+    // Work out the expected order: by delay, then the order added. Grounded planes are last.
+    std::vector<std::pair<long, int>> expected{};
+    long groundedCount = 0;
+    for(long delay: testDelays) {
+        std::shared_ptr<Plane> aPlane = std::make_shared<Plane>(planeSpecifications[Alpha]);
+        if(delay == LONG_MAX) {
+            groundedCount++;
+        } else {
+            expected.push_back(std::make_pair(delay, aPlane->getPlaneNumber()));
+        }
+        aQueue.addPlane(delay, aPlane);
+    }
+    std::stable_sort(begin(expected), end(expected), [](const std::pair<long, int> &a, const std::pair<long, int> &b) {
+        return a.first < b.first;
+    });
+    if(aQueue.getGroundedCount() != groundedCount || aQueue.countPlanes() != static_cast<long>(expected.size()) + groundedCount) {
+        std::cout << "***** error: " << aQueue.getGroundedCount() << " grounded of " << aQueue.countPlanes()
+        << " planes, expected " << groundedCount << " of " << expected.size() + groundedCount << std::endl;
+        returnValue = false;
+    }
+    // Grounded planes must not affect when the queue wants its next event
+    if(aQueue.getNextEventTime() != expected.front().first) {
+        std::cout << "***** error: next event time " << aQueue.getNextEventTime() << " expected " << expected.front().first << std::endl;
+        returnValue = false;
+    }
+    // Take the planes out one at a time. The next event time must follow the plane that is left
+    // at the front, and be LONG_MAX once only grounded planes remain.
+    for(size_t i = 0; i < expected.size(); i++) {
+        std::shared_ptr<Plane> aPlane = aQueue.removeNextPlane();
+        long expectedNextTime = i + 1 < expected.size() ? expected[i + 1].first : LONG_MAX;
+        if(!aPlane || aPlane->getPlaneNumber() != expected[i].second || aQueue.getNextEventTime() != expectedNextTime) {
+            std::cout << "***** error: plane " << (aPlane ? aPlane->getPlaneNumber() : -1) << " removed, expected "
+            << expected[i].second << " next event time " << aQueue.getNextEventTime() << " expected " << expectedNextTime << std::endl;
+            returnValue = false;
+        }
+    }
+    // What is left is the grounded planes
+    for(long i = 0; i < groundedCount; i++) {
+        if(!aQueue.removeNextPlane()) {
+            std::cout << "***** error: grounded plane missing" << std::endl;
+            returnValue = false;
+        }
+    }
+    if(!aQueue.isEmpty() || aQueue.removeNextPlane()) {
+        std::cout << "***** error: queue should be empty" << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Order test of PlaneQueue Class " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
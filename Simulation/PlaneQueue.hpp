@@ -18,13 +18,15 @@
 /*
  *******************************************************************************************
  * Struct PlaneQueueItem
- * This is a helper struct. The plane queue contains a vector of planes, but we also need
- * to know when they should be assigned to a flight.
+ * This is a helper struct. The plane queue contains a heap of planes, but we also need
+ * to know when they should be assigned to a flight. The sequence records the order planes
+ * were added so planes with the same nextFlightTime leave first come, first served.
  *******************************************************************************************
  */
 struct PlaneQueueItem {
     std::shared_ptr<Plane> thePlane;
     long nextFlightTime;
+    long sequence;
 };
 /*
  *******************************************************************************************
@@ -41,25 +43,40 @@ struct PlaneQueueStatusItem {
 /*
  *******************************************************************************************
  * Class PlaneQueue
- * This manages a vector of planes waiting for passengers. If the options are that planes
+ * This manages a heap of planes waiting for passengers. If the options are that planes
  * never wait for passengers, then this is a place to create the initial collection of planes.
  * It is also a place to put planes that are grounded due to faults if that option is chosen.
  *
+ * The planes waiting for passengers are a binary min-heap on (nextFlightTime, sequence) so
+ * adding a plane or taking the next one is O(log n). Grounded planes never fly again, so
+ * they are kept in a separate vector where adding one is O(1) and they do not slow down the
+ * heap.
+ *
  * This is a child of eventHandler. As such, it will be added to the SimClock queue.
  *
- * A Simulation object will contain exactly one PlaneQueue.
- * If the PlaneQueue object is in a Simulation it has a pointer to that Simulation object.
+ * A Simulation object will contain one PlaneQueue for each site.
+ * If the PlaneQueue object is in a Simulation it has a pointer to that Simulation object
+ * and knows its site number.
  * For testing, a PlaneQueue may have a nullptr for theSimulation property.
  *******************************************************************************************
  */
 class PlaneQueue: public EventHandler {
     Simulation *theSimulation; // Simulation object containing current simulation or nullptr
     bool verboseTesting; // Option for testing to have the class output action descriptions
-    // The following is a vector, not a queue because it is kept soonest at tne end and
-    // we can add a Plane to it that has a our of order passengerDelay
-    std::vector<PlaneQueueItem> planesWaiting;
+    // A min-heap with the plane ready soonest at the front
+    CountedVector<PlaneQueueItem> planesWaiting;
+    // Planes grounded for the rest of the simulation, in the order they were grounded
+    CountedVector<std::shared_ptr<Plane>> planesGrounded;
+    long nextPlaneSequence; // Sequence number for the next plane added so ties are handled FIFO
+    long siteNumber; // Which site in theSimulation these planes are at
+
+    // Remove the plane that is ready first from the heap and return it
+    PlaneQueueItem popPlane();
+
+    // For testing: the planes waiting, sorted the way the old vector was (soonest at the back)
+    std::vector<PlaneQueueItem> sortedPlanesWaiting();
 public:
-    PlaneQueue(Simulation *theSimulation);
+    PlaneQueue(Simulation *theSimulation, long siteNumber = 0);
     virtual ~PlaneQueue()override;
 
     // As a child of EventHandler, PlaneQueue has a nextEventTime. Each time the SimClock
@@ -75,13 +92,20 @@ public:
 
     // For testing: describe this object in the clock handler queue
     virtual const std::string describe() override;
+    
+    // Which ProfileKind the profiler counts this handler as
+    virtual int profileKind() override;
 
-    // Is the vector of Plane objects empty?
+    // Are there no planes at all, either waiting or grounded?
     bool isEmpty();
 
-    // Add a plane to the vector, sorting it according to the delayUntil time.
+    // How many planes have been grounded at this site?
+    long getGroundedCount();
+
+    // Add a plane to the heap according to the delayUntil time.
     // When the SimClock currentTime >= delayUntil the next call to handleEvent will put
     // the plane into a filght and put that into the SimClock.
+    // A delayUntil of LONG_MAX grounds the plane. It goes in the grounded pool instead.
     void addPlane(long delayUntil, std::shared_ptr<Plane> aPlane);
 
     // Fill the vector with planes with possible delays according to the settings.
@@ -90,10 +114,18 @@ public:
     // If count >= minOfEachCompany and count >= "the number of plane Companys" there will
     // at least be minOfEachCompany planes of each Company.
     void generatePlanes(long currentTime, long count, long minOfEachCompany, long maxPassengerDelay);
+
+    // Add one plane for each entry in companyChoices with possible delays according to the settings.
+    // This is used when the companies were chosen for all sites at once.
+    void generatePlanes(long currentTime, const std::vector<Company> &companyChoices, long maxPassengerDelay);
+
+    // Choose the companies for "count" planes semi-randomly. If count >= minOfEachCompany and
+    // count >= "the number of plane Companys" there will at least be minOfEachCompany of each Company.
+    // The random choices come from "random".
+    static std::vector<Company> chooseCompanies(long count, long minOfEachCompany, SimRandom &random);
  
-    // For testing: remove the next Plane from the vector independent of timing
-    // and return it to the caller. This is not currently used, but may be used
-    // later for additional unit tests.
+    // For testing: remove the next Plane from the heap independent of timing
+    // and return it to the caller. Once the heap is empty it returns grounded planes.
     std::shared_ptr<Plane> removeNextPlane();
 
     // For testing: ask some actions to be sent to cout
@@ -113,4 +145,8 @@ bool testPlaneQueueForWaits();
 // expected criteria
 bool testPlaneQueueForMinimumPerKind();
 
+// Test that planes come out of the heap in time order, FIFO for equal times, and that
+// grounded planes are kept apart and counted
+bool testPlaneQueueOrder();
+
 #endif /* PlaneQueue_hpp */
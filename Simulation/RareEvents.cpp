@@ -0,0 +1,198 @@
+//
+//  RareEvents.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "RareEvents.hpp"
+#include "Plane.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// The second moment of one plane's weighted indicator, with a expected faults in its flight
+// time: the integral over fault times t (in units of the mean interval) up to a of
+// e^-t * e^((bias - 1) t) / bias, which is the density without the bias times the weight.
+static double weightedSecondMoment(double bias, double a) {
+    if(std::fabs(bias - 2.0) < 1e-9) {
+        return a / 2.0;
+    }
+    return (std::exp((bias - 2.0) * a) - 1.0) / (bias * (bias - 2.0));
+}
+
+// The bias with the smallest variance for one plane, found on a fine grid
+double suggestFaultBias(double expectedFaults) {
+    if(expectedFaults <= 0) {
+        return 1.0;
+    }
+    double bestBias = 1.0;
+    double bestMoment = weightedSecondMoment(1.0, expectedFaults);
+    for(double bias = 1.0; bias <= 1000.0; bias *= 1.01) {
+        double moment = weightedSecondMoment(bias, expectedFaults);
+        if(moment < bestMoment) {
+            bestMoment = moment;
+            bestBias = bias;
+        }
+    }
+    return bestBias;
+}
+
+// Weighted runs with theCompany's faults biased, counting the runs that ground all of it
+RareEventEstimate estimateGroundingChance(const SimSettings &someSettings, Company theCompany, long runs, double faultBias) {
+    extern PlaneSpecification planeSpecifications[];
+    RareEventEstimate estimate{0, 0, 0, 0, faultBias, 0, 0, 0, ""};
+    if(someSettings.faultOption != 1 && someSettings.faultOption != 2) {
+        estimate.note = "only fault options that ground planes can ground a company";
+        return estimate;
+    }
+    auto startTimer = std::chrono::high_resolution_clock::now();
+    long firstSeed = someSettings.randomSeed > 0 ? someSettings.randomSeed : 1;
+    if(faultBias <= 0) {
+        // The company's flight time per plane when nothing is grounded
+        SimSettings pilotSettings = someSettings;
+        pilotSettings.faultOption = 0;
+        pilotSettings.faultBias = 1.0;
+        pilotSettings.randomSeed = firstSeed;
+        pilotSettings.progressInterval = 0;
+        Simulation pilot(pilotSettings);
+        pilot.setQuiet(true);
+        std::vector<FinalStats> results = pilot.run(false);
+        long planes = pilot.getPlaneCount(theCompany);
+        double flightSeconds = results[theCompany].totalFlights * results[theCompany].averageTimePerFlight;
+        double expectedFaults = planes > 0 ? planeSpecifications[theCompany].probability_fault__per_hour * flightSeconds / planes / secondsPerHourD : 0.0;
+        estimate.faultBias = suggestFaultBias(expectedFaults);
+    }
+
+    SimSettings runSettings = someSettings;
+    runSettings.faultBias = estimate.faultBias;
+    runSettings.faultBiasCompany = theCompany;
+    runSettings.progressInterval = 0;
+    double sum = 0, sumSquares = 0, sumWeights = 0;
+    for(long run = 0; run < runs; run++) {
+        runSettings.randomSeed = firstSeed + run;
+        Simulation aSimulation(runSettings);
+        aSimulation.setQuiet(true);
+        aSimulation.run(false);
+        double weight = aSimulation.getFaultWeight();
+        sumWeights += weight;
+        long planes = aSimulation.getPlaneCount(theCompany);
+        if(planes > 0 && aSimulation.getGroundedCount(theCompany) == planes) {
+            estimate.hits++;
+            sum += weight;
+            sumSquares += weight * weight;
+        }
+    }
+    estimate.runs = runs;
+    if(runs > 0) {
+        estimate.probability = sum / runs;
+        estimate.meanWeight = sumWeights / runs;
+    }
+    if(runs > 1) {
+        double variance = std::max(0.0, (sumSquares - runs * estimate.probability * estimate.probability) / (runs - 1));
+        estimate.standardError = std::sqrt(variance / runs);
+    }
+    if(estimate.standardError > 0) {
+        estimate.plainRuns = estimate.probability * (1.0 - estimate.probability) / (estimate.standardError * estimate.standardError);
+    }
+    estimate.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTimer).count();
+    return estimate;
+}
+
+// Check the estimates against an exact chance and check the weights
+bool testRareEvents() {
+    extern PlaneSpecification planeSpecifications[];
+    bool returnValue = true;
+    std::cout << " ***** Starting test of rare event estimates *****" << std::endl;
+
+    // With a charger for every plane, full planes and no passenger delay, each plane flies the
+    // same times until it is grounded. In 8 hours a Charlie plane flies 5 whole cycles of a
+    // 2250 second flight and a 2880 second charge, then one more flight, 13500 seconds in all.
+    // It is grounded if its first fault interval rounds to at most that, and the 4 Charlie
+    // planes are independent.
+    SimSettings settings{};
+    settings.simulationDuration = 8 * secondsPerHour;
+    settings.planeCount = 20;
+    settings.minPlanePerKind = 4;
+    settings.chargerCount = 20;
+    settings.progressInterval = 0;
+    settings.randomSeed = 101;
+    double onePlane = 1.0 - std::exp(-planeSpecifications[Charlie].probability_fault__per_hour * 13500.5 / secondsPerHourD);
+    double exact = std::pow(onePlane, 4);
+    const int faultOptions[]{1, 2};
+    const int engineOptions[]{1, 0};
+    for(int i = 0; i < 2; i++) {
+        settings.faultOption = faultOptions[i];
+        settings.engineOption = engineOptions[i];
+        RareEventEstimate estimate = estimateGroundingChance(settings, Charlie, 400);
+        if(std::fabs(estimate.probability - exact) > 4 * estimate.standardError || estimate.standardError > 0.15 * exact) {
+            std::cout << "***** error: fault option " << settings.faultOption << " estimated " << estimate.probability << " +/- "
+            << estimate.standardError << " for a chance of " << exact << std::endl;
+            returnValue = false;
+        }
+        if(estimate.plainRuns < 20 * estimate.runs || estimate.faultBias <= 1.0) {
+            std::cout << "***** error: the estimate with bias " << estimate.faultBias << " was worth only "
+            << estimate.plainRuns << " plain runs" << std::endl;
+            returnValue = false;
+        }
+    }
+
+    // Without a bias the weights are all 1 and the estimate is the share of runs
+    settings.faultOption = 1;
+    settings.engineOption = 1;
+    RareEventEstimate plain = estimateGroundingChance(settings, Bravo, 50, 1.0);
+    if(plain.meanWeight != 1.0 || plain.probability != plain.hits / 50.0) {
+        std::cout << "***** error: runs without a bias were weighted" << std::endl;
+        returnValue = false;
+    }
+
+    // The weights average 1 when planes wait for chargers and passengers and every company is
+    // biased, so the fault intervals of every plane matter
+    settings.simulationDuration = 24 * secondsPerHour;
+    settings.planeCount = 6;
+    settings.minPlanePerKind = 0;
+    settings.chargerCount = 2;
+    settings.maxPassengerDelay = 1800;
+    settings.passengerCountOption = 1;
+    settings.faultOption = 2;
+    settings.faultBias = 1.5;
+    const long runs = 2000;
+    double sum = 0, sumSquares = 0;
+    for(long run = 0; run < runs; run++) {
+        settings.randomSeed = 200 + run;
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        aSimulation.run(false);
+        double weight = aSimulation.getFaultWeight();
+        sum += weight;
+        sumSquares += weight * weight;
+    }
+    double mean = sum / runs;
+    double standardError = std::sqrt((sumSquares / runs - mean * mean) / (runs - 1));
+    if(std::fabs(mean - 1.0) > 4 * standardError) {
+        std::cout << "***** error: the weights averaged " << mean << " +/- " << standardError << std::endl;
+        returnValue = false;
+    }
+
+    // Both engines that follow each plane count the same grounded planes
+    settings.faultBias = 1.0;
+    settings.randomSeed = 7;
+    long grounded[2][companyCount]{};
+    for(int engine = 0; engine < 2; engine++) {
+        settings.engineOption = engine;
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        aSimulation.run(false);
+        for(Company c: allCompany) {
+            grounded[engine][c] = aSimulation.getGroundedCount(c);
+        }
+    }
+    if(!std::equal(std::begin(grounded[0]), std::end(grounded[0]), std::begin(grounded[1]))) {
+        std::cout << "***** error: the SimClock and FastEngine grounded different planes" << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of rare event estimates " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
@@ -0,0 +1,68 @@
+//
+//  RareEvents.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef RareEvents_hpp
+#define RareEvents_hpp
+
+#include <stdio.h>
+#include <string>
+#include "Simulation.hpp"
+
+/*
+ *******************************************************************************************
+ * Rare events by importance sampling
+ * An outcome like "every Charlie plane grounded within 24 hours" may happen once in tens of
+ * thousands of runs, so counting how often it happens in plain runs takes millions of them
+ * to say anything. Instead the runs are made with faults more likely (SimSettings::faultBias),
+ * so the outcome happens often, and each run is weighted by how much more likely its faults
+ * were without the bias (Simulation::getFaultWeight()). The average of the weight over the
+ * runs where the outcome happened is an unbiased estimate of its chance, and the spread of
+ * the weights gives its standard error.
+ *
+ * Each fault interval is drawn from u^(1/bias) instead of a uniform u, which is the same as
+ * drawing it at bias times the rate, and its weight is the ratio of the two densities of u.
+ * The interval a plane is part way through at the end is weighted by the chance of lasting
+ * as long as it has instead, which keeps the variance finite. Only the fault intervals are
+ * biased; everything else each plane draws is the same as in a plain run.
+ *
+ * Too little bias and the outcome stays rare; too much and a few runs with huge weights
+ * decide the answer. suggestFaultBias() picks the bias that minimizes the variance for one
+ * plane that must fault within a fixed flight time, from how many faults that plane would
+ * expect. The mean weight over all the runs averages 1, though it is noisy for few runs
+ * because the planes that do not fault have weights above 1.
+ *******************************************************************************************
+ */
+struct RareEventEstimate {
+    double probability; // The estimated chance of the outcome
+    double standardError; // Of that estimate
+    long runs;
+    long hits; // Runs where the outcome happened, with the bias
+    double faultBias; // The bias the runs used
+    double meanWeight; // The average weight of all the runs, which averages 1
+    double plainRuns; // Runs without a bias needed for the same standard error
+    double seconds; // Time taken by the runs, including the pilot run
+    std::string note; // Why there is no estimate, if there is not
+};
+
+// The bias that minimizes the variance of the weighted estimate of the chance that one plane
+// that expects expectedFaults faults in its flight time has at least one. It is 1 if
+// expectedFaults is not positive, and at most 1000.
+double suggestFaultBias(double expectedFaults);
+
+// The chance that every plane of theCompany is grounded by the end of a run with
+// someSettings, which must have faultOption 1 or 2. Only theCompany's faults are biased. With
+// a faultBias of 0, a pilot run without grounding measures the company's flight time per
+// plane and suggestFaultBias() chooses it. The runs use the seeds from someSettings'
+// randomSeed (or 1) on, so the estimate can be repeated.
+RareEventEstimate estimateGroundingChance(const SimSettings &someSettings, Company theCompany, long runs, double faultBias = 0);
+
+// Check that the weighted estimates match a chance that can be worked out exactly, that they
+// need far fewer runs than counting, that the weights average 1, and that the SimClock and
+// FastEngine count the same grounded planes. It reports errors to cout.
+bool testRareEvents();
+
+#endif /* RareEvents_hpp */
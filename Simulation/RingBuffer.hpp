@@ -0,0 +1,89 @@
+//
+//  RingBuffer.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/3/25.
+//
+
+#ifndef RingBuffer_hpp
+#define RingBuffer_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <cstddef>
+#include <memory>
+
+/*
+ *******************************************************************************************
+ * Template class RingBuffer
+ * This is a FIFO queue stored in a single vector used as a circular buffer. Unlike
+ * std::queue it can be indexed from the front without removing anything, so the testing
+ * functions that list the contents of a queue can look at it without popping and
+ * re-pushing every item.
+ *
+ * The capacity is always a power of two so wrapping an index is a simple mask. If the
+ * buffer fills up, it doubles in size. In a simulation it normally grows a few times at
+ * the start and then never allocates again.
+ *
+ * Its storage comes from the Allocator, so a Simulation can count it (see SimMemory).
+ *******************************************************************************************
+ */
+template <typename T, typename Allocator = std::allocator<T>>
+class RingBuffer {
+    std::vector<T, Allocator> items; // Storage for the items. Its size is the capacity of the buffer.
+    size_t head; // Index of the item at the front of the queue
+    size_t count; // How many items are in the queue
+    size_t mask; // items.size() - 1, used to wrap indexes
+
+    // Double the capacity, moving the items so the front of the queue is at index 0
+    void grow() {
+        std::vector<T, Allocator> newItems(items.size() * 2, T{}, items.get_allocator());
+        for(size_t i = 0; i < count; i++) {
+            newItems[i] = items[(head + i) & mask];
+        }
+        items.swap(newItems);
+        head = 0;
+        mask = items.size() - 1;
+    }
+public:
+    // Start with room for at least initialCapacity items (rounded up to a power of two)
+    RingBuffer(size_t initialCapacity = 16, const Allocator &anAllocator = Allocator()): items(anAllocator), head{0}, count{0}, mask{0} {
+        size_t capacity = 1;
+        while(capacity < initialCapacity) { capacity <<= 1; }
+        items.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    // Is the queue empty?
+    bool empty() const { return count == 0; }
+
+    // How many items are in the queue?
+    size_t size() const { return count; }
+
+    // How many items can the queue hold before it needs to grow?
+    size_t capacity() const { return items.size(); }
+
+    // Add an item at the back of the queue
+    void push(const T &anItem) {
+        if(count == items.size()) { grow(); }
+        items[(head + count) & mask] = anItem;
+        count++;
+    }
+
+    // Look at the item at the front of the queue. Only call this if the queue is not empty.
+    T &front() { return items[head]; }
+
+    // Remove the item at the front of the queue. Only call this if the queue is not empty.
+    // The slot is reset so it does not keep a shared_ptr alive after the item leaves.
+    void pop() {
+        items[head] = T{};
+        head = (head + 1) & mask;
+        count--;
+    }
+
+    // Look at any item without removing it. Index 0 is the front of the queue.
+    const T &operator[](size_t index) const { return items[(head + index) & mask]; }
+    T &operator[](size_t index) { return items[(head + index) & mask]; }
+};
+
+#endif /* RingBuffer_hpp */
@@ -0,0 +1,181 @@
+//
+//  RuntimeEstimate.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "RuntimeEstimate.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+// What one pilot run measured
+struct PilotRun {
+    long duration; // Simulated seconds
+    long events;
+    double seconds; // Wall-clock time, including making the Simulation
+    long peakBytes;
+    bool overBudget; // The run streamed or stopped for its memory budget
+};
+
+// Run the first duration seconds of a run with someSettings
+static PilotRun runPilot(const SimSettings &someSettings, long duration) {
+    SimSettings pilotSettings = someSettings;
+    pilotSettings.simulationDuration = duration;
+    auto startTimer = std::chrono::steady_clock::now();
+    Simulation pilot(pilotSettings);
+    pilot.setQuiet(true);
+    pilot.run(false);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTimer).count();
+    const SimMemory &memory = pilot.getMemory();
+    return PilotRun{duration, pilot.getEventCount(), seconds, memory.peakTotal,
+        memory.streamingSince >= 0 || memory.stoppedAt >= 0};
+}
+
+// Double the pilot until it takes pilotSeconds or would be longer than the run, then
+// predict the rest at the rates between the last two pilot runs
+RuntimeEstimate estimateRuntime(const SimSettings &someSettings, double pilotSeconds) {
+    RuntimeEstimate estimate{0, 0, 0, 0, 0, 0, 0, 0, ""};
+    SimSettings settings = someSettings;
+    settings.randomSeed = someSettings.randomSeed > 0 ? someSettings.randomSeed : 1;
+    settings.progressInterval = 0;
+    long duration = std::max(1L, settings.simulationDuration);
+    PilotRun longer = runPilot(settings, std::min(duration, static_cast<long>(secondsPerHour)));
+    PilotRun shorter = longer;
+    double totalSeconds = longer.seconds;
+    while(longer.seconds < pilotSeconds && 2 * longer.duration <= duration && !longer.overBudget) {
+        shorter = longer;
+        longer = runPilot(settings, 2 * shorter.duration);
+        totalSeconds += longer.seconds;
+    }
+    estimate.pilotHours = longer.duration / secondsPerHourD;
+    estimate.pilotSeconds = totalSeconds;
+
+    double hoursBetween = (longer.duration - shorter.duration) / secondsPerHourD;
+    long eventsBetween = longer.events - shorter.events;
+    if(hoursBetween > 0 && eventsBetween > 0) {
+        estimate.eventsPerHour = eventsBetween / hoursBetween;
+        estimate.nanosecondsPerEvent = std::max(0.0, longer.seconds - shorter.seconds) * 1e9 / eventsBetween;
+        estimate.bytesPerHour = std::max(0L, longer.peakBytes - shorter.peakBytes) / hoursBetween;
+    } else if(longer.events > 0) {
+        // One pilot run, so the rates include its setup
+        estimate.eventsPerHour = longer.events / (longer.duration / secondsPerHourD);
+        estimate.nanosecondsPerEvent = longer.seconds * 1e9 / longer.events;
+        estimate.bytesPerHour = longer.peakBytes / (longer.duration / secondsPerHourD);
+    }
+    double hoursLeft = (duration - longer.duration) / secondsPerHourD;
+    double eventsLeft = estimate.eventsPerHour * hoursLeft;
+    estimate.events = longer.events + std::lround(eventsLeft);
+    estimate.seconds = longer.seconds + eventsLeft * estimate.nanosecondsPerEvent * 1e-9;
+    estimate.peakBytes = longer.peakBytes + std::lround(estimate.bytesPerHour * hoursLeft);
+
+    // Say why the run may not go on as the pilot did
+    std::string separator{};
+    long budgetBytes = settings.memoryBudgetMB * 1024 * 1024;
+    if(longer.overBudget || (budgetBytes > 0 && estimate.peakBytes > budgetBytes)) {
+        estimate.peakBytes = budgetBytes > 0 ? std::min(estimate.peakBytes, budgetBytes) : estimate.peakBytes;
+        estimate.note += separator + (settings.memoryBudgetOption == 0 ? "the run will go over its memory budget and add up its stats as they happen"
+                                      : "the run will go over its memory budget and stop early");
+        separator = "; ";
+    }
+    if(settings.faultOption != 0) {
+        estimate.note += separator + "faults ground planes, so later hours have fewer events and this is an upper bound";
+        separator = "; ";
+    }
+    if(settings.cycleOption == 1 && longer.duration < duration) {
+        estimate.note += separator + "repeats may be skipped, which can make the run far faster";
+        separator = "; ";
+    }
+    return estimate;
+}
+
+// Wall-clock seconds in the unit that reads best
+static std::string readableSeconds(double seconds) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1);
+    if(seconds < 120) {
+        text << seconds << " seconds";
+    } else if(seconds < 2 * 3600) {
+        text << seconds / 60 << " minutes";
+    } else {
+        text << seconds / 3600 << " hours";
+    }
+    return text.str();
+}
+
+void writeRuntimeEstimate(const RuntimeEstimate &anEstimate, std::ostream &out) {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(0);
+    out << "Expect about " << readableSeconds(anEstimate.seconds) << ", " << anEstimate.events << " events and a peak of "
+    << std::setprecision(1) << anEstimate.peakBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    out << std::setprecision(0) << "From a pilot of " << anEstimate.pilotHours << " simulated hours in "
+    << readableSeconds(anEstimate.pilotSeconds) << ": " << anEstimate.eventsPerHour << " events per simulated hour, "
+    << std::setprecision(1) << anEstimate.nanosecondsPerEvent << " ns per event, "
+    << anEstimate.bytesPerHour / 1024.0 << " KB per simulated hour" << std::endl;
+    if(!anEstimate.note.empty()) {
+        out << "Note: " << anEstimate.note << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool testRuntimeEstimate() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of runtime estimates *****" << std::endl;
+
+    // A run long enough that the pilot is a small part of it
+    SimSettings settings{};
+    settings.simulationDuration = 2000 * secondsPerHour;
+    settings.planeCount = 300;
+    settings.chargerCount = 60;
+    settings.maxPassengerDelay = 1800;
+    settings.progressInterval = 0;
+    settings.randomSeed = 7;
+    const int engineOptions[]{1, 0};
+    for(int engine: engineOptions) {
+        settings.engineOption = engine;
+        RuntimeEstimate estimate = estimateRuntime(settings, 0.01);
+        auto startTimer = std::chrono::steady_clock::now();
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        aSimulation.run(false);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTimer).count();
+        long events = aSimulation.getEventCount();
+        long peakBytes = aSimulation.getMemory().peakTotal;
+        if(estimate.pilotHours >= 1000 || std::fabs(estimate.events - events) > 0.03 * events) {
+            std::cout << "***** error: engine " << engine << " predicted " << estimate.events << " events from a pilot of "
+            << estimate.pilotHours << " hours, and the run had " << events << std::endl;
+            returnValue = false;
+        }
+        // The records grow in doublings, so the peak is only close
+        if(std::fabs(estimate.peakBytes - peakBytes) > 0.5 * peakBytes) {
+            std::cout << "***** error: engine " << engine << " predicted a peak of " << estimate.peakBytes
+            << " bytes, and the run's was " << peakBytes << std::endl;
+            returnValue = false;
+        }
+        // Wall-clock time depends on what else the computer is doing, so it is only shown
+        std::cout << "Engine " << engine << " predicted " << estimate.seconds << " seconds, and the run took "
+        << seconds << std::endl;
+    }
+
+    // A run shorter than the first pilot is the pilot
+    settings.engineOption = 1;
+    settings.simulationDuration = secondsPerHour / 2;
+    RuntimeEstimate shortEstimate = estimateRuntime(settings);
+    Simulation shortSimulation(settings);
+    shortSimulation.setQuiet(true);
+    shortSimulation.run(false);
+    if(shortEstimate.events != shortSimulation.getEventCount() || shortEstimate.peakBytes != shortSimulation.getMemory().peakTotal) {
+        std::cout << "***** error: a half hour run was predicted to have " << shortEstimate.events << " events and "
+        << shortEstimate.peakBytes << " bytes, and had " << shortSimulation.getEventCount() << " and "
+        << shortSimulation.getMemory().peakTotal << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of runtime estimates " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
@@ -0,0 +1,64 @@
+//
+//  RuntimeEstimate.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef RuntimeEstimate_hpp
+#define RuntimeEstimate_hpp
+
+#include <stdio.h>
+#include <string>
+#include <iostream>
+#include "Simulation.hpp"
+
+/*
+ *******************************************************************************************
+ * Estimating how long a run will take before it starts
+ * A 4-year run of 1000 planes can take a few seconds or most of an hour depending on the
+ * settings, the engine and the computer. estimateRuntime() runs the first part of it (the
+ * pilot), measures it and predicts the whole run:
+ *
+ *   - The pilot starts at 1 simulated hour and doubles until it takes about as long as it
+ *     was given, or would be longer than the run. The last two pilot runs have the same
+ *     fleet, so the difference between them is the cost of the hours between them, without
+ *     the setup and the first hours when every plane starts charged.
+ *   - From that difference come the events per simulated hour, the nanoseconds per event and
+ *     the bytes of memory per simulated hour (the records of each flight and charge grow
+ *     with the run). The rest of the run is predicted at those rates from the longer pilot.
+ *
+ * The prediction assumes the run goes on as it did in the pilot. Faults that ground planes
+ * make the events fewer over time and skipped repeats make the run far faster, so with
+ * those it is an upper bound. The records are vectors that grow in doublings, so the peak
+ * memory is only close: with 1000 planes for 4 years it was 7% high. The progress line
+ * also gives the time left while the run goes (see Simulation::showProgress()).
+ *******************************************************************************************
+ */
+struct RuntimeEstimate {
+    double pilotHours; // The longer pilot run, in simulated hours
+    double pilotSeconds; // Time taken by all the pilot runs
+    double eventsPerHour; // Events per simulated hour between the last two pilot runs
+    double nanosecondsPerEvent; // Wall-clock time per event between them
+    double bytesPerHour; // Growth of the peak memory per simulated hour between them
+    long events; // Predicted for the whole run
+    double seconds; // Predicted wall-clock time of the whole run
+    long peakBytes; // Predicted peak memory of the whole run
+    std::string note; // Why the prediction may be off, if it may
+};
+
+// Predict the events, wall-clock time and peak memory of a run with someSettings from pilot
+// runs of its first hours, which together take about pilotSeconds. The pilot uses
+// someSettings' randomSeed (or 1) and does not show progress. If the run is no longer than
+// the pilot would be, the pilot is the whole run and the prediction is what it measured.
+RuntimeEstimate estimateRuntime(const SimSettings &someSettings, double pilotSeconds = 0.5);
+
+// Write the prediction and the pilot's measurements to out
+void writeRuntimeEstimate(const RuntimeEstimate &anEstimate, std::ostream &out);
+
+// Check that the predictions match the events and memory of whole runs with the SimClock and
+// the FastEngine, and that a run shorter than the pilot is predicted exactly. The predicted
+// and measured wall-clock times are shown but not checked. It reports errors to cout.
+bool testRuntimeEstimate();
+
+#endif /* RuntimeEstimate_hpp */
@@ -0,0 +1,461 @@
+//
+//  Sensitivity.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "Sensitivity.hpp"
+#include "Plane.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <thread>
+
+// The names of the parameters, indexed by SensitivityParameter
+static const char *sensitivityParameterNames[] = {
+    "chargers",
+    "minutes of maximum passenger delay",
+    "hours of charge time"
+};
+
+// The name of a parameter with its unit
+const char *sensitivityParameterName(int parameter) {
+    if(parameter < 0 || parameter >= sensitivityParameterCount) {
+        return "unknown parameter";
+    }
+    return sensitivityParameterNames[parameter];
+}
+
+// The 97.5% point of Student's t distribution, from a table up to 30 degrees of freedom
+double tQuantile95(long degrees) {
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if(degrees < 1) {
+        return 0.0;
+    }
+    if(degrees <= 30) {
+        return table[degrees - 1];
+    }
+    return 1.96 + 2.4 / degrees;
+}
+
+// The regularized incomplete beta function I_x(a, b), from its continued fraction
+static double incompleteBeta(double a, double b, double x) {
+    if(x <= 0) { return 0.0; }
+    if(x >= 1) { return 1.0; }
+    // The fraction converges quickly on this side, and I_x(a, b) = 1 - I_1-x(b, a)
+    if(x > (a + 1) / (a + b + 2)) {
+        return 1.0 - incompleteBeta(b, a, 1 - x);
+    }
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1 - x)) / a;
+    // Lentz's method
+    const double tiny = 1e-300;
+    auto guard = [tiny](double value) { return std::fabs(value) < tiny ? tiny : value; };
+    double c = 1.0;
+    double d = 1.0 / guard(1 - (a + b) * x / (a + 1));
+    double fraction = d;
+    for(int m = 1; m <= 300; m++) {
+        double even = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+        d = 1.0 / guard(1 + even * d);
+        c = guard(1 + even / c);
+        fraction *= d * c;
+        double odd = -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+        d = 1.0 / guard(1 + odd * d);
+        c = guard(1 + odd / c);
+        fraction *= d * c;
+        if(std::fabs(d * c - 1) < 1e-13) { break; }
+    }
+    return front * fraction;
+}
+
+// The point of Student's t distribution with upperTail above it, by bisecting its tail
+// probability, which is I_v/(v+t^2)(v/2, 1/2) / 2 for v degrees of freedom
+double tQuantile(double upperTail, long degrees) {
+    if(degrees < 1 || upperTail <= 0 || upperTail >= 0.5) {
+        return 0.0;
+    }
+    double v = static_cast<double>(degrees);
+    auto tail = [v](double t) { return incompleteBeta(v / 2, 0.5, v / (v + t * t)) / 2; };
+    double low = 0, high = 1;
+    while(tail(high) > upperTail) {
+        low = high;
+        high *= 2;
+    }
+    for(int step = 0; step < 100; step++) {
+        double middle = (low + high) / 2;
+        if(tail(middle) > upperTail) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return (low + high) / 2;
+}
+
+// Does the parameter change this company's charge time?
+static bool changesCompany(int company, Company c) {
+    return company >= companyCount || company == c;
+}
+
+// The parameter at someSettings. A change to every company's charge time starts from 0.
+static double parameterValue(const SimSettings &someSettings, SensitivityParameter parameter, int company) {
+    extern PlaneSpecification planeSpecifications[];
+    switch(parameter) {
+        case sensitivityChargers: return static_cast<double>(someSettings.chargerCount);
+        case sensitivityPassengerDelay: return someSettings.maxPassengerDelay / static_cast<double>(secondsPerMinute);
+        default:
+            if(company >= companyCount) { return 0.0; }
+            return planeSpecifications[company].time_to_charge__hours + someSettings.timeToChargeChange[company];
+    }
+}
+
+// someSettings with the parameter moved to value
+static SimSettings settingsAt(const SimSettings &someSettings, SensitivityParameter parameter, int company, double value) {
+    SimSettings newSettings = someSettings;
+    switch(parameter) {
+        case sensitivityChargers:
+            newSettings.chargerCount = lround(value);
+            break;
+        case sensitivityPassengerDelay:
+            newSettings.maxPassengerDelay = lround(value * secondsPerMinute);
+            break;
+        default: {
+            double change = value - parameterValue(someSettings, parameter, company);
+            for(Company c: allCompany) {
+                if(changesCompany(company, c)) {
+                    newSettings.timeToChargeChange[c] += change;
+                }
+            }
+        }
+    }
+    return newSettings;
+}
+
+// True if the parameter can be moved to value
+static bool validValue(const SimSettings &someSettings, SensitivityParameter parameter, int company, double value) {
+    extern PlaneSpecification planeSpecifications[];
+    switch(parameter) {
+        case sensitivityChargers: return lround(value) >= 1;
+        case sensitivityPassengerDelay: return value >= 0;
+        default: {
+            double change = value - parameterValue(someSettings, parameter, company);
+            for(Company c: allCompany) {
+                if(changesCompany(company, c) && planeSpecifications[c].time_to_charge__hours + someSettings.timeToChargeChange[c] + change <= 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+}
+
+// What one run gives: flights per hour, average wait and passenger miles per hour, and the
+// followed derivatives of the last two
+struct SensitivityRun {
+    double values[3];
+    double paths[2];
+    bool followed;
+    long waits;
+};
+
+// Run someSettings and add up the fleet's results
+static SensitivityRun measureRun(const SimSettings &someSettings) {
+    Simulation aSimulation(someSettings);
+    aSimulation.setQuiet(true);
+    std::vector<FinalStats> results = aSimulation.run(false);
+    double hours = someSettings.simulationDuration / secondsPerHourD;
+    double flights = 0, charges = 0, waitSeconds = 0, passengerMiles = 0;
+    for(const FinalStats &aStats: results) {
+        flights += aStats.totalFlights;
+        charges += aStats.totalCharges;
+        waitSeconds += aStats.totalCharges * (aStats.averageTimeChargingWithWait - aStats.averageTimeCharging);
+        passengerMiles += aStats.totalPassengerMiles;
+    }
+    const PathDerivatives &derivatives = aSimulation.getPathDerivatives();
+    SensitivityRun aRun{{flights / hours, charges > 0 ? waitSeconds / charges : 0.0, passengerMiles / hours}, {0, 0},
+        derivatives.followed, derivatives.waits};
+    if(derivatives.followed) {
+        aRun.paths[0] = charges > 0 ? derivatives.waitSeconds / charges : 0.0;
+        aRun.paths[1] = derivatives.passengerMiles / hours;
+    }
+    return aRun;
+}
+
+// The mean and 95% half width of some numbers
+void meanAndHalfWidth(const std::vector<double> &numbers, double &mean, double &halfWidth, double &variance) {
+    long n = static_cast<long>(numbers.size());
+    double sum = 0, sumSquares = 0;
+    for(double x: numbers) {
+        sum += x;
+    }
+    mean = n > 0 ? sum / n : 0.0;
+    for(double x: numbers) {
+        sumSquares += (x - mean) * (x - mean);
+    }
+    variance = n > 1 ? sumSquares / (n - 1) : 0.0;
+    halfWidth = n > 1 ? tQuantile95(n - 1) * std::sqrt(variance / n) : 0.0;
+}
+
+// Run each seed at low, at the settings and at high, on threads, and difference the pairs
+SensitivityEstimate estimateSensitivity(const SimSettings &someSettings, SensitivityParameter parameter, int company,
+                                        long runs, double step, unsigned threadCount) {
+    SensitivityEstimate estimate{parameter, company, 0, 0, 0, 0, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, false,
+        {0, 0, 0, 0}, {0, 0, 0, 0}, 0, ""};
+    auto startTimer = std::chrono::high_resolution_clock::now();
+    if(parameter == sensitivityTimeToCharge && (company < 0 || company > companyCount)) {
+        estimate.note = "there is no company " + std::to_string(company);
+        return estimate;
+    }
+    if(step <= 0) {
+        const double defaultSteps[]{1.0, 5.0, 0.05};
+        step = defaultSteps[parameter];
+    }
+    if(parameter == sensitivityChargers) {
+        step = std::max(1.0, std::round(step));
+    }
+    estimate.value = parameterValue(someSettings, parameter, company);
+    estimate.high = estimate.value + step;
+    estimate.low = validValue(someSettings, parameter, company, estimate.value - step) ? estimate.value - step : estimate.value;
+    if(!validValue(someSettings, parameter, company, estimate.value)) {
+        estimate.note = "the settings have no chargers or no charge time";
+        return estimate;
+    }
+
+    // Each seed is run at low, at the settings and at high. Only the runs at the settings
+    // follow the derivatives, and only for the charge time.
+    SimSettings variants[3]{settingsAt(someSettings, parameter, company, estimate.low), someSettings,
+        settingsAt(someSettings, parameter, company, estimate.high)};
+    for(SimSettings &aVariant: variants) {
+        aVariant.progressInterval = 0;
+        aVariant.chargeTimeDerivativeOption = -1;
+    }
+    if(parameter == sensitivityTimeToCharge) {
+        variants[1].chargeTimeDerivativeOption = company;
+    }
+    long firstSeed = someSettings.randomSeed > 0 ? someSettings.randomSeed : 1;
+    long taskCount = 3 * std::max(0L, runs);
+    std::vector<SensitivityRun> results(taskCount);
+    if(threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned>(std::min<long>(threadCount, std::max(1L, taskCount)));
+    std::atomic<long> nextTask{0};
+    auto runTasks = [&]() {
+        for(long task = nextTask++; task < taskCount; task = nextTask++) {
+            SimSettings runSettings = variants[task % 3];
+            runSettings.randomSeed = firstSeed + task / 3;
+            results[task] = measureRun(runSettings);
+        }
+    };
+    std::vector<std::thread> threads{};
+    for(unsigned thread = 1; thread < threadCount; thread++) {
+        threads.emplace_back(runTasks);
+    }
+    runTasks();
+    for(std::thread &aThread: threads) {
+        aThread.join();
+    }
+    estimate.runs = runs;
+
+    // The differences of the pairs, and what independent pairs would have given
+    SensitivityValue *values[3]{&estimate.flightsPerHour, &estimate.averageWait, &estimate.passengerMilesPerHour};
+    double width = estimate.high - estimate.low;
+    for(int i = 0; i < 3; i++) {
+        std::vector<double> differences{}, lows{}, highs{}, atSettings{};
+        for(long run = 0; run < runs; run++) {
+            lows.push_back(results[3 * run].values[i]);
+            atSettings.push_back(results[3 * run + 1].values[i]);
+            highs.push_back(results[3 * run + 2].values[i]);
+            differences.push_back((highs.back() - lows.back()) / width);
+        }
+        double ignore = 0, lowVariance = 0, highVariance = 0, variance = 0;
+        meanAndHalfWidth(atSettings, values[i]->value, ignore, variance);
+        meanAndHalfWidth(differences, values[i]->derivative, values[i]->halfWidth, variance);
+        meanAndHalfWidth(lows, ignore, ignore, lowVariance);
+        meanAndHalfWidth(highs, ignore, ignore, highVariance);
+        values[i]->independentHalfWidth = runs > 1 ? tQuantile95(2 * runs - 2) * std::sqrt((lowVariance + highVariance) / runs) / width : 0.0;
+    }
+
+    // The derivatives followed along the runs at the settings, if no plane waited for a charger
+    if(parameter == sensitivityTimeToCharge) {
+        bool followed = runs > 0;
+        long waits = 0;
+        for(long run = 0; run < runs; run++) {
+            followed = followed && results[3 * run + 1].followed;
+            waits += results[3 * run + 1].waits;
+        }
+        estimate.followed = followed && waits == 0;
+        if(estimate.followed) {
+            SensitivityValue *paths[2]{&estimate.pathAverageWait, &estimate.pathPassengerMilesPerHour};
+            for(int i = 0; i < 2; i++) {
+                std::vector<double> derivatives{};
+                for(long run = 0; run < runs; run++) {
+                    derivatives.push_back(results[3 * run + 1].paths[i]);
+                }
+                double variance = 0;
+                meanAndHalfWidth(derivatives, paths[i]->derivative, paths[i]->halfWidth, variance);
+                paths[i]->value = values[i + 1]->value;
+            }
+        } else if(!followed) {
+            estimate.note = "the derivatives along the path need first come, first served chargers";
+        } else {
+            estimate.note = "planes waited for chargers " + std::to_string(waits) + " times, and a small change can swap which one waits, so the derivatives along the path were not used";
+        }
+    }
+    estimate.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTimer).count();
+    return estimate;
+}
+
+// One row of the table
+static void writeValue(const char *name, const SensitivityValue &aValue, bool independent, std::ostream &out) {
+    out << std::left << std::setw(34) << name << std::right << std::setw(12) << aValue.value << std::setw(14) << aValue.derivative
+    << " +/- " << std::setw(10) << aValue.halfWidth;
+    if(independent) {
+        out << std::setw(12) << aValue.independentHalfWidth;
+    }
+    out << std::endl;
+}
+
+// The table of values and derivatives
+void writeSensitivity(const SensitivityEstimate &anEstimate, std::ostream &out) {
+    if(anEstimate.runs == 0) {
+        out << "No sensitivities: " << anEstimate.note << std::endl;
+        return;
+    }
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(4);
+    out << "Sensitivity to " << sensitivityParameterName(anEstimate.parameter);
+    if(anEstimate.parameter == sensitivityTimeToCharge) {
+        out << " of " << (anEstimate.company >= companyCount ? "every company" : companyName(allCompany[anEstimate.company]));
+    }
+    out << " at " << anEstimate.value << ", from runs at " << anEstimate.low << " and " << anEstimate.high
+    << " with the same " << anEstimate.runs << " seeds" << std::endl;
+    out << std::left << std::setw(34) << "Result" << std::right << std::setw(12) << "Value" << std::setw(14) << "Derivative"
+    << "     " << std::setw(10) << "95% CI" << std::setw(12) << "Own seeds" << std::endl;
+    writeValue("Flights per hour", anEstimate.flightsPerHour, true, out);
+    writeValue("Average wait for a charger (s)", anEstimate.averageWait, true, out);
+    writeValue("Passenger miles per hour", anEstimate.passengerMilesPerHour, true, out);
+    if(anEstimate.followed) {
+        out << "Followed along the runs at the settings:" << std::endl;
+        writeValue("Average wait for a charger (s)", anEstimate.pathAverageWait, false, out);
+        writeValue("Passenger miles per hour", anEstimate.pathPassengerMilesPerHour, false, out);
+    }
+    if(!anEstimate.note.empty()) {
+        out << "Note: " << anEstimate.note << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+    out << anEstimate.runs * 3 << " runs took " << anEstimate.seconds << " seconds" << std::endl;
+}
+
+// Check the estimates
+bool testSensitivity() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of sensitivity estimates *****" << std::endl;
+
+    // With a charger for every plane, one more charger changes nothing, so every pair is the
+    // same and the derivative is exactly 0
+    SimSettings settings{};
+    settings.simulationDuration = 24 * secondsPerHour;
+    settings.planeCount = 20;
+    settings.chargerCount = 20;
+    settings.maxPassengerDelay = 1800;
+    settings.passengerCountOption = 1;
+    settings.progressInterval = 0;
+    settings.randomSeed = 11;
+    SensitivityEstimate spare = estimateSensitivity(settings, sensitivityChargers, 0, 5);
+    if(spare.flightsPerHour.derivative != 0 || spare.flightsPerHour.halfWidth != 0 || spare.averageWait.derivative != 0 || spare.low != 19) {
+        std::cout << "***** error: a spare charger changed the flights per hour by " << spare.flightsPerHour.derivative << std::endl;
+        returnValue = false;
+    }
+
+    // Without waits, the passenger miles followed along a run change exactly as a run with
+    // every charge a second longer does, unless that second moves a flight past the end
+    long exact = 0;
+    for(long seed = 1; seed <= 20; seed++) {
+        SimSettings pathSettings = settings;
+        pathSettings.randomSeed = seed;
+        pathSettings.chargeTimeDerivativeOption = companyCount;
+        Simulation followed(pathSettings);
+        followed.setQuiet(true);
+        std::vector<FinalStats> before = followed.run(false);
+        pathSettings.chargeTimeDerivativeOption = -1;
+        std::fill(std::begin(pathSettings.timeToChargeChange), std::end(pathSettings.timeToChargeChange), 1.0 / secondsPerHourD);
+        Simulation longer(pathSettings);
+        longer.setQuiet(true);
+        std::vector<FinalStats> after = longer.run(false);
+        double change = 0;
+        for(Company c: allCompany) {
+            change += after[c].totalPassengerMiles - before[c].totalPassengerMiles;
+        }
+        const PathDerivatives &derivatives = followed.getPathDerivatives();
+        if(derivatives.followed && derivatives.waits == 0 && std::fabs(change - derivatives.passengerMiles / secondsPerHourD) < 1e-6) {
+            exact++;
+        }
+    }
+    if(exact < 16) {
+        std::cout << "***** error: the followed passenger miles matched a second longer charge in only " << exact << " of 20 runs" << std::endl;
+        returnValue = false;
+    }
+
+    // Over many runs they agree with the differences, for every company's charge time
+    // changed together and for one company's alone
+    const int companies[]{companyCount, Charlie};
+    for(int company: companies) {
+        SensitivityEstimate chargeTime = estimateSensitivity(settings, sensitivityTimeToCharge, company, 20);
+        double milesGap = std::fabs(chargeTime.pathPassengerMilesPerHour.derivative - chargeTime.passengerMilesPerHour.derivative);
+        if(!chargeTime.followed || chargeTime.pathAverageWait.derivative != 0 || chargeTime.passengerMilesPerHour.derivative >= 0 ||
+           milesGap > chargeTime.pathPassengerMilesPerHour.halfWidth + chargeTime.passengerMilesPerHour.halfWidth) {
+            std::cout << "***** error: for company " << company << " the followed passenger miles derivative was "
+            << chargeTime.pathPassengerMilesPerHour.derivative << " +/- " << chargeTime.pathPassengerMilesPerHour.halfWidth
+            << " and the difference " << chargeTime.passengerMilesPerHour.derivative << " +/- " << chargeTime.passengerMilesPerHour.halfWidth << std::endl;
+            returnValue = false;
+        }
+    }
+
+    // Where planes wait, a charger matters, and the same seeds on both sides make the
+    // interval far narrower than independent seeds would. A longer charge means longer
+    // waits, and the derivatives along the path are not used.
+    settings.chargerCount = 4;
+    SensitivityEstimate chargers = estimateSensitivity(settings, sensitivityChargers, 0, 10);
+    if(chargers.flightsPerHour.derivative - chargers.flightsPerHour.halfWidth <= 0 ||
+       chargers.averageWait.derivative + chargers.averageWait.halfWidth >= 0 ||
+       chargers.flightsPerHour.halfWidth > 0.5 * chargers.flightsPerHour.independentHalfWidth) {
+        std::cout << "***** error: a charger changed the flights per hour by " << chargers.flightsPerHour.derivative << " +/- "
+        << chargers.flightsPerHour.halfWidth << " (" << chargers.flightsPerHour.independentHalfWidth << " with their own seeds)"
+        << " and the wait by " << chargers.averageWait.derivative << std::endl;
+        returnValue = false;
+    }
+    SensitivityEstimate waiting = estimateSensitivity(settings, sensitivityTimeToCharge, Charlie, 10);
+    if(waiting.followed || waiting.averageWait.derivative - waiting.averageWait.halfWidth <= 0) {
+        std::cout << "***** error: with waits a longer Charlie charge changed the wait by " << waiting.averageWait.derivative
+        << " +/- " << waiting.averageWait.halfWidth << (waiting.followed ? " and the path derivatives were used" : "") << std::endl;
+        returnValue = false;
+    }
+
+    // The threads share the runs without changing them
+    SensitivityEstimate oneThread = estimateSensitivity(settings, sensitivityPassengerDelay, 0, 4, 0, 1);
+    SensitivityEstimate threeThreads = estimateSensitivity(settings, sensitivityPassengerDelay, 0, 4, 0, 3);
+    if(oneThread.flightsPerHour.derivative != threeThreads.flightsPerHour.derivative ||
+       oneThread.averageWait.halfWidth != threeThreads.averageWait.halfWidth) {
+        std::cout << "***** error: the runs on three threads gave different sensitivities" << std::endl;
+        returnValue = false;
+    }
+
+    // Other charger policies cannot be followed
+    settings.chargerCount = 20;
+    settings.chargerPolicyOption = chargerPolicyShortestCharge;
+    SensitivityEstimate policy = estimateSensitivity(settings, sensitivityTimeToCharge, companyCount, 2);
+    if(policy.followed || policy.note.empty()) {
+        std::cout << "***** error: the derivatives were followed with shortest charge first" << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of sensitivity estimates " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
@@ -0,0 +1,112 @@
+//
+//  Sensitivity.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#ifndef Sensitivity_hpp
+#define Sensitivity_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Simulation.hpp"
+
+/*
+ *******************************************************************************************
+ * Sensitivities of the results to a setting
+ * How much do flights per hour go up with one more charger, or the wait for a charger with
+ * a longer charge time? The difference between two independent runs is mostly chance, so
+ * it takes many runs to say. Instead each seed is run with the setting a step below and a
+ * step above, with the same fleet and the same random numbers for every plane (common
+ * random numbers), so the difference of each pair comes from the change. The spread of the
+ * pairs' differences over the seeds gives a confidence interval, and estimateSensitivity()
+ * also works out the interval the same number of runs with their own seeds would have had.
+ * The runs are shared between threads.
+ *
+ * For the charge time there is a second estimate that needs no step and no second run. The
+ * FastEngine follows the derivative of every time in the run along the run's own events
+ * (infinitesimal perturbation analysis, see SimSettings::chargeTimeDerivativeOption): a
+ * charge is done as much later as it started plus the change in the charge time, the plane
+ * takes off and lands that much later, and a plane that waited starts when the charger it
+ * got was freed. The passenger miles only change with the flights the end cuts short.
+ * Flight and charge counts jump rather than change smoothly, so they have no derivative
+ * along the path.
+ *
+ * That only holds while a small change keeps the events in the same order. Once planes wait
+ * for chargers, a small change can swap which of two planes waits, and the results jump
+ * where the path does not see it: with 8 chargers for 20 planes the derivative of the wait
+ * followed along the path came out several times the differences. So the followed
+ * derivatives are only given when no plane waited in any of the runs, and the differences
+ * are the estimate otherwise. They also need first come, first served chargers.
+ *******************************************************************************************
+ */
+// The settings whose sensitivities can be estimated
+enum SensitivityParameter {
+    sensitivityChargers = 0, // SimSettings::chargerCount, in chargers
+    sensitivityPassengerDelay, // SimSettings::maxPassengerDelay, in minutes
+    sensitivityTimeToCharge // A company's time_to_charge__hours (SimSettings::timeToChargeChange), in hours
+};
+const int sensitivityParameterCount{sensitivityTimeToCharge + 1};
+// The name of a parameter with its unit, such as "chargers"
+const char *sensitivityParameterName(int parameter);
+
+// One result and its derivative with respect to the parameter
+struct SensitivityValue {
+    double value; // Its average over the runs at the settings
+    double derivative; // How much it changes for one unit of the parameter
+    double halfWidth; // The 95% confidence interval is derivative +/- halfWidth
+    double independentHalfWidth; // What halfWidth would be with independent seeds (0 for followed derivatives)
+};
+
+struct SensitivityEstimate {
+    SensitivityParameter parameter;
+    int company; // For the charge time, the Company, or companyCount for every company together
+    double value; // The parameter at the settings
+    double low; // The differences are between the runs at low and high
+    double high;
+    long runs; // Seeds, each run at low, at the settings and at high
+    SensitivityValue flightsPerHour;
+    SensitivityValue averageWait; // For a charger, in seconds per charge
+    SensitivityValue passengerMilesPerHour;
+    bool followed; // True if the path derivatives below were followed along the runs at the settings, with no waits
+    SensitivityValue pathAverageWait;
+    SensitivityValue pathPassengerMilesPerHour;
+    double seconds; // Time taken by the runs
+    std::string note; // Why there is no estimate, or why the path derivatives were not followed
+};
+
+// The sensitivities of the fleet's flights per hour, average wait for a charger and
+// passenger miles per hour to a parameter, from runs seeds starting at someSettings'
+// randomSeed (or 1). A step of 0 uses 1 charger, 5 minutes or 0.05 hours. The difference is
+// centered on the settings unless the step below would leave no chargers, a negative delay
+// or no charge time, when it is from the settings up. The runs are shared between
+// threadCount threads, or one for each core if it is 0; the results do not depend on it.
+SensitivityEstimate estimateSensitivity(const SimSettings &someSettings, SensitivityParameter parameter, int company,
+                                        long runs, double step = 0, unsigned threadCount = 0);
+
+// The 97.5% point of Student's t distribution with degrees of freedom, which a 95% confidence
+// interval is that many standard errors either side of the mean (0 for no degrees of freedom)
+double tQuantile95(long degrees);
+
+// The point of Student's t distribution with degrees of freedom that has upperTail of the
+// distribution above it, for intervals other than 95%. It is 0 for no degrees of freedom or
+// an upperTail that is not between 0 and 0.5.
+double tQuantile(double upperTail, long degrees);
+
+// The mean of some numbers, the half width of its 95% confidence interval and their sample
+// variance. With fewer than two numbers the half width and variance are 0.
+void meanAndHalfWidth(const std::vector<double> &numbers, double &mean, double &halfWidth, double &variance);
+
+// Write the values, derivatives and confidence intervals of an estimate to out
+void writeSensitivity(const SensitivityEstimate &anEstimate, std::ostream &out);
+
+// Check that a change that cannot matter has a derivative of exactly 0, that the followed
+// derivatives match the runs where the path allows them and are not used where it does not,
+// that common random numbers narrow the intervals and that the threads do not change the
+// results. It reports errors to cout.
+bool testSensitivity();
+
+#endif /* Sensitivity_hpp */
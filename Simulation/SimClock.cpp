@@ -5,14 +5,18 @@
 //  Created by Chad Mitchell on 1/20/25.
 //
 #include <random>
+#include <algorithm>
+#include <chrono>
 #include "SimClock.hpp"
 #include "Simulation.hpp"
 
 /*
  *******************************************************************************************
  * Class SimClock
- * This manages a vector of EventHandlers. The vector is kept sorted so that the handler
- * with the earliest time is at the end ready to be popped off.
+ * This manages a binary heap of EventHandlers with the handler with the earliest time at
+ * the front ready to be taken off. Handlers with the same time are handled in the order
+ * they were added. Each handler records the time and a sequence number when it was added,
+ * and where it is in the heap, so a handler can be re-sorted without searching for it.
  *
  * This uses a "quantum" clock meaning that the time jumps from one meaningful time to the
  * next without passing through the times in between. It requires all EventHandlers to be
@@ -27,9 +31,16 @@
  *******************************************************************************************
  */
 SimClock::SimClock(Simulation *theSimulation, long endTime):
-        theSimulation{theSimulation}, endTime{endTime}, currentTime{0}, needSort{false} {
-    // initialize our vector of event handlers
-    eventHandlers = std::vector<std::shared_ptr<EventHandler>>();
+        theSimulation{theSimulation}, endTime{endTime}, currentTime{0}, needSort{false},
+        eventHandlers(CountingAllocator<std::shared_ptr<EventHandler>>(Simulation::memoryOf(theSimulation), memoryHandlers)),
+        nextSequence{0}, eventCount{0}, theProfile{nullptr},
+        theRecorder{theSimulation ? &theSimulation->theRecorder : nullptr} {
+#if SIMPROFILE
+    // Only profile if the Simulation asked for it
+    if(theSimulation && theSimulation->theProfile.enabled) {
+        theProfile = &theSimulation->theProfile;
+    }
+#endif
 }
 SimClock::~SimClock() {
 }
@@ -39,33 +50,115 @@ long SimClock::getTime() {
     return currentTime;
 }
 
-// Insert a handler into the correct location to keep the vector sorted with the handler with the soonest next event time
-// at the end of the vector
+// How many events have been handled so far (not counting the close-out)
+long SimClock::getEventCount() {
+    return eventCount;
+}
+
+// Does handler a come before handler b? (The earlier clockTime, then the lower clockSequence)
+bool SimClock::clockBefore(const EventHandler &a, const EventHandler &b) {
+    return a.clockTime < b.clockTime || (a.clockTime == b.clockTime && a.clockSequence < b.clockSequence);
+}
+
+// Move the handler at index toward the front of the heap until its parent comes before it.
+// The handlers it passes move down into the gap, so each level is one move and not a swap.
+long SimClock::siftUp(size_t index) {
+    long levels = 0;
+    std::shared_ptr<EventHandler> aHandler = std::move(eventHandlers[index]);
+    while(index > 0) {
+        size_t parent = (index - 1) / 2;
+        if(!clockBefore(*aHandler, *eventHandlers[parent])) {
+            break;
+        }
+        eventHandlers[index] = std::move(eventHandlers[parent]);
+        eventHandlers[index]->clockIndex = static_cast<long>(index);
+        index = parent;
+        levels++;
+    }
+    aHandler->clockIndex = static_cast<long>(index);
+    eventHandlers[index] = std::move(aHandler);
+    return levels;
+}
+
+// Move the handler at index toward the back of the heap until it comes before both children
+long SimClock::siftDown(size_t index) {
+    long levels = 0;
+    size_t count = eventHandlers.size();
+    std::shared_ptr<EventHandler> aHandler = std::move(eventHandlers[index]);
+    while(true) {
+        size_t child = 2 * index + 1;
+        if(child >= count) {
+            break;
+        }
+        if(child + 1 < count && clockBefore(*eventHandlers[child + 1], *eventHandlers[child])) {
+            child++;
+        }
+        if(!clockBefore(*eventHandlers[child], *aHandler)) {
+            break;
+        }
+        eventHandlers[index] = std::move(eventHandlers[child]);
+        eventHandlers[index]->clockIndex = static_cast<long>(index);
+        index = child;
+        levels++;
+    }
+    aHandler->clockIndex = static_cast<long>(index);
+    eventHandlers[index] = std::move(aHandler);
+    return levels;
+}
+
+// Take the handler at the front of the heap out of it
+std::shared_ptr<EventHandler> SimClock::popHandler() {
+    std::shared_ptr<EventHandler> firstHandler = std::move(eventHandlers.front());
+    firstHandler->clockIndex = -1;
+    if(eventHandlers.size() > 1) {
+        eventHandlers.front() = std::move(eventHandlers.back());
+        eventHandlers.pop_back();
+        siftDown(0);
+    } else {
+        eventHandlers.pop_back();
+    }
+    return firstHandler;
+}
+
+// Add a handler to the heap.
+// The new handler gets the highest sequence so far, which puts it after any handlers already
+// waiting for the same time.
 void SimClock::addHandler(std::shared_ptr<EventHandler> aHandler) {
-    // Keep eventHandlers sorted with soonest time at the end.
-    // Insert the new handler into the first location to keep it sorted.
-    auto handlerPtr = begin(eventHandlers);
-    while(handlerPtr != end(eventHandlers) &&  (*handlerPtr)->getNextEventTime() > aHandler->getNextEventTime()) {
-        handlerPtr++;
+    aHandler->clockTime = aHandler->getNextEventTime();
+    aHandler->clockSequence = nextSequence++;
+    eventHandlers.push_back(std::move(aHandler));
+    siftUp(eventHandlers.size() - 1);
+#if SIMPROFILE
+    if(theProfile) {
+        theProfile->queueInserts++;
+        theProfile->peakHandlers = std::max(theProfile->peakHandlers, static_cast<long>(eventHandlers.size()));
     }
-    eventHandlers.insert(handlerPtr, aHandler);
+#endif
 }
 
-// One of our handlers thinks that it may be in the wrong order in the vector due to internal changes.
-// If we can find the charger in the queue, we remove it and insert it back in, sorting it in the proper
-// location. But if the handler is not in the queue than nothing happens. For example, if a handler
-// asks us to do this while responding to a handleEvent() call, we already removed it from the vector
-// before calling handleEvent() and will add it back when that handleEvent() returns so no need to do anyting now.
+// One of our handlers thinks that it may be in the wrong place in the heap due to internal changes.
+// If it is in the heap, it gets a new time and sequence as if it were removed and added back, and is
+// moved to where those belong. But if the handler is not in the heap than nothing happens. For example,
+// if a handler asks us to do this while responding to a handleEvent() call, we already removed it from
+// the heap before calling handleEvent() and will add it back when that handleEvent() returns so no need
+// to do anyting now.
 void SimClock::reSortHandler(std::shared_ptr<EventHandler> aHandler) {
-    auto handlerPtr = begin(eventHandlers);
-    while(handlerPtr != end(eventHandlers)) {
-        if(*handlerPtr == aHandler) {
-            eventHandlers.erase(handlerPtr);
-            addHandler(aHandler);
-            return;
-        }
-        handlerPtr++;
+    long index = aHandler->clockIndex;
+    if(index < 0 || index >= static_cast<long>(eventHandlers.size()) || eventHandlers[index] != aHandler) {
+        return;
+    }
+    aHandler->clockTime = aHandler->getNextEventTime();
+    aHandler->clockSequence = nextSequence++;
+    long levels = siftUp(static_cast<size_t>(index));
+    if(levels == 0) {
+        levels = siftDown(static_cast<size_t>(index));
+    }
+#if SIMPROFILE
+    if(theProfile) {
+        theProfile->reSorts++;
+        theProfile->reSortDistance += levels;
     }
+#endif
 }
 
 // Set internal variable indicating that we need to resort the vector at the start of the next iteration of the run loop
@@ -76,19 +169,63 @@ void SimClock::markNeedSort()
 }
 
 
-// For testing: check if the vector is properly sorted
+// For testing: check that the heap is in order and every handler knows where it is
 bool SimClock::checkSort() {
-    return is_sorted(begin(eventHandlers), end (eventHandlers), [](std::shared_ptr<EventHandler> lhs, std::shared_ptr<EventHandler> rhs) {
-        return lhs->getNextEventTime() > rhs->getNextEventTime();
-    });
+    for(size_t index = 0; index < eventHandlers.size(); index++) {
+        if(eventHandlers[index]->clockIndex != static_cast<long>(index) ||
+           (index > 0 && clockBefore(*eventHandlers[index], *eventHandlers[(index - 1) / 2]))) {
+            return false;
+        }
+    }
+    return true;
 }
 
-// Sort the vector of handlers
+// Re-sort all the handlers by their nextEventTime
 // This function is private so only this object can call it at times that are safe
 void SimClock::sortHandlers() {
-    sort(begin(eventHandlers), end (eventHandlers), [](std::shared_ptr<EventHandler> lhs, std::shared_ptr<EventHandler> rhs) {
-        return lhs->getNextEventTime() > rhs->getNextEventTime();
+    // Put them in the order they would be handled now, then by their new times. Handlers with
+    // the same new time keep their order relative to each other.
+    std::sort(begin(eventHandlers), end(eventHandlers), [](const std::shared_ptr<EventHandler> &lhs, const std::shared_ptr<EventHandler> &rhs) {
+        return clockBefore(*lhs, *rhs);
     });
+    std::stable_sort(begin(eventHandlers), end(eventHandlers), [](const std::shared_ptr<EventHandler> &lhs, const std::shared_ptr<EventHandler> &rhs) {
+        return lhs->getNextEventTime() < rhs->getNextEventTime();
+    });
+    // Record the new times in that order. A sorted vector is already a heap.
+    for(size_t index = 0; index < eventHandlers.size(); index++) {
+        eventHandlers[index]->clockTime = eventHandlers[index]->getNextEventTime();
+        eventHandlers[index]->clockSequence = nextSequence++;
+        eventHandlers[index]->clockIndex = static_cast<long>(index);
+    }
+}
+
+#if SIMPROFILE
+// Call handleEvent() for a handler at the current time and count it in the profile.
+// Every event is counted, but the clock is only read for a sample of them.
+bool SimClock::handleProfiledEvent(const std::shared_ptr<EventHandler> &aHandler) {
+    ProfileKindStats &kindStats = theProfile->kinds[aHandler->profileKind()];
+    if(kindStats.events++ % profileSampleInterval != 0) {
+        return aHandler->handleEvent(currentTime, false);
+    }
+    // The counters are read outside the timing so the time does not include reading them
+    double countsBefore[hardwareCounterCount];
+    bool counting = theCounters.isOpen() && theCounters.read(countsBefore);
+    auto eventStartTimer = std::chrono::high_resolution_clock::now();
+    bool returnValue = aHandler->handleEvent(currentTime, false);
+    kindStats.sampledSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - eventStartTimer).count();
+    if(counting) {
+        theCounters.addSince(countsBefore, kindStats.sampledCounts);
+    }
+    kindStats.sampledEvents++;
+    return returnValue;
+}
+#endif
+
+// Record an entry in the flight recorder for a handler
+void SimClock::record(long time, const std::shared_ptr<EventHandler> &aHandler, RecorderAction action) {
+    if(theRecorder) {
+        theRecorder->record(time, aHandler->recorderKind, aHandler->recorderId, action);
+    }
 }
 
 // Run the actual simulation
@@ -105,34 +242,48 @@ bool SimClock::run(bool verbose) {
             nextProgressUpdate = progressInterval;
     }
     
-    // process events while there are any in our list
+#if SIMPROFILE
+    if(theProfile) {
+        theCounters.start(*theProfile);
+    }
+    auto loopStartTimer = std::chrono::high_resolution_clock::now();
+#endif
+    // process events while there are any in our list, unless the Simulation has gone over
+    // its memory budget and asked to stop at the current time
     while(!eventHandlers.empty()) {
+        if(theSimulation && theSimulation->stopRequested) {
+            if(verbose) {
+                std::cout << std::endl;
+                std::cout << "Stopping the clock at time " << currentTime << " for going over the memory budget" << std::endl;
+            }
+            break;
+        }
         // If some other object has indicate that we may need to sort, this is a safe time to do it
         if(needSort) {
             sortHandlers();
             needSort = false;
         }
-        // Pull the handler with the lowest next time off the end of the list (kept sorted that way)
-        std::shared_ptr<EventHandler> nextEventHandler = eventHandlers.back();
-        long nextTime = nextEventHandler->getNextEventTime();
+        // Look at the handler with the lowest next time, at the front of the heap
+        long nextTime = eventHandlers.front()->getNextEventTime();
         if(currentTime> nextTime) {
             // This should never happen so indiate there was a problem we need to fix
             std::cout << "Error in SimClock::run(): Out of order nextEventTime" << std::endl;
             std::cout << "currentTime: " << currentTime << std::endl;
-            std::cout << "nextTime: " << nextTime << " for" << nextEventHandler-> describe() << std::endl;
+            std::cout << "nextTime: " << nextTime << " for" << eventHandlers.front()-> describe() << std::endl;
+            record(nextTime, eventHandlers.front(), recordOutOfOrder);
+            if(theRecorder) { theRecorder->dump(std::cout, flightRecorderDumpCount); }
         }
  
         // If it is time for a progress update, do it.
-        // This is set up as a simple comparison so there is no overhead except when we actually update the indicator
-        if(nextTime >= nextProgressUpdate) {
+        // This is set up as a simple comparison so there is no overhead except when we actually update the indicator.
+        // Once every plane is grounded nextTime is LONG_MAX, which would otherwise match the "never" value.
+        if(nextTime >= nextProgressUpdate && progressInterval > 0) {
             long timeToDisplay = nextTime;
             if(timeToDisplay > endTime) {
                 timeToDisplay = endTime;
             }
             // It is time for a progress update
-            std::cout << "\r" << std::flush;
-            std::cout << "Simulation Clock Time = " << timeToDisplay/secondsPerHour
-            << " of " << endTime/secondsPerHour << " hours" << std::flush;
+            theSimulation->showProgress(timeToDisplay, endTime);
             nextProgressUpdate += progressInterval;
         }
 
@@ -147,8 +298,8 @@ bool SimClock::run(bool verbose) {
             currentTime = endTime;
             break;
         }
-        // Advance the current time
-        eventHandlers.pop_back();
+        // Take it out of the heap and advance the current time
+        std::shared_ptr<EventHandler> nextEventHandler = popHandler();
         if(nextTime > currentTime && verbose) {
             std::cout << std::endl;
             std::cout << "Advancing time to " << nextTime << std::endl;
@@ -158,7 +309,14 @@ bool SimClock::run(bool verbose) {
             std::cout << "Call handleEvent() for " << nextEventHandler->describe() << std::endl;
         }
         // Have the current eventHandler process an event
-        if(nextEventHandler->handleEvent(currentTime, false)) {
+        eventCount++;
+        record(currentTime, nextEventHandler, recordHandle);
+#if SIMPROFILE
+        bool keepHandler = theProfile ? handleProfiledEvent(nextEventHandler) : nextEventHandler->handleEvent(currentTime, false);
+#else
+        bool keepHandler = nextEventHandler->handleEvent(currentTime, false);
+#endif
+        if(keepHandler) {
             if(verbose) {
                 std::cout << "Keeping event handler in SimClock queue" << std::endl;
             }
@@ -168,7 +326,10 @@ bool SimClock::run(bool verbose) {
                 std::cout << "Error in SimClock::run(): Attempt to reinsert eventHandler not in future time" << std::endl;
                 std::cout << "   Handler Time: " << nextEventHandler->getNextEventTime() << std::endl;
                 std::cout << "   Current time: " << currentTime << std::endl;
+                record(nextEventHandler->getNextEventTime(), nextEventHandler, recordBadReinsert);
+                if(theRecorder) { theRecorder->dump(std::cout, flightRecorderDumpCount); }
             } else {
+                record(nextEventHandler->getNextEventTime(), nextEventHandler, recordKeep);
                 // if the eventHandler returned true, then it wants to stay in the list of handlers,
                 // but we already removed it so put it back in the list.
                 if(verbose) {
@@ -179,6 +340,7 @@ bool SimClock::run(bool verbose) {
         } else {
             // If the eventHandler returned false, it does not want to stay in the list of handlers,
             // but we already removed it so nothing to do here
+            record(currentTime, nextEventHandler, recordRemove);
             if(verbose) {
                 std::cout << "Removing event handler from SimClock queue" << std::endl;
             }
@@ -189,14 +351,31 @@ bool SimClock::run(bool verbose) {
         // if we did progress reports, close out the line that we kept reusing
         std::cout << std::endl;
     }
-    // Close out remaining handlers
-    for(std::shared_ptr<EventHandler> remainingEventHandler: eventHandlers) {
+    // Close out remaining handlers, the latest first. We take them out of the heap first
+    // because closing out a Flight can hand its plane to a ChargerQueue, which would otherwise
+    // ask us to re-sort the heap while we are looping over it.
+    CountedVector<std::shared_ptr<EventHandler>> remainingEventHandlers(eventHandlers.get_allocator());
+    remainingEventHandlers.swap(eventHandlers);
+    for(const std::shared_ptr<EventHandler> &remainingEventHandler: remainingEventHandlers) {
+        remainingEventHandler->clockIndex = -1;
+    }
+    std::sort(begin(remainingEventHandlers), end(remainingEventHandlers), [](const std::shared_ptr<EventHandler> &lhs, const std::shared_ptr<EventHandler> &rhs) {
+        return clockBefore(*rhs, *lhs);
+    });
+    for(std::shared_ptr<EventHandler> remainingEventHandler: remainingEventHandlers) {
         if(verbose) {
             std::cout << "Close out handleEvent() for " << remainingEventHandler->describe() << std::endl;
         }
         // Notify them that this is the final close-out in case they need to do something different
+        record(currentTime, remainingEventHandler, recordCloseOut);
         remainingEventHandler->handleEvent(currentTime, true);
     }
+#if SIMPROFILE
+    if(theProfile) {
+        theProfile->eventLoopSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loopStartTimer).count();
+        theCounters.finish(*theProfile);
+    }
+#endif
     return true;
 }
 
@@ -274,12 +453,23 @@ bool testSimClock(bool longTest) {
     // Select how many test handlers to use
     int testHandlerCount = longTest ? longTestHandlerCount : shortTestHandlerCount;
     // Construct and add the test event handlers
+    std::vector<std::shared_ptr<EventHandler>> handlers;
     for(int i=0; i<testHandlerCount; i++) {
-        aClock.addHandler(std::make_shared<TestHandler>(distribTestHandlerDelay(genTestHandler),
-                                                        distribTestHandlerRepeat(genTestHandler),i + 1));
+        handlers.push_back(std::make_shared<TestHandler>(distribTestHandlerDelay(genTestHandler),
+                                                         distribTestHandlerRepeat(genTestHandler),i + 1));
+        aClock.addHandler(handlers.back());
+    }
+    // Move some of them, as the queues do when their next event changes, and check the heap
+    for(size_t i = 0; i < handlers.size(); i += 2) {
+        handlers[i]->setNextEventTime(distribTestHandlerDelay(genTestHandler));
+        aClock.reSortHandler(handlers[i]);
+    }
+    bool heapOk = aClock.checkSort();
+    if(!heapOk) {
+        std::cout << "***** error: the SimClock heap is out of order" << std::endl;
     }
     // Run the test
-    bool returnValue = aClock.run(true);
+    bool returnValue = aClock.run(true) && heapOk;
     std::cout << std::endl;
     return returnValue;
 }
@@ -15,12 +15,18 @@
 #include <iostream>
 #include "EventHandler.hpp"
 #include "Simulation.hpp"
+#include "SimProfile.hpp"
+#include "HardwareCounters.hpp"
 
 /*
  *******************************************************************************************
  * Class SimClock
- * This manages a vector of EventHandlers. The vector is kept sorted so that the handler
- * with the earliest time is at the end ready to be popped off.
+ * This manages a binary heap of EventHandlers with the handler with the earliest time at
+ * the front. Handlers with the same time are handled in the order they were added. Each
+ * handler records the time and a sequence number when it was added, and where it is in the
+ * heap, so adding, re-sorting and taking the next handler each cost O(log n). (It used to be
+ * a sorted vector, where adding a flight shifted every flight due after it. The scaling
+ * harness in the benchmark showed that growing linearly with the number of flights.)
  *
  * This uses a "quantum" clock meaning that the time jumps from one meaningful time to the
  * next without passing through the times in between. It requires all EventHandlers to be
@@ -32,6 +38,9 @@
  * Once everything is set up, the simulation proceeds by calling the run() in this object.
  * That function will loop until time runs out for the simulation or until there are no
  * more EventHandlers listed.
+ *
+ * If the Simulation has profiling on, the clock counts inserts, re-sorts and events by the
+ * kind of handler and times a sample of the events. See SimProfile.
  *******************************************************************************************
  */
 class SimClock {
@@ -40,27 +49,56 @@ class SimClock {
     long currentTime; // The current clock time
     bool needSort; // Set if another object might cause the handler queue to become unsorted.
                     // It is checked at the start of each clock loop inside run().
-    std::vector<std::shared_ptr<EventHandler>> eventHandlers; // The sorged list of handlers
-    
+    CountedVector<std::shared_ptr<EventHandler>> eventHandlers; // The heap of handlers
+    long nextSequence; // Sequence number for the next handler added
+    long eventCount; // How many events have been handled (not counting the close-out)
+    SimProfile *theProfile; // The Simulation's profile if profiling is on, otherwise nullptr
+#if SIMPROFILE
+    HardwareCounters theCounters; // Open during run() if the profile asked for hardware counters
+#endif
+    FlightRecorder *theRecorder; // The Simulation's flight recorder, or nullptr without a Simulation
+
+    // Record an entry in the flight recorder for a handler
+    void record(long time, const std::shared_ptr<EventHandler> &aHandler, RecorderAction action);
+
     // This function is private so only this object can call it at times that are safe
     void sortHandlers();
+
+    // Does handler a come before handler b? (The earlier clockTime, then the lower clockSequence)
+    static bool clockBefore(const EventHandler &a, const EventHandler &b);
+
+    // Move the handler at index toward the front or the back of the heap until it is in
+    // order, keeping every clockIndex up to date. They return how many levels it moved.
+    long siftUp(size_t index);
+    long siftDown(size_t index);
+
+    // Take the handler at the front of the heap out of it
+    std::shared_ptr<EventHandler> popHandler();
+
+#if SIMPROFILE
+    // Call handleEvent() for a handler at the current time and count it in the profile
+    bool handleProfiledEvent(const std::shared_ptr<EventHandler> &aHandler);
+#endif
 public:
     SimClock(Simulation *theSimulation, long endTime);
     ~SimClock();
     
     // Get the current clock time
     long getTime();
+
+    // How many events have been handled so far (not counting the close-out)
+    long getEventCount();
     
-    // Add a handler to the vector, inserting it in sorted order
+    // Add a handler to the heap
     void addHandler(std::shared_ptr<EventHandler> aHandler);
     
-    // Remove and re-add this handler. Probably faster than a full sort
+    // Move this handler to where its new nextEventTime belongs, if it is in the heap
     void reSortHandler(std::shared_ptr<EventHandler> aHandler);
     
     // Set the private property indicating a sort is needed
     void markNeedSort();
     
-    // For testing: check if the vector is properly sorted
+    // For testing: check that the heap is in order and every handler knows where it is
     bool checkSort(); // for testing
     
     // The core loop of the simulation clock. If verbose, provide more details to cout during execution.
@@ -0,0 +1,111 @@
+//
+//  SimMemory.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "SimMemory.hpp"
+#include "Simulation.hpp"
+#include "FastEngine.hpp"
+#include <iostream>
+
+// Check that both engines count memory in every category, and that a memory budget either
+// streams the stats without changing the results or stops the run early. It reports errors to cout.
+bool testSimMemory() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of memory accounting *****" << std::endl;
+    // Long enough that the flight and charge records need several MB
+    SimSettings settings{};
+    settings.simulationDuration = 3000 * secondsPerHour;
+    settings.planeCount = 40;
+    settings.chargerCount = 4;
+    settings.siteCount = 2;
+    settings.siteFlightOption = 1;
+    settings.maxPassengerDelay = 600;
+    settings.randomSeed = 5;
+    settings.progressInterval = 0;
+
+    for(int engine = 0; engine < 2; engine++) {
+        settings.engineOption = engine;
+        settings.memoryBudgetMB = 0;
+        Simulation plainSimulation(settings);
+        plainSimulation.setQuiet(true);
+        std::vector<FinalStats> plainResults = plainSimulation.run(false);
+        const SimMemory &plainMemory = plainSimulation.getMemory();
+        for(int category = 0; category < memoryCategoryCount; category++) {
+            if(plainMemory.peakBytes[category] <= 0 || plainMemory.peakBytes[category] < plainMemory.currentBytes[category]) {
+                std::cout << "***** error: engine " << engine << " counted a peak of " << plainMemory.peakBytes[category]
+                << " bytes for " << memoryCategoryName(category) << std::endl;
+                returnValue = false;
+            }
+        }
+        if(plainMemory.peakTotal < plainMemory.peakBytes[memoryStats] || plainMemory.peakBytes[memoryStats] < 2 * 1024 * 1024 ||
+           plainMemory.streamingSince != -1 || plainMemory.stoppedAt != -1) {
+            std::cout << "***** error: unexpected memory totals from engine " << engine << std::endl;
+            returnValue = false;
+        }
+
+        // With a 1 MB budget the run switches to streaming and gives the same results
+        settings.memoryBudgetMB = 1;
+        settings.memoryBudgetOption = 0;
+        Simulation streamingSimulation(settings);
+        streamingSimulation.setQuiet(true);
+        std::vector<FinalStats> streamingResults = streamingSimulation.run(false);
+        const SimMemory &streamingMemory = streamingSimulation.getMemory();
+        if(!sameResults(streamingResults, plainResults) || streamingMemory.streamingSince <= 0 ||
+           streamingMemory.stoppedAt != -1 || streamingMemory.peakTotal > 1024 * 1024) {
+            std::cout << "***** error: engine " << engine << " did not stream within its budget (peak "
+            << streamingMemory.peakTotal << " bytes)" << std::endl;
+            returnValue = false;
+        }
+
+        // Or it stops early with fewer flights
+        settings.memoryBudgetOption = 1;
+        Simulation stoppingSimulation(settings);
+        stoppingSimulation.setQuiet(true);
+        std::vector<FinalStats> stoppedResults = stoppingSimulation.run(false);
+        const SimMemory &stoppedMemory = stoppingSimulation.getMemory();
+        long plainFlights = 0;
+        long stoppedFlights = 0;
+        for(size_t i = 0; i < plainResults.size() && i < stoppedResults.size(); i++) {
+            plainFlights += plainResults[i].totalFlights;
+            stoppedFlights += stoppedResults[i].totalFlights;
+        }
+        if(stoppedMemory.stoppedAt <= 0 || stoppedMemory.stoppedAt >= settings.simulationDuration ||
+           stoppedFlights <= 0 || stoppedFlights >= plainFlights) {
+            std::cout << "***** error: engine " << engine << " stopped at " << stoppedMemory.stoppedAt << " with "
+            << stoppedFlights << " of " << plainFlights << " flights" << std::endl;
+            returnValue = false;
+        }
+    }
+
+    // With one charger nearly every plane waits for it. A policy keeps them in a heap whose
+    // entries are larger than the FIFO ring buffer's, so its queues count more.
+    SimSettings waitingSettings{};
+    waitingSettings.simulationDuration = 50 * secondsPerHour;
+    waitingSettings.planeCount = 400;
+    waitingSettings.chargerCount = 1;
+    waitingSettings.randomSeed = 3;
+    waitingSettings.progressInterval = 0;
+    for(int engine = 0; engine < 2; engine++) {
+        waitingSettings.engineOption = engine;
+        long queueBytes[2]{};
+        const int policies[]{chargerPolicyFIFO, chargerPolicyShortestCharge};
+        for(int i = 0; i < 2; i++) {
+            waitingSettings.chargerPolicyOption = policies[i];
+            Simulation aSimulation(waitingSettings);
+            aSimulation.setQuiet(true);
+            aSimulation.run(false);
+            queueBytes[i] = aSimulation.getMemory().peakBytes[memoryQueues];
+        }
+        if(queueBytes[1] < queueBytes[0]) {
+            std::cout << "***** error: engine " << engine << " counted " << queueBytes[1] << " bytes of queues with a policy and "
+            << queueBytes[0] << " first come, first served" << std::endl;
+            returnValue = false;
+        }
+    }
+    std::cout << "Test of memory accounting " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
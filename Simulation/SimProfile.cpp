@@ -0,0 +1,123 @@
+//
+//  SimProfile.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/9/25.
+//
+
+#include "SimProfile.hpp"
+#include "Simulation.hpp"
+#include "FastEngine.hpp"
+#include <iostream>
+
+// Check that the profiler counts the same things for both engines, that its counts add up,
+// and that turning it on does not change the results. It reports errors to cout.
+bool testSimProfile() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of the profiler *****" << std::endl;
+#if SIMPROFILE
+    SimSettings settings{};
+    settings.simulationDuration = 300 * secondsPerHour;
+    settings.planeCount = 40;
+    settings.chargerCount = 4;
+    settings.siteCount = 3;
+    settings.siteFlightOption = 1;
+    settings.maxPassengerDelay = 600;
+    settings.randomSeed = 7;
+    settings.progressInterval = 0;
+
+    // Without profiling, the profile is empty
+    Simulation plainSimulation(settings);
+    plainSimulation.setQuiet(true);
+    std::vector<FinalStats> plainResults = plainSimulation.run(false);
+    if(plainSimulation.getProfile().enabled || plainSimulation.getProfile().totalEvents() != 0) {
+        std::cout << "***** error: profile filled in with profiling off" << std::endl;
+        returnValue = false;
+    }
+
+    settings.profileOption = 1;
+    SimProfile profiles[2]{};
+    for(int engine = 0; engine < 2; engine++) {
+        settings.engineOption = engine;
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        std::vector<FinalStats> results = aSimulation.run(false);
+        profiles[engine] = aSimulation.getProfile();
+        const SimProfile &aProfile = profiles[engine];
+        if(!sameResults(results, plainResults)) {
+            std::cout << "***** error: profiling changed the results for engine " << engine << std::endl;
+            returnValue = false;
+        }
+        if(!aProfile.enabled || aProfile.totalEvents() != aSimulation.getEventCount()) {
+            std::cout << "***** error: engine " << engine << " profiled " << aProfile.totalEvents()
+            << " events but handled " << aSimulation.getEventCount() << std::endl;
+            returnValue = false;
+        }
+        for(const ProfileKindStats &aKind: aProfile.kinds) {
+            if(aKind.sampledEvents != (aKind.events + profileSampleInterval - 1) / profileSampleInterval || aKind.sampledSeconds < 0) {
+                std::cout << "***** error: engine " << engine << " sampled " << aKind.sampledEvents << " of " << aKind.events << " events" << std::endl;
+                returnValue = false;
+            }
+        }
+        if(aProfile.kinds[profileFlight].events == 0 || aProfile.kinds[profileOther].events != 0 ||
+           aProfile.peakHandlers < 2 * settings.siteCount || aProfile.queueInserts < aProfile.kinds[profileFlight].events / 2 ||
+           aProfile.setupSeconds < 0 || aProfile.eventLoopSeconds <= 0 || aProfile.aggregationSeconds < 0 ||
+           aProfile.simulatedHours != 300.0) {
+            std::cout << "***** error: unexpected profile from engine " << engine << std::endl;
+            returnValue = false;
+        }
+    }
+    // Both engines keep the same things in the clock, so the counts match
+    bool sameCounts = profiles[0].queueInserts == profiles[1].queueInserts &&
+        profiles[0].reSorts == profiles[1].reSorts && profiles[0].peakHandlers == profiles[1].peakHandlers;
+    for(int kind = 0; kind < profileKindCount; kind++) {
+        sameCounts = sameCounts && profiles[0].kinds[kind].events == profiles[1].kinds[kind].events;
+    }
+    if(!sameCounts) {
+        std::cout << "***** error: the engines counted different inserts, re-sorts or events" << std::endl;
+        returnValue = false;
+    }
+
+    // Asking for hardware counters does not change the results. Where they are not available
+    // the profile says why and still has the timing.
+    settings.profileOption = 2;
+    for(int engine = 0; engine < 2; engine++) {
+        settings.engineOption = engine;
+        Simulation aSimulation(settings);
+        aSimulation.setQuiet(true);
+        std::vector<FinalStats> results = aSimulation.run(false);
+        const SimProfile &aProfile = aSimulation.getProfile();
+        if(!sameResults(results, plainResults) || !aProfile.countersRequested || aProfile.eventLoopSeconds <= 0) {
+            std::cout << "***** error: profiling with hardware counters went wrong for engine " << engine << std::endl;
+            returnValue = false;
+        }
+        bool countsOk = true;
+        for(int counter = 0; counter < hardwareCounterCount; counter++) {
+            double loopCount = aProfile.eventLoopCounts[counter];
+            double flightCount = aProfile.kinds[profileFlight].sampledCounts[counter];
+            if(aProfile.countersAvailable && aProfile.countersOpened[counter]) {
+                countsOk = countsOk && loopCount >= 0 && flightCount >= 0 && flightCount <= loopCount;
+            } else {
+                countsOk = countsOk && loopCount == 0 && flightCount == 0;
+            }
+        }
+        if(aProfile.countersAvailable && aProfile.countersOpened[counterInstructions]) {
+            countsOk = countsOk && aProfile.loopCountPerEvent(counterInstructions) > 0;
+        }
+        // There is a note about why exactly when they were not available
+        if(!countsOk || aProfile.countersAvailable != aProfile.countersNote.empty()) {
+            std::cout << "***** error: unexpected hardware counts from engine " << engine << std::endl;
+            returnValue = false;
+        }
+        if(engine == 0) {
+            std::cout << "Hardware counters " << (aProfile.countersAvailable ? "are available" :
+                                                  "are not available (" + aProfile.countersNote + "), timing only") << std::endl;
+        }
+    }
+#else
+    std::cout << "The profiler is compiled out (SIMPROFILE is 0)" << std::endl;
+#endif
+    std::cout << "Test of the profiler " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
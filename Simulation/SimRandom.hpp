@@ -0,0 +1,111 @@
+//
+//  SimRandom.hpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/5/25.
+//
+
+#ifndef SimRandom_hpp
+#define SimRandom_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <random>
+#include <cmath>
+
+/*
+ *******************************************************************************************
+ * class SimRandom
+ * This is a small, fast random number generator (SplitMix64) with only 8 bytes of state.
+ * Each Plane has its own SimRandom so the random numbers a plane draws (fault intervals,
+ * passenger counts, passenger delays and destinations) depend only on the simulation seed
+ * and the plane's place in the fleet, not on how events from other planes are interleaved.
+ * That lets two different engines running the same settings and seed produce the same
+ * results, and makes any run repeatable from its seed.
+ *
+ * A SimRandom created without a seed is seeded from std::random_device, which is what the
+ * tests and planes created outside a Simulation use.
+ *******************************************************************************************
+ */
+class SimRandom {
+    uint64_t state;
+public:
+    SimRandom(): state{0} {
+        std::random_device rd;
+        state = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    }
+    explicit SimRandom(uint64_t seed): state{seed} {
+    }
+
+    // Start the sequence over from a new seed
+    void seed(uint64_t newSeed) { state = newSeed; }
+
+    // The next 64 random bits
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // A random double in [0, 1)
+    double uniform01() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // A random long in [low, high]. Only call this with low <= high.
+    long uniformLong(long low, long high) {
+        uint64_t range = static_cast<uint64_t>(high - low) + 1;
+        return low + static_cast<long>(next() % range);
+    }
+
+    // A random count from a Poisson distribution with this mean. Small means multiply
+    // uniforms (Knuth), larger ones use Hormann's transformed rejection (PTRS), which takes
+    // about two uniforms whatever the mean.
+    long poisson(double mean) {
+        if(mean <= 0.0) {
+            return 0;
+        }
+        if(mean < 30.0) {
+            double limit = std::exp(-mean);
+            long count = 0;
+            double product = uniform01();
+            while(product > limit) {
+                count++;
+                product *= uniform01();
+            }
+            return count;
+        }
+        double rootMean = std::sqrt(mean);
+        double logMean = std::log(mean);
+        double b = 0.931 + 2.53 * rootMean;
+        double a = -0.059 + 0.02483 * b;
+        double inverseAlpha = 1.1239 + 1.1328 / (b - 3.4);
+        double vr = 0.9277 - 3.6224 / (b - 2.0);
+        while(true) {
+            double u = uniform01() - 0.5;
+            double v = uniform01();
+            double us = 0.5 - std::fabs(u);
+            long count = static_cast<long>(std::floor((2.0 * a / us + b) * u + mean + 0.43));
+            if(us >= 0.07 && v <= vr) {
+                return count;
+            }
+            if(count < 0 || (us < 0.013 && v > us)) {
+                continue;
+            }
+            if(std::log(v) + std::log(inverseAlpha) - std::log(a / (us * us) + b) <=
+               -mean + count * logMean - std::lgamma(count + 1.0)) {
+                return count;
+            }
+        }
+    }
+    // The seed for stream number "stream" of a simulation seeded with "seed". Streams with
+    // nearby numbers or seeds give unrelated sequences.
+    static uint64_t streamSeed(uint64_t seed, uint64_t stream) {
+        SimRandom mixer(seed ^ (stream * 0xD1B54A32D192ED03ULL));
+        mixer.next();
+        return mixer.next();
+    }
+};
+
+#endif /* SimRandom_hpp */
@@ -0,0 +1,328 @@
+//
+//  SimTrace.cpp
+//  JobyFirstProject
+//
+//  Created by Chad Mitchell on 2/8/25.
+//
+
+#include "SimTrace.hpp"
+#include "Simulation.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+// The buffer is written to the file when it gets this full. It has room for one more
+// record past this, and no record is longer than traceRecordRoom.
+static const size_t traceBufferSize{1 << 20};
+static const size_t traceRecordRoom{1024};
+// The process (group of tracks) ids. Site n's chargers are process chargerProcess + n.
+static const long planeProcess{1};
+static const long chargerProcess{2};
+
+SimTrace::SimTrace(const std::string &path):
+theFile{std::fopen(path.c_str(), "w")}, inMemory{false}, text{}, buffer(traceBufferSize + traceRecordRoom), used{0}, eventCount{0},
+simulationDuration{0}, firstPlaneNumber{1}, planes{}, freeLanes{}, laneCount{} {
+    writeHeader();
+}
+SimTrace::SimTrace():
+theFile{nullptr}, inMemory{true}, text{}, buffer(traceBufferSize + traceRecordRoom), used{0}, eventCount{0},
+simulationDuration{0}, firstPlaneNumber{1}, planes{}, freeLanes{}, laneCount{} {
+    writeHeader();
+}
+SimTrace::~SimTrace() {
+    close();
+}
+
+// Start the JSON. The first record has no comma in front of it, so the trace starts with
+// the name of the planes process.
+void SimTrace::writeHeader() {
+    appendText("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    appendText("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":");
+    appendNumber(planeProcess);
+    appendText(",\"args\":{\"name\":\"Planes\"}}");
+}
+
+// Did the file open? (always true in memory)
+bool SimTrace::isOpen() {
+    return theFile != nullptr || inMemory;
+}
+
+// The trace kept in memory. It is complete once close() has been called.
+const std::string &SimTrace::getText() {
+    return text;
+}
+
+// Finish the JSON and close the file
+void SimTrace::close() {
+    if(theFile || inMemory) {
+        appendText("\n]}\n");
+        flush();
+        if(theFile) {
+            std::fclose(theFile);
+        }
+        theFile = nullptr;
+        inMemory = false;
+    }
+}
+
+// How many events have been written
+long SimTrace::getEventCount() {
+    return eventCount;
+}
+
+// Write the buffer to the file (or add it to the text in memory)
+void SimTrace::flush() {
+    if(theFile && used > 0) {
+        std::fwrite(buffer.data(), 1, used, theFile);
+    } else if(inMemory) {
+        text.append(buffer.data(), used);
+    }
+    used = 0;
+}
+
+// Add text to the buffer. There is always room for the record being written.
+void SimTrace::appendText(const char *text, size_t length) {
+    std::memcpy(buffer.data() + used, text, length);
+    used += length;
+}
+void SimTrace::appendText(const char *text) {
+    appendText(text, std::strlen(text));
+}
+
+// Add a whole number to the buffer. This is several times faster than snprintf, which
+// matters since a trace of a large run has millions of numbers in it.
+void SimTrace::appendNumber(long value) {
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *start = end;
+    unsigned long magnitude = value < 0 ? 0UL - static_cast<unsigned long>(value) : static_cast<unsigned long>(value);
+    do {
+        *--start = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while(magnitude > 0);
+    if(value < 0) {
+        *--start = '-';
+    }
+    appendText(start, end - start);
+}
+
+// Add the name of a process or track to the buffer
+void SimTrace::writeName(const char *kind, long process, long track, const std::string &name) {
+    if(used >= traceBufferSize) {
+        flush();
+    }
+    appendText(",\n{\"name\":\"");
+    appendText(kind);
+    appendText("\",\"ph\":\"M\",\"pid\":");
+    appendNumber(process);
+    appendText(",\"tid\":");
+    appendNumber(track);
+    appendText(",\"args\":{\"name\":\"");
+    appendText(name.c_str(), std::min(name.size(), traceRecordRoom / 2));
+    appendText("\"}}");
+}
+
+// Start one complete ("X") event in the buffer. Times are in simulated seconds and are
+// written as microseconds by adding six zeros. Any args go in before endEvent() is called.
+void SimTrace::beginEvent(const char *name, const char *category, long process, long track, long start, long end) {
+    if(used >= traceBufferSize) {
+        flush();
+    }
+    appendText(",\n{\"name\":\"");
+    appendText(name);
+    appendText("\",\"cat\":\"");
+    appendText(category);
+    appendText("\",\"ph\":\"X\",\"pid\":");
+    appendNumber(process);
+    appendText(",\"tid\":");
+    appendNumber(track);
+    appendText(",\"ts\":");
+    appendNumber(start);
+    if(start != 0) { appendText("000000", 6); }
+    appendText(",\"dur\":");
+    appendNumber(end - start);
+    if(end != start) { appendText("000000", 6); }
+}
+
+// Finish the event
+void SimTrace::endEvent() {
+    appendText("}", 1);
+    eventCount++;
+}
+
+// Find the plane's track, naming it the first time the plane is seen.
+// Every plane starts the simulation waiting for passengers.
+SimTrace::PlaneTrack &SimTrace::planeTrack(int planeNumber, Company theCompany) {
+    long track = planeNumber - firstPlaneNumber + 1;
+    if(track > static_cast<long>(planes.size())) {
+        planes.resize(track, PlaneTrack{0, "", 0, -1});
+    }
+    PlaneTrack &aTrack = planes[track - 1];
+    if(aTrack.track == 0) {
+        aTrack.track = track;
+        aTrack.name = "Plane " + std::to_string(track) + " " + companyName(theCompany);
+        writeName("thread_name", planeProcess, track, aTrack.name);
+    }
+    return aTrack;
+}
+
+// Called by Simulation::run before the engine starts
+void SimTrace::startRun(long duration, long siteCount, int nextPlaneNumber) {
+    simulationDuration = duration;
+    firstPlaneNumber = nextPlaneNumber;
+    freeLanes.assign(siteCount, std::priority_queue<int, std::vector<int>, std::greater<int>>{});
+    laneCount.assign(siteCount, 0);
+    for(long site = 0; site < siteCount; site++) {
+        writeName("process_name", chargerProcess + site, 0, "Site " + std::to_string(site) + " chargers");
+    }
+}
+
+// A flight has ended (or was cut off by a fault or the end of the simulation).
+// The time since the plane was last charged was spent waiting for passengers.
+void SimTrace::flight(int planeNumber, Company theCompany, long originSite, long destinationSite, long startTime, long endTime,
+                      long passengerCount, long faultCount) {
+    PlaneTrack &aTrack = planeTrack(planeNumber, theCompany);
+    if(aTrack.freeSince < startTime) {
+        beginEvent("Waiting for passengers", "wait", planeProcess, aTrack.track, aTrack.freeSince, startTime);
+        endEvent();
+    }
+    beginEvent("Flight", "flight", planeProcess, aTrack.track, startTime, endTime);
+    appendText(",\"args\":{\"passengers\":");
+    appendNumber(passengerCount);
+    appendText(",\"faults\":");
+    appendNumber(faultCount);
+    appendText(",\"from\":");
+    appendNumber(originSite);
+    appendText(",\"to\":");
+    appendNumber(destinationSite);
+    appendText("}", 1);
+    endEvent();
+    aTrack.freeSince = endTime;
+}
+
+// A plane has been put on a charger. It takes the lowest numbered free charger track at the site.
+void SimTrace::chargeStarted(int planeNumber, Company theCompany, long site, long currentTime) {
+    PlaneTrack &aTrack = planeTrack(planeNumber, theCompany);
+    if(freeLanes[site].empty()) {
+        aTrack.chargerLane = laneCount[site]++;
+        writeName("thread_name", chargerProcess + site, aTrack.chargerLane, "Charger " + std::to_string(aTrack.chargerLane + 1));
+    } else {
+        aTrack.chargerLane = freeLanes[site].top();
+        freeLanes[site].pop();
+    }
+}
+
+// A charge has ended (or was cut off by the end of the simulation). It is shown on the
+// plane's track, after any wait for a charger, and on the charger's track.
+void SimTrace::charge(int planeNumber, Company theCompany, long site, long startedWaiting, long startTime, long endTime) {
+    PlaneTrack &aTrack = planeTrack(planeNumber, theCompany);
+    if(startedWaiting < startTime) {
+        beginEvent("Waiting for charger", "wait", planeProcess, aTrack.track, startedWaiting, startTime);
+        endEvent();
+    }
+    beginEvent("Charging", "charge", planeProcess, aTrack.track, startTime, endTime);
+    endEvent();
+    if(aTrack.chargerLane >= 0) {
+        // On the charger's track the event is named for the plane
+        beginEvent(aTrack.name.c_str(), "charger", chargerProcess + site, aTrack.chargerLane, startTime, endTime);
+        endEvent();
+        freeLanes[site].push(aTrack.chargerLane);
+        aTrack.chargerLane = -1;
+    }
+    aTrack.freeSince = endTime;
+}
+
+// A fault has grounded a plane for the rest of the simulation
+void SimTrace::grounded(int planeNumber, Company theCompany, long site, long currentTime) {
+    PlaneTrack &aTrack = planeTrack(planeNumber, theCompany);
+    beginEvent("Grounded", "grounded", planeProcess, aTrack.track, currentTime, std::max(currentTime, simulationDuration));
+    appendText(",\"args\":{\"site\":");
+    appendNumber(site);
+    appendText("}", 1);
+    endEvent();
+}
+
+// Count the times text appears in a trace
+static long countInTrace(const std::string &trace, const std::string &text) {
+    long count = 0;
+    for(size_t at = trace.find(text); at != std::string::npos; at = trace.find(text, at + text.size())) {
+        count++;
+    }
+    return count;
+}
+
+// Trace the same seeded run with both engines and check that the traces are the same and
+// that they agree with the results. It reports errors to cout.
+bool testSimTrace() {
+    bool returnValue = true;
+    std::cout << " ***** Starting test of SimTrace *****" << std::endl;
+    SimSettings settings{};
+    settings.simulationDuration = 100 * secondsPerHour;
+    settings.planeCount = 30;
+    settings.chargerCount = 3;
+    settings.siteCount = 2;
+    settings.siteFlightOption = 1;
+    settings.maxPassengerDelay = 600;
+    settings.faultOption = 2;
+    settings.randomSeed = 11;
+    settings.progressInterval = 0;
+
+    std::string traces[2];
+    for(int engine = 0; engine < 2; engine++) {
+        settings.engineOption = engine;
+        std::string path = "JobySimTraceTest" + std::to_string(engine) + ".json";
+        long flights = 0;
+        long charges = 0;
+        {
+            SimTrace aTrace(path);
+            if(!aTrace.isOpen()) {
+                std::cout << "***** error: could not open " << path << std::endl;
+                return false;
+            }
+            Simulation aSimulation(settings);
+            aSimulation.setQuiet(true);
+            aSimulation.setTrace(&aTrace);
+            for(const FinalStats &r: aSimulation.run(false)) {
+                flights += r.totalFlights;
+                charges += r.totalCharges;
+            }
+        }
+        std::ifstream in(path);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        traces[engine] = contents.str();
+        std::remove(path.c_str());
+        const std::string &trace = traces[engine];
+
+        // Each flight and charge in the results is in the trace, and each charge is on a charger track
+        long tracedFlights = countInTrace(trace, "\"cat\":\"flight\"");
+        long tracedCharges = countInTrace(trace, "\"cat\":\"charge\"");
+        long chargerEvents = countInTrace(trace, "\"cat\":\"charger\"");
+        if(tracedFlights != flights || tracedCharges != charges || chargerEvents != charges) {
+            std::cout << "***** error: engine " << engine << " traced " << tracedFlights << " flights and " << tracedCharges
+            << " charges (" << chargerEvents << " on chargers) but the results have " << flights << " and " << charges << std::endl;
+            returnValue = false;
+        }
+        // Faults ground planes in this run, nothing goes backwards and no site uses more charger tracks than it has chargers
+        if(countInTrace(trace, "\"cat\":\"grounded\"") == 0 || countInTrace(trace, "\"dur\":-") != 0 ||
+           countInTrace(trace, "\"Charger " + std::to_string(settings.chargerCount + 1) + "\"") != 0) {
+            std::cout << "***** error: unexpected groundings, durations or charger tracks from engine " << engine << std::endl;
+            returnValue = false;
+        }
+        if(trace.compare(0, 2, "{\"") != 0 || trace.size() < 4 || trace.compare(trace.size() - 4, 4, "\n]}\n") != 0) {
+            std::cout << "***** error: the trace from engine " << engine << " is not complete" << std::endl;
+            returnValue = false;
+        }
+    }
+    // Both engines do the same things in the same order, so their traces are the same
+    if(traces[0] != traces[1]) {
+        std::cout << "***** error: the SimClock and FastEngine traces are different" << std::endl;
+        returnValue = false;
+    }
+    std::cout << "Test of SimTrace " << (returnValue ? "passed" : "failed") << std::endl;
+    std::cout << std::endl;
+    return returnValue;
+}
@@ -9,9 +9,18 @@
 #include "SimClock.hpp"
 #include "ChargerQueue.hpp"
 #include "PlaneQueue.hpp"
+#include "FastEngine.hpp"
+#include "DecoupledEngine.hpp"
+#include "CohortEngine.hpp"
+#include "FluidModel.hpp"
+#include "SimTrace.hpp"
 #include "SimSettings.hpp"
 #include <iomanip>
 #include <chrono>
+#include <ctime>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
 
 /*
  *******************************************************************************************
@@ -22,10 +31,26 @@
  *
  * If you call run(true) then it will use "cout" to share some details about the progress
  * of the Simulation including a list of all the Flights and Charges during the simulation.
+ *
+ * SimSettings::engineOption chooses between the SimClock of EventHandler objects and the
+ * FastEngine. Both draw their random numbers the same way from the seed so they give the
+ * same results. A verbose run always uses the SimClock since it describes each handler.
+ * The DecoupledEngine runs each plane on its own when no plane ever waits for a charger,
+ * and hands the run to the FastEngine when one would. The CohortEngine runs planes that
+ * are in step with each other as one. The FluidModel is an approximation that follows
+ * how much of the fleet is in each state instead of each plane.
+ *
+ * The memory the run uses is counted in theMemory by category. If SimSettings::memoryBudgetMB
+ * is set, a run that goes over it switches to adding up its stats as they happen, or stops.
  * *******************************************************************************************
  */
 Simulation::Simulation(SimSettings someSettings):
-theSimClock{}, theChargerQueue{}, theFlightStats{}, theChargerStats{} {
+theMemory{}, theSimClock{}, theSites{},
+theFlightStats(CountingAllocator<FlightStats>(&theMemory, memoryStats)), theChargerStats(CountingAllocator<ChargerStats>(&theMemory, memoryStats)),
+theTotals{}, streaming{false}, stopRequested{false}, siteResults{},
+theSeed{0}, theRandom{0}, planesMade{0}, companyPlanes{}, companyGrounded{}, weightedPlanes{}, faultLogWeight{0}, eventCount{0}, engineNote{}, quiet{false}, theProfile{}, thePathDerivatives{false, 0, 0, 0}, theRecorder{}, theTrace{nullptr},
+progressStartWall{}, progressStartTime{0},
+pausedEngine{}, pausedTime{-1}, pausedEvents{0} {
     // Set up shared pointer to the settings for this simulation
     theSettings = std::make_shared<SimSettings>(someSettings);
 }
@@ -33,55 +58,518 @@ Simulation::~Simulation() {
     
 }
 
+// Used when a site number is out of range (or the Simulation has not been run) so the
+// callers can use their existing checks for a nullptr.
+static const std::shared_ptr<ChargerQueue> noChargerQueue{};
+static const std::shared_ptr<PlaneQueue> noPlaneQueue{};
 
-std::vector<FinalStats> Simulation::run(bool verbose)
-{
-    // Start a timer so we can report how long it takes to run
-    auto startTimer = std::chrono::high_resolution_clock::now();
-    theSimClock = std::make_shared<SimClock>(this, theSettings->simulationDuration);
+// The queues for a site. If the site does not exist these return a nullptr.
+const std::shared_ptr<ChargerQueue> &Simulation::getChargerQueue(long siteNumber) {
+    if(siteNumber < 0 || siteNumber >= static_cast<long>(theSites.size())) { return noChargerQueue; }
+    return theSites[siteNumber].theChargerQueue;
+}
+const std::shared_ptr<PlaneQueue> &Simulation::getPlaneQueue(long siteNumber) {
+    if(siteNumber < 0 || siteNumber >= static_cast<long>(theSites.size())) { return noPlaneQueue; }
+    return theSites[siteNumber].thePlaneQueue;
+}
+
+// Choose where a flight taking off from fromSite will land. With siteFlightOption 1 it is a
+// random site other than fromSite. Otherwise (or with only one site) the flight comes back.
+long Simulation::pickDestinationSite(long fromSite, SimRandom &random) {
+    if(!theSettings || theSettings->siteFlightOption != 1 || theSettings->siteCount < 2) {
+        return fromSite;
+    }
+    // Pick one of the other siteCount - 1 sites, skipping over fromSite
+    long toSite = random.uniformLong(0, theSettings->siteCount - 2);
+    if(toSite >= fromSite) { toSite++; }
+    return toSite;
+}
+
+// Create the next plane in the fleet. Its random numbers are its own stream of our seed.
+std::shared_ptr<Plane> Simulation::makePlane(Company theCompany) {
+    extern PlaneSpecification planeSpecifications[];
+    planesMade++;
+    companyPlanes[theCompany]++;
+    double faultBias = 1.0;
+    if(theSettings->faultBiasCompany < 0 || theSettings->faultBiasCompany == theCompany) {
+        faultBias = theSettings->faultBias;
+    }
+    PlaneSpecification aSpec = planeSpecifications[theCompany];
+    aSpec.time_to_charge__hours += theSettings->timeToChargeChange[theCompany];
+    std::shared_ptr<Plane> thePlane = std::allocate_shared<Plane>(CountingAllocator<Plane>(&theMemory, memoryPlanes),
+                                       aSpec, SimRandom::streamSeed(theSeed, planesMade), faultBias);
+    if(faultBias != 1.0) {
+        weightedPlanes.push_back(thePlane);
+    }
+    return thePlane;
+}
+
+// A fault grounded a plane
+void Simulation::recordGrounded(Company theCompany) {
+    companyGrounded[theCompany]++;
+}
+
+// After run(), the planes of a company
+long Simulation::getPlaneCount(Company theCompany) {
+    return companyPlanes[theCompany];
+}
+
+// After run(), the planes of a company a fault grounded
+long Simulation::getGroundedCount(Company theCompany) {
+    return companyGrounded[theCompany];
+}
+
+// After run(), the likelihood ratio of the run's faults
+double Simulation::getFaultWeight() {
+    return std::exp(faultLogWeight);
+}
+
+// After run(), the seed that was used
+long Simulation::getSeed() {
+    return theSeed;
+}
+
+// After run(), how many events the engine handled
+long Simulation::getEventCount() {
+    return eventCount;
+}
+
+// After run() with engineOption 2, 3 or 4, how the planes were run or why the FastEngine ran instead
+const std::string &Simulation::getEngineNote() {
+    return engineNote;
+}
+
+// After run(), what the profiler found (enabled is false if SimSettings::profileOption was 0)
+const SimProfile &Simulation::getProfile() {
+    return theProfile;
+}
+
+// After run(), a percentile of the waits of the charges kept, if every charge was kept
+double Simulation::getWaitPercentile(double fraction) {
+    long totalCharges = 0;
+    for(Company c: allCompany) {
+        totalCharges += theTotals.chargeCounts[c];
+    }
+    if(streaming || static_cast<long>(theChargerStats.size()) != totalCharges) {
+        return -1;
+    }
+    if(theChargerStats.empty()) {
+        return 0;
+    }
+    std::vector<long> waits{};
+    waits.reserve(theChargerStats.size());
+    for(const ChargerStats &cs: theChargerStats) {
+        waits.push_back(cs.durationWithWait - cs.duration);
+    }
+    // The nearest rank: the smallest wait that at least that fraction waited no longer than
+    double rank = std::ceil(std::max(0.0, std::min(1.0, fraction)) * waits.size());
+    size_t index = rank < 1 ? 0 : static_cast<size_t>(rank) - 1;
+    std::nth_element(begin(waits), begin(waits) + index, end(waits));
+    return static_cast<double>(waits[index]);
+}
+
+// After run(), the derivatives the FastEngine followed
+const PathDerivatives &Simulation::getPathDerivatives() {
+    return thePathDerivatives;
+}
+
+// After run(), the memory the run used by category, and what happened if it went over budget
+const SimMemory &Simulation::getMemory() {
+    return theMemory;
+}
+
+// After run(), the last things the engine did
+const FlightRecorder &Simulation::getFlightRecorder() {
+    return theRecorder;
+}
+
+// Write the last entries of the flight recorder (all of them if last is 0) to out
+void Simulation::dumpFlightRecorder(std::ostream &out, size_t last) {
+    theRecorder.dump(out, last);
+}
+
+// The SimMemory of a Simulation, or nullptr for objects made outside a Simulation (for testing)
+SimMemory *Simulation::memoryOf(Simulation *aSimulation) {
+    return aSimulation ? &aSimulation->theMemory : nullptr;
+}
+
+// For testing: do not write the summary of each run to cout
+void Simulation::setQuiet(bool newValue) {
+    quiet = newValue;
+}
+
+// Write the timeline of the next run to aTrace (or nullptr for no trace)
+void Simulation::setTrace(SimTrace *aTrace) {
+    theTrace = aTrace;
+}
+
+// After run(), the same results for each site. The outer vector is indexed by site number.
+const std::vector<std::vector<FinalStats>> &Simulation::getSiteResults() {
+    return siteResults;
+}
+
+// Clear the totals for a run with siteCount sites
+void StatsTotals::reset(long siteCount) {
+    for(auto c: allCompany) {
+        flightCounts[c] = 0;
+        flightTotals[c] = FlightStats{};
+        flightTotals[c].theCompany = c;
+        chargeCounts[c] = 0;
+        chargerTotals[c] = ChargerStats{};
+        chargerTotals[c].theCompany = c;
+    }
+    siteFlightCounts.assign(siteCount * companyCount, 0);
+    siteFlightTotals.assign(siteCount * companyCount, FlightStats{});
+    siteChargeCounts.assign(siteCount * companyCount, 0);
+    siteChargerTotals.assign(siteCount * companyCount, ChargerStats{});
+}
+
+// Add one flight (or count flights already added together in f) to the totals for its company and site
+void StatsTotals::addFlight(const FlightStats &f, long count) {
+    Company c{f.theCompany};
+    long s = f.siteNumber * companyCount + c;
+    FlightStats *totals[] {&flightTotals[c], &siteFlightTotals[s]};
+    flightCounts[c] += count;
+    siteFlightCounts[s] += count;
+    for(FlightStats *t: totals) {
+        t->duration += f.duration;
+        t->passengerCount += f.passengerCount;
+        t->faultCount += f.faultCount;
+        t->passengerMiles += f.passengerMiles;
+    }
+}
+
+// Add one charge (or count charges already added together in cs) to the totals for its company and site
+void StatsTotals::addCharge(const ChargerStats &cs, long count) {
+    Company c{cs.theCompany};
+    long s = cs.siteNumber * companyCount + c;
+    ChargerStats *totals[] {&chargerTotals[c], &siteChargerTotals[s]};
+    chargeCounts[c] += count;
+    siteChargeCounts[s] += count;
+    for(ChargerStats *t: totals) {
+        t->duration += cs.duration;
+        t->durationWithWait += cs.durationWithWait;
+    }
+}
+
+// Add another set of totals for the same sites to these, times over, one site and company at a time
+void StatsTotals::add(const StatsTotals &other, long times) {
+    long siteCount = static_cast<long>(siteFlightCounts.size()) / companyCount;
+    for(long site = 0; site < siteCount; site++) {
+        for(auto c: allCompany) {
+            long s = site * companyCount + c;
+            FlightStats someFlights = other.siteFlightTotals[s];
+            someFlights.theCompany = c;
+            someFlights.siteNumber = site;
+            someFlights.duration *= times;
+            someFlights.passengerCount *= times;
+            someFlights.faultCount *= times;
+            someFlights.passengerMiles *= times;
+            addFlight(someFlights, other.siteFlightCounts[s] * times);
+            ChargerStats someCharges = other.siteChargerTotals[s];
+            someCharges.theCompany = c;
+            someCharges.siteNumber = site;
+            someCharges.duration *= times;
+            someCharges.durationWithWait *= times;
+            addCharge(someCharges, other.siteChargeCounts[s] * times);
+        }
+    }
+}
+
+// Record a flight. Until the run is streaming it is kept in theFlightStats. Growing the
+// vector doubles it, so first check that the bigger vector fits in the budget.
+void Simulation::recordFlight(const FlightStats &someStats, long currentTime) {
+    theRecorder.record(currentTime, profileFlight, someStats.planeNumber, recordFlightLogged);
+    if(!streaming && theFlightStats.size() == theFlightStats.capacity()) {
+        checkMemory(currentTime, static_cast<long>(std::max<size_t>(1, theFlightStats.capacity()) * sizeof(FlightStats)));
+    }
+    if(streaming) {
+        theTotals.addFlight(someStats);
+    } else {
+        theFlightStats.push_back(someStats);
+    }
+    if(theMemory.overBudget) {
+        checkMemory(currentTime, 0);
+    }
+}
+
+// Record a charge, the same way as a flight
+void Simulation::recordCharge(const ChargerStats &someStats, long currentTime) {
+    theRecorder.record(currentTime, profileChargerQueue, someStats.planeNumber, recordChargeLogged);
+    if(!streaming && theChargerStats.size() == theChargerStats.capacity()) {
+        checkMemory(currentTime, static_cast<long>(std::max<size_t>(1, theChargerStats.capacity()) * sizeof(ChargerStats)));
+    }
+    if(streaming) {
+        theTotals.addCharge(someStats);
+    } else {
+        theChargerStats.push_back(someStats);
+    }
+    if(theMemory.overBudget) {
+        checkMemory(currentTime, 0);
+    }
+}
+
+// If the run is over its memory budget (or would be after allocating moreBytes), switch to
+// streaming aggregation or stop. A run that stops also streams, so closing out the handlers
+// that are left does not allocate any more records.
+void Simulation::checkMemory(long currentTime, long moreBytes) {
+    if(!theMemory.wouldExceed(moreBytes)) {
+        return;
+    }
+    if(!streaming && theSettings->memoryBudgetOption == 0) {
+        startStreaming(currentTime);
+        if(!theMemory.overBudget) {
+            return;
+        }
+    }
+    if(!stopRequested) {
+        stopRequested = true;
+        theMemory.stoppedAt = currentTime;
+        if(!quiet) {
+            std::cout << std::endl << "Memory budget of " << theSettings->memoryBudgetMB << " MB exceeded, stopping the simulation at "
+            << currentTime << " seconds" << std::endl;
+        }
+    }
+    if(!streaming) {
+        startStreaming(currentTime);
+    }
+}
+
+// Add up the records kept so far, in the order they happened, and free them
+void Simulation::startStreaming(long currentTime) {
+    for(const FlightStats &f: theFlightStats) {
+        theTotals.addFlight(f);
+    }
+    for(const ChargerStats &cs: theChargerStats) {
+        theTotals.addCharge(cs);
+    }
+    CountedVector<FlightStats>(theFlightStats.get_allocator()).swap(theFlightStats);
+    CountedVector<ChargerStats>(theChargerStats.get_allocator()).swap(theChargerStats);
+    streaming = true;
+    theMemory.streamingSince = currentTime;
+}
+
+// Turn the totals for one company (at one site or all of them) into FinalStats.
+// Some of them want grand totals and some of them want averages.
+static FinalStats makeFinalStats(Company c, long flightCount, const FlightStats &totalFlightStats,
+                                 long chargeCount, const ChargerStats &totalChargerStats) {
+    extern PlaneSpecification planeSpecifications[];
+    double flightCountD = flightCount; // so we do floating point math
+    if(flightCountD <= 0) flightCountD = 1.0; // so we avoid division by 0
+    double chargeCountD = chargeCount; // so we do floating point math
+    if(chargeCountD <= 0) chargeCountD = 1.0; // so we avoid division by 0
+    double averageTime = totalFlightStats.duration/flightCountD;
+    return FinalStats{c, flightCount, averageTime,
+        averageTime * planeSpecifications[c].cruise_speed__mph / secondsPerHourD,
+        chargeCount,
+        totalChargerStats.duration / chargeCountD,
+        totalChargerStats.durationWithWait / chargeCountD,
+        totalFlightStats.faultCount,
+        totalFlightStats.passengerMiles};
+}
+
+
+// Run the simulation with a SimClock of EventHandler objects. It returns the final simulated time.
+long Simulation::runHandlers(bool verbose, const std::vector<std::vector<Company>> &siteCompanies) {
+    theSimClock = std::allocate_shared<SimClock>(CountingAllocator<SimClock>(&theMemory, memoryHandlers), this, theSettings->simulationDuration);
  
-    // Set up the environment
-    theChargerQueue = std::make_shared<ChargerQueue>(this, theSettings->chargerCount);
-    thePlaneQueue = std::make_shared<PlaneQueue>(this);
-    thePlaneQueue->generatePlanes(theSimClock->getTime(), theSettings->planeCount, theSettings->minPlanePerKind, theSettings->maxPassengerDelay);
-    theSimClock->addHandler(theChargerQueue);
-    theSimClock->addHandler(thePlaneQueue);
+    // Set up the environment with a ChargerQueue and a PlaneQueue for each site
+    long siteCount = static_cast<long>(siteCompanies.size());
+    std::shared_ptr<ChargerPolicy> thePolicy = ChargerPolicy::makePolicy(theSettings->chargerPolicyOption, *theSettings);
+    theSites.clear();
+    theSites.reserve(siteCount);
+    for(long site = 0; site < siteCount; site++) {
+        theSites.push_back(SimSite{
+            std::allocate_shared<ChargerQueue>(CountingAllocator<ChargerQueue>(&theMemory, memoryHandlers), this, theSettings->chargerCount, thePolicy, site),
+            std::allocate_shared<PlaneQueue>(CountingAllocator<PlaneQueue>(&theMemory, memoryHandlers), this, site)});
+    }
+    for(long site = 0; site < siteCount; site++) {
+        theSites[site].thePlaneQueue->generatePlanes(theSimClock->getTime(), siteCompanies[site], theSettings->maxPassengerDelay);
+    }
+    for(const SimSite &aSite: theSites) {
+        theSimClock->addHandler(aSite.theChargerQueue);
+        theSimClock->addHandler(aSite.thePlaneQueue);
+    }
     
     // Run the actual simulation
     theSimClock->run(verbose);
-    
+    eventCount = theSimClock->getEventCount();
+    return theSimClock->getTime();
+}
+
+std::vector<FinalStats> Simulation::run(bool verbose)
+{
+    // Start a timer so we can report how long it takes to run
+    auto startTimer = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<Company>> siteCompanies = startRun();
+    long siteCount = static_cast<long>(siteCompanies.size());
+
+    if(theTrace) {
+        theTrace->startRun(theSettings->simulationDuration, siteCount, Plane::getNextPlaneNumber());
+    }
+
+    // Run the actual simulation with the chosen engine. The DecoupledEngine returns -1 if a
+    // plane would have waited for a charger. Then the FastEngine runs it with new planes made
+    // from the same random number streams.
+    long finalTime{-1};
+    int engineOption = theSettings->engineOption;
+    if(theSettings->faultBias != 1.0 && engineOption > 1) {
+        engineNote = "a fault bias needs each plane's fault intervals, so the FastEngine ran it";
+        engineOption = 1;
+    }
+    if(theSettings->chargeTimeDerivativeOption >= 0 && engineOption != 1 && !verbose) {
+        engineNote = "the FastEngine follows the derivatives along each plane's events, so it ran it";
+        engineOption = 1;
+    }
+    bool fastEngine = engineOption == 1;
+    if(engineOption == 2 && !verbose) {
+        if(DecoupledEngine::canRun(*theSettings, theTrace)) {
+            DecoupledEngine theEngine(this);
+            finalTime = theEngine.run(siteCompanies);
+            eventCount = theEngine.getEventCount();
+            engineNote = theEngine.getNote();
+        } else {
+            engineNote = "a trace or memory budget needs the events in time order, so the FastEngine ran it";
+        }
+        if(finalTime < 0) {
+            planesMade = 0;
+            std::fill(std::begin(companyPlanes), std::end(companyPlanes), 0);
+            fastEngine = true;
+        }
+    }
+    if(engineOption == 3 && !verbose) {
+        if(CohortEngine::canRun(*theSettings, theTrace)) {
+            CohortEngine theEngine(this);
+            finalTime = theEngine.run(siteCompanies);
+            eventCount = theEngine.getEventCount();
+            engineNote = theEngine.getNote();
+        } else {
+            engineNote = "cohorts need faults counted when flights end, first come, first served chargers and no trace or memory budget, so the FastEngine ran it";
+            fastEngine = true;
+        }
+    }
+    if(engineOption == 4 && !verbose) {
+        if(theTrace) {
+            engineNote = "a trace needs each plane's events, so the FastEngine ran it instead of the fluid model";
+            fastEngine = true;
+        } else {
+            FluidModel theModel(this);
+            finalTime = theModel.run(siteCompanies);
+            eventCount = theModel.getEventCount();
+            engineNote = theModel.getNote();
+        }
+    }
+    if(finalTime >= 0) {
+        // The DecoupledEngine, CohortEngine or FluidModel ran it
+    } else if(fastEngine && !verbose) {
+        FastEngine theEngine(this);
+        finalTime = theEngine.run(siteCompanies);
+        eventCount = theEngine.getEventCount();
+        if(!theEngine.getNote().empty()) {
+            engineNote += (engineNote.empty() ? "" : "; ") + theEngine.getNote();
+        }
+    } else {
+        finalTime = runHandlers(verbose, siteCompanies);
+    }
+    return finishRun(verbose, finalTime, startTimer);
+}
+
+// Set up the seed, clear the last run and choose the companies of the planes at each site
+std::vector<std::vector<Company>> Simulation::startRun() {
+    // Set up the random numbers. Without a seed in the settings, make one up. It is kept to a
+    // positive long so it can be typed back in to repeat the run.
+    theSeed = theSettings->randomSeed;
+    if(theSeed <= 0) {
+        theSeed = static_cast<long>((SimRandom().next() ^ static_cast<uint64_t>(time(0))) & LONG_MAX);
+        if(theSeed == 0) { theSeed = 1; }
+    }
+    theRandom.seed(SimRandom::streamSeed(theSeed, 0));
+    planesMade = 0;
+    std::fill(std::begin(companyPlanes), std::end(companyPlanes), 0);
+    std::fill(std::begin(companyGrounded), std::end(companyGrounded), 0);
+    faultLogWeight = 0;
+    // Free what is left of the last run so it is not counted in this one
+    weightedPlanes.clear();
+    theSimClock = nullptr;
+    theSites.clear();
+    pausedEngine.reset();
+    pausedTime = -1;
+    CountedVector<FlightStats>(theFlightStats.get_allocator()).swap(theFlightStats);
+    CountedVector<ChargerStats>(theChargerStats.get_allocator()).swap(theChargerStats);
+    streaming = false;
+    stopRequested = false;
+    theMemory.startRun(theSettings->memoryBudgetMB * 1024 * 1024);
+    theRecorder.clear();
+    engineNote.clear();
+    // The engine fills in the counts and event loop time if the profile is enabled
+    theProfile = SimProfile{};
+    thePathDerivatives = PathDerivatives{false, 0, 0, 0};
+    progressStartWall = std::chrono::steady_clock::now();
+    progressStartTime = 0;
+#if SIMPROFILE
+    theProfile.enabled = theSettings->profileOption != 0;
+    theProfile.countersRequested = theSettings->profileOption == 2;
+#endif
+
+    // Choose the companies for all the planes at once so minPlanePerKind applies to the whole
+    // fleet, then deal them out to the sites in turn.
+    long siteCount = std::max(1L, theSettings->siteCount);
+    theTotals.reset(siteCount);
+    std::vector<Company> companyChoices = PlaneQueue::chooseCompanies(theSettings->planeCount, theSettings->minPlanePerKind, theRandom);
+    std::vector<std::vector<Company>> siteCompanies(siteCount);
+    for(size_t i = 0; i < companyChoices.size(); i++) {
+        siteCompanies[i % siteCount].push_back(companyChoices[i]);
+    }
+    return siteCompanies;
+}
+
+// Add up the stats of a run that ended at finalTime and return the results
+std::vector<FinalStats> Simulation::finishRun(bool verbose, long finalTime, std::chrono::high_resolution_clock::time_point startTimer) {
+    long siteCount = std::max(1L, theSettings->siteCount);
     // Display the run time
     auto stopTimer = std::chrono::high_resolution_clock::now();
+#if SIMPROFILE
+    if(theProfile.enabled) {
+        // Setup is everything before the event loop, including what the engine does before it starts
+        theProfile.setupSeconds = std::chrono::duration<double>(stopTimer - startTimer).count() - theProfile.eventLoopSeconds;
+        theProfile.simulatedHours = finalTime / secondsPerHourD;
+        theProfile.eventsPerSimulatedHour = finalTime > 0 ? eventCount / theProfile.simulatedHours : 0.0;
+    }
+#endif
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stopTimer - startTimer);
     double secondsTaken = duration.count() / 1000000.0;
-    std::cout << "Time taken by simulation: "
-    << duration.count() << " microseconds ("
-    << secondsTaken << " seconds)" << std::endl;
+    if(!quiet) {
+        std::cout << "Time taken by simulation: "
+        << duration.count() << " microseconds ("
+        << secondsTaken << " seconds)" << std::endl;
+        if(secondsTaken > 0) {
+            std::cout << eventCount << " events (" << std::fixed << std::setprecision(0)
+            << eventCount / secondsTaken << " events per second)" << std::defaultfloat << std::endl;
+        }
+    }
 
     // Prepare to return the results
-    
-    // First summarize the flight stat data and charger stat data
-    long flightCounts[maxCompany+1]{};
-    FlightStats totalFlightStats[maxCompany+1]{};
-    long chargeCounts[maxCompany+1]{};
-    ChargerStats totalChargerStats[maxCompany+1]{};
-    // initialize the totals
-    for(auto c: allCompany) {
-        totalFlightStats[c].theCompany = c;
-        totalChargerStats[c].theCompany = c;
+
+    // With a fault bias, the weight of the run is the product of its planes' weights
+    for(const std::shared_ptr<Plane> &aPlane: weightedPlanes) {
+        faultLogWeight += aPlane->getFaultLogWeight();
     }
+    weightedPlanes.clear();
+    
+    // First summarize the flight stat data and charger stat data.
+    // We keep totals for each company across all sites and for each company at each site,
+    // filling both in one pass over the stats. A run that switched to streaming has already
+    // added them all up.
     if(verbose) {
         std::cout << "***** List of flights *****" << std::endl;
+        if(streaming) {
+            std::cout << "Not kept, the run switched to streaming aggregation at " << theMemory.streamingSince << " seconds" << std::endl;
+        }
     }
     // Total the statistics from each flight
-    for(FlightStats f: theFlightStats) {
+    for(const FlightStats &f: theFlightStats) {
         using namespace std;
-        Company c{f.theCompany};
-        flightCounts[c]++;
-        totalFlightStats[c].duration += f.duration;
-        totalFlightStats[c].passengerCount += f.passengerCount;
-        totalFlightStats[c].faultCount += f.faultCount;
-        totalFlightStats[c].passengerMiles += f.passengerMiles;
+        theTotals.addFlight(f);
         // In verbose mode we list each flight
         if(verbose) {
             cout << "Duration: " << setw(10) << f.duration
@@ -89,27 +577,35 @@ std::vector<FinalStats> Simulation::run(bool verbose)
             << " Passenger Miles: " << setw(10) << f.passengerMiles
             << " Faults: " << setw(3) << f.faultCount
             << " Plane #" << left << setw(3) << f.planeNumber
-            << " " << companyName(f.theCompany) << endl;
+            << " " << companyName(f.theCompany);
+            if(siteCount > 1) {
+                cout << " Site " << f.siteNumber;
+            }
+            cout << endl;
         }
     }
     
     if(verbose) {
         std::cout << std::endl;
         std::cout << "***** List of charges *****" << std::endl;
+        if(streaming) {
+            std::cout << "Not kept, the run switched to streaming aggregation at " << theMemory.streamingSince << " seconds" << std::endl;
+        }
     }
     // Total the statistics from each charge
-    for(ChargerStats cs: theChargerStats) {
+    for(const ChargerStats &cs: theChargerStats) {
         using namespace std;
-        Company c{cs.theCompany};
-        chargeCounts[c]++;
-        totalChargerStats[c].duration += cs.duration;
-        totalChargerStats[c].durationWithWait += cs.durationWithWait;
+        theTotals.addCharge(cs);
         // In verbose mode we list each charge
         if(verbose) {
             cout << "Charge Duration: " << setw(10) << cs.duration
             << "Duration+Wait: " << setw(10) << cs.durationWithWait
             << " Plane #" << left << setw(3) << cs.planeNumber
-            << " " << companyName(cs.theCompany) << endl;
+            << " " << companyName(cs.theCompany);
+            if(siteCount > 1) {
+                cout << " Site " << cs.siteNumber;
+            }
+            cout << endl;
         }
     }
     if(verbose) {
@@ -131,39 +627,165 @@ std::vector<FinalStats> Simulation::run(bool verbose)
     // };
     // Now summarize the results
     // We transfer from a total of the individual flights and charges to results
-    // Some of them want grand totals and some of them want averages
     std::vector<FinalStats> returnValue{};
-    extern PlaneSpecification planeSpecifications[];
     long totalFlights{0};
     long totalCharges{0};
     for(auto c: allCompany) {
-        totalFlights += flightCounts[c];
-        totalCharges += chargeCounts[c];
-        double flightCountD = flightCounts[c]; // so we do floating point math
-        if(flightCountD <= 0) flightCountD = 1.0; // so we avoid division by 0
-        double chargeCountD = chargeCounts[c]; // so we do floating point math
-        if(chargeCountD <= 0) chargeCountD = 1.0; // so we avoid division by 0
-        double averageTime = totalFlightStats[c].duration/flightCountD;
-        FinalStats stats{c,  flightCounts[c], averageTime,
-            averageTime * planeSpecifications[c].cruise_speed__mph / secondsPerHourD,
-            chargeCounts[c],
-            totalChargerStats[c].duration / chargeCountD,
-            totalChargerStats[c].durationWithWait / chargeCountD,
-            totalFlightStats[c].faultCount,
-            totalFlightStats[c].passengerMiles};
-        returnValue.push_back(stats);
+        totalFlights += theTotals.flightCounts[c];
+        totalCharges += theTotals.chargeCounts[c];
+        returnValue.push_back(makeFinalStats(c, theTotals.flightCounts[c], theTotals.flightTotals[c], theTotals.chargeCounts[c], theTotals.chargerTotals[c]));
+    }
+    // And the same for each site
+    siteResults.assign(siteCount, std::vector<FinalStats>{});
+    for(long site = 0; site < siteCount; site++) {
+        for(auto c: allCompany) {
+            long s = site * companyCount + c;
+            siteResults[site].push_back(makeFinalStats(c, theTotals.siteFlightCounts[s], theTotals.siteFlightTotals[s],
+                                                       theTotals.siteChargeCounts[s], theTotals.siteChargerTotals[s]));
+        }
     }
     
+#if SIMPROFILE
+    if(theProfile.enabled) {
+        theProfile.aggregationSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - stopTimer).count();
+    }
+#endif
+
     // Output a short summary of the overall simulation.
     // We let the caller output the more detailed statistics.
-    std::cout << "Final simulated time: " << theSimClock->getTime() << " seconds (" <<
-    theSimClock->getTime()/(secondsPerHourD) << " hours)" << std::endl;
-    std::cout << totalFlights << " flights and " << totalCharges << " charges" << std::endl;
-    std::cout << std::endl;
+    if(!quiet) {
+        std::cout << "Final simulated time: " << finalTime << " seconds (" <<
+        finalTime/(secondsPerHourD) << " hours)" << std::endl;
+        std::cout << totalFlights << " flights and " << totalCharges << " charges" << std::endl;
+        std::cout << "Random seed: " << theSeed << std::endl;
+        if(!engineNote.empty()) {
+            std::cout << "Engine: " << engineNote << std::endl;
+        }
+        if(theMemory.stoppedAt >= 0) {
+            std::cout << "Stopped early for going over the memory budget of " << theSettings->memoryBudgetMB << " MB" << std::endl;
+        }
+        std::cout << std::endl;
+    }
     
     return returnValue;
 }
 
+// Run the FastEngine to pauseTime and keep it there for branch() or finish()
+long Simulation::pauseAt(long pauseTime) {
+    if(!FastEngine::canBranch(*theSettings, theTrace)) {
+        return -1;
+    }
+    std::vector<std::vector<Company>> siteCompanies = startRun();
+    theProfile = SimProfile{};
+    pausedEngine.reset(new FastEngine(this));
+    pausedEngine->start(siteCompanies);
+    pausedTime = pausedEngine->runUntil(std::max(0L, std::min(pauseTime, theSettings->simulationDuration)));
+    pausedEvents = pausedEngine->getEventCount();
+    eventCount = pausedEvents;
+    return pausedTime;
+}
+
+// A copy of this paused Simulation with someSettings, counted in its own memory
+std::unique_ptr<Simulation> Simulation::copyPaused(const SimSettings &someSettings) {
+    std::unique_ptr<Simulation> aCopy(new Simulation(someSettings));
+    aCopy->theMemory.startRun(someSettings.memoryBudgetMB * 1024 * 1024);
+    aCopy->theSeed = theSeed;
+    aCopy->theRandom = theRandom;
+    aCopy->planesMade = planesMade;
+    std::copy(std::begin(companyPlanes), std::end(companyPlanes), std::begin(aCopy->companyPlanes));
+    std::copy(std::begin(companyGrounded), std::end(companyGrounded), std::begin(aCopy->companyGrounded));
+    aCopy->theFlightStats.assign(begin(theFlightStats), end(theFlightStats));
+    aCopy->theChargerStats.assign(begin(theChargerStats), end(theChargerStats));
+    aCopy->theTotals = theTotals;
+    aCopy->streaming = streaming;
+    aCopy->quiet = quiet;
+    aCopy->pausedEngine.reset(new FastEngine(*pausedEngine, aCopy.get()));
+    aCopy->pausedTime = pausedTime;
+    aCopy->pausedEvents = pausedEvents;
+    aCopy->eventCount = pausedEvents;
+    return aCopy;
+}
+
+// A copy of this paused Simulation whose planes have new random numbers for branchNumber
+std::unique_ptr<Simulation> Simulation::branch(uint64_t branchNumber) {
+    if(!pausedEngine) {
+        return nullptr;
+    }
+    std::unique_ptr<Simulation> aBranch = copyPaused(*theSettings);
+    aBranch->pausedEngine->reseed(branchNumber);
+    aBranch->engineNote = "branch " + std::to_string(branchNumber);
+    return aBranch;
+}
+
+// A copy of this paused Simulation with aDelta applied at the pause
+std::unique_ptr<Simulation> Simulation::whatIf(const SimDelta &aDelta) {
+    if(!pausedEngine || static_cast<long>(aDelta.addedPlanes.size()) > std::max(1L, theSettings->siteCount)) {
+        return nullptr;
+    }
+    SimSettings newSettings = *theSettings;
+    if(aDelta.chargerCount >= 0) { newSettings.chargerCount = aDelta.chargerCount; }
+    if(aDelta.maxPassengerDelay >= 0) { newSettings.maxPassengerDelay = aDelta.maxPassengerDelay; }
+    if(aDelta.faultOption >= 0) { newSettings.faultOption = aDelta.faultOption; }
+    for(const std::vector<Company> &sitePlanes: aDelta.addedPlanes) {
+        newSettings.planeCount += static_cast<long>(sitePlanes.size());
+    }
+    std::unique_ptr<Simulation> aWhatIf = copyPaused(newSettings);
+    aWhatIf->pausedEngine->applyDelta(aDelta);
+    aWhatIf->engineNote = "what-if " + aDelta.describe();
+    return aWhatIf;
+}
+
+// A short description of the changes in a SimDelta
+std::string SimDelta::describe() const {
+    std::ostringstream description;
+    const char *separator = "";
+    if(chargerCount >= 0) {
+        description << separator << chargerCount << " chargers";
+        separator = ", ";
+    }
+    if(maxPassengerDelay >= 0) {
+        description << separator << "passenger delay " << maxPassengerDelay << " s";
+        separator = ", ";
+    }
+    if(faultOption >= 0) {
+        description << separator << "fault option " << faultOption;
+        separator = ", ";
+    }
+    size_t added = 0;
+    for(const std::vector<Company> &sitePlanes: addedPlanes) {
+        added += sitePlanes.size();
+    }
+    if(added > 0) {
+        description << separator << added << " more planes";
+        separator = ", ";
+    }
+    return *separator ? description.str() : "no change";
+}
+
+// Run a paused Simulation or a branch to the end and add up the whole run
+std::vector<FinalStats> Simulation::finish() {
+    if(!pausedEngine) {
+        std::cout << "Error in Simulation::finish(): the Simulation is not paused" << std::endl;
+        return std::vector<FinalStats>{};
+    }
+    auto startTimer = std::chrono::high_resolution_clock::now();
+    progressStartWall = std::chrono::steady_clock::now();
+    progressStartTime = pausedTime;
+    pausedEngine->runUntil(theSettings->simulationDuration);
+    long finalTime = pausedEngine->closeOut();
+    eventCount = pausedEngine->getEventCount();
+    std::ostringstream noteStream;
+    noteStream << (engineNote.empty() ? "" : engineNote + " ") << "from a run paused at " << pausedTime / secondsPerHourD
+    << " hours, " << eventCount - pausedEvents << " events after the pause";
+    if(!pausedEngine->getNote().empty()) {
+        noteStream << "; " << pausedEngine->getNote();
+    }
+    engineNote = noteStream.str();
+    pausedEngine.reset();
+    pausedTime = -1;
+    return finishRun(false, finalTime, startTimer);
+}
+
 // How often do we show progress indicator (<= 0 means not at all)
 // This decides it based on settings
 long Simulation::getProgressInterval() {
@@ -174,3 +796,29 @@ long Simulation::getProgressInterval() {
     }
     return 0;
 }
+
+// Wall-clock seconds as h:mm:ss, or m:ss under an hour
+static std::string wallClockText(double seconds) {
+    long whole = static_cast<long>(seconds + 0.5);
+    std::ostringstream text;
+    if(whole >= 3600) {
+        text << whole / 3600 << ":" << std::setw(2) << std::setfill('0') << (whole / 60) % 60;
+    } else {
+        text << whole / 60;
+    }
+    text << ":" << std::setw(2) << std::setfill('0') << whole % 60;
+    return text.str();
+}
+
+// The line is written over the last one with '\r', so it ends with spaces to clear a longer one
+void Simulation::showProgress(long clockTime, long endTime) {
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - progressStartWall).count();
+    std::ostringstream line;
+    line << "Simulation Clock Time = " << clockTime/secondsPerHour << " of " << endTime/secondsPerHour
+    << " hours, " << wallClockText(wallSeconds) << " so far";
+    if(clockTime > progressStartTime) {
+        double secondsLeft = wallSeconds * (endTime - clockTime) / (clockTime - progressStartTime);
+        line << ", about " << wallClockText(secondsLeft) << " left";
+    }
+    std::cout << "\r" << line.str() << "      " << std::flush;
+}